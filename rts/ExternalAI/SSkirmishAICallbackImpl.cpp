@@ -195,13 +195,12 @@ static float getRulesParamFloatValueByName(
 	float defaultValue
 ) {
 	float value = defaultValue;
-	const std::string key(rulesParamName);
-	auto it = params.find(key);
-	if (it == params.end())
+	const LuaRulesParams::Param* param = params.Find(rulesParamName);
+	if (param == nullptr)
 		return value;
 
-	if (modParamIsVisible(it->second, losMask))
-		value = it->second.valueInt;
+	if (modParamIsVisible(*param, losMask))
+		value = param->valueInt;
 
 	return value;
 }
@@ -213,13 +212,12 @@ static const char* getRulesParamStringValueByName(
 	const char* defaultValue
 ) {
 	const char* value = defaultValue;
-	const std::string key(rulesParamName);
-	auto it = params.find(key);
-	if (it == params.end())
+	const LuaRulesParams::Param* param = params.Find(rulesParamName);
+	if (param == nullptr)
 		return value;
 
-	if (modParamIsVisible(it->second, losMask))
-		value = it->second.valueString.c_str();
+	if (modParamIsVisible(*param, losMask))
+		value = param->valueString.c_str();
 
 	return value;
 }
@@ -3848,7 +3846,7 @@ EXPORT(int) skirmishAiCallback_Unit_CurrentCommand_getParams(
 	if (!CHECK_COMMAND_ID(q, commandId))
 		return -1;
 
-	const std::vector<float>& ps = q->at(commandId).params;
+	const CommandParams& ps = q->at(commandId).params;
 	const int paramsRealSize = ps.size();
 
 	size_t paramsSize = paramsRealSize;
@@ -5198,7 +5196,7 @@ EXPORT(int) skirmishAiCallback_Group_OrderPreview_getParams(
 	if (!isControlledByLocalPlayer(skirmishAIId))
 		return 0;
 
-	const std::vector<float>& ps = guihandler->GetOrderPreview().params;
+	const CommandParams& ps = guihandler->GetOrderPreview().params;
 	const int paramsRealSize = ps.size();
 
 	size_t paramsSize = paramsRealSize;
@@ -0,0 +1,248 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+#include "DemoAnalysis.h"
+
+#include "Lua/LuaHandleSynced.h"
+#include "Lua/LuaRulesParams.h"
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/Team.h"
+#include "Sim/Misc/TeamHandler.h"
+#include "System/Log/ILog.h"
+#include "System/Net/RawPacket.h"
+
+bool CDemoAnalysis::enabled = false;
+std::string CDemoAnalysis::outputFile;
+
+
+static void WriteString(FILE* file, const std::string& str)
+{
+	fputc('"', file);
+
+	for (const char c: str) {
+		switch (c) {
+			case '"' : { fputs("\\\"", file); } break;
+			case '\\': { fputs("\\\\", file); } break;
+			case '\n': { fputs("\\n" , file); } break;
+			case '\r': { fputs("\\r" , file); } break;
+			case '\t': { fputs("\\t" , file); } break;
+			default: {
+				if (static_cast<unsigned char>(c) < 0x20) {
+					fprintf(file, "\\u%04x", c);
+				} else {
+					fputc(c, file);
+				}
+			} break;
+		}
+	}
+
+	fputc('"', file);
+}
+
+static void WriteNumber(FILE* file, float value)
+{
+	// JSON has no representation for these
+	if (std::isfinite(value)) {
+		fprintf(file, "%.9g", value);
+	} else {
+		fputs("null", file);
+	}
+}
+
+static void WriteRulesParams(FILE* file, const LuaRulesParams::Params& params)
+{
+	bool first = true;
+
+	fputc('{', file);
+
+	for (size_t i = 0; i < params.size(); i++) {
+		const LuaRulesParams::Param& param = params.GetParam(i);
+
+		if (param.erased)
+			continue;
+
+		fputs(first? "": ", ", file);
+		WriteString(file, params.GetName(i));
+		fputs(": ", file);
+
+		// same typing as Spring.GetGameRulesParam
+		if (!param.valueString.empty()) {
+			WriteString(file, param.valueString);
+		} else {
+			WriteNumber(file, param.valueInt);
+		}
+
+		first = false;
+	}
+
+	fputc('}', file);
+}
+
+static void WriteTeamStatistics(FILE* file, const TeamStatistics& stats)
+{
+	fprintf(file, "{\"frame\": %d", stats.frame);
+
+	#define WRITE_FLOAT_STAT(name) { fputs(", \"" #name "\": ", file); WriteNumber(file, stats.name); }
+	#define WRITE_INT_STAT(name) { fprintf(file, ", \"" #name "\": %d", stats.name); }
+
+	WRITE_FLOAT_STAT(metalUsed);
+	WRITE_FLOAT_STAT(energyUsed);
+	WRITE_FLOAT_STAT(metalProduced);
+	WRITE_FLOAT_STAT(energyProduced);
+	WRITE_FLOAT_STAT(metalExcess);
+	WRITE_FLOAT_STAT(energyExcess);
+	WRITE_FLOAT_STAT(metalReceived);
+	WRITE_FLOAT_STAT(energyReceived);
+	WRITE_FLOAT_STAT(metalSent);
+	WRITE_FLOAT_STAT(energySent);
+	WRITE_FLOAT_STAT(damageDealt);
+	WRITE_FLOAT_STAT(damageReceived);
+	WRITE_INT_STAT(unitsProduced);
+	WRITE_INT_STAT(unitsDied);
+	WRITE_INT_STAT(unitsReceived);
+	WRITE_INT_STAT(unitsSent);
+	WRITE_INT_STAT(unitsCaptured);
+	WRITE_INT_STAT(unitsOutCaptured);
+	WRITE_INT_STAT(unitsKilled);
+
+	#undef WRITE_INT_STAT
+	#undef WRITE_FLOAT_STAT
+
+	fputc('}', file);
+}
+
+
+
+CDemoAnalysis::CDemoAnalysis(const std::string& demoFile)
+	: CEventClient("[CDemoAnalysis]", 271991, false)
+	, demoReader(demoFile, 0.0f)
+	, demoFile(demoFile)
+	, startFrame(-1)
+	, startTime(spring_notime)
+	, gameOver(false)
+{
+	eventHandler.AddClient(this);
+}
+
+CDemoAnalysis::~CDemoAnalysis()
+{
+	eventHandler.RemoveClient(this);
+}
+
+
+void CDemoAnalysis::GameOver(const std::vector<unsigned char>& winners)
+{
+	winningAllyTeams = winners;
+	gameOver = true;
+}
+
+
+std::shared_ptr<const netcode::RawPacket> CDemoAnalysis::GetData(int frameNum)
+{
+	netcode::RawPacket* buf = nullptr;
+
+	// every chunk is due, there is no clock to wait for
+	while ((buf = demoReader.GetData(FLT_MAX)) != nullptr) {
+		std::shared_ptr<const netcode::RawPacket> packet(buf);
+
+		if (buf->length <= 0)
+			continue;
+
+		switch (buf->data[0]) {
+			case NETMSG_NEWFRAME:
+			case NETMSG_KEYFRAME: {
+				if (startFrame < 0) {
+					startFrame = frameNum;
+					startTime = spring_gettime();
+				}
+			} break;
+
+			// the server sent its own versions of these during the handshake
+			case NETMSG_GAMEDATA:
+			case NETMSG_SETPLAYERNUM:
+			case NETMSG_USER_SPEED:
+			case NETMSG_INTERNAL_SPEED: {
+				continue;
+			} break;
+
+			default: {
+			} break;
+		}
+
+		return packet;
+	}
+
+	return nullptr;
+}
+
+
+bool CDemoAnalysis::WriteResults(int frameNum) const
+{
+	const int numFrames = (startFrame < 0)? 0: (frameNum - startFrame);
+	const float wallTime = (startFrame < 0)? 0.0f: (spring_gettime() - startTime).toSecsf();
+	const float simFPS = numFrames / std::max(wallTime, 0.001f);
+
+	LOG("[DemoAnalysis] simulated %d frames in %.2f seconds (%.1f frames per second)", numFrames, wallTime, simFPS);
+
+	FILE* file = fopen(outputFile.c_str(), "w");
+
+	if (file == nullptr) {
+		LOG_L(L_ERROR, "[DemoAnalysis] could not open \"%s\" for writing", outputFile.c_str());
+		return false;
+	}
+
+	fputs("{\n\t\"demo\": ", file);
+	WriteString(file, demoFile);
+	fprintf(file, ",\n\t\"frames\": %d", numFrames);
+	fprintf(file, ",\n\t\"gameSeconds\": %.2f", numFrames / float(GAME_SPEED));
+	fprintf(file, ",\n\t\"wallSeconds\": %.3f", wallTime);
+	fprintf(file, ",\n\t\"simFramesPerSecond\": %.1f", simFPS);
+	fprintf(file, ",\n\t\"gameOver\": %s", gameOver? "true": "false");
+	fputs(",\n\t\"winningAllyTeams\": [", file);
+
+	for (size_t n = 0; n < winningAllyTeams.size(); n++) {
+		fprintf(file, "%s%d", (n == 0)? "": ", ", winningAllyTeams[n]);
+	}
+
+	fputs("],\n\t\"rulesParams\": ", file);
+	WriteRulesParams(file, CLuaHandleSynced::GetGameParams());
+	fputs(",\n\t\"teams\": [", file);
+
+	std::vector<TeamStatistics> history;
+
+	for (int teamNum = 0; teamNum < teamHandler->ActiveTeams(); teamNum++) {
+		const CTeam* team = teamHandler->Team(teamNum);
+
+		fprintf(file, "%s\n\t\t{\"team\": %d", (teamNum == 0)? "": ",", teamNum);
+		fprintf(file, ", \"allyTeam\": %d", teamHandler->AllyTeam(teamNum));
+		fprintf(file, ", \"gaia\": %s", team->gaia? "true": "false");
+		fprintf(file, ", \"dead\": %s", team->isDead? "true": "false");
+		fputs(", \"side\": ", file);
+		WriteString(file, team->GetSide());
+		fputs(", \"rulesParams\": ", file);
+		WriteRulesParams(file, team->modParams);
+		fputs(", \"stats\": [", file);
+
+		// one entry per TeamStatistics::statsPeriod, the last one is still being filled
+		team->statHistory.GetRange(0, team->statHistory.size() - 1, history);
+
+		for (size_t n = 0; n < history.size(); n++) {
+			fputs((n == 0)? "\n\t\t\t": ",\n\t\t\t", file);
+			WriteTeamStatistics(file, history[n]);
+		}
+
+		fputs("\n\t\t]}", file);
+	}
+
+	fputs("\n\t]\n}\n", file);
+
+	const bool ok = (ferror(file) == 0);
+
+	fclose(file);
+	return ok;
+}
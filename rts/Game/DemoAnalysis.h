@@ -0,0 +1,70 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _DEMO_ANALYSIS_H
+#define _DEMO_ANALYSIS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "System/EventHandler.h"
+#include "System/LoadSave/DemoReader.h"
+#include "System/Misc/SpringTime.h"
+
+namespace netcode {
+	class RawPacket;
+}
+
+/**
+ * Replays a demo as fast as the simulation allows (--analyze-demo).
+ *
+ * The local server only performs the handshake, after that CGame reads
+ * the demo packets straight from here instead of receiving them paced
+ * by the server clock, and skips all unsynced per-frame work.
+ * Once the demo ends the team statistics and the (game and team) rules
+ * params set by synced Lua are written as JSON to <outputFile>, along
+ * with the simulation throughput.
+ */
+class CDemoAnalysis : public CEventClient
+{
+public:
+	static bool enabled;
+	static std::string outputFile;
+
+public:
+	CDemoAnalysis(const std::string& demoFile);
+	~CDemoAnalysis();
+
+	// CEventClient interface
+	bool WantsEvent(const std::string& eventName) {
+		return (eventName == "GameOver");
+	}
+	bool GetFullRead() const { return true; }
+	int  GetReadAllyTeam() const { return AllAccessTeam; }
+
+	void GameOver(const std::vector<unsigned char>& winningAllyTeams);
+
+	/**
+	 * @brief next packet of the demo, filtered like CGameServer::SendDemoData
+	 * @return null once the demo has ended
+	 */
+	std::shared_ptr<const netcode::RawPacket> GetData(int frameNum);
+	bool ReachedEnd() { return demoReader.ReachedEnd(); }
+
+	/// writes the results, returns false if the file could not be written
+	bool WriteResults(int frameNum) const;
+
+private:
+	CDemoReader demoReader;
+	std::string demoFile;
+
+	std::vector<unsigned char> winningAllyTeams;
+
+	/// frame and time the first NETMSG_NEWFRAME was read at
+	int startFrame;
+	spring_time startTime;
+
+	bool gameOver;
+};
+
+#endif // _DEMO_ANALYSIS_H
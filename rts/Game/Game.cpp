@@ -12,6 +12,7 @@
 #include "ChatMessage.h"
 #include "CommandMessage.h"
 #include "ConsoleHistory.h"
+#include "DemoAnalysis.h"
 #include "GameHelper.h"
 #include "GameSetup.h"
 #include "GlobalUnsynced.h"
@@ -116,10 +117,12 @@
 #include "System/LoadSave/LoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/Log/ILog.h"
+#include "System/Platform/errorhandler.h"
 #include "System/Platform/Watchdog.h"
 #include "System/Sound/ISound.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/DumpState.h"
+#include "System/Sync/SyncChecker.h"
 #include "System/TimeProfiler.h"
 
 
@@ -196,6 +199,7 @@ CR_REG_METADATA(CGame, (
 	CR_IGNORED(worldDrawer),
 	CR_IGNORED(defsParser),
 	CR_IGNORED(saveFile),
+	CR_IGNORED(demoAnalysis),
 
 	// from CGameController
 	CR_IGNORED(writingPos),
@@ -245,6 +249,7 @@ CGame::CGame(const std::string& mapName, const std::string& modName, ILoadSaveHa
 	, worldDrawer(NULL)
 	, defsParser(NULL)
 	, saveFile(saveFile)
+	, demoAnalysis(nullptr)
 	, finishedLoading(false)
 	, gameOver(false)
 {
@@ -758,6 +763,12 @@ void CGame::LoadFinalize()
 		benchmark.ResetState();
 	}
 
+	if (CDemoAnalysis::enabled && gameSetup->hostDemo && gameServer != nullptr) {
+		// from here on the demo is read by us, the server only keeps the connection
+		demoAnalysis = new CDemoAnalysis(gameSetup->demoName);
+		gameServer->SetDemoReadByClient();
+	}
+
 	lastReadNetTime = spring_gettime();
 	lastSimFrameTime = lastReadNetTime;
 	lastDrawFrameTime = lastReadNetTime;
@@ -808,6 +819,7 @@ void CGame::KillMisc()
 	LOG("[Game::%s][1]", __func__);
 	CEndGameBox::Destroy();
 	IVideoCapturing::FreeInstance();
+	SafeDelete(demoAnalysis);
 
 	LOG("[Game::%s][2]", __func__);
 	// delete this first since AI's might call back into sim-components in their dtors
@@ -1042,6 +1054,11 @@ bool CGame::Update()
 	SendClientProcUsage();
 	ClientReadNet(); // this can issue new SimFrame()s
 
+	if (demoAnalysis != nullptr && demoAnalysis->ReachedEnd() && !gu->globalQuit) {
+		SetExitCode(demoAnalysis->WriteResults(gs->frameNum)? 0: 1);
+		gu->globalQuit = true;
+	}
+
 	if (!gameOver) {
 		if (clientNet->NeedsReconnect()) {
 			clientNet->AttemptReconnect(SpringVersion::GetFull());
@@ -1096,6 +1113,10 @@ bool CGame::UpdateUnsynced(const spring_time currentTime)
 		}
 	}
 
+	// nothing is drawn while analysing a demo
+	if (demoAnalysis != nullptr)
+		return true;
+
 	if (skipping) {
 		// when fast-forwarding, maintain a draw-rate of 2Hz
 		if (spring_tomsecs(currentTime - skipLastDrawTime) < 500.0f)
@@ -1526,7 +1547,7 @@ void CGame::SimFrame() {
 	tracefile << "New frame:" << gs->frameNum << " " << gsRNG.GetSeed() << "\n";
 #endif
 
-	if (!skipping) {
+	if (!skipping && demoAnalysis == nullptr) {
 		// everything here is unsynced and should ideally moved to Game::Update()
 		waitCommandsAI.Update();
 		geometricObjects->Update();
@@ -1542,23 +1563,33 @@ void CGame::SimFrame() {
 	}
 
 	// everything from here is simulation
+	// (the checksum at each section end is what gets compared on a desync)
+	SYNC_SECTION_END(SYNC_SECTION_INPUT);
 	{
 		SCOPED_SPECIAL_TIMER("Sim");
 		{
 			SCOPED_TIMER("Sim::GameFrame");
 			eventHandler.GameFrame(gs->frameNum);
 		}
+		SYNC_SECTION_END(SYNC_SECTION_LUA);
 		helper->Update();
 		mapDamage->Update();
+		smoothGround->Update();
+		SYNC_SECTION_END(SYNC_SECTION_MAPDAMAGE);
 		pathManager->Update();
+		SYNC_SECTION_END(SYNC_SECTION_PATH);
 		unitHandler->Update();
+		SYNC_SECTION_END(SYNC_SECTION_UNITS);
 		projectileHandler->Update();
+		SYNC_SECTION_END(SYNC_SECTION_PROJECTILES);
 		featureHandler->Update();
+		SYNC_SECTION_END(SYNC_SECTION_FEATURES);
 		{
 			SCOPED_TIMER("Sim::Script");
 			cobEngine->Tick(33);
 			unitScriptEngine->Tick(33);
 		}
+		SYNC_SECTION_END(SYNC_SECTION_SCRIPTS);
 		wind.Update();
 		losHandler->Update();
 		// dead ghosts have to be updated in sim, after los,
@@ -1566,9 +1597,11 @@ void CGame::SimFrame() {
 		// should probably be split from drawer
 		unitDrawer->UpdateGhostedBuildings();
 		interceptHandler.Update(false);
+		SYNC_SECTION_END(SYNC_SECTION_LOS);
 
 		teamHandler->GameFrame(gs->frameNum);
 		playerHandler->GameFrame(gs->frameNum);
+		SYNC_SECTION_END(SYNC_SECTION_TEAMS);
 	}
 
 	lastSimFrameTime = spring_gettime();
@@ -1578,7 +1611,7 @@ void CGame::SimFrame() {
 	eventHandler.DbgTimingInfo(TIMING_SIM, lastFrameTime, lastSimFrameTime);
 
 	#ifdef HEADLESS
-	{
+	if (demoAnalysis == nullptr) {
 		const float msecMaxSimFrameTime = 1000.0f / (GAME_SPEED * gs->wantedSpeedFactor);
 		const float msecDifSimFrameTime = (lastSimFrameTime - lastFrameTime).toMilliSecsf();
 		// multiply by 0.5 to give unsynced code some execution time (50% of our sleep-budget)
@@ -19,6 +19,7 @@ class ILoadSaveHandler;
 class Action;
 class ChatMessage;
 class CWorldDrawer;
+class CDemoAnalysis;
 
 
 class CGame : public CGameController
@@ -227,6 +228,9 @@ private:
 	/// for reloading the savefile
 	ILoadSaveHandler* saveFile;
 
+	/// reads the demo directly when running with --analyze-demo
+	CDemoAnalysis* demoAnalysis;
+
 	volatile bool finishedLoading;
 	bool gameOver;
 };
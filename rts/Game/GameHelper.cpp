@@ -39,6 +39,9 @@
 #include "System/myMath.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/SyncTracer.h"
+#include "System/TimeProfiler.h"
+
+#include <type_traits>
 
 #define NUM_WAITING_DAMAGE_LISTS 128
 
@@ -50,6 +53,7 @@ CGameHelper* helper;
 
 
 CGameHelper::CGameHelper()
+	: inExplosion(false)
 {
 	waitingDamageLists.resize(NUM_WAITING_DAMAGE_LISTS);
 }
@@ -81,6 +85,25 @@ float CGameHelper::CalcImpulseScale(const DamageArray& damages, const float expD
 	return Clamp(rawImpulseScale, -MAX_EXPLOSION_IMPULSE, MAX_EXPLOSION_IMPULSE);
 }
 
+template<typename T>
+static bool CalcExplosionHit(T* object, const float3& expPos, const float expRadius, float3& volPos, float& expDist)
+{
+	const LocalModelPiece* lhp = object->GetLastHitPiece(gs->frameNum);
+	const CollisionVolume* vol = object->GetCollisionVolume(lhp);
+
+	const float3& lhpPos = (lhp != NULL && vol == lhp->GetCollisionVolume())? lhp->GetAbsolutePos(): ZeroVector;
+
+	// features are always treated as a whole
+	const LocalModelPiece* distPiece = std::is_same<T, CUnit>::value? lhp: NULL;
+
+	volPos = vol->GetWorldSpacePos(object, lhpPos);
+	expDist = (expRadius != 0.0f) ? vol->GetPointSurfaceDistance(object, distPiece, expPos) : 0.0f;
+
+	// return early if (distance > radius)
+	return (expDist <= expRadius);
+}
+
+
 void CGameHelper::DoExplosionDamage(
 	CUnit* unit,
 	CUnit* owner,
@@ -98,20 +121,52 @@ void CGameHelper::DoExplosionDamage(
 	if (ignoreOwner && (unit == owner))
 		return;
 
-	const LocalModelPiece* lhp = unit->GetLastHitPiece(gs->frameNum);
-	const CollisionVolume* vol = unit->GetCollisionVolume(lhp);
+	float3 volPos;
+	float expDist;
 
-	const float3& lhpPos = (lhp != NULL && vol == lhp->GetCollisionVolume())? lhp->GetAbsolutePos(): ZeroVector;
-	const float3& volPos = vol->GetWorldSpacePos(unit, lhpPos);
+	if (!CalcExplosionHit(unit, expPos, expRadius, volPos, expDist))
+		return;
 
-	// linear damage falloff with distance
-	const float expDist = (expRadius != 0.0f) ? vol->GetPointSurfaceDistance(unit, lhp, expPos) : 0.0f;
-	const float expRim = expDist * expEdgeEffect;
+	ApplyExplosionDamage(unit, owner, expPos, volPos, expDist, expRadius, expSpeed, expEdgeEffect, damages, weaponDefID, projectileID);
+}
 
-	// return early if (distance > radius)
-	if (expDist > expRadius)
+void CGameHelper::DoExplosionDamage(
+	CFeature* feature,
+	CUnit* owner,
+	const float3& expPos,
+	const float expRadius,
+	const float expEdgeEffect,
+	const DamageArray& damages,
+	const int weaponDefID,
+	const int projectileID
+) {
+	assert(feature != NULL);
+
+	float3 volPos;
+	float expDist;
+
+	if (!CalcExplosionHit(feature, expPos, expRadius, volPos, expDist))
 		return;
 
+	ApplyExplosionDamage(feature, owner, expPos, volPos, expDist, expRadius, expEdgeEffect, damages, weaponDefID, projectileID);
+}
+
+void CGameHelper::ApplyExplosionDamage(
+	CUnit* unit,
+	CUnit* owner,
+	const float3& expPos,
+	const float3& volPos,
+	const float expDist,
+	const float expRadius,
+	const float expSpeed,
+	const float expEdgeEffect,
+	const DamageArray& damages,
+	const int weaponDefID,
+	const int projectileID
+) {
+	// linear damage falloff with distance
+	const float expRim = expDist * expEdgeEffect;
+
 	// expEdgeEffect should be in [0, 1], so expRadius >= expDist >= expDist*expEdgeEffect
 	assert(expRadius >= expRim);
 
@@ -141,30 +196,20 @@ void CGameHelper::DoExplosionDamage(
 	}
 }
 
-void CGameHelper::DoExplosionDamage(
+void CGameHelper::ApplyExplosionDamage(
 	CFeature* feature,
 	CUnit* owner,
 	const float3& expPos,
+	const float3& volPos,
+	const float expDist,
 	const float expRadius,
 	const float expEdgeEffect,
 	const DamageArray& damages,
 	const int weaponDefID,
 	const int projectileID
 ) {
-	assert(feature != NULL);
-
-	const LocalModelPiece* lhp = feature->GetLastHitPiece(gs->frameNum);
-	const CollisionVolume* vol = feature->GetCollisionVolume(lhp);
-
-	const float3& lhpPos = (lhp != NULL && vol == lhp->GetCollisionVolume())? lhp->GetAbsolutePos(): ZeroVector;
-	const float3& volPos = vol->GetWorldSpacePos(feature, lhpPos);
-
-	const float expDist = (expRadius != 0.0f) ? vol->GetPointSurfaceDistance(feature, NULL, expPos) : 0.0f;
 	const float expRim = expDist * expEdgeEffect;
 
-	if (expDist > expRadius)
-		return;
-
 	assert(expRadius >= expRim);
 
 	const float expDistanceMod = (expRadius + 0.001f - expDist) / (expRadius + 0.001f - expRim);
@@ -183,36 +228,65 @@ void CGameHelper::DamageObjectsInExplosionRadius(
 	const float expRad,
 	const int weaponDefID
 ) {
-	static std::vector<CUnit*> unitCache;
-	static std::vector<CFeature*> featureCache;
+	assert(explosionUnitHits.empty() && explosionFeatureHits.empty());
 
-	const unsigned int oldNumUnits = unitCache.size();
-	const unsigned int oldNumFeatures = featureCache.size();
+	explosionUnits.clear();
+	explosionFeatures.clear();
 
-	quadField->GetUnitsAndFeaturesColVol(params.pos, expRad, unitCache, featureCache);
+	quadField->GetUnitsAndFeaturesColVol(params.pos, expRad, explosionUnits, explosionFeatures);
 
-	const unsigned int newNumUnits = unitCache.size();
-	const unsigned int newNumFeatures = featureCache.size();
+	// first find everything within the explosion radius, then damage it;
+	// damage can not cause further explosions before all hits are known
+	// (those are queued by Explosion) so the order of the two does not
+	// matter for which objects are hit
+	for (CUnit* unit: explosionUnits) {
+		if (params.ignoreOwner && (unit == params.owner))
+			continue;
 
-	// damage all units within the explosion radius
-	// NOTE:
-	//   this can recursively trigger ::Explosion() again
-	//   which would overwrite our object cache if we did
-	//   not keep track of end-markers --> certain objects
-	//   would not be damaged AT ALL (!)
-	for (unsigned int n = oldNumUnits; n < newNumUnits; n++)
-		DoExplosionDamage(unitCache[n], params.owner, params.pos, expRad, params.explosionSpeed, params.edgeEffectiveness, params.ignoreOwner, params.damages, weaponDefID, params.projectileID);
+		ExplosionHit<CUnit> hit = {unit, ZeroVector, 0.0f};
 
-	unitCache.resize(oldNumUnits);
+		if (CalcExplosionHit(unit, params.pos, expRad, hit.volPos, hit.distance))
+			explosionUnitHits.push_back(hit);
+	}
 
-	// damage all features within the explosion radius
-	for (unsigned int n = oldNumFeatures; n < newNumFeatures; n++)
-		DoExplosionDamage(featureCache[n], params.owner, params.pos, expRad, params.edgeEffectiveness, params.damages, weaponDefID, params.projectileID);
+	for (CFeature* feature: explosionFeatures) {
+		ExplosionHit<CFeature> hit = {feature, ZeroVector, 0.0f};
 
-	featureCache.resize(oldNumFeatures);
+		if (CalcExplosionHit(feature, params.pos, expRad, hit.volPos, hit.distance))
+			explosionFeatureHits.push_back(hit);
+	}
+
+	for (const ExplosionHit<CUnit>& hit: explosionUnitHits)
+		ApplyExplosionDamage(hit.object, params.owner, params.pos, hit.volPos, hit.distance, expRad, params.explosionSpeed, params.edgeEffectiveness, params.damages, weaponDefID, params.projectileID);
+
+	for (const ExplosionHit<CFeature>& hit: explosionFeatureHits)
+		ApplyExplosionDamage(hit.object, params.owner, params.pos, hit.volPos, hit.distance, expRad, params.edgeEffectiveness, params.damages, weaponDefID, params.projectileID);
+
+	explosionUnitHits.clear();
+	explosionFeatureHits.clear();
 }
 
 void CGameHelper::Explosion(const CExplosionParams& params) {
+	if (inExplosion) {
+		queuedExplosions.emplace_back(params);
+		return;
+	}
+
+	inExplosion = true;
+
+	// chain reactions are processed breadth-first in the order
+	// they were caused, without growing the stack for each link
+	DoExplosion(params);
+
+	while (!queuedExplosions.empty()) {
+		DoExplosion(queuedExplosions.front().params);
+		queuedExplosions.pop_front();
+	}
+
+	inExplosion = false;
+}
+
+void CGameHelper::DoExplosion(const CExplosionParams& params) {
 	const DamageArray& damages = params.damages;
 
 	// if weaponDef is NULL, this is a piece-explosion
@@ -617,8 +691,50 @@ namespace {
 } // end of namespace
 
 
+const std::vector<CGameHelper::TargetCandidate>& CGameHelper::GetTargetCandidates(int allyTeam, int quadIdx)
+{
+	if (targetCandidateQuads.size() != size_t(teamHandler->ActiveAllyTeams()))
+		targetCandidateQuads.resize(teamHandler->ActiveAllyTeams());
+
+	std::vector<TargetCandidateQuad>& allyTeamQuads = targetCandidateQuads[allyTeam];
+
+	if (allyTeamQuads.empty())
+		allyTeamQuads.resize(quadField->GetNumQuadsX() * quadField->GetNumQuadsZ(), {-1, {}});
+
+	TargetCandidateQuad& tcq = allyTeamQuads[quadIdx];
+
+	// units only move and change LOS state before the weapons
+	// search for targets (outside of Lua), so once per frame is
+	// enough
+	if (tcq.frameNum == gs->frameNum)
+		return tcq.candidates;
+
+	tcq.frameNum = gs->frameNum;
+	tcq.candidates.clear();
+
+	const CQuadField::Quad& quad = quadField->GetQuad(quadIdx);
+
+	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+		if (teamHandler->Ally(allyTeam, t))
+			continue;
+
+		for (CUnit* unit: quad.teamUnits[t]) {
+			const unsigned short losStatus = unit->losStatus[allyTeam];
+
+			if ((losStatus & (LOS_INLOS | LOS_INRADAR)) == 0)
+				continue;
+
+			tcq.candidates.push_back({unit, unit->GetErrorPos(allyTeam, true), unit->curArmorMultiple, unit->armorType, losStatus});
+		}
+	}
+
+	return tcq.candidates;
+}
+
 void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
 {
+	SCOPED_TIMER("Sim::Unit::TargetSearch");
+
 	const CUnit* owner    = weapon->owner;
 	const float radius    = weapon->range;
 	const float3& pos     = owner->pos;
@@ -632,91 +748,89 @@ void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoi
 	const float secDamage = weapon->damages->GetDefault() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
 	const bool paralyzer  = (weapon->damages->paralyzeDamageTime != 0);
 
+	// added to the candidates' errorPos for radar targets, see GetUnitPositionWithError
+	const float errorScale = weapon->MoveErrorExperience() * GAME_SPEED;
+
 	// copy on purpose since the below calls lua
 	const std::vector<int> quads = quadField->GetQuads(pos, radius + (aHeight - std::max(0.0f, readMap->GetInitMinHeight())) * heightMod);
 	const int tempNum = gs->GetTempNum();
 
-	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
-		if (teamHandler->Ally(owner->allyteam, t))
-			continue;
+	for (const int qi: quads) {
+		for (const TargetCandidate& candidate: GetTargetCandidates(owner->allyteam, qi)) {
+			CUnit* targetUnit = candidate.unit;
 
-		for (const int qi: quads) {
-			const std::vector<CUnit*>& allyTeamUnits = quadField->GetQuad(qi).teamUnits[t];
+			if (targetUnit->tempNum == tempNum)
+				continue;
 
-			for (CUnit* targetUnit: allyTeamUnits) {
-				if (targetUnit->tempNum == tempNum)
-					continue;
+			targetUnit->tempNum = tempNum;
 
-				targetUnit->tempNum = tempNum;
+			float targetPriority = 1.0f;
 
-				float targetPriority = 1.0f;
+			if (!weapon->TestTarget(float3(), SWeaponTarget(targetUnit)))
+				continue;
 
-				if (!weapon->TestTarget(float3(), SWeaponTarget(targetUnit)))
-					continue;
+			if (targetUnit == avoidUnit)
+				targetPriority *= 10.0f;
 
-				if (targetUnit == avoidUnit)
-					targetPriority *= 10.0f;
+			float3 targPos = candidate.errorPos;
+			const unsigned short targetLOSState = candidate.losStatus;
 
-				float3 targPos;
-				const unsigned short targetLOSState = targetUnit->losStatus[owner->allyteam];
+			if ((targetLOSState & LOS_INLOS) == 0) {
+				if (weapon->doTargetGroundPos)
+					targPos -= (targetUnit->aimPos - targetUnit->pos);
 
-				if (targetLOSState & LOS_INLOS) {
-					targPos = targetUnit->aimPos;
-				} else if (targetLOSState & LOS_INRADAR) {
-					targPos = weapon->GetUnitPositionWithError(targetUnit);
-					targetPriority *= 10.0f;
-				} else {
-					continue;
-				}
+				targPos += (weapon->errorVector * (errorScale * targetUnit->speed.w));
+				targetPriority *= 10.0f;
+			}
 
-				const float modRange = radius + (aHeight - targPos.y) * heightMod;
+			const float modRange = radius + (aHeight - targPos.y) * heightMod;
 
-				if (pos.SqDistance2D(targPos) > modRange * modRange)
-					continue;
+			if (pos.SqDistance2D(targPos) > modRange * modRange)
+				continue;
 
-				const float dist2D = (pos - targPos).Length2D();
-				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = weapon->damages->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
+			const float dist2D = (pos - targPos).Length2D();
+			const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
+			const float damageMul = weapon->damages->Get(candidate.armorType) * candidate.armorMultiple;
 
-				targetPriority *= rangeMul;
+			targetPriority *= rangeMul;
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPriority *= (secDamage + targetUnit->health);
+			if (targetLOSState & LOS_INLOS) {
+				targetPriority *= (secDamage + targetUnit->health);
 
-					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
-						targetPriority *= 4.0f;
+				if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
+					targetPriority *= 4.0f;
 
-					if (weapon->hasTargetWeight)
-						targetPriority *= weapon->TargetWeight(targetUnit);
+				if (weapon->hasTargetWeight)
+					targetPriority *= weapon->TargetWeight(targetUnit);
 
-				} else {
-					targetPriority *= (secDamage + 10000.0f);
-				}
+			} else {
+				targetPriority *= (secDamage + 10000.0f);
+			}
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
+			if (targetLOSState & LOS_PREVLOS) {
+				targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
 
-					if (targetUnit->category & weapon->badTargetCategory)
-						targetPriority *= 100.0f;
+				if (targetUnit->category & weapon->badTargetCategory)
+					targetPriority *= 100.0f;
 
-					if (targetUnit->IsCrashing())
-						targetPriority *= 1000.0f;
+				if (targetUnit->IsCrashing())
+					targetPriority *= 1000.0f;
 
-					if (targetUnit == lastAttacker)
-						targetPriority *= 0.5f;
-				}
+				if (targetUnit == lastAttacker)
+					targetPriority *= 0.5f;
+			}
 
-				const bool allow = eventHandler.AllowWeaponTarget(owner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
-				//Lua call may have changed tempNum, so needs to be set again.
-				targetUnit->tempNum = tempNum;
+			const bool allow = eventHandler.AllowWeaponTarget(owner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
+			//Lua call may have changed tempNum, so needs to be set again.
+			targetUnit->tempNum = tempNum;
 
-				if (!allow)
-					continue;
+			if (!allow)
+				continue;
 
-				targets.push_back(std::pair<float, CUnit*>(targetPriority, targetUnit));
-			}
+			targets.push_back(std::pair<float, CUnit*>(targetPriority, targetUnit));
 		}
 	}
+
 	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
 
 #ifdef TRACE_SYNC
@@ -9,6 +9,7 @@
 #include "System/float3.h"
 #include "System/type2.h"
 
+#include <deque>
 #include <vector>
 
 class CUnit;
@@ -112,7 +113,7 @@ public:
 	 */
 	static float3 ClosestBuildSite(int team, const UnitDef* unitDef, float3 pos, float searchRadius, int minDist, int facing = 0);
 
-	static void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets);
+	void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets);
 
 	void Update();
 
@@ -142,9 +143,89 @@ public:
 	);
 
 	void DamageObjectsInExplosionRadius(const CExplosionParams& params, const float expRad, const int weaponDefID);
+
+	/**
+	 * Explosions caused by another one (e.g. by units dying from its damage)
+	 * are queued and happen in order once it is done, rather than recursing
+	 * into the middle of its damage loop.
+	 */
 	void Explosion(const CExplosionParams& params);
 
 private:
+	void DoExplosion(const CExplosionParams& params);
+
+	void ApplyExplosionDamage(
+		CUnit* unit,
+		CUnit* owner,
+		const float3& expPos,
+		const float3& volPos,
+		const float expDist,
+		const float expRadius,
+		const float expSpeed,
+		const float expEdgeEffect,
+		const DamageArray& damages,
+		const int weaponDefID,
+		const int projectileID
+	);
+	void ApplyExplosionDamage(
+		CFeature* feature,
+		CUnit* owner,
+		const float3& expPos,
+		const float3& volPos,
+		const float expDist,
+		const float expRadius,
+		const float expEdgeEffect,
+		const DamageArray& damages,
+		const int weaponDefID,
+		const int projectileID
+	);
+
+private:
+	/// an enemy unit visible to an allyteam, as it was when first searched for in a frame
+	struct TargetCandidate {
+		CUnit* unit;
+
+		/// aimPos plus the allyteam's radar error (none if in LOS)
+		float3 errorPos;
+		float armorMultiple;
+
+		int armorType;
+		unsigned short losStatus;
+	};
+
+	struct TargetCandidateQuad {
+		int frameNum;
+		std::vector<TargetCandidate> candidates;
+	};
+
+	const std::vector<TargetCandidate>& GetTargetCandidates(int allyTeam, int quadIdx);
+
+private:
+	template<typename T> struct ExplosionHit {
+		T* object;
+
+		float3 volPos;
+		float distance;
+	};
+
+	struct QueuedExplosion {
+		QueuedExplosion(const CExplosionParams& p)
+		: damages(p.damages)
+		, params{
+			p.pos, p.dir, damages, p.weaponDef,
+			p.owner, p.hitUnit, p.hitFeature,
+			p.craterAreaOfEffect, p.damageAreaOfEffect, p.edgeEffectiveness, p.explosionSpeed, p.gfxMod,
+			p.impactOnly, p.ignoreOwner, p.damageGround,
+			p.projectileID
+		}
+		{}
+		QueuedExplosion(const QueuedExplosion&) = delete; // params refers to our damages
+
+		// the original params.damages can be temporary
+		DamageArray damages;
+		CExplosionParams params;
+	};
+
 	struct WaitingDamage {
 		WaitingDamage(int attacker, int target, const DamageArray& damage, const float3& impulse, const int _weaponID, const int _projectileID)
 		: target(target)
@@ -165,6 +246,24 @@ private:
 	};
 
 	std::vector< std::vector<WaitingDamage> > waitingDamageLists;
+
+	/**
+	 * [allyTeam][quad] candidates for weapon auto-targeting, built on first
+	 * use in a frame; weapons of nearby units (with usually overlapping
+	 * ranges) share them instead of each scanning every enemy allyteam
+	 */
+	std::vector< std::vector<TargetCandidateQuad> > targetCandidateQuads;
+
+	// reused by every DamageObjectsInExplosionRadius call, which can not
+	// be reentered since nested explosions are queued
+	std::vector<CUnit*> explosionUnits;
+	std::vector<CFeature*> explosionFeatures;
+	std::vector< ExplosionHit<CUnit> > explosionUnitHits;
+	std::vector< ExplosionHit<CFeature> > explosionFeatureHits;
+
+	// deque since pushing must not move the explosion being processed
+	std::deque<QueuedExplosion> queuedExplosions;
+	bool inExplosion;
 };
 
 extern CGameHelper* helper;
@@ -954,7 +954,7 @@ void CSelectedUnitsHandler::SendCommand(const Command& c)
 		selectionChanged = false;
 	}
 
-	clientNet->Send(CBaseNetProtocol::Get().SendCommand(gu->myPlayerNum, c.GetID(), c.options, c.params));
+	clientNet->Send(CBaseNetProtocol::Get().SendCommand(gu->myPlayerNum, c.GetID(), c.options, c.params.data(), c.params.size()));
 }
 
 
@@ -1028,7 +1028,8 @@ void CSelectedUnitsHandler::SendCommandsToUnits(const std::vector<int>& unitIDs,
 			*packet << cmd.options;
 		if (sameCmdParamSize == 0xFFFF)
 			*packet << static_cast<unsigned short>(cmd.params.size());
-		*packet << cmd.params;
+		for (const float param: cmd.params)
+			*packet << param;
 	}
 
 	clientNet->Send(std::shared_ptr<netcode::RawPacket>(packet));
@@ -503,6 +503,8 @@ void CEndGameBox::FillTeamStats()
 	stats.push_back(Stat("Damage Dealt"));
 	stats.push_back(Stat("Damage Received"));
 
+	std::vector<TeamStatistics> history;
+
 	for (int team = 0; team < teamHandler->ActiveTeams(); team++) {
 		const CTeam* pteam = teamHandler->Team(team);
 
@@ -510,7 +512,9 @@ void CEndGameBox::FillTeamStats()
 			continue;
 		}
 
-		for (auto si = pteam->statHistory.cbegin(); si != pteam->statHistory.cend(); ++si) {
+		pteam->statHistory.GetRange(0, pteam->statHistory.size() - 1, history);
+
+		for (auto si = history.cbegin(); si != history.cend(); ++si) {
 			stats[0].AddStat(team, 0);
 
 			stats[1].AddStat(team, si->metalUsed);
@@ -229,7 +229,7 @@ class CLuaHandleSynced
 		CUnsyncedLuaHandle unsyncedLuaHandle;
 
 	public:
-		static void ClearGameParams() { spring::clear_unordered_map(gameParams); }
+		static void ClearGameParams() { gameParams.Clear(); }
 		static const LuaRulesParams::Params& GetGameParams() { return gameParams; }
 
 	private:
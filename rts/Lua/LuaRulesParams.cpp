@@ -1,6 +1,10 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "LuaRulesParams.h"
+#include "System/UnorderedMap.hpp"
+
+#include <algorithm>
+#include <cassert>
 
 using namespace LuaRulesParams;
 
@@ -8,5 +12,328 @@ CR_BIND(Param,)
 CR_REG_METADATA(Param, (
 	CR_MEMBER(los),
 	CR_MEMBER(valueInt),
-	CR_MEMBER(valueString)
+	CR_MEMBER(valueString),
+	CR_MEMBER(changeFrame),
+	CR_MEMBER(erased)
+))
+
+CR_BIND(Params,)
+CR_REG_METADATA(Params, (
+	// saved by name, keys differ between processes
+	CR_IGNORED(keys),
+	CR_MEMBER(params),
+	CR_IGNORED(loadedNames),
+	CR_MEMBER(numErased),
+	CR_MEMBER(firstEraseFrame),
+	CR_MEMBER(lastChangeFrame),
+	CR_SERIALIZER(Serialize),
+	CR_POSTLOAD(PostLoad)
 ))
+
+
+static spring::unordered_map<std::string, int> keyIndices;
+static std::vector<std::string> keyNames;
+
+// number of Params holding each key, and the keys no Params holds
+static std::vector<int> keyRefs;
+static std::vector<int> freeKeys;
+
+
+static void AddKeyRef(int key)
+{
+	keyRefs[key] += 1;
+}
+
+static void RemoveKeyRef(int key)
+{
+	assert(keyRefs[key] > 0);
+
+	if ((keyRefs[key] -= 1) > 0)
+		return;
+
+	keyIndices.erase(keyNames[key]);
+	keyNames[key].clear();
+	freeKeys.push_back(key);
+}
+
+
+int LuaRulesParams::GetKey(const std::string& name)
+{
+	const auto it = keyIndices.find(name);
+
+	if (it == keyIndices.end())
+		return -1;
+
+	return it->second;
+}
+
+int LuaRulesParams::InternKey(const std::string& name)
+{
+	const auto it = keyIndices.find(name);
+
+	if (it != keyIndices.end())
+		return it->second;
+
+	if (freeKeys.empty()) {
+		keyNames.push_back(name);
+		keyRefs.push_back(0);
+		return (keyIndices[name] = keyNames.size() - 1);
+	}
+
+	const int key = freeKeys.back();
+
+	freeKeys.pop_back();
+	keyNames[key] = name;
+	return (keyIndices[name] = key);
+}
+
+const std::string& LuaRulesParams::GetKeyName(int key)
+{
+	assert(key >= 0 && key < keyNames.size());
+	return keyNames[key];
+}
+
+size_t LuaRulesParams::GetNumKeys()
+{
+	return keyIndices.size();
+}
+
+void LuaRulesParams::ResetKeys()
+{
+	spring::clear_unordered_map(keyIndices);
+	keyNames.clear();
+	keyRefs.clear();
+	freeKeys.clear();
+}
+
+
+
+Params& Params::operator = (const Params& p)
+{
+	if (this == &p)
+		return *this;
+
+	for (const int key: p.keys) {
+		AddKeyRef(key);
+	}
+
+	ReleaseKeys();
+
+	keys = p.keys;
+	params = p.params;
+	loadedNames = p.loadedNames;
+
+	numErased = p.numErased;
+	firstEraseFrame = p.firstEraseFrame;
+	lastChangeFrame = p.lastChangeFrame;
+	return *this;
+}
+
+Params& Params::operator = (Params&& p)
+{
+	if (this == &p)
+		return *this;
+
+	ReleaseKeys();
+
+	// <p> no longer holds its keys
+	keys = std::move(p.keys);
+	params = std::move(p.params);
+	loadedNames = std::move(p.loadedNames);
+
+	p.keys.clear();
+	p.params.clear();
+
+	numErased = p.numErased;
+	firstEraseFrame = p.firstEraseFrame;
+	lastChangeFrame = p.lastChangeFrame;
+	return *this;
+}
+
+void Params::ReleaseKeys()
+{
+	for (const int key: keys) {
+		RemoveKeyRef(key);
+	}
+
+	keys.clear();
+}
+
+
+int Params::FindIndex(int key) const
+{
+	const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+
+	if (it == keys.end() || *it != key)
+		return -1;
+
+	return (it - keys.begin());
+}
+
+const Param* Params::Find(const std::string& name) const
+{
+	const int key = LuaRulesParams::GetKey(name);
+
+	if (key < 0)
+		return nullptr;
+
+	const int idx = FindIndex(key);
+
+	if (idx < 0 || params[idx].erased)
+		return nullptr;
+
+	return &params[idx];
+}
+
+Param& Params::Set(const std::string& name, int frame)
+{
+	DropErased(frame);
+
+	const int key = InternKey(name);
+	const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+	const int idx = it - keys.begin();
+
+	if (it == keys.end() || *it != key) {
+		AddKeyRef(key);
+		keys.insert(it, key);
+		params.insert(params.begin() + idx, Param());
+	}
+
+	Param& param = params[idx];
+
+	if (param.erased) {
+		param = Param();
+		numErased -= 1;
+	}
+
+	param.changeFrame = frame;
+	lastChangeFrame = frame;
+	return param;
+}
+
+bool Params::Erase(const std::string& name, int frame)
+{
+	DropErased(frame);
+
+	const int key = LuaRulesParams::GetKey(name);
+
+	if (key < 0)
+		return false;
+
+	const int idx = FindIndex(key);
+
+	if (idx < 0 || params[idx].erased)
+		return false;
+
+	// keep the los so readers know who may see the removal
+	Param& param = params[idx];
+	param.valueInt = 0.0f;
+	param.valueString.clear();
+	param.changeFrame = frame;
+	param.erased = true;
+
+	if ((numErased += 1) == 1)
+		firstEraseFrame = frame;
+
+	lastChangeFrame = frame;
+	return true;
+}
+
+void Params::DropErased(int frame)
+{
+	if (numErased == 0 || (frame - firstEraseFrame) < ERASED_PARAM_FRAMES)
+		return;
+
+	size_t n = 0;
+
+	numErased = 0;
+	firstEraseFrame = frame;
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		const Param& param = params[i];
+
+		if (param.erased) {
+			if ((frame - param.changeFrame) >= ERASED_PARAM_FRAMES) {
+				RemoveKeyRef(keys[i]);
+				continue;
+			}
+
+			numErased += 1;
+			firstEraseFrame = std::min(firstEraseFrame, param.changeFrame);
+		}
+
+		if (n != i) {
+			keys[n] = keys[i];
+			params[n] = std::move(params[i]);
+		}
+
+		n += 1;
+	}
+
+	keys.resize(n);
+	params.resize(n);
+}
+
+
+void Params::Serialize(creg::ISerializer* s)
+{
+	// called after the members, params is already loaded
+	int numKeys = keys.size();
+	s->SerializeInt(&numKeys, sizeof(numKeys));
+
+	if (s->IsWriting()) {
+		for (const int key: keys) {
+			std::string name = GetKeyName(key);
+			int len = name.size();
+
+			s->SerializeInt(&len, sizeof(len));
+			s->Serialize(&name[0], len);
+		}
+
+		return;
+	}
+
+	assert(numKeys == params.size());
+
+	// Serialize may run on several objects concurrently, PostLoad does not;
+	// interning there also keeps the new key order the same for everyone
+	loadedNames.clear();
+	loadedNames.reserve(numKeys);
+
+	for (int n = 0; n < numKeys; n++) {
+		std::string name;
+		int len = 0;
+
+		s->SerializeInt(&len, sizeof(len));
+		name.resize(len);
+		s->Serialize(&name[0], len);
+
+		loadedNames.push_back(std::move(name));
+	}
+}
+
+void Params::PostLoad()
+{
+	assert(loadedNames.size() == params.size());
+
+	std::vector< std::pair<int, Param> > entries;
+	entries.reserve(loadedNames.size());
+
+	for (size_t n = 0; n < loadedNames.size(); n++) {
+		entries.emplace_back(InternKey(loadedNames[n]), std::move(params[n]));
+		AddKeyRef(entries.back().first);
+	}
+
+	std::vector<std::string>().swap(loadedNames);
+
+	// restore key order, keys are not necessarily interned as they were when saving
+	std::sort(entries.begin(), entries.end(), [](const std::pair<int, Param>& a, const std::pair<int, Param>& b) { return (a.first < b.first); });
+
+	keys.clear();
+	params.clear();
+
+	for (auto& e: entries) {
+		keys.push_back(e.first);
+		params.push_back(std::move(e.second));
+	}
+}
@@ -4,8 +4,10 @@
 #define LUA_RULESPARAMS_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
-#include "System/UnorderedMap.hpp"
+#include "Sim/Misc/GlobalConstants.h"
 #include "System/creg/creg_cond.h"
 
 namespace LuaRulesParams
@@ -28,14 +30,107 @@ namespace LuaRulesParams
 	struct Param {
 		CR_DECLARE_STRUCT(Param)
 
-		Param() : los(RULESPARAMLOS_PRIVATE),valueInt(0.0f) {};
+		Param() : los(RULESPARAMLOS_PRIVATE),valueInt(0.0f),changeFrame(0),erased(false) {};
 
 		int   los;
 		float valueInt;
 		std::string valueString;
+
+		//! frame of the last Set or Erase, for "changed since" queries
+		int  changeFrame;
+		//! erased params are kept so readers can see them disappear
+		bool erased;
 	};
 
-	typedef spring::unordered_map<std::string, Param> Params;
+
+	//! number of frames an erased param is kept for "changed since" queries
+	//! (readers polling less often must re-read all params to see removals)
+	static constexpr int ERASED_PARAM_FRAMES = 60 * GAME_SPEED;
+
+
+	/**
+	 * Rules-param names are interned into small integer keys at their
+	 * first Set, so each object only stores (key, value) arrays sorted
+	 * by key instead of a string-keyed hash-map.
+	 *
+	 * Keys are handed out in the order names are first set by synced
+	 * code, which makes them (and the iteration order of Params) equal
+	 * on all clients. Readers never intern, an unknown name is simply
+	 * a param that does not exist.
+	 *
+	 * Params count references to the keys they hold. The key of a name
+	 * no object holds anymore is freed and handed out again, so scripts
+	 * that generate names (e.g. per target) do not grow the table without
+	 * bound. Keys are only released by synced code as well.
+	 */
+	int GetKey(const std::string& name);
+	int InternKey(const std::string& name);
+	const std::string& GetKeyName(int key);
+	//! number of names currently held by any Params
+	size_t GetNumKeys();
+	//! must only be called when no Params objects hold keys (between games)
+	void ResetKeys();
+
+
+	class Params {
+		CR_DECLARE_STRUCT(Params)
+
+	public:
+		Params(): numErased(0), firstEraseFrame(0), lastChangeFrame(0) {}
+		Params(const Params& p): Params() { *this = p; }
+		Params(Params&& p): Params() { *this = std::move(p); }
+		~Params() { ReleaseKeys(); }
+
+		Params& operator = (const Params& p);
+		Params& operator = (Params&& p);
+
+		//! returns nullptr if the param does not exist or was erased
+		const Param* Find(const std::string& name) const;
+
+		//! creates the param if needed, marks it changed at <frame>
+		Param& Set(const std::string& name, int frame);
+		//! returns false if there was no (live) param named <name>
+		//! (the erased param is dropped on the first Set or Erase made
+		//! ERASED_PARAM_FRAMES or more after it)
+		bool Erase(const std::string& name, int frame);
+
+		void Clear() { *this = Params(); }
+
+		//! number of slots, including erased params
+		size_t size() const { return keys.size(); }
+		bool empty() const { return keys.empty(); }
+
+		int GetKey(size_t i) const { return keys[i]; }
+		const std::string& GetName(size_t i) const { return GetKeyName(keys[i]); }
+		const Param& GetParam(size_t i) const { return params[i]; }
+
+		//! frame of the last change to any param of this object
+		int GetLastChangeFrame() const { return lastChangeFrame; }
+		bool ChangedSince(int frame) const { return (lastChangeFrame > frame); }
+
+		void Serialize(creg::ISerializer* s);
+		void PostLoad();
+
+	private:
+		int FindIndex(int key) const;
+
+		void DropErased(int frame);
+		void ReleaseKeys();
+
+	private:
+		//! sorted interned keys, params[i] belongs to keys[i]
+		std::vector<int> keys;
+		std::vector<Param> params;
+
+		//! names of the loaded params until PostLoad interns them
+		std::vector<std::string> loadedNames;
+
+		//! number of erased params, and the frame of the oldest erase
+		int numErased;
+		int firstEraseFrame;
+
+		int lastChangeFrame;
+	};
 }
 
 #endif // LUA_RULESPARAMS_H
@@ -956,19 +956,22 @@ void SetRulesParam(lua_State* L, const char* caller, int offset,
 
 	const string key = luaL_checkstring(L, index);
 
-	LuaRulesParams::Param& param = params[key];
+	if (lua_isnoneornil(L, valIndex)) {
+		params.Erase(key, gs->GetLuaSimFrame());
+		return; //no need to set los if param was erased
+	}
+	if (!lua_isnumber(L, valIndex) && !lua_isstring(L, valIndex)) {
+		luaL_error(L, "Incorrect arguments to %s()", caller);
+	}
+
+	LuaRulesParams::Param& param = params.Set(key, gs->GetLuaSimFrame());
 
 	//! set the value of the parameter
 	if (lua_isnumber(L, valIndex)) {
 		param.valueInt = lua_tofloat(L, valIndex);
 		param.valueString.resize(0);
-	} else if (lua_isstring(L, valIndex)) {
-		param.valueString = lua_tostring(L, valIndex);
-	} else if (lua_isnoneornil(L, valIndex)) {
-		params.erase(key);
-		return; //no need to set los if param was erased
 	} else {
-		luaL_error(L, "Incorrect arguments to %s()", caller);
+		param.valueString = lua_tostring(L, valIndex);
 	}
 
 	//! set the los checking of the parameter
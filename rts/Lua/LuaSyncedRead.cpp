@@ -723,20 +723,42 @@ static inline CTeam* ParseTeam(lua_State* L, const char* caller, int index)
 
 static int PushRulesParams(lua_State* L, const char* caller,
                           const LuaRulesParams::Params& params,
-                          const int losStatus)
+                          const int losStatus, const int sinceIndex)
 {
+	// if a frame is given only push params changed after it, erased ones as false
+	const bool changedOnly = lua_isnumber(L, sinceIndex);
+	const int sinceFrame = luaL_optint(L, sinceIndex, 0);
+
+	if (changedOnly && !params.ChangedSince(sinceFrame)) {
+		lua_createtable(L, 0, 0);
+		return 1;
+	}
+
 	lua_createtable(L, 0, params.size());
 
-	for (auto& it: params) {
-		const std::string& name = it.first;
-		const LuaRulesParams::Param& param = it.second;
+	for (size_t i = 0; i < params.size(); i++) {
+		const LuaRulesParams::Param& param = params.GetParam(i);
+
 		if (!(param.los & losStatus))
 			continue;
 
+		if (changedOnly) {
+			if (param.changeFrame <= sinceFrame)
+				continue;
+
+			if (param.erased) {
+				LuaPushNamedBool(L, params.GetName(i), false);
+				continue;
+			}
+		} else {
+			if (param.erased)
+				continue;
+		}
+
 		if (!param.valueString.empty()) {
-			LuaPushNamedString(L, name, param.valueString);
+			LuaPushNamedString(L, params.GetName(i), param.valueString);
 		} else {
-			LuaPushNamedNumber(L, name, param.valueInt);
+			LuaPushNamedNumber(L, params.GetName(i), param.valueInt);
 		}
 	}
 
@@ -748,18 +770,16 @@ static int GetRulesParam(lua_State* L, const char* caller, int index,
                           const LuaRulesParams::Params& params,
                           const int& losStatus)
 {
-	const string key = luaL_checkstring(L, index);
-	auto it = params.find(key);
-	if (it == params.end())
-		return 0;
+	const LuaRulesParams::Param* param = params.Find(luaL_checkstring(L, index));
 
-	const LuaRulesParams::Param& param = it->second;
+	if (param == nullptr)
+		return 0;
 
-	if (param.los & losStatus) {
-		if (!param.valueString.empty()) {
-			lua_pushsstring(L, param.valueString);
+	if (param->los & losStatus) {
+		if (!param->valueString.empty()) {
+			lua_pushsstring(L, param->valueString);
 		} else {
-			lua_pushnumber(L, param.valueInt);
+			lua_pushnumber(L, param->valueInt);
 		}
 		return 1;
 	}
@@ -882,7 +902,7 @@ int LuaSyncedRead::GetGameRulesParams(lua_State* L)
 	//! always readable for all
 	const int losMask = LuaRulesParams::RULESPARAMLOS_PRIVATE_MASK;
 
-	return PushRulesParams(L, __FUNCTION__, params, losMask);
+	return PushRulesParams(L, __FUNCTION__, params, losMask, 1);
 }
 
 
@@ -1277,7 +1297,7 @@ int LuaSyncedRead::GetTeamRulesParams(lua_State* L)
 
 	const LuaRulesParams::Params&  params    = team->modParams;
 
-	return PushRulesParams(L, __FUNCTION__, params, losMask);
+	return PushRulesParams(L, __FUNCTION__, params, losMask, 2);
 }
 
 
@@ -1323,7 +1343,6 @@ int LuaSyncedRead::GetTeamStatsHistory(lua_State* L)
 	}
 
 	const auto& teamStats = team->statHistory;
-	auto it = teamStats.cbegin();
 	const int statCount = teamStats.size();
 
 	int start = 0;
@@ -1338,13 +1357,15 @@ int LuaSyncedRead::GetTeamStatsHistory(lua_State* L)
 		end = max(0, min(statCount - 1, end));
 	}
 
-	std::advance(it, start);
+	// only the requested window is decoded
+	std::vector<TeamStatistics> statRange;
+	teamStats.GetRange(start, end, statRange);
 
 	lua_newtable(L);
 	if (statCount > 0) {
 		int count = 1;
-		for (int i = start; i <= end; ++i, ++it) {
-			const TeamStatistics& stats = *it;
+		for (int i = start; i <= end; ++i) {
+			const TeamStatistics& stats = statRange[i - start];
 			lua_newtable(L); {
 				if (i+1 == teamStats.size()) {
 					// the `stats.frame` var indicates the frame when a new entry needs to get added,
@@ -4265,7 +4286,7 @@ int LuaSyncedRead::GetUnitRulesParams(lua_State* L)
 
 	const LuaRulesParams::Params&  params    = unit->modParams;
 
-	return PushRulesParams(L, __FUNCTION__, params, losMask);
+	return PushRulesParams(L, __FUNCTION__, params, losMask, 2);
 }
 
 
@@ -4633,7 +4654,7 @@ int LuaSyncedRead::GetFeatureRulesParams(lua_State* L)
 
 	const LuaRulesParams::Params&  params    = feature->modParams;
 
-	return PushRulesParams(L, __FUNCTION__, params, losMask);
+	return PushRulesParams(L, __FUNCTION__, params, losMask, 2);
 }
 
 
@@ -8,6 +8,7 @@
 #include "Sim/Misc/GroundBlockingObjectMap.h"
 #include "Sim/Misc/LosHandler.h"
 #include "Sim/Misc/QuadField.h"
+#include "Sim/Misc/SmoothHeightMesh.h"
 #include "Sim/Units/Unit.h"
 #include "Sim/Units/UnitHandler.h"
 #include "Sim/Path/IPathManager.h"
@@ -182,6 +183,7 @@ void CBasicMapDamage::RecalcArea(int x1, int x2, int y1, int y2)
 {
 	readMap->UpdateHeightMapSynced(SRectangle(x1, y1, x2, y2));
 	featureHandler->TerrainChanged(x1, y1, x2, y2);
+	smoothGround->TerrainChanged(x1, y1, x2, y2);
 	{
 		SCOPED_TIMER("Sim::BasicMapDamage::Los");
 		losHandler->UpdateHeightMapSynced(SRectangle(x1, y1, x2, y2));
@@ -192,6 +194,41 @@ void CBasicMapDamage::RecalcArea(int x1, int x2, int y1, int y2)
 	}
 }
 
+void CBasicMapDamage::RecalcTerrainChanges()
+{
+	if (terrainChanges.empty())
+		return;
+
+	// resolves overlaps; the merged rectangles cover (at least) the union
+	// of the pushed ones, so every square is still recalculated exactly as
+	// RecalcArea would have done but only once per frame
+	terrainChanges.Optimize();
+
+	for (const SRectangle& rect: terrainChanges) {
+		readMap->UpdateHeightMapSynced(rect);
+	}
+	for (const SRectangle& rect: terrainChanges) {
+		featureHandler->TerrainChanged(rect.x1, rect.z1, rect.x2, rect.z2);
+		smoothGround->TerrainChanged(rect.x1, rect.z1, rect.x2, rect.z2);
+	}
+	{
+		SCOPED_TIMER("Sim::BasicMapDamage::Los");
+
+		for (const SRectangle& rect: terrainChanges) {
+			losHandler->UpdateHeightMapSynced(rect);
+		}
+	}
+	{
+		SCOPED_TIMER("Sim::BasicMapDamage::Path");
+
+		for (const SRectangle& rect: terrainChanges) {
+			pathManager->TerrainChange(rect.x1, rect.z1, rect.x2, rect.z2, TERRAINCHANGE_DAMAGE_RECALCULATION);
+		}
+	}
+
+	terrainChanges.clear();
+}
+
 
 void CBasicMapDamage::Update()
 {
@@ -228,10 +265,12 @@ void CBasicMapDamage::Update()
 		}
 
 		if (e.ttl == 0) {
-			RecalcArea(e.x1 - 1, e.x2 + 1, e.y1 - 1, e.y2 + 1);
+			terrainChanges.push_back(SRectangle(e.x1 - 1, e.y1 - 1, e.x2 + 1, e.y2 + 1));
 		}
 	}
 
+	RecalcTerrainChanges();
+
 	while (!explosions.empty()) {
 		const Explo& explosion = explosions.front();
 
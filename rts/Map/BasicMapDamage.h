@@ -4,6 +4,7 @@
 #define _BASIC_MAP_DAMAGE_H
 
 #include "MapDamage.h"
+#include "System/Misc/RectangleOptimizer.h"
 
 #include <deque>
 #include <vector>
@@ -19,6 +20,9 @@ public:
 	void RecalcArea(int x1, int x2, int y1, int y2);
 	void Update();
 
+private:
+	void RecalcTerrainChanges();
+
 private:
 	struct ExploBuilding {
 		/**
@@ -46,6 +50,14 @@ private:
 
 	std::deque<Explo> explosions;
 
+	/**
+	 * Areas of all explosions that expired during the current Update,
+	 * merged and propagated in one pass at its end (rather than once per
+	 * crater) since barrages tend to make many overlapping ones expire in
+	 * the same frame. Always empty between frames.
+	 */
+	CRectangleOptimizer terrainChanges;
+
 	static const unsigned int CRATER_TABLE_SIZE = 200;
 	static const unsigned int EXPLOSION_LIFETIME = 10;
 
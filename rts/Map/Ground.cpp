@@ -2,6 +2,7 @@
 
 
 #include "Ground.h"
+#include "HeightMaxPyramid.h"
 #include "ReadMap.h"
 #include "System/myMath.h"
 
@@ -185,9 +186,42 @@ void CGround::CheckColSquare(CProjectile* p, int x, int y)
 }
 */
 
-inline static bool ClampInMapHeight(float3& from, float3& to)
+// skips the squares of pyramid blocks a ray passes well above
+struct SquareSkipper {
+	SquareSkipper(const CHeightMaxPyramid* p, const float3& f, const float3& t)
+		: pyramid(p)
+		, from(f)
+		, to(t)
+		, skipBlock(0, 0, -1, -1)
+		, testedBlock(-1, -1)
+	{}
+
+	bool CanSkip(int x, int z) {
+		if (x >= skipBlock.x1 && x <= skipBlock.x2 && z >= skipBlock.z1 && z <= skipBlock.z2)
+			return true;
+
+		// every square of a block that could not be skipped needs its own test
+		const int2 block(x >> CHeightMaxPyramid::BASE_SHIFT, z >> CHeightMaxPyramid::BASE_SHIFT);
+
+		if (block == testedBlock)
+			return false;
+
+		testedBlock = block;
+		return (pyramid->FindSkipBlock(from, to, x, z, skipBlock));
+	}
+
+	const CHeightMaxPyramid* pyramid;
+	const float3& from;
+	const float3& to;
+
+	SRectangle skipBlock;
+	int2 testedBlock;
+};
+
+
+inline static bool ClampInMapHeight(float3& from, float3& to, float maxHeight)
 {
-	const float heightAboveMapMax = from.y - readMap->GetCurrMaxHeight();
+	const float heightAboveMapMax = from.y - maxHeight;
 
 	if (heightAboveMapMax <= 0.0f)
 		return false;
@@ -211,11 +245,18 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 	const float* hm  = readMap->GetSharedCornerHeightMap(synced);
 	const float3* nm = readMap->GetSharedFaceNormals(synced);
 
+	const CHeightMaxPyramid* hmp = readMap->GetSharedHeightMaxPyramid(synced);
+
+	return (LineGroundCol(from, to, hm, nm, hmp, readMap->GetCurrMaxHeight(), synced));
+}
+
+float CGround::LineGroundCol(float3 from, float3 to, const float* hm, const float3* nm, const CHeightMaxPyramid* hmp, float maxHeight, bool synced)
+{
 	const float3 pfrom = from;
 
 	// only for performance -> skip part that can impossibly collide
 	// with the terrain, cause it is above map's current max height
-	ClampInMapHeight(from, to);
+	ClampInMapHeight(from, to, maxHeight);
 
 	// handle special cases where the ray origin is out of bounds:
 	// need to move <from> to the closest map-edge along the ray
@@ -261,6 +302,8 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 
 	bool keepgoing = true;
 
+	SquareSkipper skipper(hmp, from, to);
+
 	if ((fsx == tsx) && (fsz == tsz)) {
 		// <from> and <to> are the same
 		const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, fsz);
@@ -273,10 +316,15 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 		int zp = fsz;
 
 		while (keepgoing) {
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, zp);
+			if (skipper.CanSkip(fsx, zp)) {
+				// continue after the last square of the block
+				zp = (dirz > 0)? std::min(skipper.skipBlock.z2, tsz): std::max(skipper.skipBlock.z1, tsz);
+			} else {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  fsx, zp);
 
-			if (ret >= 0.0f) {
-				return (ret + skippedDist);
+				if (ret >= 0.0f) {
+					return (ret + skippedDist);
+				}
 			}
 
 			keepgoing = (zp != tsz);
@@ -287,10 +335,14 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 		int xp = fsx;
 
 		while (keepgoing) {
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  xp, fsz);
+			if (skipper.CanSkip(xp, fsz)) {
+				xp = (dirx > 0)? std::min(skipper.skipBlock.x2, tsx): std::max(skipper.skipBlock.x1, tsx);
+			} else {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  xp, fsz);
 
-			if (ret >= 0.0f) {
-				return (ret + skippedDist);
+				if (ret >= 0.0f) {
+					return (ret + skippedDist);
+				}
 			}
 
 			keepgoing = (xp != tsx);
@@ -323,11 +375,15 @@ float CGround::LineGroundCol(float3 from, float3 to, bool synced)
 		int curz = fsz;
 
 		while (keepgoing) {
-			// do the collision test with the squares triangles
-			const float ret = LineGroundSquareCol(hm, nm,  from, to,  curx, curz);
-
-			if (ret >= 0.0f) {
-				return (ret + skippedDist);
+			// do the collision test with the squares triangles, unless
+			// the ray passes above the block around them; the DDA still
+			// has to step through it to stay on the same squares
+			if (!skipper.CanSkip(curx, curz)) {
+				const float ret = LineGroundSquareCol(hm, nm,  from, to,  curx, curz);
+
+				if (ret >= 0.0f) {
+					return (ret + skippedDist);
+				}
 			}
 
 			// check if we reached the end already and need to stop the loop
@@ -7,6 +7,8 @@
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/GlobalSynced.h"
 
+class CHeightMaxPyramid;
+
 class CGround
 {
 public:
@@ -37,6 +39,8 @@ public:
 
 	static float LineGroundCol(float3 from, float3 to, bool synced = true);
 	static float LineGroundCol(const float3 pos, const float3 dir, float len, bool synced = true);
+	/// LineGroundCol over the given maps instead of those shared by readMap
+	static float LineGroundCol(float3 from, float3 to, const float* hm, const float3* nm, const CHeightMaxPyramid* hmp, float maxHeight, bool synced);
 	static float LinePlaneCol(const float3 pos, const float3 dir, float len, float hgt);
 	static float LineGroundWaterCol(const float3 pos, const float3 dir, float len, bool testWater, bool synced = true);
 	static float TrajectoryGroundCol(float3 from, const float3& flatdir, float length, float linear, float quadratic);
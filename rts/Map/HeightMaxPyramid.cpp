@@ -0,0 +1,211 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cfloat>
+
+#include "HeightMaxPyramid.h"
+#include "Sim/Misc/GlobalConstants.h"
+
+// any part of a line that could end up in a block when computed in floats
+static constexpr float BLOCK_EDGE_MARGIN = 0.5f;
+
+
+void CHeightMaxPyramid::Init(int mapx_, int mapy_)
+{
+	mapx = mapx_;
+	mapy = mapy_;
+
+	for (int l = 0; l < NUM_LEVELS; l++) {
+		const int shift = BASE_SHIFT + l;
+
+		sizeX[l] = (mapx + (1 << shift) - 1) >> shift;
+		sizeZ[l] = (mapy + (1 << shift) - 1) >> shift;
+
+		levels[l].clear();
+		levels[l].resize(sizeX[l] * sizeZ[l], FLT_MAX);
+	}
+}
+
+
+void CHeightMaxPyramid::Update(const float* cornerHeightMap, SRectangle rect)
+{
+	if (levels[0].empty())
+		return;
+
+	// a vertex bounds the squares on both sides of it
+	rect.x1 = std::max(       0, rect.x1 - 1);
+	rect.z1 = std::max(       0, rect.z1 - 1);
+	rect.x2 = std::min(mapx - 1, rect.x2 + 1);
+	rect.z2 = std::min(mapy - 1, rect.z2 + 1);
+
+	if (rect.x1 > rect.x2 || rect.z1 > rect.z2)
+		return;
+
+	int bx1 = rect.x1 >> BASE_SHIFT;
+	int bz1 = rect.z1 >> BASE_SHIFT;
+	int bx2 = rect.x2 >> BASE_SHIFT;
+	int bz2 = rect.z2 >> BASE_SHIFT;
+
+	for (int bz = bz1; bz <= bz2; bz++) {
+		const int vz1 = bz << BASE_SHIFT;
+		const int vz2 = std::min(mapy, (bz + 1) << BASE_SHIFT);
+
+		for (int bx = bx1; bx <= bx2; bx++) {
+			const int vx1 = bx << BASE_SHIFT;
+			const int vx2 = std::min(mapx, (bx + 1) << BASE_SHIFT);
+
+			float maxHeight = -FLT_MAX;
+
+			for (int vz = vz1; vz <= vz2; vz++) {
+				for (int vx = vx1; vx <= vx2; vx++) {
+					maxHeight = std::max(maxHeight, cornerHeightMap[vz * (mapx + 1) + vx]);
+				}
+			}
+
+			levels[0][bz * sizeX[0] + bx] = maxHeight;
+		}
+	}
+
+	for (int l = 1; l < NUM_LEVELS; l++) {
+		const std::vector<float>& child = levels[l - 1];
+		const int childSizeX = sizeX[l - 1];
+		const int childSizeZ = sizeZ[l - 1];
+
+		bx1 >>= 1; bz1 >>= 1;
+		bx2 >>= 1; bz2 >>= 1;
+
+		for (int bz = bz1; bz <= bz2; bz++) {
+			const int cz1 = bz * 2;
+			const int cz2 = std::min(childSizeZ - 1, cz1 + 1);
+
+			for (int bx = bx1; bx <= bx2; bx++) {
+				const int cx1 = bx * 2;
+				const int cx2 = std::min(childSizeX - 1, cx1 + 1);
+
+				float maxHeight = -FLT_MAX;
+
+				for (int cz = cz1; cz <= cz2; cz++) {
+					for (int cx = cx1; cx <= cx2; cx++) {
+						maxHeight = std::max(maxHeight, child[cz * childSizeX + cx]);
+					}
+				}
+
+				levels[l][bz * sizeX[l] + bx] = maxHeight;
+			}
+		}
+	}
+}
+
+
+void CHeightMaxPyramid::RaiseHeight(int vx, int vz, float height)
+{
+	if (levels[0].empty())
+		return;
+
+	const int x1 = std::max(       0, vx - 1);
+	const int z1 = std::max(       0, vz - 1);
+	const int x2 = std::min(mapx - 1, vx    );
+	const int z2 = std::min(mapy - 1, vz    );
+
+	for (int l = 0; l < NUM_LEVELS; l++) {
+		const int shift = BASE_SHIFT + l;
+		bool raised = false;
+
+		for (int bz = (z1 >> shift); bz <= (z2 >> shift); bz++) {
+			for (int bx = (x1 >> shift); bx <= (x2 >> shift); bx++) {
+				float& maxHeight = levels[l][bz * sizeX[l] + bx];
+
+				if (height <= maxHeight)
+					continue;
+
+				maxHeight = height;
+				raised = true;
+			}
+		}
+
+		// parents are never lower than their children
+		if (!raised)
+			return;
+	}
+}
+
+
+bool CHeightMaxPyramid::IsAboveBlock(const float3& from, const float3& dir, int level, int bx, int bz, SRectangle& block) const
+{
+	const int shift = BASE_SHIFT + level;
+
+	block.x1 = bx << shift;
+	block.z1 = bz << shift;
+	block.x2 = std::min(mapx, (bx + 1) << shift) - 1;
+	block.z2 = std::min(mapy, (bz + 1) << shift) - 1;
+
+	const float minX = block.x1 * SQUARE_SIZE - BLOCK_EDGE_MARGIN;
+	const float minZ = block.z1 * SQUARE_SIZE - BLOCK_EDGE_MARGIN;
+	const float maxX = (block.x2 + 1) * SQUARE_SIZE + BLOCK_EDGE_MARGIN;
+	const float maxZ = (block.z2 + 1) * SQUARE_SIZE + BLOCK_EDGE_MARGIN;
+
+	// interval of the (infinite) line over the block; the square tests
+	// can also return hits on the extension of the segment, so this is
+	// deliberately not clipped to [0, 1]
+	float tmin = -FLT_MAX;
+	float tmax =  FLT_MAX;
+
+	if (dir.x != 0.0f) {
+		const float t1 = (minX - from.x) / dir.x;
+		const float t2 = (maxX - from.x) / dir.x;
+
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	} else if (from.x < minX || from.x > maxX) {
+		return false;
+	}
+
+	if (dir.z != 0.0f) {
+		const float t1 = (minZ - from.z) / dir.z;
+		const float t2 = (maxZ - from.z) / dir.z;
+
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	} else if (from.z < minZ || from.z > maxZ) {
+		return false;
+	}
+
+	if (tmin > tmax)
+		return false;
+	// vertical line, every height is reached
+	if (tmin == -FLT_MAX || tmax == FLT_MAX)
+		return false;
+
+	const float minY = std::min(from.y + dir.y * tmin, from.y + dir.y * tmax);
+
+	return (minY > (GetMaxHeight(level, bx, bz) + SKIP_MARGIN));
+}
+
+
+bool CHeightMaxPyramid::FindSkipBlock(const float3& from, const float3& to, int x, int z, SRectangle& block) const
+{
+	if (levels[0].empty())
+		return false;
+	if (x < 0 || z < 0 || x >= mapx || z >= mapy)
+		return false;
+
+	const float3 dir = to - from;
+
+	SRectangle levelBlock;
+
+	if (!IsAboveBlock(from, dir, 0, x >> BASE_SHIFT, z >> BASE_SHIFT, levelBlock))
+		return false;
+
+	block = levelBlock;
+
+	for (int l = 1; l < NUM_LEVELS; l++) {
+		const int shift = BASE_SHIFT + l;
+
+		if (!IsAboveBlock(from, dir, l, x >> shift, z >> shift, levelBlock))
+			break;
+
+		block = levelBlock;
+	}
+
+	return true;
+}
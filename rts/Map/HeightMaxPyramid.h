@@ -0,0 +1,68 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _HEIGHT_MAX_PYRAMID_H
+#define _HEIGHT_MAX_PYRAMID_H
+
+#include <vector>
+
+#include "System/float3.h"
+#include "System/Rectangle.h"
+
+/**
+ * Maximum corner height of every block of 4x4, 8x8, ... 256x256 heightmap
+ * squares, used by CGround::LineGroundCol to skip the parts of a ray that
+ * pass above all terrain below them without testing each square.
+ *
+ * The stored heights never underestimate the real ones: Update recomputes
+ * them exactly for a changed area, RaiseHeight only ever increases them
+ * in between (e.g. for CReadMap::SetHeight).
+ */
+class CHeightMaxPyramid
+{
+public:
+	/// the finest level has blocks of (1 << BASE_SHIFT) squares per side
+	static const int BASE_SHIFT = 2;
+	static const int NUM_LEVELS = 7;
+
+	/**
+	 * how far (in elmos) a ray has to stay above a block to skip it, keeps
+	 * rounding in the per-square test from ever finding a hit in one
+	 */
+	static constexpr float SKIP_MARGIN = 1.0f;
+
+	CHeightMaxPyramid(): mapx(0), mapy(0) {}
+
+	/// all blocks start out unbounded, i.e. nothing is skipped before the first Update
+	void Init(int mapx, int mapy);
+
+	/// <rect> is in squares, inclusive
+	void Update(const float* cornerHeightMap, SRectangle rect);
+	/// vertex (<vx>, <vz>) of the corner heightmap was set to <height>
+	void RaiseHeight(int vx, int vz, float height);
+
+	/**
+	 * @brief finds the largest block around square (<x>, <z>) that no part
+	 *   of the segment <from>, <to> (in elmos) can intersect the terrain of
+	 * @param block set to the block's squares (inclusive) if one is found
+	 */
+	bool FindSkipBlock(const float3& from, const float3& to, int x, int z, SRectangle& block) const;
+
+	float GetMaxHeight(int level, int bx, int bz) const { return levels[level][bz * sizeX[level] + bx]; }
+
+	int GetSizeX(int level) const { return sizeX[level]; }
+	int GetSizeZ(int level) const { return sizeZ[level]; }
+
+private:
+	bool IsAboveBlock(const float3& from, const float3& dir, int level, int bx, int bz, SRectangle& block) const;
+
+private:
+	int mapx;
+	int mapy;
+
+	int sizeX[NUM_LEVELS];
+	int sizeZ[NUM_LEVELS];
+
+	std::vector<float> levels[NUM_LEVELS];
+};
+
+#endif // _HEIGHT_MAX_PYRAMID_H
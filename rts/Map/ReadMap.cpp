@@ -21,6 +21,7 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/Misc/RectangleOptimizer.h"
 #include "System/Sync/HsiehHash.h"
+#include "System/TimeProfiler.h"
 #include "System/Util.h"
 
 #ifdef USE_UNSYNCED_HEIGHTMAP
@@ -89,9 +90,12 @@ CR_REG_METADATA(CReadMap, (
 	CR_IGNORED(sharedFaceNormals),
 	CR_IGNORED(sharedCenterNormals),
 	CR_IGNORED(sharedSlopeMaps),
+	CR_IGNORED(sharedHeightMaxPyramids),
 	CR_MEMBER(typeMap),
 	CR_MEMBER(unsyncedHeightMapUpdates),
 	CR_MEMBER(unsyncedHeightMapUpdatesTemp),
+	CR_IGNORED(heightMaxPyramidSynced),
+	CR_IGNORED(heightMaxPyramidUnsynced),
 	HEIGHTMAP_DIGESTS
 	CR_POSTLOAD(PostLoad),
 	CR_SERIALIZER(Serialize)
@@ -171,9 +175,7 @@ void CReadMap::Serialize(creg::ISerializer* s)
 			s->Serialize(&height, sizeof(int));
 			ishm[i] = height ^ ioshm[i];
 		}
-		mapDamage->RecalcArea(2, mapDims.mapx - 3, 2, mapDims.mapy - 3);
 	}
-
 }
 
 
@@ -198,6 +200,15 @@ void CReadMap::PostLoad()
 	sharedSlopeMaps[0] = &slopeMap[0]; // NO UNSYNCED VARIANT
 	sharedSlopeMaps[1] = &slopeMap[0];
 
+	sharedHeightMaxPyramids[0] = &heightMaxPyramidUnsynced;
+	sharedHeightMaxPyramids[1] = &heightMaxPyramidSynced;
+
+	// not in Serialize, that may run on a pool thread while other objects
+	// are still being read; this reaches into the feature-, los-, path-
+	// and smooth-ground handlers
+	mapDamage->RecalcArea(2, mapDims.mapx - 3, 2, mapDims.mapy - 3);
+	heightMaxPyramidSynced.Update(GetCornerHeightMapSynced(), SRectangle(0, 0, mapDims.mapx, mapDims.mapy));
+
 	//FIXME reconstruct
 	/*mipPointerHeightMaps.resize(numHeightMipMaps, nullptr);
 	mipPointerHeightMaps[0] = &centerHeightMap[0];
@@ -277,6 +288,9 @@ void CReadMap::Initialize()
 	slopeMap.resize(mapDims.hmapx * mapDims.hmapy);
 	visVertexNormals.resize(mapDims.mapxp1 * mapDims.mapyp1);
 
+	heightMaxPyramidSynced.Init(mapDims.mapx, mapDims.mapy);
+	heightMaxPyramidUnsynced.Init(mapDims.mapx, mapDims.mapy);
+
 	// note: if USE_UNSYNCED_HEIGHTMAP is false, then
 	// heightMapUnsyncedPtr points to an empty vector
 	// for SMF maps so indexing it is forbidden (!)
@@ -302,13 +316,19 @@ void CReadMap::Initialize()
 
 		sharedSlopeMaps[0] = &slopeMap[0]; // NO UNSYNCED VARIANT
 		sharedSlopeMaps[1] = &slopeMap[0];
+
+		sharedHeightMaxPyramids[0] = &heightMaxPyramidUnsynced;
+		sharedHeightMaxPyramids[1] = &heightMaxPyramidSynced;
 	}
 
 	mapChecksum = CalcHeightmapChecksum();
 
 	// not callable here because losHandler is still NULL, deferred to Game::PostLoadSim
 	// InitHeightMapDigestVectors();
-	UpdateHeightMapSynced(SRectangle(0, 0, mapDims.mapx, mapDims.mapy), true);
+	{
+		ScopedOnceTimer timer("ReadMap::UpdateHeightMapSynced (init)");
+		UpdateHeightMapSynced(SRectangle(0, 0, mapDims.mapx, mapDims.mapy), true);
+	}
 
 	// FIXME can't call that yet cause sky & skyLight aren't created yet (crashes in SMFReadMap.cpp)
 	// UpdateDraw(true);
@@ -395,6 +415,8 @@ void CReadMap::UpdateDraw(bool firstCall)
 	// unsyncedHeightMapUpdatesTemp is now guaranteed empty
 	for (const SRectangle& rect: unsyncedHeightMapUpdatesSwap) {
 		UpdateHeightMapUnsynced(rect);
+		// the unsynced heights are copied one vertex beyond <rect>
+		heightMaxPyramidUnsynced.Update(GetCornerHeightMapUnsynced(), SRectangle(rect.x1 - 1, rect.z1 - 1, rect.x2 + 1, rect.z2 + 1));
 	}
 	for (const SRectangle& rect: unsyncedHeightMapUpdatesSwap) {
 		eventHandler.UnsyncedHeightMapUpdate(rect);
@@ -413,10 +435,9 @@ void CReadMap::UpdateHeightMapSynced(SRectangle hmRect, bool initialize)
 	hmRect.x2 = std::min(mapDims.mapxm1, hmRect.x2 + 1);
 	hmRect.z2 = std::min(mapDims.mapym1, hmRect.z2 + 1);
 
-	UpdateCenterHeightmap(hmRect, initialize);
-	UpdateMipHeightmaps(hmRect, initialize);
-	UpdateFaceNormals(hmRect, initialize);
-	UpdateSlopemap(hmRect, initialize); // must happen after UpdateFaceNormals()!
+	UpdateHeightMapDerivatives(hmRect, initialize);
+	UpdateMipHeightmaps(hmRect, initialize); // must happen after UpdateHeightMapDerivatives()!
+	heightMaxPyramidSynced.Update(GetCornerHeightMapSynced(), hmRect);
 
 	assert(initialize == (losHandler == nullptr));
 
@@ -448,135 +469,103 @@ void CReadMap::UpdateHeightMapSynced(SRectangle hmRect, bool initialize)
 }
 
 
-void CReadMap::UpdateCenterHeightmap(const SRectangle& rect, bool initialize)
+void CReadMap::UpdateHeightMapDerivatives(const SRectangle& rect, bool initialize)
 {
 	const float* heightmapSynced = GetCornerHeightMapSynced();
 
-	for (int y = rect.z1; y <= rect.z2; y++) {
-		for (int x = rect.x1; x <= rect.x2; x++) {
-			const int idxTL = (y    ) * mapDims.mapxp1 + x;
-			const int idxTR = (y    ) * mapDims.mapxp1 + x + 1;
-			const int idxBL = (y + 1) * mapDims.mapxp1 + x;
-			const int idxBR = (y + 1) * mapDims.mapxp1 + x + 1;
-
-			const float height =
-				heightmapSynced[idxTL] +
-				heightmapSynced[idxTR] +
-				heightmapSynced[idxBL] +
-				heightmapSynced[idxBR];
-			centerHeightMap[y * mapDims.mapx + x] = height * 0.25f;
-		}
-	}
-}
-
-
-void CReadMap::UpdateMipHeightmaps(const SRectangle& rect, bool initialize)
-{
-	for (int i = 0; i < numHeightMipMaps - 1; i++) {
-		const int hmapx = mapDims.mapx >> i;
-
-		const int sx = (rect.x1 >> i) & (~1);
-		const int ex = (rect.x2 >> i);
-		const int sy = (rect.z1 >> i) & (~1);
-		const int ey = (rect.z2 >> i);
-		float* topMipMap = mipPointerHeightMaps[i];
-		float* subMipMap = mipPointerHeightMaps[i + 1];
-
-		for (int y = sy; y < ey; y += 2) {
-			for (int x = sx; x < ex; x += 2) {
-				const float height =
-					topMipMap[(x    ) + (y    ) * hmapx] +
-					topMipMap[(x    ) + (y + 1) * hmapx] +
-					topMipMap[(x + 1) + (y    ) * hmapx] +
-					topMipMap[(x + 1) + (y + 1) * hmapx];
-				subMipMap[(x / 2) + (y / 2) * hmapx / 2] = height * 0.25f;
-			}
-		}
-	}
-}
-
-
-void CReadMap::UpdateFaceNormals(const SRectangle& rect, bool initialize)
-{
-	const float* heightmapSynced = GetCornerHeightMapSynced();
-
-	const int z1 = std::max(             0, rect.z1 - 1);
-	const int x1 = std::max(             0, rect.x1 - 1);
-	const int z2 = std::min(mapDims.mapym1, rect.z2 + 1);
-	const int x2 = std::min(mapDims.mapxm1, rect.x2 + 1);
-
-	for_mt(z1, z2+1, [&](const int y) {
-		float3 fnTL;
-		float3 fnBR;
-
-		for (int x = x1; x <= x2; x++) {
-			const int idxTL = (y    ) * mapDims.mapxp1 + x; // TL
-			const int idxBL = (y + 1) * mapDims.mapxp1 + x; // BL
-
-			const float& hTL = heightmapSynced[idxTL    ];
-			const float& hTR = heightmapSynced[idxTL + 1];
-			const float& hBL = heightmapSynced[idxBL    ];
-			const float& hBR = heightmapSynced[idxBL + 1];
-
-			// normal of top-left triangle (face) in square
-			//
-			//  *---> e1
-			//  |
-			//  |
-			//  v
-			//  e2
-			//const float3 e1( SQUARE_SIZE, hTR - hTL,           0);
-			//const float3 e2(           0, hBL - hTL, SQUARE_SIZE);
-			//const float3 fnTL = (e2.cross(e1)).Normalize();
-			fnTL.y = SQUARE_SIZE;
-			fnTL.x = - (hTR - hTL);
-			fnTL.z = - (hBL - hTL);
-			fnTL.Normalize();
-
-			// normal of bottom-right triangle (face) in square
-			//
-			//         e3
-			//         ^
-			//         |
-			//         |
-			//  e4 <---*
-			//const float3 e3(-SQUARE_SIZE, hBL - hBR,           0);
-			//const float3 e4(           0, hTR - hBR,-SQUARE_SIZE);
-			//const float3 fnBR = (e4.cross(e3)).Normalize();
-			fnBR.y = SQUARE_SIZE;
-			fnBR.x = (hBL - hBR);
-			fnBR.z = (hTR - hBR);
-			fnBR.Normalize();
-
-			faceNormalsSynced[(y * mapDims.mapx + x) * 2    ] = fnTL;
-			faceNormalsSynced[(y * mapDims.mapx + x) * 2 + 1] = fnBR;
-			// square-normal
-			centerNormalsSynced[y * mapDims.mapx + x] = (fnTL + fnBR).Normalize();
-			centerNormals2D[y * mapDims.mapx + x] = (fnTL + fnBR).Normalize2D();
+	// every output keeps its own (differently expanded) range, writing
+	// beyond it could replace values that are stale on purpose, e.g. of
+	// craters that have not finished yet
+	const SRectangle chRect = rect;
+	const SRectangle fnRect(
+		std::max(             0, rect.x1 - 1),
+		std::max(             0, rect.z1 - 1),
+		std::min(mapDims.mapxm1, rect.x2 + 1),
+		std::min(mapDims.mapym1, rect.z2 + 1)
+	);
+	const SRectangle smRect(
+		std::max(                0, (rect.x1 / 2) - 1),
+		std::max(                0, (rect.z1 / 2) - 1),
+		std::min(mapDims.hmapx - 1, (rect.x2 / 2) + 1),
+		std::min(mapDims.hmapy - 1, (rect.z2 / 2) + 1)
+	);
+
+	// one task per slopemap row, i.e. per pair of heightmap rows; all three
+	// row ranges are contained in that of the slopemap so the face normals
+	// it needs are always computed by the same task and the corner heights
+	// are only pulled into cache once
+	for_mt(smRect.z1, smRect.z2 + 1, [&](const int sy) {
+		for (int y = sy * 2; y <= (sy * 2 + 1); y++) {
+			const bool updateCenter = (y >= chRect.z1 && y <= chRect.z2);
+			const bool updateNormal = (y >= fnRect.z1 && y <= fnRect.z2);
+
+			if (!updateNormal)
+				continue;
 
-			#ifdef USE_UNSYNCED_HEIGHTMAP
-			if (initialize) {
-				faceNormalsUnsynced[(y * mapDims.mapx + x) * 2    ] = faceNormalsSynced[(y * mapDims.mapx + x) * 2    ];
-				faceNormalsUnsynced[(y * mapDims.mapx + x) * 2 + 1] = faceNormalsSynced[(y * mapDims.mapx + x) * 2 + 1];
-				centerNormalsUnsynced[y * mapDims.mapx + x] = centerNormalsSynced[y * mapDims.mapx + x];
+			float3 fnTL;
+			float3 fnBR;
+
+			for (int x = fnRect.x1; x <= fnRect.x2; x++) {
+				const int idxTL = (y    ) * mapDims.mapxp1 + x; // TL
+				const int idxBL = (y + 1) * mapDims.mapxp1 + x; // BL
+
+				const float& hTL = heightmapSynced[idxTL    ];
+				const float& hTR = heightmapSynced[idxTL + 1];
+				const float& hBL = heightmapSynced[idxBL    ];
+				const float& hBR = heightmapSynced[idxBL + 1];
+
+				if (updateCenter && x >= chRect.x1 && x <= chRect.x2)
+					centerHeightMap[y * mapDims.mapx + x] = (hTL + hTR + hBL + hBR) * 0.25f;
+
+				// normal of top-left triangle (face) in square
+				//
+				//  *---> e1
+				//  |
+				//  |
+				//  v
+				//  e2
+				//const float3 e1( SQUARE_SIZE, hTR - hTL,           0);
+				//const float3 e2(           0, hBL - hTL, SQUARE_SIZE);
+				//const float3 fnTL = (e2.cross(e1)).Normalize();
+				fnTL.y = SQUARE_SIZE;
+				fnTL.x = - (hTR - hTL);
+				fnTL.z = - (hBL - hTL);
+				fnTL.Normalize();
+
+				// normal of bottom-right triangle (face) in square
+				//
+				//         e3
+				//         ^
+				//         |
+				//         |
+				//  e4 <---*
+				//const float3 e3(-SQUARE_SIZE, hBL - hBR,           0);
+				//const float3 e4(           0, hTR - hBR,-SQUARE_SIZE);
+				//const float3 fnBR = (e4.cross(e3)).Normalize();
+				fnBR.y = SQUARE_SIZE;
+				fnBR.x = (hBL - hBR);
+				fnBR.z = (hTR - hBR);
+				fnBR.Normalize();
+
+				faceNormalsSynced[(y * mapDims.mapx + x) * 2    ] = fnTL;
+				faceNormalsSynced[(y * mapDims.mapx + x) * 2 + 1] = fnBR;
+				// square-normal
+				centerNormalsSynced[y * mapDims.mapx + x] = (fnTL + fnBR).Normalize();
+				centerNormals2D[y * mapDims.mapx + x] = (fnTL + fnBR).Normalize2D();
+
+				#ifdef USE_UNSYNCED_HEIGHTMAP
+				if (initialize) {
+					faceNormalsUnsynced[(y * mapDims.mapx + x) * 2    ] = faceNormalsSynced[(y * mapDims.mapx + x) * 2    ];
+					faceNormalsUnsynced[(y * mapDims.mapx + x) * 2 + 1] = faceNormalsSynced[(y * mapDims.mapx + x) * 2 + 1];
+					centerNormalsUnsynced[y * mapDims.mapx + x] = centerNormalsSynced[y * mapDims.mapx + x];
+				}
+				#endif
 			}
-			#endif
 		}
-	});
-}
 
-
-void CReadMap::UpdateSlopemap(const SRectangle& rect, bool initialize)
-{
-	const int sx = std::max(0,                 (rect.x1 / 2) - 1);
-	const int ex = std::min(mapDims.hmapx - 1, (rect.x2 / 2) + 1);
-	const int sy = std::max(0,                 (rect.z1 / 2) - 1);
-	const int ey = std::min(mapDims.hmapy - 1, (rect.z2 / 2) + 1);
-
-	for (int y = sy; y <= ey; y++) {
-		for (int x = sx; x <= ex; x++) {
-			const int idx0 = (y*2    ) * (mapDims.mapx) + x*2;
-			const int idx1 = (y*2 + 1) * (mapDims.mapx) + x*2;
+		for (int x = smRect.x1; x <= smRect.x2; x++) {
+			const int idx0 = (sy*2    ) * (mapDims.mapx) + x*2;
+			const int idx1 = (sy*2 + 1) * (mapDims.mapx) + x*2;
 
 			float avgslope = 0.0f;
 			avgslope += faceNormalsSynced[(idx0    ) * 2    ].y;
@@ -602,8 +591,35 @@ void CReadMap::UpdateSlopemap(const SRectangle& rect, bool initialize)
 			const float lerp = maxslope / avgslope;
 			const float slope = mix(maxslope, avgslope, lerp);
 
-			slopeMap[y * mapDims.hmapx + x] = 1.0f - slope;
+			slopeMap[sy * mapDims.hmapx + x] = 1.0f - slope;
 		}
+	});
+}
+
+
+void CReadMap::UpdateMipHeightmaps(const SRectangle& rect, bool initialize)
+{
+	for (int i = 0; i < numHeightMipMaps - 1; i++) {
+		const int hmapx = mapDims.mapx >> i;
+
+		const int sx = (rect.x1 >> i) & (~1);
+		const int ex = (rect.x2 >> i);
+		const int sy = (rect.z1 >> i) & (~1);
+		const int ey = (rect.z2 >> i);
+		float* topMipMap = mipPointerHeightMaps[i];
+		float* subMipMap = mipPointerHeightMaps[i + 1];
+
+		// each level is built from the previous one, rows within it are independent
+		for_mt(sy, ey, 2, [&](const int y) {
+			for (int x = sx; x < ex; x += 2) {
+				const float height =
+					topMipMap[(x    ) + (y    ) * hmapx] +
+					topMipMap[(x    ) + (y + 1) * hmapx] +
+					topMipMap[(x + 1) + (y    ) * hmapx] +
+					topMipMap[(x + 1) + (y + 1) * hmapx];
+				subMipMap[(x / 2) + (y / 2) * hmapx / 2] = height * 0.25f;
+			}
+		});
 	}
 }
 
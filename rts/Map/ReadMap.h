@@ -5,6 +5,7 @@
 
 #include <vector>
 
+#include "HeightMaxPyramid.h"
 #include "MapTexture.h"
 #include "MapDimensions.h"
 #include "Sim/Misc/GlobalConstants.h"
@@ -184,6 +185,7 @@ public:
 	const float3* GetSharedFaceNormals(bool synced) const { return sharedFaceNormals[synced]; }
 	const float3* GetSharedCenterNormals(bool synced) const { return sharedCenterNormals[synced]; }
 	const float* GetSharedSlopeMap(bool synced) const { return sharedSlopeMaps[synced]; }
+	const CHeightMaxPyramid* GetSharedHeightMaxPyramid(bool synced) const { return sharedHeightMaxPyramids[synced]; }
 
 	/// if you modify the heightmap through these, call UpdateHeightMapSynced
 	float SetHeight(const int idx, const float h, const int add = 0);
@@ -207,10 +209,9 @@ public:
 	unsigned int CalcTypemapChecksum();
 
 private:
-	void UpdateCenterHeightmap(const SRectangle& rect, bool initialize);
+	/// center heights, face and center normals and the slopemap in one pass
+	void UpdateHeightMapDerivatives(const SRectangle& rect, bool initialize);
 	void UpdateMipHeightmaps(const SRectangle& rect, bool initialize);
-	void UpdateFaceNormals(const SRectangle& rect, bool initialize);
-	void UpdateSlopemap(const SRectangle& rect, bool initialize);
 
 	inline void HeightMapUpdateLOSCheck(const SRectangle& hmRect);
 	inline bool HasHeightMapChanged(const int lmx, const int lmy);
@@ -252,6 +253,10 @@ protected:
 	CRectangleOptimizer unsyncedHeightMapUpdates;
 	CRectangleOptimizer unsyncedHeightMapUpdatesTemp;
 
+	/// per-block maximum corner heights, see CGround::LineGroundCol
+	CHeightMaxPyramid heightMaxPyramidSynced;
+	CHeightMaxPyramid heightMaxPyramidUnsynced;
+
 private:
 	// these combine the various synced and unsynced arrays
 	// for branch-less access: [0] = !synced, [1] = synced
@@ -260,6 +265,7 @@ private:
 	const float3* sharedFaceNormals[2];
 	const float3* sharedCenterNormals[2];
 	const float* sharedSlopeMaps[2];
+	const CHeightMaxPyramid* sharedHeightMaxPyramids[2];
 
 #ifdef USE_UNSYNCED_HEIGHTMAP
 	/// these are not "digests", just simple rolling counters
@@ -290,6 +296,9 @@ inline float CReadMap::SetHeight(const int idx, const float h, const int add) {
 	// add=1 <--> x = x*1 + h = x+h
 	x = x * add + h;
 
+	// keep the pyramid conservative until the next UpdateHeightMapSynced
+	heightMaxPyramidSynced.RaiseHeight(idx % mapDims.mapxp1, idx / mapDims.mapxp1, x);
+
 	currHeightBounds.x = std::min(x, currHeightBounds.x);
 	currHeightBounds.y = std::max(x, currHeightBounds.y);
 
@@ -6,6 +6,8 @@
 #include "System/Log/ILog.h"
 #include "System/Net/Socket.h"
 
+#include <algorithm>
+#include <limits>
 #include <string.h>
 #include <vector>
 #include <cinttypes>
@@ -48,6 +50,13 @@ enum EVENT
 	/// Server gave out a warning (string warningmessage)
 	SERVER_WARNING = 5,
 
+	/**
+	 * @brief Server resource usage, sent every 10 seconds
+	 *   (uint32 milliseconds the server thread spent on the game so far,
+	 *   uint32 kilobytes of game traffic held in memory)
+	 */
+	SERVER_STATS = 6,
+
 	/// Player has joined the game (uchar playernumber, string name)
 	PLAYER_JOINED = 10,
 
@@ -236,6 +245,19 @@ void AutohostInterface::SendGameOver(uchar playerNum, const std::vector<uchar>&
 	Send(asio::buffer(buffer));
 }
 
+void AutohostInterface::SendServerStats(std::uint32_t workTime, size_t memoryUsage)
+{
+	const std::uint32_t memoryKB = std::min(memoryUsage / 1024, size_t(std::numeric_limits<std::uint32_t>::max()));
+
+	uchar msg[1 + 2 * sizeof(std::uint32_t)];
+	msg[0] = SERVER_STATS;
+
+	memcpy(&msg[1], &workTime, sizeof(workTime));
+	memcpy(&msg[1 + sizeof(workTime)], &memoryKB, sizeof(memoryKB));
+
+	Send(asio::buffer(&msg, sizeof(msg)));
+}
+
 void AutohostInterface::SendPlayerJoined(uchar playerNum, const std::string& name)
 {
 	if (autohost.is_open()) {
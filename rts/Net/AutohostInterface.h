@@ -36,6 +36,7 @@ public:
 	void SendQuit();
 	void SendStartPlaying(const unsigned char* gameID, const std::string& demoName);
 	void SendGameOver(uchar playerNum, const std::vector<uchar>& winningAllyTeams);
+	void SendServerStats(std::uint32_t workTime, size_t memoryUsage);
 
 	void SendPlayerJoined(uchar playerNum, const std::string& name);
 	void SendPlayerLeft(uchar playerNum, uchar reason);
@@ -6,6 +6,12 @@
 #include "Sim/Misc/GlobalConstants.h"
 #include "System/Net/Connection.h"
 #include "System/Misc/SpringTime.h"
+#include "System/SpringFormat.h"
+
+#include <algorithm>
+
+// upper (exclusive) bounds of all but the last bucket, in milliseconds
+static const int pingBucketLimits[GameParticipant::PingHistogram::NUM_BUCKETS - 1] = {25, 50, 100, 200, 400, 800, 1600};
 
 GameParticipant::GameParticipant()
 : id(-1)
@@ -15,8 +21,13 @@ GameParticipant::GameParticipant()
 , isLocal(false)
 , isReconn(false)
 , isMidgameJoin(false)
+, batchBroadcasts(false)
 {
 	linkData[MAX_AIS] = PlayerLinkData(false);
+
+#ifdef SYNCCHECK
+	syncSections.frameNum = -1;
+#endif
 }
 
 void GameParticipant::SendData(std::shared_ptr<const netcode::RawPacket> packet)
@@ -32,6 +43,7 @@ void GameParticipant::Connected(std::shared_ptr<netcode::CConnection> _link, boo
 	isLocal = local;
 	myState = CONNECTED;
 	lastFrameResponse = 0;
+	pingHistogram.Clear();
 }
 
 void GameParticipant::Kill(const std::string& reason, const bool flush)
@@ -48,9 +60,42 @@ void GameParticipant::Kill(const std::string& reason, const bool flush)
 		link.reset();
 	}
 	linkData[MAX_AIS].link.reset();
+	batchBroadcasts = false;
 #ifdef SYNCCHECK
 	syncResponse.clear();
 #endif
 	myState = DISCONNECTED;
 }
 
+
+
+void GameParticipant::PingHistogram::Clear()
+{
+	std::fill(counts, counts + NUM_BUCKETS, 0);
+	numSamples = 0;
+	maxPing = 0;
+}
+
+void GameParticipant::PingHistogram::AddSample(int pingMsecs)
+{
+	const int* limit = std::upper_bound(pingBucketLimits, pingBucketLimits + NUM_BUCKETS - 1, pingMsecs);
+
+	counts[limit - pingBucketLimits] += 1;
+	numSamples += 1;
+	maxPing = std::max(maxPing, pingMsecs);
+}
+
+std::string GameParticipant::PingHistogram::ToString() const
+{
+	std::string str = spring::format("%d samples, max %dms:", numSamples, maxPing);
+
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		if (i < (NUM_BUCKETS - 1)) {
+			str += spring::format(" <%d=%d", pingBucketLimits[i], counts[i]);
+		} else {
+			str += spring::format(" >=%d=%d", pingBucketLimits[i - 1], counts[i]);
+		}
+	}
+
+	return str;
+}
@@ -4,10 +4,12 @@
 #define _GAME_PARTICIPANT_H
 
 #include <memory>
+#include <string>
 
 #include "Game/Players/PlayerBase.h"
 #include "Game/Players/PlayerStatistics.h"
 #include "System/Net/LoopbackConnection.h"
+#include "System/Sync/SyncSections.h"
 
 namespace netcode
 {
@@ -44,6 +46,8 @@ public:
 	bool isLocal;
 	bool isReconn;
 	bool isMidgameJoin;
+	/// broadcasts reach this (remote spectator) via CGameServer's shared spectator batch
+	bool batchBroadcasts;
 	std::shared_ptr<netcode::CConnection> link;
 	PlayerStatistics lastStats;
 
@@ -54,8 +58,26 @@ public:
 	};
 	std::map<unsigned char, PlayerLinkData> linkData;
 
+	/// ping samples taken by CGameServer::LagProtection, bucketed for reporting
+	struct PingHistogram {
+		static const int NUM_BUCKETS = 8;
+
+		PingHistogram() { Clear(); }
+
+		void Clear();
+		void AddSample(int pingMsecs);
+		std::string ToString() const;
+
+		int counts[NUM_BUCKETS];
+		int numSamples;
+		int maxPing;
+	};
+	PingHistogram pingHistogram;
+
 #ifdef SYNCCHECK
 	std::map<int, unsigned> syncResponse; // syncResponse[frameNum] = checksum
+	/// answer to the last NETMSG_SYNCSECTIONS_REQUEST, frameNum is -1 until it arrives
+	SyncSectionChecksums syncSections;
 #endif
 };
 
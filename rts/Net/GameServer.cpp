@@ -3,7 +3,9 @@
 #include "System/Net/UDPListener.h"
 #include "System/Net/UDPConnection.h"
 
+#include <chrono>
 #include <functional>
+#include <iterator>
 #include <deque>
 #if defined DEDICATED || defined DEBUG
 	#include <iostream>
@@ -64,11 +66,14 @@ using netcode::RawPacket;
 
 
 CONFIG(int, AutohostPort).defaultValue(0);
-CONFIG(int, ServerSleepTime).defaultValue(5).description("number of milliseconds to sleep per tick");
+CONFIG(int, ServerSleepTime).defaultValue(5).minimumValue(1).description("maximum number of milliseconds the server waits between ticks, it wakes up earlier on incoming data and when the next frame is due (but not on autohost input)");
 CONFIG(int, SpeedControl).defaultValue(1).minimumValue(1).maximumValue(2)
 	.description("Sets how server adjusts speed according to player's load (CPU), 1: use average, 2: use highest");
 CONFIG(bool, AllowSpectatorJoin).defaultValue(true).description("allow any unauthenticated clients to join as spectator with any name, name will be prefixed with ~");
 CONFIG(bool, WhiteListAdditionalPlayers).defaultValue(true);
+CONFIG(int, ServerPacketCacheMemory).defaultValue(64).minimumValue(0).description("megabytes of (compressed) game traffic the server keeps in memory for reconnecting and late-joining clients, older traffic is moved to a temporary file if ServerPacketCacheSpill is set; 0 means no limit");
+CONFIG(bool, ServerPacketCacheSpill).defaultValue(true);
+CONFIG(bool, ServerBatchSpectatorData).defaultValue(true).description("send the messages broadcast during one server update to remote spectators as a single shared buffer, instead of one by one");
 CONFIG(bool, ServerRecordDemos).defaultValue(false).dedicatedValue(true);
 CONFIG(bool, ServerLogInfoMessages).defaultValue(false);
 CONFIG(bool, ServerLogDebugMessages).defaultValue(false);
@@ -92,9 +97,15 @@ static const unsigned SYNCCHECK_TIMEOUT = 300;
 /// used to prevent msg spam
 static const unsigned SYNCCHECK_MSG_TIMEOUT = 400;
 
+/// how long to wait for all players' section checksums after a desync
+static const spring_time syncSectionsTimeout = spring_secs(5);
+
 /// The time interval in msec for sending player statistics to each client
 static const spring_time playerInfoTime = spring_secs(2);
 
+/// The time interval for reporting the server's own cpu and memory usage to the autohost
+static const spring_time serverStatsTime = spring_secs(10);
+
 /// every n'th frame will be a keyframe (and contain the server's framenumber)
 static const unsigned serverKeyframeInterval = 16;
 
@@ -120,7 +131,8 @@ static const std::string SERVER_COMMANDS[] = {
 };
 
 
-std::set<std::string> CGameServer::commandBlacklist;
+// filled once, several servers can run in the same process
+std::set<std::string> CGameServer::commandBlacklist(std::begin(SERVER_COMMANDS), std::end(SERVER_COMMANDS));
 
 
 
@@ -139,6 +151,8 @@ CGameServer::CGameServer(
 , gameEndTime(spring_notime)
 , lastPlayerInfo(serverStartTime)
 , lastUpdate(serverStartTime)
+, lastStatsReport(serverStartTime)
+, workTime(spring_notime)
 
 , modGameTime(0.0f)
 , gameTime(0.0f)
@@ -161,12 +175,16 @@ CGameServer::CGameServer(
 
 , syncErrorFrame(0)
 , syncWarningFrame(0)
+, syncSectionsFrame(-1)
 
 , localClientNumber(-1u)
 
+, wakeRequested(false)
+
 , gameHasStarted(false)
 , generatedGameID(false)
 , reloadingServer(false)
+, demoReadByClient(false)
 {
 	myClientSetup = newClientSetup;
 	myGameData = newGameData;
@@ -178,12 +196,17 @@ CGameServer::CGameServer(
 CGameServer::~CGameServer()
 {
 	quitServer = true;
+	WakeUp();
 
 	LOG_L(L_INFO, "[%s][1]", __FUNCTION__);
 	thread->join();
 	delete thread;
 	LOG_L(L_INFO, "[%s][2]", __FUNCTION__);
 
+	// the local client can outlive us, stop it from calling WakeUp
+	if (HasLocalClient() && players[localClientNumber].link != nullptr)
+		std::static_pointer_cast<netcode::CLocalConnection>(players[localClientNumber].link)->SetDataCallback(nullptr);
+
 	// after this, demoRecorder goes out of scope and its dtor is called
 	WriteDemoData();
 }
@@ -197,6 +220,9 @@ void CGameServer::Initialize()
 	whiteListAdditionalPlayers = configHandler->GetBool("WhiteListAdditionalPlayers");
 	logInfoMessages = configHandler->GetBool("ServerLogInfoMessages");
 	logDebugMessages = configHandler->GetBool("ServerLogDebugMessages");
+	batchSpectatorData = configHandler->GetBool("ServerBatchSpectatorData");
+
+	packetCache.SetMemoryLimit(configHandler->GetInt("ServerPacketCacheMemory") * size_t(1024 * 1024), configHandler->GetBool("ServerPacketCacheSpill"));
 
 	rng.Seed((myGameData->GetSetupText()).length());
 
@@ -265,10 +291,6 @@ void CGameServer::Initialize()
 		}
 	}
 
-	for (unsigned int n = 0; n < (sizeof(SERVER_COMMANDS) / sizeof(std::string)); n++) {
-		commandBlacklist.insert(SERVER_COMMANDS[n]);
-	}
-
 	if (configHandler->GetBool("ServerRecordDemos")) {
 		demoRecorder.reset(new CDemoRecorder(myGameSetup->mapName, myGameSetup->modName, true));
 		demoRecorder->WriteSetupText(myGameData->GetSetupText());
@@ -381,7 +403,11 @@ void CGameServer::AddLocalClient(const std::string& myName, const std::string& m
 	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
 	assert(!HasLocalClient());
 
-	localClientNumber = BindConnection(myName, "", myVersion, true, std::shared_ptr<netcode::CConnection>(new netcode::CLocalConnection()));
+	std::shared_ptr<netcode::CLocalConnection> localConn(new netcode::CLocalConnection());
+
+	// the local client does not go through UDPNet, make it wake us up itself
+	localConn->SetDataCallback([this]() { WakeUp(); });
+	localClientNumber = BindConnection(myName, "", myVersion, true, localConn);
 }
 
 void CGameServer::AddAutohostInterface(const std::string& autohostIP, const int autohostPort)
@@ -424,6 +450,7 @@ void CGameServer::SkipTo(int targetFrameNum)
 	if (!gameHasStarted) { return; }
 	if (serverFrameNum >= targetFrameNum) { return; }
 	if (demoReader == NULL) { return; }
+	if (demoReadByClient) { return; }
 
 	CommandMessage startMsg(spring::format("skip start %d", targetFrameNum), SERVER_PLAYER);
 	CommandMessage endMsg("skip end", SERVER_PLAYER);
@@ -566,9 +593,7 @@ bool CGameServer::SendDemoData(int targetFrameNum)
 
 void CGameServer::Broadcast(std::shared_ptr<const netcode::RawPacket> packet)
 {
-	for (GameParticipant& p: players) {
-		p.SendData(packet);
-	}
+	SendToAll(packet);
 
 	if (canReconnect || allowSpecJoin || !gameHasStarted)
 		AddToPacketCache(packet);
@@ -577,6 +602,51 @@ void CGameServer::Broadcast(std::shared_ptr<const netcode::RawPacket> packet)
 		demoRecorder->SaveToDemo(packet->data, packet->length, GetDemoTime());
 }
 
+void CGameServer::SendToAll(std::shared_ptr<const netcode::RawPacket> packet)
+{
+	bool haveBatched = false;
+
+	for (GameParticipant& p: players) {
+		haveBatched |= p.batchBroadcasts;
+
+		if (p.batchBroadcasts)
+			continue;
+
+		p.SendData(packet);
+	}
+
+	// the UDP stream does not care about message boundaries, so all of an
+	// update's messages can be appended and queued once per spectator
+	if (haveBatched)
+		spectatorBatch.insert(spectatorBatch.end(), packet->data, packet->data + packet->length);
+}
+
+void CGameServer::SendToPlayer(GameParticipant& player, std::shared_ptr<const netcode::RawPacket> packet)
+{
+	// a batched spectator must not get this ahead of what was broadcast before
+	if (player.batchBroadcasts)
+		FlushSpectatorBatch();
+
+	player.SendData(packet);
+}
+
+void CGameServer::FlushSpectatorBatch()
+{
+	if (spectatorBatch.empty())
+		return;
+
+	std::shared_ptr<const netcode::RawPacket> batch(new netcode::RawPacket(&spectatorBatch[0], spectatorBatch.size()));
+
+	for (GameParticipant& p: players) {
+		if (!p.batchBroadcasts)
+			continue;
+
+		p.SendData(batch);
+	}
+
+	spectatorBatch.clear();
+}
+
 void CGameServer::Message(const std::string& message, bool broadcast)
 {
 	if (broadcast) {
@@ -584,7 +654,7 @@ void CGameServer::Message(const std::string& message, bool broadcast)
 	}
 	else if (HasLocalClient()) {
 		// host should see
-		players[localClientNumber].SendData(CBaseNetProtocol::Get().SendSystemMessage(SERVER_PLAYER, message));
+		SendToPlayer(players[localClientNumber], CBaseNetProtocol::Get().SendSystemMessage(SERVER_PLAYER, message));
 	}
 	if (hostif)
 		hostif->Message(message);
@@ -595,7 +665,7 @@ void CGameServer::Message(const std::string& message, bool broadcast)
 }
 
 void CGameServer::PrivateMessage(int playerNum, const std::string& message) {
-	players[playerNum].SendData(CBaseNetProtocol::Get().SendSystemMessage(SERVER_PLAYER, message));
+	SendToPlayer(players[playerNum], CBaseNetProtocol::Get().SendSystemMessage(SERVER_PLAYER, message));
 }
 
 void CGameServer::CheckSync()
@@ -692,6 +762,8 @@ void CGameServer::CheckSync()
 			if (!syncErrorFrame || (*f - syncErrorFrame > static_cast<int>(SYNCCHECK_MSG_TIMEOUT))) {
 				syncErrorFrame = *f;
 
+				RequestSyncSections(*f);
+
 				// TODO enable this when we have resync
 				//serverNet->SendPause(SERVER_PLAYER, true);
 			#ifdef SYNCDEBUG
@@ -736,6 +808,8 @@ void CGameServer::CheckSync()
 		} else
 			++f;
 	}
+
+	CheckSyncSections();
 #else
 	// Make it clear this build isn't suitable for release.
 	if (!syncErrorFrame || (serverFrameNum - syncErrorFrame > SYNCCHECK_MSG_TIMEOUT)) {
@@ -746,6 +820,108 @@ void CGameServer::CheckSync()
 }
 
 
+void CGameServer::RequestSyncSections(int frameNum)
+{
+#ifdef SYNCCHECK
+	if (syncSectionsFrame >= 0)
+		return;
+
+	syncSectionsFrame = frameNum;
+	syncSectionsRequestTime = spring_gettime();
+
+	for (GameParticipant& p: players) {
+		p.syncSections.frameNum = -1;
+	}
+
+	// not broadcast, the request has no place in the packet cache or demo
+	SendToAll(CBaseNetProtocol::Get().SendSyncSectionsRequest(frameNum));
+#endif
+}
+
+void CGameServer::CheckSyncSections()
+{
+#ifdef SYNCCHECK
+	if (syncSectionsFrame < 0)
+		return;
+
+	std::vector<const GameParticipant*> responders;
+	bool complete = true;
+
+	for (const GameParticipant& p: players) {
+		if (!p.link)
+			continue;
+
+		if (p.syncSections.frameNum == syncSectionsFrame) {
+			responders.push_back(&p);
+		} else {
+			complete = false;
+		}
+	}
+
+	if (!complete && spring_gettime() < (syncSectionsRequestTime + syncSectionsTimeout))
+		return;
+
+	const int frameNum = syncSectionsFrame;
+	syncSectionsFrame = -1;
+
+	if (responders.size() < 2) {
+		Message(spring::format(SyncSectionUnknown, frameNum, int(responders.size())));
+		return;
+	}
+
+	const GameParticipant* localClient = nullptr;
+
+	if (HasLocalClient() && players[localClientNumber].syncSections.frameNum == frameNum)
+		localClient = &players[localClientNumber];
+
+	// the checksums are chained, so the earliest section that differs is
+	// where the simulation diverged; later ones differ as a consequence
+	for (unsigned section = 0; section < SYNC_SECTION_COUNT; ++section) {
+		unsigned correctChecksum = 0;
+
+		if (localClient != nullptr) {
+			// dictatorship
+			correctChecksum = localClient->syncSections.checksums[section];
+		} else {
+			// democracy
+			std::map<unsigned, unsigned> votes;
+			unsigned maxVotes = 0;
+
+			for (const GameParticipant* p: responders) {
+				const unsigned checksum = p->syncSections.checksums[section];
+				const unsigned numVotes = ++votes[checksum];
+
+				if (numVotes > maxVotes) {
+					maxVotes = numVotes;
+					correctChecksum = checksum;
+				}
+			}
+		}
+
+		// maps incorrect checksum to players with that checksum
+		std::map<unsigned, std::vector<int> > desyncGroups;
+
+		for (const GameParticipant* p: responders) {
+			if (p->syncSections.checksums[section] != correctChecksum)
+				desyncGroups[p->syncSections.checksums[section]].push_back(p->id);
+		}
+
+		if (desyncGroups.empty())
+			continue;
+
+		for (const auto& g: desyncGroups) {
+			const std::string playerNames = GetPlayerNames(g.second);
+			Message(spring::format(SyncSectionError, playerNames.c_str(), frameNum, SyncSections::GetName(section), g.first, correctChecksum));
+		}
+
+		return;
+	}
+
+	Message(spring::format(SyncSectionUnknown, frameNum, int(responders.size())));
+#endif
+}
+
+
 float CGameServer::GetDemoTime() const {
 	if (!gameHasStarted) return gameTime;
 	return (startTime + serverFrameNum / float(GAME_SPEED));
@@ -830,6 +1006,14 @@ void CGameServer::Update()
 			quitServer = true;
 		}
 	}
+
+	if (hostif && lastStatsReport < (spring_gettime() - serverStatsTime)) {
+		lastStatsReport = spring_gettime();
+		hostif->SendServerStats(workTime.toMilliSecsi(), GetMemoryUsage());
+	}
+
+	// broadcasts made outside of the server thread wait for the next update
+	FlushSpectatorBatch();
 }
 
 
@@ -849,6 +1033,8 @@ void CGameServer::LagProtection()
 			const int curPing = ((serverFrameNum - player.lastFrameResponse) * 1000) / (GAME_SPEED * internalSpeed);
 			Broadcast(CBaseNetProtocol::Get().SendPlayerInfo(player.id, player.cpuUsage, curPing));
 
+			player.pingHistogram.AddSample(curPing);
+
 			const float playerCpuUsage = player.cpuUsage;
 			const float correctedCpu   = Clamp(playerCpuUsage, 0.0f, 1.0f);
 
@@ -1255,6 +1441,32 @@ void CGameServer::ProcessPacket(const unsigned playerNum, std::shared_ptr<const
 #endif
 		} break;
 
+		case NETMSG_SYNCSECTIONS: {
+#ifdef SYNCCHECK
+			netcode::UnpackPacket pckt(packet, 1);
+
+			unsigned char playerNum; pckt >> playerNum;
+			          int  frameNum; pckt >> frameNum;
+
+			if (playerNum != a) {
+				Message(spring::format(WrongPlayer, msgCode, a, (unsigned)playerNum));
+				break;
+			}
+			// late answers to an earlier request are of no use
+			if (frameNum != syncSectionsFrame)
+				break;
+
+			GameParticipant& p = players[a];
+
+			for (unsigned int n = 0; n < SYNC_SECTION_COUNT; ++n) {
+				pckt >> p.syncSections.checksums[n];
+			}
+
+			p.syncSections.frameNum = frameNum;
+			CheckSyncSections();
+#endif
+		} break;
+
 		case NETMSG_SHARE:
 			if (inbuf[1] != a) {
 				Message(spring::format(WrongPlayer, msgCode, a, (unsigned)inbuf[1]));
@@ -1751,6 +1963,7 @@ void CGameServer::HandleConnectionAttempts()
 			netcode::UnpackPacket msg(packet, 3);
 			std::string name, passwd, version;
 			unsigned char reconnect, netloss;
+			unsigned char linkFlags = 0;
 			unsigned short netversion;
 			msg >> netversion;
 			msg >> name;
@@ -1759,10 +1972,17 @@ void CGameServer::HandleConnectionAttempts()
 			msg >> reconnect;
 			msg >> netloss;
 
+			// not sent by older clients
+			if (msg.GetRemainingBytes() > 0)
+				msg >> linkFlags;
+
 			if (netversion != NETWORK_VERSION)
 				throw netcode::UnpackPacketException(spring::format("Wrong network version: %d, required version: %d", (int)netversion, (int)NETWORK_VERSION));
 
-			BindConnection(name, passwd, version, false, UDPNet->AcceptConnection(), reconnect, netloss);
+			const std::shared_ptr<netcode::UDPConnection> link = UDPNet->AcceptConnection();
+			link->SetCompression(globalConfig->linkCompression && (linkFlags & LINK_FLAG_COMPRESSION) != 0);
+
+			BindConnection(name, passwd, version, false, link, reconnect, netloss);
 		} catch (const netcode::UnpackPacketException& ex) {
 			const std::string msg = spring::format(ConnectionReject, ex.what());
 			prev->Unmute();
@@ -1962,7 +2182,7 @@ void CGameServer::StartGame(bool forced)
 	gameHasStarted = true;
 	startTime = gameTime;
 	if (!canReconnect && !allowSpecJoin)
-		packetCache.clear(); // free memory
+		packetCache.Clear(); // free memory
 
 	if (UDPNet && !canReconnect && !allowSpecJoin)
 		UDPNet->SetAcceptingConnections(false); // do not accept new connections
@@ -2297,9 +2517,24 @@ bool CGameServer::HasFinished() const
 	return quitServer;
 }
 
+spring_time CGameServer::GetWorkTime() const
+{
+	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+	return workTime;
+}
+
+size_t CGameServer::GetMemoryUsage() const
+{
+	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+	return (packetCache.GetMemoryUsage() + packetCache.GetOpenSegmentSize());
+}
+
 void CGameServer::CreateNewFrame(bool fromServerThread, bool fixedFrameTime)
 {
 	if (demoReader != NULL) {
+		if (demoReadByClient)
+			return;
+
 		CheckSync();
 		SendDemoData(-1);
 		return;
@@ -2399,9 +2634,7 @@ void CGameServer::CreateNewFrame(bool fromServerThread, bool fixedFrameTime)
 			if ((serverFrameNum % gameProgressFrameInterval) == 0) {
 				CBaseNetProtocol::PacketType progressPacket = CBaseNetProtocol::Get().SendCurrentFrameProgress(serverFrameNum);
 				// we cannot use broadcast here, since we want to skip caching
-				for (GameParticipant& p: players) {
-					p.SendData(progressPacket);
-				}
+				SendToAll(progressPacket);
 			}
 		#ifdef SYNCCHECK
 			outstandingSyncFrames.insert(serverFrameNum);
@@ -2433,6 +2666,54 @@ std::string CGameServer::SpeedControlToString(int speedCtrl)
 }
 
 
+void CGameServer::WaitForData()
+{
+	spring_time timeout = spring_msecs(loopSleepTime);
+
+	{
+		std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+
+		if (demoReader != nullptr) {
+			// demo frames are sent as modGameTime passes them, tick twice per frame
+			timeout = std::min(timeout, spring_msecs(500.0f / (GAME_SPEED * internalSpeed)));
+		} else if (gameHasStarted && !isPaused) {
+			// CreateNewFrame leaves frameTimeLeft in (-1, 0], the next frame is due once it turns positive
+			const float frameMsecsLeft = -frameTimeLeft / ((GAME_SPEED * 0.001f) * internalSpeed);
+			const spring_time frameTimeout = (lastNewFrameTick + spring_msecs(frameMsecsLeft)) - spring_gettime();
+
+			timeout = std::max(spring_msecs(1), std::min(timeout, frameTimeout));
+		}
+	}
+
+	if (UDPNet != nullptr) {
+		UDPNet->WaitForData(timeout);
+		return;
+	}
+
+	std::unique_lock<spring::mutex> lock(wakeMutex);
+
+	if (!wakeRequested)
+		wakeCond.wait_for(lock, std::chrono::microseconds(timeout.toMicroSecsi()));
+
+	wakeRequested = false;
+}
+
+void CGameServer::WakeUp()
+{
+	if (UDPNet != nullptr) {
+		UDPNet->Wake();
+		return;
+	}
+
+	{
+		std::lock_guard<spring::mutex> lock(wakeMutex);
+		wakeRequested = true;
+	}
+
+	wakeCond.notify_one();
+}
+
+
 __FORCE_ALIGN_STACK__
 void CGameServer::UpdateLoop()
 {
@@ -2441,7 +2722,9 @@ void CGameServer::UpdateLoop()
 		Threading::SetAffinity(~0);
 
 		while (!quitServer) {
-			spring_msecs(loopSleepTime).sleep(true);
+			WaitForData();
+
+			const spring_time workStartTime = spring_gettime();
 
 			if (UDPNet)
 				UDPNet->Update();
@@ -2449,12 +2732,22 @@ void CGameServer::UpdateLoop()
 			std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
 			ServerReadNet();
 			Update();
+
+			workTime += (spring_gettime() - workStartTime);
+		}
+
+		for (GameParticipant& p: players) {
+			if (p.pingHistogram.numSamples == 0)
+				continue;
+
+			LOG("[GameServer] ping histogram for %s: %s", p.name.c_str(), p.pingHistogram.ToString().c_str());
 		}
 
 		if (hostif)
 			hostif->SendQuit();
 
 		Broadcast(CBaseNetProtocol::Get().SendQuit("Server shutdown"));
+		FlushSpectatorBatch();
 
 		if (!reloadingServer) {
 			// this is to make sure the Flush has any effect at all (we don't want a forced flush)
@@ -2485,6 +2778,7 @@ void CGameServer::KickPlayer(const int playerNum)
 	}
 	Message(spring::format(PlayerLeft, players[playerNum].GetType(), players[playerNum].name.c_str(), "kicked"));
 	Broadcast(CBaseNetProtocol::Get().SendPlayerLeft(playerNum, 2));
+	FlushSpectatorBatch();
 	players[playerNum].Kill("Kicked from the battle", true);
 	if (hostif)
 		hostif->SendPlayerLeft(playerNum, 2);
@@ -2689,14 +2983,19 @@ unsigned CGameServer::BindConnection(std::string name, const std::string& passwd
 		return newPlayerNumber;
 	}
 
+	// everything broadcast until now reaches the new player through the packet cache
+	FlushSpectatorBatch();
+
 	newPlayer.Connected(link, isLocal);
 	newPlayer.SendData(std::shared_ptr<const RawPacket>(myGameData->Pack()));
 	newPlayer.SendData(CBaseNetProtocol::Get().SendSetPlayerNum((unsigned char)newPlayerNumber));
 
 	// after gamedata and playerNum, the player can start loading
 	// throw at him all stuff he missed until now
-	for (const std::shared_ptr<const netcode::RawPacket>& p: packetCache)
-		newPlayer.SendData(p);
+	packetCache.ForEachPacket([&](const std::shared_ptr<const netcode::RawPacket>& p) { newPlayer.SendData(p); });
+
+	// local connections deliver packets as they are, so they can not take batches
+	newPlayer.batchBroadcasts = (batchSpectatorData && newPlayer.spectator && !isLocal);
 
 	if (demoReader == NULL || myGameSetup->demoName.empty()) {
 		// player wants to play -> join team
@@ -2780,5 +3079,5 @@ void CGameServer::FreeSkirmishAIId(const unsigned char skirmishAIId)
 
 void CGameServer::AddToPacketCache(std::shared_ptr<const netcode::RawPacket> &pckt)
 {
-	packetCache.push_back(pckt);
+	packetCache.Add(pckt);
 }
@@ -15,6 +15,7 @@
 #include <list>
 
 #include "Game/GameData.h"
+#include "Net/PacketCache.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamBase.h"
 #include "System/float3.h"
@@ -91,6 +92,8 @@ public:
 
 	void SetGamePausable(const bool arg);
 	void SetReloading(const bool arg) { reloadingServer = arg; }
+	/// the local client reads the demo itself (--analyze-demo), stop streaming it
+	void SetDemoReadByClient() { demoReadByClient = true; }
 
 	bool PreSimFrame() const { return (serverFrameNum == -1); }
 	bool HasStarted() const { return gameHasStarted; }
@@ -99,6 +102,11 @@ public:
 	/// Is the server still running?
 	bool HasFinished() const;
 
+	/// time the server thread spent on this game, excluding waiting for data
+	spring_time GetWorkTime() const;
+	/// bytes held for this game's traffic (packet cache and pending spectator data)
+	size_t GetMemoryUsage() const;
+
 	void UpdateSpeedControl(int speedCtrl);
 	static std::string SpeedControlToString(int speedCtrl);
 	static const std::set<std::string>& GetCommandBlackList() { return commandBlacklist; }
@@ -145,8 +153,16 @@ private:
 	void StartGame(bool forced);
 	void UpdateLoop();
 	void Update();
+	/// block until network data arrives, WakeUp is called or the next frame is due
+	void WaitForData();
+	/// makes WaitForData return; thread-safe
+	void WakeUp();
 	void ProcessPacket(const unsigned playerNum, std::shared_ptr<const netcode::RawPacket> packet);
 	void CheckSync();
+	/// asks all linked players for their per-section checksums of <frameNum>
+	void RequestSyncSections(int frameNum);
+	/// reports the first diverging section once all answers arrived
+	void CheckSyncSections();
 	void HandleConnectionAttempts();
 	void ServerReadNet();
 
@@ -160,6 +176,12 @@ private:
 	bool SendDemoData(int targetFrameNum);
 
 	void Broadcast(std::shared_ptr<const netcode::RawPacket> packet);
+	/// like Broadcast, but the packet is neither cached nor recorded
+	void SendToAll(std::shared_ptr<const netcode::RawPacket> packet);
+	/// sends <packet> to one participant, after everything broadcast before it
+	void SendToPlayer(GameParticipant& player, std::shared_ptr<const netcode::RawPacket> packet);
+	/// send everything broadcast since the last call to the batched spectators, as one shared packet
+	void FlushSpectatorBatch();
 
 	/**
 	 * @brief skip frames
@@ -194,6 +216,9 @@ private:
 	spring_time lastPlayerInfo;
 	spring_time lastUpdate;
 	spring_time lastBandwidthUpdate;
+	spring_time lastStatsReport;
+	/// accumulated by UpdateLoop, see GetWorkTime
+	spring_time workTime;
 
 	float modGameTime;
 	float gameTime;
@@ -220,6 +245,7 @@ private:
 	float medianCpu;
 	int medianPing;
 	int curSpeedCtrl;
+	/// maximum time the server thread waits for data between updates
 	int loopSleepTime;
 
 	/// The maximum speed users are allowed to set
@@ -237,7 +263,11 @@ private:
 	bool logInfoMessages;
 	bool logDebugMessages;
 
-	std::deque< std::shared_ptr<const netcode::RawPacket> > packetCache;
+	CPacketCache packetCache;
+
+	/// broadcast messages not yet sent to participants with batchBroadcasts set
+	std::vector<std::uint8_t> spectatorBatch;
+	bool batchSpectatorData;
 
 	/////////////////// sync stuff ///////////////////
 #ifdef SYNCCHECK
@@ -246,6 +276,10 @@ private:
 	int syncErrorFrame;
 	int syncWarningFrame;
 
+	/// frame of the pending NETMSG_SYNCSECTIONS_REQUEST, -1 if none
+	int syncSectionsFrame;
+	spring_time syncSectionsRequestTime;
+
 	///////////////// internal stuff //////////////////
 	void InternalSpeedChange(float newSpeed);
 	void UserSpeedChange(float newSpeed, int player);
@@ -269,9 +303,15 @@ private:
 
 	mutable spring::recursive_mutex gameServerMutex;
 
+	/// lets WaitForData block when there is no UDP socket to wait on
+	spring::mutex wakeMutex;
+	spring::condition_variable wakeCond;
+	bool wakeRequested;
+
 	volatile bool gameHasStarted;
 	volatile bool generatedGameID;
 	volatile bool reloadingServer;
+	volatile bool demoReadByClient;
 
 	int linkMinPacketSize;
 
@@ -15,6 +15,7 @@
 #include "Game/GlobalUnsynced.h"
 #include "Game/SelectedUnitsHandler.h"
 #include "Game/ChatMessage.h"
+#include "Game/DemoAnalysis.h"
 #include "Game/WordCompletion.h"
 #include "Game/IVideoCapturing.h"
 #include "Game/InMapDraw.h"
@@ -30,6 +31,9 @@
 #include "Sim/Units/UnitHandler.h"
 #include "System/EventHandler.h"
 #include "System/GlobalConfig.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
 #include "System/Log/ILog.h"
 #include "System/myMath.h"
 #include "Net/Protocol/NetProtocol.h"
@@ -41,8 +45,14 @@
 #define LOG_SECTION_NET "Net"
 LOG_REGISTER_SECTION_GLOBAL(LOG_SECTION_NET)
 
+CONFIG(std::string, SyncSectionLog).defaultValue("").description("If set, every frame's per-section sync checksums are written to this file (relative to the write-dir); compare two of them with `demotool --syncdiff`.");
+
 static spring::unordered_map<int, unsigned int> localSyncChecksums;
 
+#ifdef SYNCCHECK
+static CSyncSectionLog syncSectionLog;
+#endif
+
 
 void CGame::AddTraffic(int playerID, int packetCode, int length)
 {
@@ -219,12 +229,15 @@ void CGame::ClientReadNet()
 
 	UpdateNetMessageProcessingTimeLeft();
 
-	const spring_time msgProcEndTime = spring_gettime() + spring_msecs(GetNetMessageProcessingTimeLimit());
+	// a demo being analysed is consumed as fast as possible, only
+	// return often enough for the main loop to feed the watchdog
+	const float msgProcTimeLimit = (demoAnalysis != nullptr)? 500.0f: GetNetMessageProcessingTimeLimit();
+	const spring_time msgProcEndTime = spring_gettime() + spring_msecs(msgProcTimeLimit);
 
 	// really process the messages
 	while (true) {
 		// smooths simframes across the full second
-		if (msgProcTimeLeft <= 0.0f)
+		if (msgProcTimeLeft <= 0.0f && demoAnalysis == nullptr)
 			break;
 		// balance the time spent in sim & drawing
 		if (spring_gettime() > msgProcEndTime)
@@ -235,6 +248,10 @@ void CGame::ClientReadNet()
 		// get netpacket from the queue
 		std::shared_ptr<const netcode::RawPacket> packet = clientNet->GetData(gs->frameNum);
 
+		// server messages first, then the next one from the demo
+		if (!packet && demoAnalysis != nullptr)
+			packet = demoAnalysis->GetData(gs->frameNum);
+
 		if (!packet)
 			break;
 
@@ -513,7 +530,25 @@ void CGame::ClientReadNet()
 				// both NETMSG_SYNCRESPONSE and NETMSG_NEWFRAME are used for ping calculation by server
 				ASSERT_SYNCED(gs->frameNum);
 				ASSERT_SYNCED(CSyncChecker::GetChecksum());
-				clientNet->Send(CBaseNetProtocol::Get().SendSyncResponse(gu->myPlayerNum, gs->frameNum, CSyncChecker::GetChecksum()));
+
+				// nobody is waiting for our responses when analysing a demo
+				if (demoAnalysis == nullptr)
+					clientNet->Send(CBaseNetProtocol::Get().SendSyncResponse(gu->myPlayerNum, gs->frameNum, CSyncChecker::GetChecksum()));
+
+				{
+					const SyncSectionChecksums& sections = CSyncChecker::EndFrame(gs->frameNum);
+
+					if (gs->frameNum == 0) {
+						const std::string& logName = configHandler->GetString("SyncSectionLog");
+
+						syncSectionLog.Close();
+
+						if (!logName.empty() && !syncSectionLog.Open(dataDirsAccess.LocateFile(logName, FileQueryFlags::WRITE | FileQueryFlags::CREATE_DIRS)))
+							LOG_L(L_WARNING, "[%s] could not open sync section log \"%s\"", __FUNCTION__, logName.c_str());
+					}
+
+					syncSectionLog.Write(sections);
+				}
 
 				if (gameServer != NULL && gameServer->GetDemoReader() != NULL) {
 					// buffer all checksums, so we can check sync later between demo & local
@@ -561,6 +596,21 @@ void CGame::ClientReadNet()
 			} break;
 
 
+			case NETMSG_SYNCSECTIONS_REQUEST: {
+#ifdef SYNCCHECK
+				const int frameNum = *(int*)(inbuf + 1);
+				const SyncSectionChecksums* sections = CSyncChecker::GetSectionChecksums(frameNum);
+
+				if (sections == nullptr) {
+					LOG_L(L_WARNING, "[%s] no sync section checksums left for frame %d (current frame %d)", __FUNCTION__, frameNum, gs->frameNum);
+					break;
+				}
+
+				clientNet->Send(CBaseNetProtocol::Get().SendSyncSections(gu->myPlayerNum, frameNum, sections->checksums));
+#endif
+				AddTraffic(-1, packetCode, dataLength);
+			} break;
+
 			case NETMSG_COMMAND: {
 				try {
 					netcode::UnpackPacket pckt(packet, 1);
@@ -665,8 +715,11 @@ void CGame::ClientReadNet()
 						pckt >> c.aiCommandId;
 					}
 
+					const int numParams = (psize - 11) / 4;
+					c.params.reserve(std::max(0, numParams));
+
 					// insert the command parameters
-					for (int a = 0; a < ((psize - 11) / 4); ++a) {
+					for (int a = 0; a < numParams; ++a) {
 						float param;
 						pckt >> param;
 						c.PushParam(param);
@@ -710,6 +763,7 @@ void CGame::ClientReadNet()
 					vector<Command> commands;
 					short int commandCount;
 					pckt >> commandCount;
+					commands.reserve(std::max(short(0), commandCount));
 					for (int c = 0; c < commandCount; c++) {
 						int cmd_id;
 						unsigned char cmd_opt;
@@ -722,18 +776,20 @@ void CGame::ClientReadNet()
 						else
 							cmd_opt = sameCmdOpt;
 
-						Command cmd(cmd_id, cmd_opt);
+						// unpack straight into the vector, commands are never copied here
+						commands.emplace_back(cmd_id, cmd_opt);
+						Command& cmd = commands.back();
 						short int paramCount;
 						if (sameCmdParamSize == 0xFFFF)
 							pckt >> paramCount;
 						else
 							paramCount = sameCmdParamSize;
+						cmd.params.reserve(std::max(short(0), paramCount));
 						for (int p = 0; p < paramCount; p++) {
 							float param;
 							pckt >> param;
 							cmd.PushParam(param);
 						}
-						commands.push_back(cmd);
 					}
 					// apply the commands
 					if (pairwise) {
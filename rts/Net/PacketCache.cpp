@@ -0,0 +1,226 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "PacketCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <zlib.h>
+
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "System/Log/ILog.h"
+#include "System/Net/RawPacket.h"
+
+
+CPacketCache::CPacketCache()
+	: openNumPackets(0)
+	, openFirstFrameNum(-1)
+	, numPackets(0)
+	, numSpilledSegments(0)
+	, memoryUsage(0)
+	, maxMemoryUsage(0)
+	, allowSpill(false)
+	, spillFile(nullptr)
+{
+}
+
+CPacketCache::~CPacketCache()
+{
+	Clear();
+}
+
+
+void CPacketCache::SetMemoryLimit(size_t maxMemory, bool spill)
+{
+	maxMemoryUsage = maxMemory;
+	allowSpill = spill;
+
+	SpillSegments();
+}
+
+
+void CPacketCache::Add(const PacketPtr& packet)
+{
+	assert(packet->length > 0);
+
+	if (packet->data[0] == NETMSG_KEYFRAME && packet->length >= (1 + sizeof(std::int32_t))) {
+		// the head segment ends with the first keyframe, all others at the
+		// first keyframe after they reached their size
+		if (openFirstFrameNum < 0 || openData.size() >= SEGMENT_SIZE) {
+			CloseSegment();
+			std::memcpy(&openFirstFrameNum, packet->data + 1, sizeof(std::int32_t));
+		}
+	}
+
+	const std::uint32_t length = packet->length;
+	const size_t pos = openData.size();
+
+	openData.resize(pos + sizeof(length) + length);
+	std::memcpy(&openData[pos], &length, sizeof(length));
+	std::memcpy(&openData[pos + sizeof(length)], packet->data, length);
+
+	openNumPackets += 1;
+	numPackets += 1;
+}
+
+
+void CPacketCache::Clear()
+{
+	segments.clear();
+	openData.clear();
+	openData.shrink_to_fit();
+
+	openNumPackets = 0;
+	openFirstFrameNum = -1;
+
+	numPackets = 0;
+	numSpilledSegments = 0;
+	memoryUsage = 0;
+
+	if (spillFile != nullptr) {
+		fclose(spillFile);
+		spillFile = nullptr;
+	}
+}
+
+
+void CPacketCache::CloseSegment()
+{
+	std::shared_ptr<Segment> segment(new Segment());
+	segment->firstFrameNum = openFirstFrameNum;
+	segment->numPackets = openNumPackets;
+	segment->rawSize = openData.size();
+	segment->spillOffset = -1;
+	segment->spillSize = 0;
+
+	if (!openData.empty()) {
+		uLongf compressedSize = compressBound(openData.size());
+		segment->data.resize(compressedSize);
+
+		const int error = compress(&segment->data[0], &compressedSize, &openData[0], openData.size());
+		assert(error == Z_OK);
+
+		segment->data.resize(compressedSize);
+		segment->data.shrink_to_fit();
+	}
+
+	memoryUsage += segment->data.size();
+	segments.emplace_back(segment);
+
+	openData.clear();
+	openNumPackets = 0;
+
+	SpillSegments();
+}
+
+
+void CPacketCache::SpillSegments()
+{
+	if (maxMemoryUsage == 0)
+		return;
+
+	while (memoryUsage > maxMemoryUsage && numSpilledSegments < segments.size()) {
+		if (!allowSpill)
+			break;
+
+		if (spillFile == nullptr && (spillFile = tmpfile()) == nullptr) {
+			LOG_L(L_WARNING, "[PacketCache::%s] could not create a spill file, keeping %u bytes in memory", __FUNCTION__, unsigned(memoryUsage));
+			allowSpill = false;
+			break;
+		}
+
+		const Segment& segment = *segments[numSpilledSegments];
+		const long offset = (fseek(spillFile, 0, SEEK_END) == 0)? ftell(spillFile): -1;
+
+		if (offset < 0 || fwrite(segment.data.data(), 1, segment.data.size(), spillFile) != segment.data.size()) {
+			LOG_L(L_WARNING, "[PacketCache::%s] could not write to the spill file, keeping %u bytes in memory", __FUNCTION__, unsigned(memoryUsage));
+			allowSpill = false;
+			break;
+		}
+
+		// segments are immutable, anyone still holding the old one keeps its data
+		std::shared_ptr<Segment> spilled(new Segment());
+		spilled->firstFrameNum = segment.firstFrameNum;
+		spilled->numPackets = segment.numPackets;
+		spilled->rawSize = segment.rawSize;
+		spilled->spillOffset = offset;
+		spilled->spillSize = segment.data.size();
+
+		memoryUsage -= segment.data.size();
+		segments[numSpilledSegments++] = spilled;
+	}
+}
+
+
+void CPacketCache::ForEachPacket(const PacketFunc& func, int fromFrameNum) const
+{
+	size_t firstSegment = 0;
+
+	if (fromFrameNum >= 0) {
+		// the last segment starting at or before fromFrameNum; the head is always replayed
+		for (size_t n = 1; n < segments.size(); n++) {
+			if (segments[n]->firstFrameNum <= fromFrameNum)
+				firstSegment = n;
+		}
+
+		if (!segments.empty())
+			ReplaySegment(*segments[0], func);
+
+		if (openFirstFrameNum >= 0 && openFirstFrameNum <= fromFrameNum)
+			firstSegment = segments.size();
+
+		firstSegment = std::max(firstSegment, size_t(1));
+	}
+
+	for (size_t n = firstSegment; n < segments.size(); n++) {
+		ReplaySegment(*segments[n], func);
+	}
+
+	if (!openData.empty())
+		ReplayPackets(&openData[0], openData.size(), func);
+}
+
+
+void CPacketCache::ReplaySegment(const Segment& segment, const PacketFunc& func) const
+{
+	if (segment.rawSize == 0)
+		return;
+
+	std::vector<std::uint8_t> compressed;
+	const std::vector<std::uint8_t>* data = &segment.data;
+
+	if (segment.spillOffset >= 0) {
+		compressed.resize(segment.spillSize);
+
+		if (fseek(spillFile, segment.spillOffset, SEEK_SET) != 0 || fread(&compressed[0], 1, compressed.size(), spillFile) != compressed.size()) {
+			LOG_L(L_ERROR, "[PacketCache::%s] could not read %u packets back from the spill file", __FUNCTION__, segment.numPackets);
+			return;
+		}
+
+		data = &compressed;
+	}
+
+	std::vector<std::uint8_t> raw(segment.rawSize);
+	uLongf rawSize = raw.size();
+
+	if (uncompress(&raw[0], &rawSize, data->data(), data->size()) != Z_OK || rawSize != raw.size()) {
+		LOG_L(L_ERROR, "[PacketCache::%s] could not decompress %u packets", __FUNCTION__, segment.numPackets);
+		return;
+	}
+
+	ReplayPackets(&raw[0], raw.size(), func);
+}
+
+
+void CPacketCache::ReplayPackets(const std::uint8_t* data, unsigned size, const PacketFunc& func) const
+{
+	for (unsigned pos = 0; (pos + sizeof(std::uint32_t)) <= size; ) {
+		std::uint32_t length;
+		std::memcpy(&length, data + pos, sizeof(length));
+		pos += sizeof(length);
+
+		assert((pos + length) <= size);
+		func(PacketPtr(new netcode::RawPacket(data + pos, length)));
+		pos += length;
+	}
+}
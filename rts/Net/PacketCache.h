@@ -0,0 +1,102 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _PACKET_CACHE_H
+#define _PACKET_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "System/Misc/NonCopyable.h"
+
+namespace netcode {
+	class RawPacket;
+}
+
+/**
+ * Everything the server broadcast so far, replayed to reconnecting players
+ * and late-joining spectators.
+ *
+ * Packets are appended to an open segment, which is closed and compressed
+ * at the first keyframe after it grew beyond SEGMENT_SIZE bytes; so every
+ * segment but the head (which holds all pre-game packets) starts with a
+ * keyframe and the stream can be replayed from any segment onwards.
+ * Closed segments are immutable and ref-counted. Once their compressed size
+ * exceeds the memory limit, the oldest ones are moved to a temporary spill
+ * file and read back from there when replayed.
+ */
+class CPacketCache : public spring::noncopyable
+{
+public:
+	typedef std::shared_ptr<const netcode::RawPacket> PacketPtr;
+	typedef std::function<void(const PacketPtr&)> PacketFunc;
+
+	/// uncompressed bytes collected before a segment is closed
+	static const unsigned SEGMENT_SIZE = 256 * 1024;
+
+	CPacketCache();
+	~CPacketCache();
+
+	/// <maxMemory> is in bytes, zero means unlimited
+	void SetMemoryLimit(size_t maxMemory, bool allowSpill);
+
+	void Add(const PacketPtr& packet);
+	void Clear();
+
+	/**
+	 * @brief calls <func> for every cached packet, oldest first
+	 * @param fromFrameNum if >= 0, segments that only contain frames before
+	 *   the last keyframe at or before fromFrameNum are skipped (except the
+	 *   head segment), e.g. for a client that starts from a state snapshot
+	 */
+	void ForEachPacket(const PacketFunc& func, int fromFrameNum = -1) const;
+
+	size_t GetNumPackets() const { return numPackets; }
+	size_t GetNumSegments() const { return (segments.size() + 1); }
+	size_t GetNumSpilledSegments() const { return numSpilledSegments; }
+	/// bytes held in memory, excluding the open segment
+	size_t GetMemoryUsage() const { return memoryUsage; }
+	size_t GetOpenSegmentSize() const { return openData.capacity(); }
+
+private:
+	struct Segment {
+		/// of the keyframe the segment starts with, -1 for the head
+		int firstFrameNum;
+		unsigned numPackets;
+		unsigned rawSize;
+
+		/// zlib-compressed packets, empty once spilled
+		std::vector<std::uint8_t> data;
+
+		long spillOffset;
+		unsigned spillSize;
+	};
+
+	void CloseSegment();
+	void SpillSegments();
+
+	void ReplaySegment(const Segment& segment, const PacketFunc& func) const;
+	void ReplayPackets(const std::uint8_t* data, unsigned size, const PacketFunc& func) const;
+
+private:
+	std::vector< std::shared_ptr<const Segment> > segments;
+
+	/// uncompressed, every packet is prefixed by its length
+	std::vector<std::uint8_t> openData;
+	unsigned openNumPackets;
+	int openFirstFrameNum;
+
+	size_t numPackets;
+	size_t numSpilledSegments;
+	size_t memoryUsage;
+	size_t maxMemoryUsage;
+
+	bool allowSpill;
+
+	/// created on first spill, removed on close
+	FILE* spillFile;
+};
+
+#endif // _PACKET_CACHE_H
@@ -7,6 +7,7 @@
 #include "System/Net/RawPacket.h"
 #include "System/Net/PackPacket.h"
 #include "System/Net/ProtocolDef.h"
+#include "System/Sync/SyncSections.h"
 #include <cinttypes>
 
 using netcode::PackPacket;
@@ -85,11 +86,14 @@ PacketType CBaseNetProtocol::SendPathCheckSum(uchar myPlayerNum, std::uint32_t c
 }
 
 
-PacketType CBaseNetProtocol::SendCommand(uchar myPlayerNum, int id, uchar options, const std::vector<float>& params)
+PacketType CBaseNetProtocol::SendCommand(uchar myPlayerNum, int id, uchar options, const float* params, unsigned int numParams)
 {
-	unsigned size = 9 + params.size() * sizeof(float);
+	unsigned size = 9 + numParams * sizeof(float);
 	PackPacket* packet = new PackPacket(size, NETMSG_COMMAND);
-	*packet << static_cast<unsigned short>(size) << myPlayerNum << id << options << params;
+	*packet << static_cast<unsigned short>(size) << myPlayerNum << id << options;
+	for (unsigned int i = 0; i < numParams; ++i) {
+		*packet << params[i];
+	}
 	return PacketType(packet);
 }
 
@@ -111,10 +115,10 @@ PacketType CBaseNetProtocol::SendPause(uchar myPlayerNum, uchar bPaused)
 
 
 
-PacketType CBaseNetProtocol::SendAICommand(uchar myPlayerNum, unsigned char aiID, short unitID, int id, int aiCommandId, uchar options, const std::vector<float>& params)
+PacketType CBaseNetProtocol::SendAICommand(uchar myPlayerNum, unsigned char aiID, short unitID, int id, int aiCommandId, uchar options, const float* params, unsigned int numParams)
 {
 	int cmdTypeId = NETMSG_AICOMMAND;
-	unsigned size = 12 + (params.size() * sizeof(float));
+	unsigned size = 12 + (numParams * sizeof(float));
 	if (aiCommandId != -1) {
 		cmdTypeId = NETMSG_AICOMMAND_TRACKED;
 		size += 4;
@@ -124,7 +128,9 @@ PacketType CBaseNetProtocol::SendAICommand(uchar myPlayerNum, unsigned char aiID
 	if (cmdTypeId == NETMSG_AICOMMAND_TRACKED) {
 		*packet << aiCommandId;
 	}
-	*packet << params;
+	for (unsigned int i = 0; i < numParams; ++i) {
+		*packet << params[i];
+	}
 	return PacketType(packet);
 }
 
@@ -173,11 +179,11 @@ PacketType CBaseNetProtocol::SendDirectControlUpdate(uchar myPlayerNum, uchar st
 }
 
 
-PacketType CBaseNetProtocol::SendAttemptConnect(const std::string& name, const std::string& passwd, const std::string& version, int netloss, bool reconnect)
+PacketType CBaseNetProtocol::SendAttemptConnect(const std::string& name, const std::string& passwd, const std::string& version, int netloss, bool reconnect, uchar linkFlags)
 {
-	std::uint16_t size = 10 + name.size() + passwd.size() + version.size();
+	std::uint16_t size = 11 + name.size() + passwd.size() + version.size();
 	PackPacket* packet = new PackPacket(size , NETMSG_ATTEMPTCONNECT);
-	*packet << size << NETWORK_VERSION << name << passwd << version << uchar(reconnect) << uchar(netloss);
+	*packet << size << NETWORK_VERSION << name << passwd << version << uchar(reconnect) << uchar(netloss) << linkFlags;
 	return PacketType(packet);
 }
 
@@ -277,6 +283,25 @@ PacketType CBaseNetProtocol::SendSyncResponse(uchar myPlayerNum, int frameNum, u
 	return PacketType(packet);
 }
 
+PacketType CBaseNetProtocol::SendSyncSectionsRequest(int frameNum)
+{
+	PackPacket* packet = new PackPacket(5, NETMSG_SYNCSECTIONS_REQUEST);
+	*packet << frameNum;
+	return PacketType(packet);
+}
+
+PacketType CBaseNetProtocol::SendSyncSections(uchar myPlayerNum, int frameNum, const uint* checksums)
+{
+	PackPacket* packet = new PackPacket(6 + SYNC_SECTION_COUNT * sizeof(uint), NETMSG_SYNCSECTIONS);
+	*packet << myPlayerNum << frameNum;
+
+	for (unsigned int n = 0; n < SYNC_SECTION_COUNT; ++n) {
+		*packet << checksums[n];
+	}
+
+	return PacketType(packet);
+}
+
 PacketType CBaseNetProtocol::SendSystemMessage(uchar myPlayerNum, std::string message)
 {
 	if (message.size() > 65000)
@@ -500,6 +525,9 @@ CBaseNetProtocol::CBaseNetProtocol()
 	proto->AddType(NETMSG_AI_CREATED, -1);
 	proto->AddType(NETMSG_AI_STATE_CHANGED, 4);
 	proto->AddType(NETMSG_GAME_FRAME_PROGRESS,5);
+	proto->AddType(NETMSG_COMPRESSED, -2);
+	proto->AddType(NETMSG_SYNCSECTIONS_REQUEST, 5);
+	proto->AddType(NETMSG_SYNCSECTIONS, 6 + SYNC_SECTION_COUNT * sizeof(uint));
 
 #ifdef SYNCDEBUG
 	proto->AddType(NETMSG_SD_CHKREQUEST, 5);
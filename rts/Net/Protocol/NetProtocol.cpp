@@ -49,7 +49,7 @@ void CNetProtocol::InitClient(const char* server_addr, unsigned portnum, const s
 	netcode::UDPConnection* conn = new netcode::UDPConnection(configHandler->GetInt("SourcePort"), server_addr, portnum);
 	conn->Unmute();
 	serverConn.reset(conn);
-	serverConn->SendData(CBaseNetProtocol::Get().SendAttemptConnect(userName, userPasswd, myVersion, globalConfig->networkLossFactor));
+	serverConn->SendData(CBaseNetProtocol::Get().SendAttemptConnect(userName, userPasswd, myVersion, globalConfig->networkLossFactor, false, LINK_FLAG_COMPRESSION));
 	serverConn->Flush(true);
 
 	LOG("Connecting to %s:%i using name %s", server_addr, portnum, myName.c_str());
@@ -68,7 +68,7 @@ void CNetProtocol::AttemptReconnect(const std::string& myVersion)
 {
 	netcode::UDPConnection* conn = new netcode::UDPConnection(*serverConn);
 	conn->Unmute();
-	conn->SendData(CBaseNetProtocol::Get().SendAttemptConnect(userName, userPasswd, myVersion, globalConfig->networkLossFactor, true));
+	conn->SendData(CBaseNetProtocol::Get().SendAttemptConnect(userName, userPasswd, myVersion, globalConfig->networkLossFactor, true, LINK_FLAG_COMPRESSION));
 	conn->Flush(true);
 
 	LOG("Reconnecting to server... %ds", dynamic_cast<netcode::UDPConnection&>(*serverConn).GetReconnectSecs());
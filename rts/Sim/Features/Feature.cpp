@@ -516,44 +516,41 @@ void CFeature::UpdateQuadFieldPosition(const float3& moveVec)
 }
 
 
-bool CFeature::UpdateVelocity(
-	const float3& dragAccel,
-	const float3& gravAccel,
-	const float3& movMask,
-	const float3& velMask
-) {
+float3 CFeature::CalcVelocity() const
+{
 	// apply drag and gravity to speed; leave more advanced physics (water
 	// buoyancy, etc) to Lua
 	// NOTE:
-	//   all these calls use the base-class because FeatureHandler::Update
-	//   iterates over updateFeatures and our ::SetVelocity will insert us
-	//   into that
-	//
+	//   this only reads the feature's state so FeatureHandler::Update can
+	//   calculate the velocities of all queued features in parallel
+	const float3 dragAccel = GetDragAccelerationVec(float4(mapInfo->atmosphere.fluidDensity, mapInfo->water.fluidDensity, 1.0f, 0.1f));
+	const float3 gravAccel = UpVector * mapInfo->map.gravity;
+	const float3& velMask = moveCtrl.velocityMask;
+
 	// drag is only valid for current speed, needs to be applied first
-	CWorldObject::SetVelocity((speed + dragAccel) * velMask);
+	float3 newSpeed = (speed + dragAccel) * velMask;
 
 	if (!IsInWater()) {
 		// quadratic downward acceleration if not in water
-		CWorldObject::SetVelocity(((speed * OnesVector) + gravAccel) * velMask);
+		newSpeed = ((newSpeed * OnesVector) + gravAccel) * velMask;
 	} else {
 		// constant downward speed otherwise, unless floating
-		CWorldObject::SetVelocity(((speed *   XZVector) + gravAccel * (1 - def->floating)) * velMask);
+		newSpeed = ((newSpeed *   XZVector) + gravAccel * (1 - def->floating)) * velMask;
 	}
 
-	const float oldGroundHeight = CGround::GetHeightReal(pos        );
-	const float newGroundHeight = CGround::GetHeightReal(pos + speed);
+	const float oldGroundHeight = CGround::GetHeightReal(pos           );
+	const float newGroundHeight = CGround::GetHeightReal(pos + newSpeed);
 
 	// adjust vertical speed so we do not sink into the ground
-	if ((pos.y + speed.y) <= newGroundHeight) {
-		speed.y  = std::min(newGroundHeight - pos.y, math::fabs(newGroundHeight - oldGroundHeight));
-		speed.y *= moveCtrl.velocityMask.y;
+	if ((pos.y + newSpeed.y) <= newGroundHeight) {
+		newSpeed.y  = std::min(newGroundHeight - pos.y, math::fabs(newGroundHeight - oldGroundHeight));
+		newSpeed.y *= velMask.y;
 	}
 
-	// indicates whether to update quadfield position
-	return ((speed.x * movMask.x) != 0.0f || (speed.z * movMask.z) != 0.0f);
+	return newSpeed;
 }
 
-bool CFeature::UpdatePosition()
+bool CFeature::UpdatePosition(const float3* newSpeed)
 {
 	const float3 oldPos = pos;
 	// const float4 oldSpd = speed;
@@ -562,15 +559,18 @@ bool CFeature::UpdatePosition()
 		// raw movement; not masked or clamped
 		UpdateQuadFieldPosition(speed = (moveCtrl.velVector += moveCtrl.accVector));
 	} else {
-		const float3 dragAccel = GetDragAccelerationVec(float4(mapInfo->atmosphere.fluidDensity, mapInfo->water.fluidDensity, 1.0f, 0.1f));
-		const float3 gravAccel = UpVector * mapInfo->map.gravity;
+		const float3& movMask = moveCtrl.movementMask;
+
+		// use the base-class because our ::SetVelocity would
+		// insert us into the FH update-queue we are iterated by
+		CWorldObject::SetVelocity((newSpeed != nullptr)? *newSpeed: CalcVelocity());
 
 		// horizontal movement
-		if (UpdateVelocity(dragAccel, gravAccel, moveCtrl.movementMask, moveCtrl.velocityMask))
-			UpdateQuadFieldPosition((speed * XZVector) * moveCtrl.movementMask);
+		if ((speed.x * movMask.x) != 0.0f || (speed.z * movMask.z) != 0.0f)
+			UpdateQuadFieldPosition((speed * XZVector) * movMask);
 
 		// vertical movement
-		Move((speed * UpVector) * moveCtrl.movementMask, true);
+		Move((speed * UpVector) * movMask, true);
 		// adjusting vertical speed won't help if the ground moved and buried us
 		Move(UpVector * (std::max(CGround::GetHeightReal(pos.x, pos.z), pos.y) - pos.y), true);
 
@@ -596,9 +596,9 @@ bool CFeature::UpdatePosition()
 }
 
 
-bool CFeature::Update()
+bool CFeature::Update(const float3* newSpeed)
 {
-	bool continueUpdating = UpdatePosition();
+	bool continueUpdating = UpdatePosition(newSpeed);
 
 	continueUpdating |= (smokeTime != 0);
 	continueUpdating |= (fireTime != 0);
@@ -90,9 +90,11 @@ public:
 	void ForcedMove(const float3& newPos);
 	void ForcedSpin(const float3& newDir);
 
-	bool Update();
-	bool UpdatePosition();
-	bool UpdateVelocity(const float3& dragAccel, const float3& gravAccel, const float3& movMask, const float3& velMask);
+	/// <newSpeed> is the result of CalcVelocity if it is already known
+	bool Update(const float3* newSpeed = nullptr);
+	bool UpdatePosition(const float3* newSpeed);
+	/// speed after drag, gravity and ground contact; does not modify the feature
+	float3 CalcVelocity() const;
 
 	void SetTransform(const CMatrix44f& m, bool synced) { transMatrix[synced] = m; }
 	void UpdateTransform(const float3& p, bool synced) { transMatrix[synced] = std::move(ComposeMatrix(p)); }
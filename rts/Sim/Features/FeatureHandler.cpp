@@ -12,9 +12,14 @@
 #include "System/EventHandler.h"
 #include "System/TimeProfiler.h"
 #include "System/Util.h"
+#include "System/Threading/ThreadPool.h"
 
 CFeatureHandler* featureHandler = NULL;
 
+// features are only woken by terrain changes that move the ground under
+// them by more than this (elmos), resting ones otherwise stay asleep
+static const float TERRAIN_CHANGE_WAKE_HEIGHT = 0.5f;
+
 /******************************************************************************/
 
 CR_BIND(CFeatureHandler, )
@@ -23,7 +28,11 @@ CR_REG_METADATA(CFeatureHandler, (
 	CR_MEMBER(toBeFreedFeatureIDs),
 	CR_MEMBER(activeFeatureIDs),
 	CR_MEMBER(features),
-	CR_MEMBER(updateFeatures)
+	CR_MEMBER(updateFeatures),
+	CR_IGNORED(reclaimedFeatureIDs),
+	CR_IGNORED(featureVelocities),
+	CR_IGNORED(numTerrainChanges),
+	CR_IGNORED(featureVelocitiesTerrainChanges)
 ))
 
 /******************************************************************************/
@@ -188,21 +197,86 @@ void CFeatureHandler::Update()
 {
 	SCOPED_TIMER("Sim::Features");
 
-	if ((gs->frameNum & 31) == 0) {
+	if ((gs->frameNum & 31) == 0 && !toBeFreedFeatureIDs.empty()) {
+		// one pass over all reclaimers instead of one per ID
+		CBuilderCAI::GetReclaimedFeatureIDs(reclaimedFeatureIDs);
+
 		toBeFreedFeatureIDs.erase(std::remove_if(toBeFreedFeatureIDs.begin(), toBeFreedFeatureIDs.end(),
 			[this](int id) { return this->TryFreeFeatureID(id); }
 		), toBeFreedFeatureIDs.end());
 	}
 
-	updateFeatures.erase(std::remove_if(updateFeatures.begin(), updateFeatures.end(),
-		[this](CFeature* feature) { return this->UpdateFeature(feature); }
-	), updateFeatures.end());
+	CalcFeatureVelocities();
+
+	// features created or woken while updating are appended, they
+	// are kept for the next frame (as with remove_if) but without
+	// invalidating any iterators
+	const size_t numUpdateFeatures = updateFeatures.size();
+	size_t numKeptFeatures = 0;
+
+	for (size_t i = 0; i < numUpdateFeatures; i++) {
+		CFeature* feature = updateFeatures[i];
+
+		if (!UpdateFeature(feature, GetFeatureVelocity(feature, i)))
+			updateFeatures[numKeptFeatures++] = feature;
+	}
+
+	updateFeatures.erase(std::copy(updateFeatures.begin() + numUpdateFeatures, updateFeatures.end(), updateFeatures.begin() + numKeptFeatures), updateFeatures.end());
+}
+
+
+void CFeatureHandler::CalcFeatureVelocities()
+{
+	FeatureVelocities& fv = featureVelocities;
+
+	const size_t numFeatures = updateFeatures.size();
+
+	fv.positions.resize(numFeatures);
+	fv.speeds.resize(numFeatures);
+	fv.velocityMasks.resize(numFeatures);
+	fv.newSpeeds.resize(numFeatures);
+	fv.valid.resize(numFeatures);
+
+	featureVelocitiesTerrainChanges = numTerrainChanges;
+
+	for_mt(0, numFeatures, [&](const int i) {
+		const CFeature* feature = updateFeatures[i];
+
+		if ((fv.valid[i] = (!feature->deleteMe && !feature->moveCtrl.enabled)) == 0)
+			return;
+
+		fv.positions[i] = feature->pos;
+		fv.speeds[i] = feature->speed;
+		fv.velocityMasks[i] = feature->moveCtrl.velocityMask;
+		fv.newSpeeds[i] = feature->CalcVelocity();
+	});
+}
+
+const float3* CFeatureHandler::GetFeatureVelocity(const CFeature* feature, size_t idx) const
+{
+	const FeatureVelocities& fv = featureVelocities;
+
+	if (idx >= fv.valid.size() || fv.valid[idx] == 0)
+		return nullptr;
+	// the updates before may have changed the terrain or this feature (a
+	// deletion, the only update that calls into Lua, clears <valid>)
+	if (numTerrainChanges != featureVelocitiesTerrainChanges)
+		return nullptr;
+
+	const auto same = [](const float3& a, const float3& b) { return (a.x == b.x && a.y == b.y && a.z == b.z); };
+
+	if (!same(feature->pos, fv.positions[idx]) || !same(feature->speed, fv.speeds[idx]))
+		return nullptr;
+	if (!same(feature->moveCtrl.velocityMask, fv.velocityMasks[idx]))
+		return nullptr;
+
+	return &fv.newSpeeds[idx];
 }
 
 
 bool CFeatureHandler::TryFreeFeatureID(int id)
 {
-	if (CBuilderCAI::IsFeatureBeingReclaimed(id)) {
+	if (std::binary_search(reclaimedFeatureIDs.begin(), reclaimedFeatureIDs.end(), id)) {
 		// postpone putting this ID back into the free pool
 		// (this gives area-reclaimers time to choose a new
 		// target with a different ID)
@@ -216,7 +290,7 @@ bool CFeatureHandler::TryFreeFeatureID(int id)
 }
 
 
-bool CFeatureHandler::UpdateFeature(CFeature* feature)
+bool CFeatureHandler::UpdateFeature(CFeature* feature, const float3* newSpeed)
 {
 	assert(feature->inUpdateQue);
 
@@ -233,10 +307,14 @@ bool CFeatureHandler::UpdateFeature(CFeature* feature)
 		delete feature;
 		CSolidObject::SetDeletingRefID(-1);
 
+		// the callins (and death-dependencies) above may have changed any
+		// feature, e.g. through Spring.SetFeatureMass which CalcVelocity
+		// depends on via the drag; calculate the remaining ones serially
+		featureVelocities.valid.clear();
 		return true;
 	}
 
-	if (!feature->Update()) {
+	if (!feature->Update(newSpeed)) {
 		// feature is done updating itself, remove from queue
 		feature->inUpdateQue = false;
 
@@ -266,8 +344,19 @@ void CFeatureHandler::TerrainChanged(int x1, int y1, int x2, int y2)
 
 	const auto& quads = quadField->GetQuadsRectangle(mins, maxs);
 
+	numTerrainChanges++;
+
 	for (const int qi: quads) {
 		for (CFeature* f: quadField->GetQuad(qi).features) {
+			if (f->inUpdateQue)
+				continue;
+
+			// feature physics only look at the ground below the center
+			// (see CFeature::CalcVelocity), if that did not move toward
+			// or away from the feature nothing can happen to it
+			if (math::fabs(CGround::GetHeightReal(f->pos.x, f->pos.z) - f->pos.y) <= TERRAIN_CHANGE_WAKE_HEIGHT)
+				continue;
+
 			// put this feature back in the update-queue
 			SetFeatureUpdateable(f);
 		}
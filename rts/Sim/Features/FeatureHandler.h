@@ -41,7 +41,7 @@ class CFeatureHandler : public spring::noncopyable
 	CR_DECLARE_STRUCT(CFeatureHandler)
 
 public:
-	CFeatureHandler() { activeFeatureIDs.reserve(128); }
+	CFeatureHandler(): numTerrainChanges(0), featureVelocitiesTerrainChanges(0) { activeFeatureIDs.reserve(128); }
 	~CFeatureHandler();
 
 	CFeature* LoadFeature(const FeatureLoadParams& params);
@@ -49,7 +49,7 @@ public:
 
 	void Update();
 
-	bool UpdateFeature(CFeature* feature);
+	bool UpdateFeature(CFeature* feature, const float3* newSpeed = nullptr);
 	bool TryFreeFeatureID(int id);
 	bool AddFeature(CFeature* feature);
 	void DeleteFeature(CFeature* feature);
@@ -79,6 +79,9 @@ private:
 	void AllocateNewFeatureIDs(const CFeature* feature);
 	void InsertActiveFeature(CFeature* feature);
 
+	void CalcFeatureVelocities();
+	const float3* GetFeatureVelocity(const CFeature* feature, size_t idx) const;
+
 private:
 	SimObjectIDPool idPool;
 
@@ -87,6 +90,27 @@ private:
 	std::vector<CFeature*> features;
 
 	std::vector<CFeature*> updateFeatures;
+
+	/// sorted, refreshed before toBeFreedFeatureIDs are checked
+	std::vector<int> reclaimedFeatureIDs;
+
+	/**
+	 * CFeature::CalcVelocity results for updateFeatures, calculated in
+	 * parallel before they are updated in order, with the position and
+	 * speed they were calculated from; a result is only used if neither
+	 * changed (nor the terrain) while updating the features before it,
+	 * and none of those was deleted (which runs Lua callins)
+	 */
+	struct FeatureVelocities {
+		std::vector<float3> positions;
+		std::vector<float3> speeds;
+		std::vector<float3> velocityMasks;
+		std::vector<float3> newSpeeds;
+		std::vector<unsigned char> valid;
+	} featureVelocities;
+
+	unsigned int numTerrainChanges;
+	unsigned int featureVelocitiesTerrainChanges;
 };
 
 extern CFeatureHandler* featureHandler;
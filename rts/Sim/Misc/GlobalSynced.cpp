@@ -7,6 +7,7 @@
 
 #include "ExternalAI/SkirmishAIHandler.h"
 #include "Game/GameSetup.h"
+#include "Lua/LuaRulesParams.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "System/Util.h"
@@ -69,6 +70,7 @@ void CGlobalSynced::ResetState() {
 #ifdef SYNCCHECK
 	// reset checksum
 	CSyncChecker::NewFrame();
+	CSyncChecker::ClearSectionChecksums();
 #endif
 
 	speedFactor       = 1.0f;
@@ -92,6 +94,9 @@ void CGlobalSynced::ResetState() {
 		// less cavemanly than delete + new
 		teamHandler->ResetState();
 		skirmishAIHandler.ResetState();
+
+		// no team, unit or feature of the previous game is left to hold keys
+		LuaRulesParams::ResetKeys();
 	}
 }
 
@@ -26,6 +26,11 @@ public:
 
 	void DependentDied(CObject* o);
 
+private:
+	static bool MayIntercept(const CWeapon* w, const CWeaponProjectile* p, float weaponDist);
+
+	void CheckInterceptTarget(CWeapon* w, CWeaponProjectile* p);
+
 private:
 	std::deque<CWeapon*> interceptors;
 	std::deque<CWeaponProjectile*> interceptables;
@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <vector>
 #include <cassert>
 #include <limits>
@@ -17,6 +18,10 @@
 
 SmoothHeightMesh* smoothGround = NULL;
 
+// the maxima are smoothed by NUM_BLURS horizontal and vertical box blurs
+static const int BLUR_RADIUS = 3;
+static const int NUM_BLURS = 3;
+
 
 static float Interpolate(float x, float y, const int maxx, const int maxy, const float res, const float* heightmap)
 {
@@ -48,6 +53,7 @@ SmoothHeightMesh::SmoothHeightMesh(float mx, float my, float res, float smoothRa
 	, fmaxy(my)
 	, resolution(res)
 	, smoothRadius(std::max(1.0f, smoothRad))
+	, windowRadius(smoothRadius / res)
 {
 	MakeSmoothMesh();
 }
@@ -56,6 +62,8 @@ SmoothHeightMesh::~SmoothHeightMesh() {
 
 	mesh.clear();
 	origMesh.clear();
+	heights.clear();
+	maxima.clear();
 }
 
 
@@ -91,350 +99,259 @@ float SmoothHeightMesh::SetMaxHeight(int index, float h)
 
 
 
-inline static void FindMaximumColumnHeights(
-	const int maxx,
-	const int maxy,
-	const int intrad,
-	const float resolution,
-	std::vector<float>& colsMaxima,
-	std::vector<int>& maximaRows)
+void SmoothHeightMesh::TerrainChanged(int x1, int z1, int x2, int z2)
 {
-	// initialize the algorithm: find the maximum
-	// height per column and the corresponding row
-	for (int y = 0; y <= std::min(maxy, intrad); ++y) {
-		for (int x = 0; x <= maxx; ++x)  {
-			const float curx = x * resolution;
-			const float cury = y * resolution;
-			const float curh = CGround::GetHeightAboveWater(curx, cury);
-
-			if (curh > colsMaxima[x]) {
-				colsMaxima[x] = curh;
-				maximaRows[x] = y;
-			}
-		}
-	}
+	// a vertex changes the ground of the squares around it
+	const int cx1 = std::max(int(((x1 - 1) * SQUARE_SIZE) / resolution), 0);
+	const int cz1 = std::max(int(((z1 - 1) * SQUARE_SIZE) / resolution), 0);
+	const int cx2 = std::min(int(((x2 + 1) * SQUARE_SIZE) / resolution) + 1, maxx - 1);
+	const int cz2 = std::min(int(((z2 + 1) * SQUARE_SIZE) / resolution) + 1, maxy - 1);
+
+	if (cx1 > cx2 || cz1 > cz2)
+		return;
+
+	// pushed as half-open so single rows and columns survive Optimize
+	meshChanges.push_back(SRectangle(cx1, cz1, cx2 + 1, cz2 + 1));
 }
 
-inline static void AdvanceMaximaRows(
-	const int y,
-	const int maxx,
-	const float resolution,
-	const std::vector<float>& colsMaxima,
-	      std::vector<int>& maximaRows)
+void SmoothHeightMesh::Update()
 {
-	const float cury = y * resolution;
+	if (meshChanges.empty())
+		return;
 
-	// try to advance rows if they're equal to current maximum but are further away
-	for (int x = 0; x <= maxx; ++x) {
-		if (maximaRows[x] == (y - 1)) {
-			const float curx = x * resolution;
-			const float curh = CGround::GetHeightAboveWater(curx, cury);
+	SCOPED_TIMER("Sim::SmoothHeightMesh");
 
-			if (curh == colsMaxima[x]) {
-				maximaRows[x] = y;
-			}
+	meshChanges.Optimize();
 
-			assert(curh <= colsMaxima[x]);
-		}
+	for (const SRectangle& rect: meshChanges) {
+		UpdateSmoothMesh(SRectangle(rect.x1, rect.z1, std::min(rect.x2, maxx - 1), std::min(rect.z2, maxy - 1)));
 	}
+
+	meshChanges.clear();
 }
 
 
 
-inline static void FindRadialMaximum(
-	int y,
-	int maxx,
-	int intrad,
-	float resolution,
-	const std::vector<float>& colsMaxima,
-	      std::vector<float>& mesh)
+static SRectangle DilateRect(const SRectangle& rect, int radius, int maxx, int maxy)
 {
-	const float cury = y * resolution;
-
-	for (int x = 0; x <= maxx; ++x) {
-		float maxRowHeight = -std::numeric_limits<float>::max();
-
-		// find current maximum within radius smoothRadius
-		// (in every column stack) along the current row
-		const int startx = std::max(x - intrad, 0);
-		const int endx = std::min(maxx, x + intrad);
-
-		for (int i = startx; i <= endx; ++i) {
-			assert(i >= 0);
-			assert(i <= maxx);
-			assert(CGround::GetHeightReal(i * resolution, cury) <= colsMaxima[i]);
-
-			maxRowHeight = std::max(colsMaxima[i], maxRowHeight);
-		}
-
-#ifndef NDEBUG
-		const float curx = x * resolution;
-		assert(maxRowHeight <= std::max(readMap->GetCurrMaxHeight(), 0.0f));
-		assert(maxRowHeight >= CGround::GetHeightAboveWater(curx, cury));
+	return (SRectangle(std::max(rect.x1 - radius, 0), std::max(rect.z1 - radius, 0), std::min(rect.x2 + radius, maxx - 1), std::min(rect.z2 + radius, maxy - 1)));
+}
 
-	#ifdef SMOOTHMESH_CORRECTNESS_CHECK
-		// naive algorithm
-		float maxRowHeightAlt = -std::numeric_limits<float>::max();
+/**
+ * out[i] = max(in[i], ..., in[i + 2 * r]) for i in [0, n)
+ *
+ * van Herk / Gil-Werman: with prefix and suffix maxima over blocks of
+ * (2 * r + 1) elements every window spans at most two blocks, so this
+ * takes three comparisons per element regardless of the radius
+ */
+static void SlidingWindowMax(
+	const float* in,
+	const int n,
+	const int r,
+	float* out,
+	std::vector<float>& prefix,
+	std::vector<float>& suffix)
+{
+	const int size = n + 2 * r;
+	const int blockSize = 2 * r + 1;
 
-		for (float y1 = cury - smoothRadius; y1 <= cury + smoothRadius; y1 += resolution) {
-			for (float x1 = curx - smoothRadius; x1 <= curx + smoothRadius; x1 += resolution) {
-				maxRowHeightAlt = std::max(maxRowHeightAlt, CGround::GetHeightAboveWater(x1, y1));
-			}
-		}
+	prefix.resize(size);
+	suffix.resize(size);
 
-		assert(maxRowHeightAlt == maxRowHeight);
-	#endif
-#endif
+	for (int i = 0; i < size; ++i) {
+		prefix[i] = ((i % blockSize) == 0)? in[i]: std::max(prefix[i - 1], in[i]);
+	}
+	for (int i = size - 1; i >= 0; --i) {
+		suffix[i] = ((i % blockSize) == (blockSize - 1) || i == (size - 1))? in[i]: std::max(suffix[i + 1], in[i]);
+	}
 
-		mesh[x + y * maxx] = maxRowHeight;
+	for (int i = 0; i < n; ++i) {
+		out[i] = std::max(suffix[i], prefix[i + 2 * r]);
 	}
 }
 
-
-
-inline static void FixRemainingMaxima(
-	const int y,
+/**
+ * One box blur pass over the cells of <wr>, clipped to the mesh.
+ * Cells outside of <wr> are approximated by its edge, which only
+ * affects the results within BLUR_RADIUS of an edge that is not a
+ * mesh border.
+ */
+static void BlurWindow(
+	const SRectangle& wr,
 	const int maxx,
 	const int maxy,
-	const int intrad,
-	const float resolution,
-	std::vector<float>& colsMaxima,
-	std::vector<int>& maximaRows)
+	const bool vertical,
+	const std::vector<float>& heights,
+	const std::vector<float>& src,
+	std::vector<float>& dst)
 {
-	// fix remaining maximums after a pass
-	const int nextrow = y + intrad + 1;
-	const float nextrowy = nextrow * resolution;
-
-	for (int x = 0; x <= maxx; ++x) {
-#ifdef _DEBUG
-		for (int y1 = std::max(0, y - intrad); y1 <= std::min(maxy, y + intrad); ++y1) {
-			assert(CGround::GetHeightReal(x * resolution, y1 * resolution) <= colsMaxima[x]);
-		}
-#endif
-		const float curx = x * resolution;
-
-		if (maximaRows[x] <= (y - intrad)) {
-			// find a new maximum if the old one left the window
-			colsMaxima[x] = -std::numeric_limits<float>::max();
-
-			for (int y1 = std::max(0, y - intrad + 1); y1 <= std::min(maxy, nextrow); ++y1) {
-				const float h = CGround::GetHeightAboveWater(curx, y1 * resolution);
-
-				if (h > colsMaxima[x]) {
-					colsMaxima[x] = h;
-					maximaRows[x] = y1;
-				} else if (colsMaxima[x] == h) {
-					// if equal, move as far down as possible
-					maximaRows[x] = y1;
+	const int w = wr.x2 - wr.x1 + 1;
+	const float maxHeight = readMap->GetCurrMaxHeight();
+
+	for_mt(wr.z1, wr.z2 + 1, [&](const int y) {
+		for (int x = wr.x1; x <= wr.x2; ++x) {
+			const int c = vertical? y: x;
+			const int c1 = std::max(c - BLUR_RADIUS, 0);
+			const int c2 = std::min(c + BLUR_RADIUS, (vertical? maxy: maxx) - 1);
+
+			float sum = 0.0f;
+
+			for (int i = c1; i <= c2; ++i) {
+				if (vertical) {
+					sum += src[(Clamp(i, wr.z1, wr.z2) - wr.z1) * w + (x - wr.x1)];
+				} else {
+					sum += src[(y - wr.z1) * w + (Clamp(i, wr.x1, wr.x2) - wr.x1)];
 				}
 			}
-		} else if (nextrow <= maxy) {
-			// else, just check if a new maximum has entered the window
-			const float h = CGround::GetHeightAboveWater(curx, nextrowy);
 
-			if (h > colsMaxima[x]) {
-				colsMaxima[x] = h;
-				maximaRows[x] = nextrow;
-			}
-		}
-
-		assert(maximaRows[x] <= nextrow);
-		assert(maximaRows[x] >= y - intrad + 1);
+			// never below the ground
+			const float gh = heights[x + y * maxx];
+			const float sh = sum / (c2 - c1 + 1);
 
-#ifdef _DEBUG
-		for (int y1 = std::max(0, y - intrad + 1); y1 <= std::min(maxy, y + intrad + 1); ++y1) {
-			assert(colsMaxima[x] >= CGround::GetHeightReal(curx, y1 * resolution));
+			dst[(y - wr.z1) * w + (x - wr.x1)] = std::min(maxHeight, std::max(gh, sh));
 		}
-#endif
-	}
+	});
 }
 
 
 
-inline static void BlurHorizontal(
-	const int maxx,
-	const int maxy,
-	const int smoothrad,
-	const float resolution,
-	const std::vector<float>& mesh,
-	std::vector<float>& smoothed)
+void SmoothHeightMesh::UpdateMaxima(const SRectangle& rect)
 {
-	const float n = 2.0f * smoothrad + 1.0f;
-	const float recipn = 1.0f / n;
-	const int lineSize = maxx + 1;
+	const int r = windowRadius;
 
-	for_mt(0, maxy+1, [&](const int y) {
-		float avg = 0.0f;
+	// maxima that can change, and the rows their windows cover
+	const SRectangle mr = DilateRect(rect, r, maxx, maxy);
+	const int rz1 = std::max(mr.z1 - r, 0);
+	const int rz2 = std::min(mr.z2 + r, maxy - 1);
 
-		for (int x = 0; x <= 2 * smoothrad; ++x) {
-			avg += mesh[x + y * lineSize];
-		}
+	const int w = mr.x2 - mr.x1 + 1;
+	const int h = mr.z2 - mr.z1 + 1;
 
-		for (int x = 0; x <= maxx; ++x) {
-			const int idx = x + y * lineSize;
+	std::vector<float> rowMaxima(w * (rz2 - rz1 + 1));
 
-			if (x <= smoothrad || x > (maxx - smoothrad)) {
-				// map-border case
-				smoothed[idx] = 0.0f;
+	// separable: first the maximum along every row, then along the columns of those
+	for_mt(rz1, rz2 + 1, [&](const int y) {
+		std::vector<float> window(w + 2 * r);
+		std::vector<float> prefix;
+		std::vector<float> suffix;
 
-				const int xstart = std::max(x - smoothrad, 0);
-				const int xend   = std::min(x + smoothrad, maxx);
-
-				for (int x1 = xstart; x1 <= xend; ++x1) {
-					smoothed[idx] += mesh[x1 + y * lineSize];
-				}
+		for (int i = 0; i < (w + 2 * r); ++i) {
+			const int x = mr.x1 - r + i;
+			window[i] = (x >= 0 && x < maxx)? heights[x + y * maxx]: -std::numeric_limits<float>::max();
+		}
 
-				const float gh = CGround::GetHeightAboveWater(x * resolution, y * resolution);
-				const float sh = smoothed[idx] / (xend - xstart + 1);
+		SlidingWindowMax(&window[0], w, r, &rowMaxima[(y - rz1) * w], prefix, suffix);
+	});
 
-				smoothed[idx] = std::min(readMap->GetCurrMaxHeight(), std::max(gh, sh));
-			} else {
-				// non-border case
-				avg += mesh[idx + smoothrad] - mesh[idx - smoothrad - 1];
+	for_mt(mr.x1, mr.x2 + 1, [&](const int x) {
+		std::vector<float> window(h + 2 * r);
+		std::vector<float> column(h);
+		std::vector<float> prefix;
+		std::vector<float> suffix;
 
-				const float gh = CGround::GetHeightAboveWater(x * resolution, y * resolution);
-				const float sh = recipn * avg;
+		for (int i = 0; i < (h + 2 * r); ++i) {
+			const int y = mr.z1 - r + i;
+			window[i] = (y >= rz1 && y <= rz2)? rowMaxima[(y - rz1) * w + (x - mr.x1)]: -std::numeric_limits<float>::max();
+		}
 
-				smoothed[idx] = std::min(readMap->GetCurrMaxHeight(), std::max(gh, sh));
-			}
+		SlidingWindowMax(&window[0], h, r, &column[0], prefix, suffix);
 
-			assert(smoothed[idx] <= std::max(readMap->GetCurrMaxHeight(), 0.0f));
-			assert(smoothed[idx] >=          readMap->GetCurrMinHeight()       );
+		for (int i = 0; i < h; ++i) {
+			maxima[x + (mr.z1 + i) * maxx] = column[i];
 		}
 	});
-}
 
-inline static void BlurVertical(
-	const int maxx,
-	const int maxy,
-	const int smoothrad,
-	const float resolution,
-	const std::vector<float>& mesh,
-	std::vector<float>& smoothed)
-{
-	const float n = 2.0f * smoothrad + 1.0f;
-	const float recipn = 1.0f / n;
-	const int lineSize = maxx + 1;
+#ifdef SMOOTHMESH_CORRECTNESS_CHECK
+	// naive algorithm
+	for (int y = mr.z1; y <= mr.z2; ++y) {
+		for (int x = mr.x1; x <= mr.x2; ++x) {
+			float maxHeight = -std::numeric_limits<float>::max();
 
-	for_mt(0, maxx+1, [&](const int x) {
-		float avg = 0.0f;
+			for (int y1 = std::max(y - r, 0); y1 <= std::min(y + r, maxy - 1); ++y1) {
+				for (int x1 = std::max(x - r, 0); x1 <= std::min(x + r, maxx - 1); ++x1) {
+					maxHeight = std::max(maxHeight, heights[x1 + y1 * maxx]);
+				}
+			}
 
-		for (int y = 0; y <= 2 * smoothrad; ++y) {
-			avg += mesh[x + y * lineSize];
+			assert(maxHeight == maxima[x + y * maxx]);
 		}
+	}
+#endif
+}
 
-		for (int y = 0; y <= maxy; ++y) {
-			const int idx = x + y * lineSize;
+void SmoothHeightMesh::UpdateBlurred(const SRectangle& rect)
+{
+	// every pass spreads the errors at the window edges by BLUR_RADIUS
+	const SRectangle wr = DilateRect(rect, BLUR_RADIUS * NUM_BLURS, maxx, maxy);
+	const int w = wr.x2 - wr.x1 + 1;
+	const int h = wr.z2 - wr.z1 + 1;
 
-			if (y <= smoothrad || y > (maxy - smoothrad)) {
-				// map-border case
-				smoothed[idx] = 0.0f;
+	std::vector<float> blurred(w * h);
+	std::vector<float> temp(w * h);
 
-				const int ystart = std::max(y - smoothrad, 0);
-				const int yend   = std::min(y + smoothrad, maxy);
+	for (int y = wr.z1; y <= wr.z2; ++y) {
+		std::copy(maxima.begin() + (wr.x1 + y * maxx), maxima.begin() + (wr.x2 + 1 + y * maxx), blurred.begin() + (y - wr.z1) * w);
+	}
 
-				for (int y1 = ystart; y1 <= yend; ++y1) {
-					smoothed[idx] += mesh[x + y1 * lineSize];
-				}
+	// actually smooth with approximate Gaussian blur passes
+	for (int numBlurs = NUM_BLURS; numBlurs > 0; --numBlurs) {
+		BlurWindow(wr, maxx, maxy, false, heights, blurred, temp); blurred.swap(temp);
+		BlurWindow(wr, maxx, maxy,  true, heights, blurred, temp); blurred.swap(temp);
+	}
 
-				const float gh = CGround::GetHeightAboveWater(x * resolution, y * resolution);
-				const float sh = smoothed[idx] / (yend - ystart + 1);
+	for_mt(rect.z1, rect.z2 + 1, [&](const int y) {
+		for (int x = rect.x1; x <= rect.x2; ++x) {
+			const int idx = x + y * maxx;
+			const float smoothed = blurred[(y - wr.z1) * w + (x - wr.x1)];
 
-				smoothed[idx] = std::min(readMap->GetCurrMaxHeight(), std::max(gh, sh));
+			// cells changed by Lua keep their offset to the original mesh
+			if (mesh[idx] == origMesh[idx]) {
+				mesh[idx] = smoothed;
 			} else {
-				// non-border case
-				avg += mesh[x + (y + smoothrad) * lineSize] - mesh[x + (y - smoothrad - 1) * lineSize];
-
-				const float gh = CGround::GetHeightAboveWater(x * resolution, y * resolution);
-				const float sh = recipn * avg;
-
-				smoothed[idx] = std::min(readMap->GetCurrMaxHeight(), std::max(gh, sh));
+				mesh[idx] += (smoothed - origMesh[idx]);
 			}
 
-			assert(smoothed[idx] <= std::max(readMap->GetCurrMaxHeight(), 0.0f));
-			assert(smoothed[idx] >=          readMap->GetCurrMinHeight()       );
+			origMesh[idx] = smoothed;
+
+			assert(smoothed <= std::max(readMap->GetCurrMaxHeight(), 0.0f));
+			assert(smoothed >=          readMap->GetCurrMinHeight()       );
 		}
 	});
 }
 
-
-
-inline static void CheckInvariants(
-	int y,
-	int maxx,
-	int maxy,
-	int intrad,
-	float resolution,
-	const std::vector<float>& colsMaxima,
-	const std::vector<int>& maximaRows)
+void SmoothHeightMesh::UpdateSmoothMesh(const SRectangle& rect)
 {
-	// check invariants
-	if (y < maxy) {
-		for (int x = 0; x <= maxx; ++x) {
-			assert(maximaRows[x] > y - intrad);
-			assert(maximaRows[x] <= maxy);
-			assert(colsMaxima[x] <= std::max(readMap->GetCurrMaxHeight(), 0.0f));
-			assert(colsMaxima[x] >=          readMap->GetCurrMinHeight()       );
-		}
-	}
-	for (int y1 = std::max(0, y - intrad + 1); y1 <= std::min(maxy, y + intrad + 1); ++y1) {
-		for (int x1 = 0; x1 <= maxx; ++x1) {
-			assert(CGround::GetHeightReal(x1 * resolution, y1 * resolution) <= colsMaxima[x1]);
+	for_mt(rect.z1, rect.z2 + 1, [&](const int y) {
+		for (int x = rect.x1; x <= rect.x2; ++x) {
+			heights[x + y * maxx] = CGround::GetHeightAboveWater(x * resolution, y * resolution);
 		}
-	}
-}
-
+	});
 
+	// the same cells of a full rebuild would come out identical
+	UpdateMaxima(rect);
+	UpdateBlurred(DilateRect(rect, windowRadius + BLUR_RADIUS * NUM_BLURS, maxx, maxy));
+}
 
 void SmoothHeightMesh::MakeSmoothMesh()
 {
 	ScopedOnceTimer timer("SmoothHeightMesh::MakeSmoothMesh");
 
 	// info:
-	//   height-value array has size <maxx + 1> * <maxy + 1>
-	//   and represents a grid of <maxx> cols by <maxy> rows
-	//   maximum legal index is ((maxx + 1) * (maxy + 1)) - 1
+	//   cells are stored row by row with a stride of <maxx>, GetHeight
+	//   interpolates between the <maxx> cols by <maxy> rows of them
+	//   (cell (x, y) samples the ground at (x, y) * resolution)
 	//
-	//   row-width (number of height-value corners per row) is (maxx + 1)
-	//   col-height (number of height-value corners per col) is (maxy + 1)
+	//   mesh and origMesh have room for <maxx + 1> * <maxy + 1> values
+	//   so the indices Lua can pass (up to maxx + maxy * maxx) stay in
+	//   bounds, only the first <maxx> * <maxy> are used
 	//
-	//   1st row has indices [maxx*(  0) + (  0), maxx*(1) + (  0)] inclusive
-	//   2nd row has indices [maxx*(  1) + (  1), maxx*(2) + (  1)] inclusive
-	//   3rd row has indices [maxx*(  2) + (  2), maxx*(3) + (  2)] inclusive
-	//   ...
-	//   Nth row has indices [maxx*(N-1) + (N-1), maxx*(N) + (N-1)] inclusive
-	//
-	const size_t size = (this->maxx + 1) * (this->maxy + 1);
-	// use sliding window of maximums to reduce computational complexity
-	const int intrad = smoothRadius / resolution;
-	const int smoothrad = 3;
-
 	assert(mesh.empty());
-	mesh.resize(size);
-
-	std::vector<float> colsMaxima(maxx + 1, -std::numeric_limits<float>::max());
-	std::vector<int> maximaRows(maxx + 1, -1);
-	std::vector<float> smoothed(size);
-
-	FindMaximumColumnHeights(maxx, maxy, intrad, resolution, colsMaxima, maximaRows);
-
-	for (int y = 0; y <= maxy; ++y) {
-		AdvanceMaximaRows(y, maxx, resolution, colsMaxima, maximaRows);
-		FindRadialMaximum(y, maxx, intrad, resolution, colsMaxima, mesh);
-		FixRemainingMaxima(y, maxx, maxy, intrad, resolution, colsMaxima, maximaRows);
-
-#ifdef _DEBUG
-		CheckInvariants(y, maxx, maxy, intrad, resolution, colsMaxima, maximaRows);
-#endif
-	}
 
-	// actually smooth with approximate Gaussian blur passes
-	for (int numBlurs = 3; numBlurs > 0; --numBlurs) {
-		BlurHorizontal(maxx, maxy, smoothrad, resolution, mesh, smoothed); mesh.swap(smoothed);
-		BlurVertical(maxx, maxy, smoothrad, resolution, mesh, smoothed); mesh.swap(smoothed);
-	}
+	mesh.resize((maxx + 1) * (maxy + 1), 0.0f);
+	origMesh.resize((maxx + 1) * (maxy + 1), 0.0f);
+	heights.resize(maxx * maxy);
+	maxima.resize(maxx * maxy);
 
-	// `mesh` now contains the smoothed heightmap, save it in origMesh
-	origMesh.resize(size);
-	std::copy(mesh.begin(), mesh.end(), origMesh.begin());
+	// use sliding window of maximums to reduce computational complexity
+	UpdateSmoothMesh(SRectangle(0, 0, maxx - 1, maxy - 1));
 }
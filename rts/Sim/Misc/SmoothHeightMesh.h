@@ -5,10 +5,16 @@
 
 #include <vector>
 
+#include "System/Misc/RectangleOptimizer.h"
+
 class CGround;
 
 /**
  * Provides a GetHeight(x, y) of its own that smooths the mesh.
+ *
+ * The mesh follows terrain deformation: changed heightmap areas are
+ * collected by TerrainChanged and only the cells they can influence
+ * are recalculated, once per frame in Update.
  */
 class SmoothHeightMesh
 {
@@ -22,6 +28,10 @@ public:
 	float AddHeight(int index, float h);
 	float SetMaxHeight(int index, float h);
 
+	/// heightmap vertices within <x1, z1> - <x2, z2> (inclusive) have changed
+	void TerrainChanged(int x1, int z1, int x2, int z2);
+	void Update();
+
 	int GetMaxX() const { return maxx; }
 	int GetMaxY() const { return maxy; }
 	float GetFMaxX() const { return fmaxx; }
@@ -33,14 +43,29 @@ public:
 
 private:
 	void MakeSmoothMesh();
+	/// <rect> is in mesh cells, inclusive
+	void UpdateSmoothMesh(const SRectangle& rect);
+
+	void UpdateMaxima(const SRectangle& rect);
+	void UpdateBlurred(const SRectangle& rect);
 
 	const int maxx, maxy;
 	const float fmaxx, fmaxy;
 	const float resolution;
 	const float smoothRadius;
 
+	/// radius (in cells) of the window whose maximum height every cell starts out with
+	const int windowRadius;
+
 	std::vector<float> mesh;
 	std::vector<float> origMesh;
+
+	/// ground height above water and the maximum of that within windowRadius, per cell
+	std::vector<float> heights;
+	std::vector<float> maxima;
+
+	/// in mesh cells, waiting for Update
+	CRectangleOptimizer meshChanges;
 };
 
 extern SmoothHeightMesh* smoothGround;
@@ -69,8 +69,6 @@ CTeam::CTeam():
 	origColor(0, 0, 0, 0),
 	highlight(0.0f)
 {
-	statHistory.reserve(1024);
-	statHistory.push_back(TeamStatistics());
 }
 
 void CTeam::SetDefaultStartPos()
@@ -377,7 +375,7 @@ void CTeam::SlowUpdate()
 
 	if (nextHistoryEntry <= gs->frameNum) {
 		currentStats.frame = gs->frameNum;
-		statHistory.push_back(currentStats);
+		statHistory.PushCurrent();
 
 		nextHistoryEntry = gs->frameNum + (TeamStatistics::statsPeriod * GAME_SPEED);
 		GetCurrentStats().frame = nextHistoryEntry;
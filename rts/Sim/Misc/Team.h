@@ -8,7 +8,7 @@
 #include <list>
 
 #include "TeamBase.h"
-#include "TeamStatistics.h"
+#include "TeamStatsHistory.h"
 #include "Sim/Misc/Resource.h"
 #include "System/Color.h"
 #include "ExternalAI/SkirmishAIKey.h"
@@ -47,8 +47,8 @@ public:
 	unsigned int GetMaxUnits() const { return maxUnits; }
 	bool AtUnitLimit() const { return (units.size() >= maxUnits); }
 
-	TeamStatistics& GetCurrentStats() { return statHistory.back(); }
-	const TeamStatistics& GetCurrentStats() const { return statHistory.back(); }
+	TeamStatistics& GetCurrentStats() { return statHistory.GetCurrent(); }
+	const TeamStatistics& GetCurrentStats() const { return statHistory.GetCurrent(); }
 
 	CTeam& operator = (const TeamBase& base) {
 		TeamBase::operator = (base);
@@ -95,7 +95,7 @@ public:
 	SResourcePack resPrevExcess;
 
 	int nextHistoryEntry;
-	std::vector<TeamStatistics> statHistory;
+	TeamStatsHistory statHistory;
 
 	/// mod controlled parameters
 	LuaRulesParams::Params  modParams;
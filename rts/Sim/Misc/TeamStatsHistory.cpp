@@ -0,0 +1,119 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "TeamStatsHistory.h"
+
+CR_BIND(TeamStatsHistory, )
+CR_REG_METADATA(TeamStatsHistory, (
+	CR_MEMBER(data),
+	CR_MEMBER(keyframes),
+	CR_MEMBER(last),
+	CR_MEMBER(current),
+	CR_MEMBER(numRecords)
+))
+
+
+// every field of TeamStatistics is a 32-bit int or float
+static const unsigned int NUM_FIELDS = sizeof(TeamStatistics) / sizeof(std::uint32_t);
+
+static_assert((NUM_FIELDS * sizeof(std::uint32_t)) == sizeof(TeamStatistics), "TeamStatistics fields are not all 32 bits");
+
+
+static void EncodeRecord(const TeamStatistics& record, const TeamStatistics* base, std::vector<unsigned char>& data)
+{
+	std::uint32_t fields[NUM_FIELDS];
+	std::uint32_t baseFields[NUM_FIELDS] = {0};
+
+	std::memcpy(fields, &record, sizeof(fields));
+
+	if (base != nullptr)
+		std::memcpy(baseFields, base, sizeof(baseFields));
+
+	for (unsigned int n = 0; n < NUM_FIELDS; n++) {
+		std::uint32_t delta = fields[n] ^ baseFields[n];
+
+		// seven bits per byte, the high bit marks that more follow
+		while (delta >= 0x80) {
+			data.push_back((delta & 0x7F) | 0x80);
+			delta >>= 7;
+		}
+
+		data.push_back(delta);
+	}
+}
+
+static const unsigned char* DecodeRecord(const unsigned char* data, const TeamStatistics* base, TeamStatistics& record)
+{
+	std::uint32_t fields[NUM_FIELDS] = {0};
+
+	if (base != nullptr)
+		std::memcpy(fields, base, sizeof(fields));
+
+	for (unsigned int n = 0; n < NUM_FIELDS; n++) {
+		std::uint32_t delta = 0;
+
+		for (unsigned int shift = 0; ; shift += 7) {
+			const unsigned char byte = *(data++);
+
+			delta |= (std::uint32_t(byte & 0x7F) << shift);
+
+			if ((byte & 0x80) == 0)
+				break;
+		}
+
+		fields[n] ^= delta;
+	}
+
+	std::memcpy(&record, fields, sizeof(fields));
+	return data;
+}
+
+
+
+void TeamStatsHistory::PushCurrent()
+{
+	const bool keyframe = ((numRecords % KEYFRAME_INTERVAL) == 0);
+
+	if (keyframe)
+		keyframes.push_back(data.size());
+
+	EncodeRecord(current, keyframe? nullptr: &last, data);
+
+	last = current;
+	numRecords++;
+}
+
+
+void TeamStatsHistory::GetRange(unsigned int start, unsigned int end, std::vector<TeamStatistics>& records) const
+{
+	records.clear();
+
+	end = std::min(end, numRecords);
+
+	if (start > end)
+		return;
+
+	records.reserve(end - start + 1);
+
+	if (start < numRecords) {
+		const unsigned int keyframe = start / KEYFRAME_INTERVAL;
+		const unsigned int lastRecord = std::min(end, numRecords - 1);
+
+		const unsigned char* pos = &data[keyframes[keyframe]];
+
+		TeamStatistics record;
+
+		for (unsigned int n = keyframe * KEYFRAME_INTERVAL; n <= lastRecord; n++) {
+			pos = DecodeRecord(pos, ((n % KEYFRAME_INTERVAL) == 0)? nullptr: &record, record);
+
+			if (n >= start)
+				records.push_back(record);
+		}
+	}
+
+	if (end == numRecords)
+		records.push_back(current);
+}
@@ -0,0 +1,62 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef TEAM_STATS_HISTORY_H
+#define TEAM_STATS_HISTORY_H
+
+#include <vector>
+
+#include "TeamStatistics.h"
+#include "System/creg/creg_cond.h"
+
+/**
+ * History of a team's TeamStatistics, one record per statsPeriod plus the
+ * current one that is still being filled.
+ *
+ * Finished records are delta-encoded: every field is XOR'ed (bitwise, so
+ * the floats come back exactly) with the same field of the record before
+ * it and written as a variable-length integer. Counters and fields that did
+ * not change take one byte, the slowly growing float totals rarely more than
+ * three. Every KEYFRAME_INTERVAL'th record is encoded against zero so that a
+ * range can be decoded without walking the whole history.
+ */
+class TeamStatsHistory
+{
+	CR_DECLARE_STRUCT(TeamStatsHistory)
+
+public:
+	static const unsigned int KEYFRAME_INTERVAL = 64;
+
+	TeamStatsHistory(): numRecords(0) {}
+
+	/// number of records, including the current one
+	unsigned int size() const { return (numRecords + 1); }
+
+	TeamStatistics& GetCurrent() { return current; }
+	const TeamStatistics& GetCurrent() const { return current; }
+
+	/// appends a copy of the current record to the finished ones
+	void PushCurrent();
+
+	/**
+	 * Replaces the contents of <records> by the records in [start, end]
+	 * (clamped to the history); decoding starts at the keyframe before
+	 * <start>, not at the beginning.
+	 */
+	void GetRange(unsigned int start, unsigned int end, std::vector<TeamStatistics>& records) const;
+
+	/// size of the encoded records in bytes
+	size_t GetDataSize() const { return data.size(); }
+
+private:
+	std::vector<unsigned char> data;
+	/// offset into data of every KEYFRAME_INTERVAL'th record
+	std::vector<unsigned int> keyframes;
+
+	/// the last finished record, the base of the next delta
+	TeamStatistics last;
+	TeamStatistics current;
+
+	unsigned int numRecords;
+};
+
+#endif // TEAM_STATS_HISTORY_H
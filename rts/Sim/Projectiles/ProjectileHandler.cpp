@@ -527,10 +527,16 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 		const float3 ppos0 = p->pos;
 		const float3 ppos1 = p->pos + p->speed;
 
-		quadField->GetUnitsAndFeaturesColVol(p->pos, p->radius + p->speed.w, tempUnits, tempFeatures, &tempRepulsers);
+		// only gather the shields near projectiles some shield can stop,
+		// most (and all unsynced) projectiles skip the repulser lists
+		const bool shieldable = (p->weapon && static_cast<const CWeaponProjectile*>(p)->GetWeaponDef()->interceptedByShieldType != 0);
 
-		CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1);
-		tempRepulsers.clear();
+		quadField->GetUnitsAndFeaturesColVol(p->pos, p->radius + p->speed.w, tempUnits, tempFeatures, shieldable? &tempRepulsers: nullptr);
+
+		if (shieldable) {
+			CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1);
+			tempRepulsers.clear();
+		}
 		CheckUnitCollisions(p, tempUnits, ppos0, ppos1);
 		tempUnits.clear();
 		CheckFeatureCollisions(p, tempFeatures, ppos0, ppos1);
@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <cassert>
 
 #include "BuilderCAI.h"
@@ -1411,6 +1412,37 @@ bool CBuilderCAI::IsFeatureBeingReclaimed(int featureId, CUnit *friendUnit)
 }
 
 
+void CBuilderCAI::GetReclaimedFeatureIDs(std::vector<int>& featureIDs)
+{
+	featureIDs.clear();
+
+	std::vector<int> rm;
+
+	for (auto it = featureReclaimers.begin(); it != featureReclaimers.end(); ++it) {
+		const CUnit* u = unitHandler->GetUnit(*it);
+		const CCommandAI* cai = u->commandAI;
+		const CCommandQueue& cq = cai->commandQue;
+
+		if (cq.empty()) {
+			rm.push_back(u->id);
+			continue;
+		}
+		const Command& c = cq.front();
+		if (c.GetID() != CMD_RECLAIM || (c.params.size() != 1 && c.params.size() != 5)) {
+			rm.push_back(u->id);
+			continue;
+		}
+
+		featureIDs.push_back((int)c.params[0] - unitHandler->MaxUnits());
+	}
+
+	for (auto it = rm.begin(); it != rm.end(); ++it)
+		RemoveUnitFromFeatureReclaimers(unitHandler->GetUnit(*it));
+
+	std::sort(featureIDs.begin(), featureIDs.end());
+}
+
+
 bool CBuilderCAI::IsFeatureBeingResurrected(int featureId, CUnit *friendUnit)
 {
 	bool retval = false;
@@ -57,6 +57,8 @@ public:
 	 */
 	static bool IsUnitBeingReclaimed(const CUnit* unit, CUnit* friendUnit = NULL);
 	static bool IsFeatureBeingReclaimed(int featureId, CUnit* friendUnit = NULL);
+	/// sorted IDs of all features targeted by any reclaimer, see IsFeatureBeingReclaimed
+	static void GetReclaimedFeatureIDs(std::vector<int>& featureIDs);
 	static bool IsFeatureBeingResurrected(int featureId, CUnit* friendUnit = NULL);
 
 	bool IsInBuildRange(const CWorldObject* obj) const;
@@ -5,11 +5,12 @@
 
 #include <string>
 #include <climits> // for INT_MAX
+#include <utility>
 
 #ifdef BUILDING_AI
 #include <vector>
 #else
-#include "System/SafeVector.h"
+#include "CommandParams.h"
 #endif
 
 #include "System/creg/creg_cond.h"
@@ -187,6 +188,20 @@ public:
 		return *this;
 	}
 
+	Command(Command&& c) {
+		*this = std::move(c);
+	}
+
+	Command& operator = (Command&& c) {
+		id = c.id;
+		aiCommandId = c.aiCommandId;
+
+		SetFlags(c.timeOut, c.tag, c.options);
+
+		params = std::move(c.params);
+		return *this;
+	}
+
 	Command(const float3& pos)
 		: id(0)
 		, aiCommandId(-1)
@@ -253,7 +268,7 @@ public:
 		rc.numParams   = params.size();
 		rc.tag         = tag;
 		rc.options     = options;
-		rc.params      = &params[0];
+		rc.params      = params.data();
 		return rc;
 	}
 
@@ -371,7 +386,6 @@ public:
 	void PushParam(float par) { params.push_back(par); }
 	float GetParam(size_t idx) const { return params[idx]; }
 
-	/// const safe_vector<float>& GetParams() const { return params; }
 	const size_t GetParamsCount() const { return params.size(); }
 
 	void SetID(int id) _deprecated { this->id = id; params.clear(); }
@@ -444,7 +458,7 @@ public:
 	#ifdef BUILDING_AI
 	std::vector<float> params;
 	#else
-	safe_vector<float> params;
+	CommandParams params;
 	#endif
 };
 
@@ -49,11 +49,45 @@ void CCommandAI::KillCommandDescriptionCache() { SafeDelete(commandDescriptionCa
 
 CR_BIND(CCommandQueue, )
 CR_REG_METADATA(CCommandQueue, (
-	CR_MEMBER(queue),
 	CR_MEMBER(queueType),
-	CR_MEMBER(tagCounter)
+	CR_MEMBER(tagCounter),
+
+	// queued commands are written by Serialize, free nodes are not saved
+	CR_IGNORED(ring),
+	CR_IGNORED(headIndex),
+	CR_IGNORED(numNodes),
+	CR_IGNORED(nodes),
+	CR_IGNORED(freeNodes),
+
+	CR_SERIALIZER(Serialize)
 ))
 
+void CCommandQueue::Serialize(creg::ISerializer* s)
+{
+	int numCommands = numNodes;
+	s->SerializeInt(&numCommands, sizeof(numCommands));
+
+	if (!s->IsWriting()) {
+		// not push_back, tags are restored from the save
+		ring.clear();
+		nodes.clear();
+		freeNodes.clear();
+
+		headIndex = 0;
+		numNodes = 0;
+
+		for (int n = 0; n < numCommands; n++) {
+			OpenSlot(numNodes);
+			nodes.emplace_back();
+			GetSlot(numNodes - 1) = &nodes.back();
+		}
+	}
+
+	for (int n = 0; n < numCommands; n++) {
+		s->SerializeObjectInstance(GetNode(n), Command::StaticClass());
+	}
+}
+
 CR_BIND_DERIVED(CCommandAI, CObject, )
 CR_REG_METADATA(CCommandAI, (
 	CR_MEMBER(stockpileWeapon),
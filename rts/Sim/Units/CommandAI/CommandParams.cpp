@@ -0,0 +1,122 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "CommandParams.h"
+
+#include "System/Log/ILog.h"
+#include "System/Threading/SpringThreading.h"
+
+#if !defined(UNITSYNC) && !defined(UNIT_TEST)
+#include "System/Platform/CrashHandler.h"
+#endif
+
+#include <mutex>
+#include <vector>
+
+constexpr CommandParams::size_type CommandParams::NUM_INLINE_PARAMS;
+
+
+namespace {
+	// spilled buffers hold MIN_POOLED_ELEMS << i floats for bucket i;
+	// anything larger than the last bucket goes straight to the heap
+	constexpr CommandParams::size_type MIN_POOLED_ELEMS = 16;
+	constexpr CommandParams::size_type NUM_POOL_BUCKETS = 8;
+
+	struct ParamsPool {
+		std::vector<float*> freeBuffers[NUM_POOL_BUCKETS];
+		spring::spinlock mutex;
+	};
+
+	// intentionally never destroyed, Commands can outlive any static
+	ParamsPool* GetPool() {
+		static ParamsPool* pool = new ParamsPool();
+		return pool;
+	}
+
+	CommandParams::size_type GetBucket(CommandParams::size_type n) {
+		CommandParams::size_type bucket = 0;
+
+		while ((MIN_POOLED_ELEMS << bucket) < n)
+			bucket++;
+
+		return bucket;
+	}
+}
+
+
+float* CommandParams::AllocElems(size_type& n)
+{
+	const size_type bucket = GetBucket(n);
+
+	if (bucket >= NUM_POOL_BUCKETS)
+		return (new float[n]);
+
+	n = MIN_POOLED_ELEMS << bucket;
+
+	ParamsPool* pool = GetPool();
+	std::lock_guard<spring::spinlock> lock(pool->mutex);
+	std::vector<float*>& buffers = pool->freeBuffers[bucket];
+
+	if (buffers.empty())
+		return (new float[n]);
+
+	float* buf = buffers.back();
+	buffers.pop_back();
+	return buf;
+}
+
+void CommandParams::FreeElems(float* buf, size_type n)
+{
+	const size_type bucket = GetBucket(n);
+
+	if (bucket >= NUM_POOL_BUCKETS) {
+		delete[] buf;
+		return;
+	}
+
+	ParamsPool* pool = GetPool();
+	std::lock_guard<spring::spinlock> lock(pool->mutex);
+	pool->freeBuffers[bucket].push_back(buf);
+}
+
+CommandParams::size_type CommandParams::GetNumPooledBuffers()
+{
+	ParamsPool* pool = GetPool();
+	std::lock_guard<spring::spinlock> lock(pool->mutex);
+
+	size_type n = 0;
+
+	for (const std::vector<float*>& buffers: pool->freeBuffers) {
+		n += buffers.size();
+	}
+
+	return n;
+}
+
+
+const float& CommandParams::SafeElement(size_type idx) const {
+	static const float def = 0.0f;
+
+	if (showError) {
+		showError = false;
+		LOG_L(L_ERROR, "[%s const] index %u out of bounds! (size %u)", __FUNCTION__, idx, numElems);
+#if !defined(UNITSYNC) && !defined(UNIT_TEST)
+		CrashHandler::OutputStacktrace();
+#endif
+	}
+
+	return def;
+}
+
+float& CommandParams::SafeElement(size_type idx) {
+	static float def = 0.0f;
+
+	if (showError) {
+		showError = false;
+		LOG_L(L_ERROR, "[%s] index %u out of bounds! (size %u)", __FUNCTION__, idx, numElems);
+#if !defined(UNITSYNC) && !defined(UNIT_TEST)
+		CrashHandler::OutputStacktrace();
+#endif
+	}
+
+	return def;
+}
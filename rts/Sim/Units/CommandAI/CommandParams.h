@@ -0,0 +1,174 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COMMAND_PARAMS_H
+#define COMMAND_PARAMS_H
+
+#include <algorithm>
+#include <cstring>
+
+#include "System/creg/creg_cond.h"
+
+/**
+ * Parameter storage of a Command.
+ *
+ * Behaves like the safe_vector<float> it replaces (including out-of-bounds
+ * reads returning a dummy element), but keeps up to NUM_INLINE_PARAMS values
+ * inside the Command itself. Larger parameter lists spill into buffers that
+ * are recycled through a global pool instead of being returned to the heap.
+ */
+class CommandParams
+{
+public:
+	typedef float value_type;
+	typedef unsigned int size_type;
+	typedef float* iterator;
+	typedef const float* const_iterator;
+
+	// enough for e.g. a build command (pos + facing) plus an insert-position
+	static constexpr size_type NUM_INLINE_PARAMS = 6;
+
+public:
+	CommandParams(): elems(inlineElems), numElems(0), maxElems(NUM_INLINE_PARAMS), showError(true) {}
+	CommandParams(const CommandParams& p): CommandParams() { *this = p; }
+	CommandParams(CommandParams&& p): CommandParams() { *this = std::move(p); }
+	~CommandParams() { FreeElems(); }
+
+	CommandParams& operator = (const CommandParams& p) {
+		if (this == &p)
+			return *this;
+
+		numElems = 0;
+		reserve(p.numElems);
+		std::memcpy(elems, p.elems, p.numElems * sizeof(float));
+		numElems = p.numElems;
+		return *this;
+	}
+
+	CommandParams& operator = (CommandParams&& p) {
+		if (this == &p)
+			return *this;
+
+		// take over a spilled buffer, copy everything else
+		if (p.IsSpilled() && p.maxElems > maxElems) {
+			FreeElems();
+
+			elems = p.elems;
+			numElems = p.numElems;
+			maxElems = p.maxElems;
+
+			p.elems = p.inlineElems;
+			p.numElems = 0;
+			p.maxElems = NUM_INLINE_PARAMS;
+			return *this;
+		}
+
+		*this = static_cast<const CommandParams&>(p);
+		p.clear();
+		return *this;
+	}
+
+	bool operator == (const CommandParams& p) const { return (numElems == p.numElems && std::equal(begin(), end(), p.begin())); }
+	bool operator != (const CommandParams& p) const { return !(*this == p); }
+
+	const float& operator [] (size_type i) const { return ((i < numElems)? elems[i]: SafeElement(i)); }
+	      float& operator [] (size_type i)       { return ((i < numElems)? elems[i]: SafeElement(i)); }
+	const float& at(size_type i) const { return (*this)[i]; }
+	      float& at(size_type i)       { return (*this)[i]; }
+
+	const float& front() const { return (*this)[0]; }
+	      float& front()       { return (*this)[0]; }
+	const float& back() const { return (*this)[numElems - 1]; }
+	      float& back()       { return (*this)[numElems - 1]; }
+
+	const float* data() const { return elems; }
+	      float* data()       { return elems; }
+
+	const_iterator begin() const { return elems; }
+	const_iterator end() const { return (elems + numElems); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	iterator begin() { return elems; }
+	iterator end() { return (elems + numElems); }
+
+	size_type size() const { return numElems; }
+	size_type capacity() const { return maxElems; }
+	bool empty() const { return (numElems == 0); }
+
+	void clear() { numElems = 0; }
+	void pop_back() { numElems -= (numElems > 0); }
+
+	void push_back(float v) {
+		if (numElems == maxElems)
+			reserve(numElems + 1);
+
+		elems[numElems++] = v;
+	}
+
+	void resize(size_type n, float v = 0.0f) {
+		reserve(n);
+		std::fill(elems + std::min(n, numElems), elems + n, v);
+		numElems = n;
+	}
+
+	void reserve(size_type n) {
+		if (n <= maxElems)
+			return;
+
+		size_type newMaxElems = n;
+		float* newElems = AllocElems(newMaxElems);
+
+		std::memcpy(newElems, elems, numElems * sizeof(float));
+		FreeElems();
+
+		elems = newElems;
+		maxElems = newMaxElems;
+	}
+
+	/// total number of spilled buffers currently held by the pool (for tests)
+	static size_type GetNumPooledBuffers();
+
+private:
+	bool IsSpilled() const { return (elems != inlineElems); }
+
+	void FreeElems() {
+		if (!IsSpilled())
+			return;
+
+		FreeElems(elems, maxElems);
+		elems = inlineElems;
+		maxElems = NUM_INLINE_PARAMS;
+	}
+
+	/// rounds <n> up to the size of the returned buffer
+	static float* AllocElems(size_type& n);
+	static void FreeElems(float* buf, size_type n);
+
+	const float& SafeElement(size_type i) const;
+	      float& SafeElement(size_type i);
+
+private:
+	float* elems;
+	size_type numElems;
+	size_type maxElems;
+
+	float inlineElems[NUM_INLINE_PARAMS];
+
+	mutable bool showError;
+};
+
+
+#ifdef USING_CREG
+
+namespace creg
+{
+	template<>
+	struct DeduceType<CommandParams> {
+		static std::shared_ptr<IType> Get() {
+			return std::shared_ptr<IType>(new DynamicArrayType<CommandParams>(DeduceType<float>::Get()));
+		}
+	};
+}
+
+#endif // USING_CREG
+
+#endif // COMMAND_PARAMS_H
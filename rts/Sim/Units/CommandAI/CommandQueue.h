@@ -3,10 +3,27 @@
 #ifndef _COMMAND_QUEUE_H
 #define _COMMAND_QUEUE_H
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
 #include "Command.h"
 
-/// A wrapper class for std::deque<Command> to keep track of commands
+/**
+ * A deque-like container of Commands to keep track of commands.
+ *
+ * Commands live in nodes owned by the queue and are referenced from a ring
+ * buffer of pointers. Popped or erased nodes are kept for reuse (including
+ * their parameter buffers), so a unit that keeps cycling through orders
+ * stops allocating once its queue has reached its working size. Like with
+ * std::deque, references to commands stay valid when other commands are
+ * added or removed.
+ */
 class CCommandQueue {
 
 	friend class CCommandAI;
@@ -24,21 +41,67 @@ class CCommandQueue {
 
 		inline QueueType GetType() const { return queueType; }
 
+	private:
+		template<typename Q, typename T>
+		class basic_iterator {
+			friend class CCommandQueue;
+			template<typename Q2, typename T2> friend class basic_iterator;
+
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef T* pointer;
+			typedef T& reference;
+
+			basic_iterator(): queue(nullptr), index(0) {}
+			basic_iterator(Q* q, difference_type i): queue(q), index(i) {}
+
+			// iterator -> const_iterator
+			template<typename Q2, typename T2, typename = typename std::enable_if<std::is_convertible<T2*, T*>::value>::type>
+			basic_iterator(const basic_iterator<Q2, T2>& it): queue(it.queue), index(it.index) {}
+
+			reference operator * () const { return *(queue->GetNode(index)); }
+			pointer operator -> () const { return queue->GetNode(index); }
+			reference operator [] (difference_type n) const { return *(queue->GetNode(index + n)); }
+
+			basic_iterator& operator ++ () { ++index; return *this; }
+			basic_iterator& operator -- () { --index; return *this; }
+			basic_iterator operator ++ (int) { basic_iterator it = *this; ++index; return it; }
+			basic_iterator operator -- (int) { basic_iterator it = *this; --index; return it; }
+
+			basic_iterator& operator += (difference_type n) { index += n; return *this; }
+			basic_iterator& operator -= (difference_type n) { index -= n; return *this; }
+			basic_iterator operator + (difference_type n) const { return basic_iterator(queue, index + n); }
+			basic_iterator operator - (difference_type n) const { return basic_iterator(queue, index - n); }
+			difference_type operator - (const basic_iterator& it) const { return (index - it.index); }
+
+			// friends so that iterators and const_iterators compare both ways
+			friend bool operator == (const basic_iterator& a, const basic_iterator& b) { return (a.index == b.index); }
+			friend bool operator != (const basic_iterator& a, const basic_iterator& b) { return (a.index != b.index); }
+			friend bool operator <  (const basic_iterator& a, const basic_iterator& b) { return (a.index <  b.index); }
+			friend bool operator >  (const basic_iterator& a, const basic_iterator& b) { return (a.index >  b.index); }
+			friend bool operator <= (const basic_iterator& a, const basic_iterator& b) { return (a.index <= b.index); }
+			friend bool operator >= (const basic_iterator& a, const basic_iterator& b) { return (a.index >= b.index); }
+
+		private:
+			Q* queue;
+			difference_type index;
+		};
+
 	public:
 		/// limit to a float's integer range
 		static const int maxTagValue = (1 << 24); // 16777216
 
-		typedef std::deque<Command> basis;
+		typedef size_t size_type;
+		typedef basic_iterator<CCommandQueue, Command> iterator;
+		typedef basic_iterator<const CCommandQueue, const Command> const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
-		typedef basis::size_type              size_type;
-		typedef basis::iterator               iterator;
-		typedef basis::const_iterator         const_iterator;
-		typedef basis::reverse_iterator       reverse_iterator;
-		typedef basis::const_reverse_iterator const_reverse_iterator;
+		inline bool empty() const { return (numNodes == 0); }
 
-		inline bool empty() const { return queue.empty(); }
-
-		inline size_type size() const { return queue.size(); }
+		inline size_type size() const { return numNodes; }
 
 		inline void push_back(const Command& cmd);
 		inline void push_front(const Command& cmd);
@@ -47,49 +110,54 @@ class CCommandQueue {
 
 		inline void pop_back()
 		{
-			queue.pop_back();
+			assert(!empty());
+			FreeNode(GetNode(--numNodes));
 		}
 		inline void pop_front()
 		{
-			queue.pop_front();
+			assert(!empty());
+			FreeNode(GetNode(0));
+			headIndex = (headIndex + 1) & (ring.size() - 1);
+			numNodes -= 1;
 		}
 
 		inline iterator erase(iterator pos)
 		{
-			return queue.erase(pos);
-		}
-		inline iterator erase(iterator first, iterator last)
-		{
-			return queue.erase(first, last);
+			return erase(pos, pos + 1);
 		}
+		inline iterator erase(iterator first, iterator last);
+
 		inline void clear()
 		{
-			queue.clear();
+			erase(begin(), end());
 		}
 
-		inline iterator       end()         { return queue.end(); }
-		inline const_iterator end()   const { return queue.end(); }
-		inline iterator       begin()       { return queue.begin(); }
-		inline const_iterator begin() const { return queue.begin(); }
+		inline iterator       end()         { return       iterator(this, numNodes); }
+		inline const_iterator end()   const { return const_iterator(this, numNodes); }
+		inline iterator       begin()       { return       iterator(this, 0); }
+		inline const_iterator begin() const { return const_iterator(this, 0); }
+
+		inline reverse_iterator       rend()         { return       reverse_iterator(begin()); }
+		inline const_reverse_iterator rend()   const { return const_reverse_iterator(begin()); }
+		inline reverse_iterator       rbegin()       { return       reverse_iterator(end()); }
+		inline const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
 
-		inline reverse_iterator       rend()         { return queue.rend(); }
-		inline const_reverse_iterator rend()   const { return queue.rend(); }
-		inline reverse_iterator       rbegin()       { return queue.rbegin(); }
-		inline const_reverse_iterator rbegin() const { return queue.rbegin(); }
+		inline       Command& back()        { assert(!empty()); return *GetNode(numNodes - 1); }
+		inline const Command& back()  const { assert(!empty()); return *GetNode(numNodes - 1); }
+		inline       Command& front()       { assert(!empty()); return *GetNode(0); }
+		inline const Command& front() const { assert(!empty()); return *GetNode(0); }
 
-		inline       Command& back()        { return queue.back(); }
-		inline const Command& back()  const { return queue.back(); }
-		inline       Command& front()       { return queue.front(); }
-		inline const Command& front() const { return queue.front(); }
+		inline       Command& at(size_type i)       { CheckRange(i); return *GetNode(i); }
+		inline const Command& at(size_type i) const { CheckRange(i); return *GetNode(i); }
 
-		inline       Command& at(size_type i)       { return queue.at(i); }
-		inline const Command& at(size_type i) const { return queue.at(i); }
+		inline       Command& operator[](size_type i)       { return *GetNode(i); }
+		inline const Command& operator[](size_type i) const { return *GetNode(i); }
 
-		inline       Command& operator[](size_type i)       { return queue[i]; }
-		inline const Command& operator[](size_type i) const { return queue[i]; }
+		/// creg serialize callback
+		void Serialize(creg::ISerializer* s);
 
 	private:
-		CCommandQueue() : queueType(CommandQueueType), tagCounter(0) {};
+		CCommandQueue() : queueType(CommandQueueType), tagCounter(0), headIndex(0), numNodes(0) {};
 		CCommandQueue(const CCommandQueue&);
 		CCommandQueue& operator=(const CCommandQueue&);
 
@@ -97,10 +165,34 @@ class CCommandQueue {
 		inline int GetNextTag();
 		inline void SetQueueType(QueueType type) { queueType = type; }
 
+		void CheckRange(size_type i) const {
+			if (i >= numNodes)
+				throw std::out_of_range("CCommandQueue::at");
+		}
+
+		// ring.size() is always zero or a power of two
+		Command* GetNode(size_type i) const { return ring[(headIndex + i) & (ring.size() - 1)]; }
+		Command*& GetSlot(size_type i) { return ring[(headIndex + i) & (ring.size() - 1)]; }
+
+		inline Command* AllocNode(const Command& cmd);
+		inline void FreeNode(Command* node) { freeNodes.push_back(node); }
+
+		/// opens a gap of one slot at position <i>, nearest end moves
+		inline void OpenSlot(size_type i);
+		inline void GrowRing();
+
 	private:
-		std::deque<Command> queue;
 		QueueType queueType;
 		int tagCounter;
+
+		// ring of (pointers to) the queued commands
+		std::vector<Command*> ring;
+		size_type headIndex;
+		size_type numNodes;
+
+		// node storage, never shrinks; deque keeps node addresses stable
+		std::deque<Command> nodes;
+		std::vector<Command*> freeNodes;
 };
 
 
@@ -114,26 +206,118 @@ inline int CCommandQueue::GetNextTag()
 }
 
 
+inline Command* CCommandQueue::AllocNode(const Command& cmd)
+{
+	// cmd may reference a queued command, copy it before touching the ring
+	if (freeNodes.empty()) {
+		nodes.push_back(cmd);
+		return &nodes.back();
+	}
+
+	Command* node = freeNodes.back();
+	freeNodes.pop_back();
+	*node = cmd;
+	return node;
+}
+
+
+inline void CCommandQueue::GrowRing()
+{
+	std::vector<Command*> newRing(std::max(ring.size() * 2, size_t(8)), nullptr);
+
+	for (size_type n = 0; n < numNodes; n++) {
+		newRing[n] = GetNode(n);
+	}
+
+	ring.swap(newRing);
+	headIndex = 0;
+}
+
+
+inline void CCommandQueue::OpenSlot(size_type i)
+{
+	if (numNodes == ring.size())
+		GrowRing();
+
+	const size_type mask = ring.size() - 1;
+
+	if (i < (numNodes >> 1)) {
+		// shift [0, i) one slot towards the front
+		headIndex = (headIndex + mask) & mask;
+
+		for (size_type n = 0; n < i; n++) {
+			GetSlot(n) = GetSlot(n + 1);
+		}
+	} else {
+		// shift [i, numNodes) one slot towards the back
+		for (size_type n = numNodes; n > i; n--) {
+			GetSlot(n) = GetSlot(n - 1);
+		}
+	}
+
+	numNodes += 1;
+}
+
+
 inline void CCommandQueue::push_back(const Command& cmd)
 {
-	queue.push_back(cmd);
-	queue.back().tag = GetNextTag();
+	Command* node = AllocNode(cmd);
+	node->tag = GetNextTag();
+
+	OpenSlot(numNodes);
+	GetSlot(numNodes - 1) = node;
 }
 
 
 inline void CCommandQueue::push_front(const Command& cmd)
 {
-	queue.push_front(cmd);
-	queue.front().tag = GetNextTag();
+	Command* node = AllocNode(cmd);
+	node->tag = GetNextTag();
+
+	OpenSlot(0);
+	GetSlot(0) = node;
 }
 
 
 inline CCommandQueue::iterator CCommandQueue::insert(iterator pos,
                                                      const Command& cmd)
 {
-	Command tmpCmd = cmd;
-	tmpCmd.tag = GetNextTag();
-	return queue.insert(pos, tmpCmd);
+	Command* node = AllocNode(cmd);
+	node->tag = GetNextTag();
+
+	OpenSlot(pos.index);
+	GetSlot(pos.index) = node;
+	return pos;
+}
+
+
+inline CCommandQueue::iterator CCommandQueue::erase(iterator first, iterator last)
+{
+	const size_type i = first.index;
+	const size_type n = last.index - first.index;
+
+	assert(first.index <= last.index && last.index <= numNodes);
+
+	for (size_type k = i; k < (i + n); k++) {
+		FreeNode(GetSlot(k));
+	}
+
+	if (i < (numNodes - (i + n))) {
+		// close the gap from the front
+		for (size_type k = i; k > 0; k--) {
+			GetSlot(k - 1 + n) = GetSlot(k - 1);
+		}
+
+		headIndex = (headIndex + n) & (ring.size() - 1);
+	} else {
+		// close the gap from the back
+		for (size_type k = i + n; k < numNodes; k++) {
+			GetSlot(k - n) = GetSlot(k);
+		}
+	}
+
+	numNodes -= n;
+	return first;
 }
 
 
@@ -7,6 +7,8 @@
 #include "CobFile.h"
 #include "System/FileSystem/FileHandler.h"
 
+#include <algorithm>
+
 
 CCobEngine* cobEngine = nullptr;
 CCobFileHandler* cobFileHandler = nullptr;
@@ -18,12 +20,16 @@ CCobFileHandler* cobFileHandler = nullptr;
 CR_BIND(CCobEngine, )
 
 CR_REG_METADATA(CCobEngine, (
+	CR_MEMBER(threadInstances),
+	CR_MEMBER(freeThreadIDs),
 	CR_MEMBER(currentTime),
+	CR_MEMBER(sleepScanTime),
 	CR_MEMBER(running),
 	CR_MEMBER(sleeping),
 
 	//always null/empty when saving
 	CR_IGNORED(wantToRun),
+	CR_IGNORED(waking),
 	CR_IGNORED(curThread)
 ))
 
@@ -31,31 +37,35 @@ CR_REG_METADATA(CCobEngine, (
 CCobEngine::CCobEngine()
 	: curThread(nullptr)
 	, currentTime(0)
-
-{ }
+	, sleepScanTime(0)
+{
+	sleeping.resize(SLEEP_WHEEL_SIZE);
+}
 
 
 CCobEngine::~CCobEngine()
 {
-	//Should delete all things that the scheduler knows
+	//Should free all things that the scheduler knows
+	std::vector<int> threadIDs;
+
 	do {
-		while (!running.empty()) {
-			CCobThread* tmp = running.back();
-			running.pop_back();
-			delete tmp;
-		}
-		while (!wantToRun.empty()) {
-			CCobThread* tmp = wantToRun.back();
-			wantToRun.pop_back();
-			delete tmp;
+		threadIDs.clear();
+		threadIDs.insert(threadIDs.end(), running.begin(), running.end());
+		threadIDs.insert(threadIDs.end(), wantToRun.begin(), wantToRun.end());
+
+		for (std::vector<int>& slot: sleeping) {
+			threadIDs.insert(threadIDs.end(), slot.begin(), slot.end());
+			slot.clear();
 		}
-		while (!sleeping.empty()) {
-			CCobThread* tmp = sleeping.top();
-			sleeping.pop();
-			delete tmp;
+
+		running.clear();
+		wantToRun.clear();
+
+		for (const int threadID: threadIDs) {
+			FreeThread(GetThread(threadID));
 		}
 		// callbacks may add new threads
-	} while (!running.empty() || !wantToRun.empty() || !sleeping.empty());
+	} while (!threadIDs.empty());
 }
 
 
@@ -68,16 +78,44 @@ CCobFileHandler::~CCobFileHandler()
 }
 
 
+CCobThread* CCobEngine::AllocThread(CCobInstance* owner)
+{
+	int threadID = threadInstances.size();
+
+	if (freeThreadIDs.empty()) {
+		threadInstances.emplace_back();
+	} else {
+		threadID = freeThreadIDs.back();
+		freeThreadIDs.pop_back();
+	}
+
+	CCobThread* thread = GetThread(threadID);
+	thread->Reset(owner, threadID);
+	return thread;
+}
+
+void CCobEngine::FreeThread(CCobThread* thread)
+{
+	// the callback might start new threads, only recycle the slot afterwards
+	thread->Release();
+	freeThreadIDs.push_back(thread->GetID());
+}
+
+
 //A thread wants to continue running at a later time, and adds itself to the scheduler
 void CCobEngine::AddThread(CCobThread *thread)
 {
 	switch (thread->state) {
 		case CCobThread::Run:
-			wantToRun.push_back(thread);
-			break;
-		case CCobThread::Sleep:
-			sleeping.push(thread);
+			wantToRun.push_back(thread->GetID());
 			break;
+		case CCobThread::Sleep: {
+			// overdue threads go into the first slot of the next scan
+			const int slotTime = std::max(thread->GetWakeTime(), sleepScanTime);
+			const int slotIndex = (slotTime / SLEEP_SLOT_TIME) % SLEEP_WHEEL_SIZE;
+
+			sleeping[slotIndex].push_back(thread->GetID());
+		} break;
 		default:
 			LOG_L(L_ERROR, "thread added to scheduler with unknown state (%d)", thread->state);
 			break;
@@ -90,57 +128,100 @@ void CCobEngine::TickThread(CCobThread* thread)
 	curThread = thread; // for error messages originating in CUnitScript
 
 	if (!thread->Tick())
-		delete thread;
+		FreeThread(thread);
 
 	curThread = NULL;
 }
 
 
-void CCobEngine::Tick(int deltaTime)
+bool CCobEngine::GatherWakingThreads()
 {
-	currentTime += deltaTime;
+	// a sleeping thread is due once its wake-time is strictly less than the current time
+	const int lastDueTime = currentTime - 1;
 
-	// Advance all running threads
-	for (CCobThread* t: running) {
-		//LOG_L(L_DEBUG, "Now 1running %d: %s", currentTime, (*i)->GetName().c_str());
-		TickThread(t);
+	if (lastDueTime < sleepScanTime)
+		return false;
+
+	const int firstSlot = sleepScanTime / SLEEP_SLOT_TIME;
+	const int lastSlot = lastDueTime / SLEEP_SLOT_TIME;
+	const int numSlots = std::min(lastSlot - firstSlot + 1, int(SLEEP_WHEEL_SIZE));
+
+	for (int n = 0; n < numSlots; n++) {
+		std::vector<int>& slot = sleeping[(firstSlot + n) % SLEEP_WHEEL_SIZE];
+
+		size_t numSleeping = 0;
+
+		// threads due in a later revolution of the wheel stay in place
+		for (const int threadID: slot) {
+			if (GetThread(threadID)->GetWakeTime() < currentTime) {
+				waking.push_back(threadID);
+			} else {
+				slot[numSleeping++] = threadID;
+			}
+		}
+
+		slot.resize(numSleeping);
 	}
 
-	// A thread can never go from running->running, so clear the list
-	// note: if preemption was to be added, this would no longer hold
-	// however, ta scripts can not run preemptively anyway since there
-	// isn't any synchronization methods available
-	running.clear();
+	// the last slot can still contain threads due in the next tick, rescan it then
+	sleepScanTime = lastSlot * SLEEP_SLOT_TIME;
 
-	// The threads that just ran may have added new threads that should run next tick
-	std::swap(running, wantToRun);
+	// wake earliest-due threads first; ties are broken by ID to keep this synced
+	std::sort(waking.begin(), waking.end(), [&](int a, int b) {
+		const int wa = GetThread(a)->GetWakeTime();
+		const int wb = GetThread(b)->GetWakeTime();
+		return ((wa < wb) || (wa == wb && a < b));
+	});
 
-	//Check on the sleeping threads
-	if (!sleeping.empty()) {
-		CCobThread* cur = sleeping.top();
+	return (!waking.empty());
+}
 
-		while ((cur != NULL) && (cur->GetWakeTime() < currentTime)) {
-			// Start with removing the executing thread from the queue
-			sleeping.pop();
 
-			//Run forward again. This can quite possibly readd the thread to the sleeping array again
-			//But it will not interfere since it is guaranteed to sleep > 0 ms
+void CCobEngine::WakeSleepingThreads()
+{
+	// woken threads can go back to sleep with a past wake-time, loop until none are left
+	while (GatherWakingThreads()) {
+		for (const int threadID: waking) {
+			CCobThread* cur = GetThread(threadID);
+
+			//Run forward again. This can quite possibly readd the thread to the sleeping wheel again
 			//LOG_L(L_DEBUG, "Now 2running %d: %s", currentTime, cur->GetName().c_str());
 			if (cur->state == CCobThread::Sleep) {
 				cur->state = CCobThread::Run;
 				TickThread(cur);
 			} else if (cur->state == CCobThread::Dead) {
-				delete cur;
+				FreeThread(cur);
 			} else {
 				LOG_L(L_ERROR, "Sleeping thread strange state %d", cur->state);
 			}
-
-			if (!sleeping.empty())
-				cur = sleeping.top();
-			else
-				cur = NULL;
 		}
+
+		waking.clear();
+	}
+}
+
+
+void CCobEngine::Tick(int deltaTime)
+{
+	currentTime += deltaTime;
+
+	// Advance all running threads
+	for (const int threadID: running) {
+		//LOG_L(L_DEBUG, "Now 1running %d: %s", currentTime, GetThread(threadID)->GetName().c_str());
+		TickThread(GetThread(threadID));
 	}
+
+	// A thread can never go from running->running, so clear the list
+	// note: if preemption was to be added, this would no longer hold
+	// however, ta scripts can not run preemptively anyway since there
+	// isn't any synchronization methods available
+	running.clear();
+
+	// The threads that just ran may have added new threads that should run next tick
+	std::swap(running, wantToRun);
+
+	//Check on the sleeping threads
+	WakeSleepingThreads();
 }
 
 
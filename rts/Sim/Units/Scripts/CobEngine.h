@@ -9,12 +9,13 @@
  * It also manages reading and caching of the actual .cob files
  */
 
+#include <deque>
 #include <vector>
 
 #include "CobThread.h"
 #include "System/creg/creg_cond.h"
 
-#include "System/creg/STL_Queue.h"
+#include "System/creg/STL_Deque.h"
 #include "System/UnorderedMap.hpp"
 
 
@@ -23,31 +24,61 @@ class CCobInstance;
 class CCobFile;
 
 
-class CCobThreadPtr_less : public std::binary_function<CCobThread*, CCobThread*, bool> {
-public:
-	bool operator() (const CCobThread* const& a, const CCobThread* const& b) const {
-		return a->GetWakeTime() > b->GetWakeTime();
-	}
-};
-
-
 class CCobEngine
 {
 	CR_DECLARE_STRUCT(CCobEngine)
+public:
+	/// width (in ms) of each slot of the sleeping-thread timing wheel
+	static constexpr int SLEEP_SLOT_TIME = 32;
+	/// number of wheel slots; sleeps beyond SLEEP_SLOT_TIME * SLEEP_WHEEL_SIZE ms wrap around
+	static constexpr int SLEEP_WHEEL_SIZE = 64;
+
 protected:
-	std::vector<CCobThread*> running;
+	/**
+	 * Pooled thread storage, indexed by thread ID. Threads are never freed
+	 * but recycled through freeThreadIDs, so their stacks keep capacity and
+	 * script calls do not allocate. A deque keeps pointers to live threads
+	 * valid while new ones are allocated during a thread's Tick.
+	 */
+	std::deque<CCobThread> threadInstances;
+	std::vector<int> freeThreadIDs;
+
+	std::vector<int> running;
 	/**
 	 * Threads are added here if they are in Running.
 	 * And moved to real running after running is empty.
 	 */
-	std::vector<CCobThread*> wantToRun;
-	std::priority_queue<CCobThread*, std::vector<CCobThread*>, CCobThreadPtr_less> sleeping;
+	std::vector<int> wantToRun;
+	/**
+	 * Timing wheel of sleeping thread IDs; slot = (wakeTime / SLEEP_SLOT_TIME)
+	 * modulo SLEEP_WHEEL_SIZE. Slots in [sleepScanTime, currentTime) are
+	 * scanned each tick, threads that are not yet due stay in their slot.
+	 */
+	std::vector< std::vector<int> > sleeping;
+	/// scratch list of threads woken in the current tick, always empty when saving
+	std::vector<int> waking;
+
 	CCobThread* curThread;
 	int currentTime;
+	int sleepScanTime;
+
 	void TickThread(CCobThread* thread);
+	bool GatherWakingThreads();
+	void WakeSleepingThreads();
+
 public:
 	CCobEngine();
 	~CCobEngine();
+
+	/**
+	 * Returns a recycled (or new) thread owned by owner, registered with it.
+	 * The pointer stays valid until the thread is passed to FreeThread.
+	 */
+	CCobThread* AllocThread(CCobInstance* owner);
+	/// Runs the thread's callback, unregisters it and returns it to the pool
+	void FreeThread(CCobThread* thread);
+	CCobThread* GetThread(int threadID) { return &threadInstances[threadID]; }
+
 	void AddThread(CCobThread* thread);
 	void Tick(int deltaTime);
 	void ShowScriptError(const std::string& msg);
@@ -149,7 +149,7 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 
 	int code_octets = size - ch.OffsetToScriptCode;
 	int code_ints = (code_octets) / 4 + 4;
-	code = new int[code_ints];
+	code = new int[code_ints]();
 	memcpy(code, &cobdata[ch.OffsetToScriptCode], code_octets);
 	for (int i = 0; i < code_ints; i++) {
 		swabDWordInPlace(code[i]);
@@ -180,6 +180,8 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 
 	delete[] cobdata;
 
+	cob::DecodeCode(code, code_ints, scriptNames, instructions);
+
 	//Create a reverse mapping (name->int)
 	for (unsigned int i = 0; i < scriptNames.size(); ++i) {
 		scriptMap[scriptNames[i]] = i;
@@ -194,6 +196,15 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 			scriptIndex[it->second] = fn;
 		}
 	}
+
+	// flag the Fire* scripts, SHOW displays a muzzle flare when called from one
+	fireScripts.resize(scriptNames.size(), false);
+	for (int i = 0; i < MAX_WEAPONS_PER_UNIT; ++i) {
+		const int fn = scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i];
+		if (fn >= 0) {
+			fireScripts[fn] = true;
+		}
+	}
 }
 
 
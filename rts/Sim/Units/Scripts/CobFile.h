@@ -7,6 +7,7 @@
 #include <string>
 
 #include "Lua/LuaHashString.h"
+#include "CobOpcodes.h"
 #include "CobScriptNames.h"
 #include "System/UnorderedMap.hpp"
 
@@ -19,6 +20,8 @@ public:
 	~CCobFile();
 
 	int GetFunctionId(const std::string& name);
+	/// true if functionId is one of the weapon Fire* scripts
+	bool IsFireScript(int functionId) const { return fireScripts[functionId]; }
 
 
 	std::vector<std::string> scriptNames;
@@ -27,9 +30,12 @@ public:
 	std::vector<int> scriptLengths;
 	std::vector<std::string> pieceNames;
 	std::vector<int> scriptIndex;
+	std::vector<bool> fireScripts;
 	std::vector<int> sounds;
 	std::vector<LuaHashString> luaScripts;
 	spring::unordered_map<std::string, int> scriptMap;
+	/// pre-decoded code, indexed by raw code offset (see cob::DecodeCode)
+	std::vector<cob::Instruction> instructions;
 	int* code;
 	int numStaticVars;
 	std::string name;
@@ -42,7 +42,7 @@ CR_BIND_DERIVED(CCobInstance, CUnitScript, )
 
 CR_REG_METADATA(CCobInstance, (
 	CR_MEMBER(staticVars),
-	CR_MEMBER(threads),
+	CR_MEMBER(threadIDs),
 
 	//loaded from cobFileHandler
 	CR_IGNORED(script),
@@ -99,15 +99,16 @@ CCobInstance::~CCobInstance()
 	//this may be dangerous, is it really desired?
 	//Destroy();
 	// Deleting waiting threads and unregistering all callbacks
-	while (!threads.empty()) {
-		CCobThread* t = threads.back();
+	while (!threadIDs.empty()) {
+		CCobThread* t = cobEngine->GetThread(threadIDs.back());
 		t->owner = nullptr;
 		if (t->IsWaiting()) {
-			delete t;
+			// not known to the scheduler, recycle it here
+			cobEngine->FreeThread(t);
 		} else {
 			t->state = CCobThread::Dead;
 		}
-		threads.pop_back();
+		threadIDs.pop_back();
 	}
 }
 
@@ -438,8 +439,8 @@ float CCobInstance::TargetWeight(int weaponNum, const CUnit* targetUnit)
 
 void CCobInstance::AnimFinished(AnimType type, int piece, int axis)
 {
-	for (CCobThread* t: threads) {
-		t->AnimFinished(type, piece, axis);
+	for (const int threadID: threadIDs) {
+		cobEngine->GetThread(threadID)->AnimFinished(type, piece, axis);
 	}
 }
 
@@ -488,7 +489,7 @@ int CCobInstance::RealCall(int functionId, vector<int>& args, ThreadCallbackType
 	}
 
 
-	CCobThread* thread = new CCobThread(this);
+	CCobThread* thread = cobEngine->AllocThread(this);
 	thread->Start(functionId, args, false);
 
 	//LOG_L(L_DEBUG, "Calling %s:%s", script->name.c_str(), script->scriptNames[functionId].c_str());
@@ -516,10 +517,10 @@ int CCobInstance::RealCall(int functionId, vector<int>& args, ThreadCallbackType
 		for (; i < args.size(); ++i)
 			args[i] = 0;
 
-		// dtor runs the callback
+		// FreeThread runs the callback
 		if (retCode != nullptr)
 			*retCode = thread->GetRetCode();
-		delete thread;
+		cobEngine->FreeThread(thread);
 		return 0;
 	}
 
@@ -624,7 +625,9 @@ void CCobInstance::ThreadCallback(ThreadCallbackType type, int retCode, int cbPa
 
 void CCobInstance::Signal(int signal)
 {
-	for (CCobThread* t: threads) {
+	for (const int threadID: threadIDs) {
+		CCobThread* t = cobEngine->GetThread(threadID);
+
 		if ((signal & t->signalMask) != 0) {
 			t->state = CCobThread::Dead;
 			//LOG_L(L_DEBUG, "Killing a thread %d %d", signal, (*i)->signalMask);
@@ -40,7 +40,8 @@ protected:
 public:
 	CCobFile* script;
 	std::vector<int> staticVars;
-	std::vector<CCobThread *> threads;
+	/// IDs of the CCobEngine-pooled threads run by this instance
+	std::vector<int> threadIDs;
 	const CCobFile* GetScriptAddr() const { return script; }
 
 public:
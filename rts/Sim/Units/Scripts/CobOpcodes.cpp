@@ -0,0 +1,81 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "CobOpcodes.h"
+
+
+namespace cob {
+	Opcode GetOpcode(int rawOpcode)
+	{
+		switch (rawOpcode) {
+			#define COB_OPCODE_CASE(name, value, numArgs, mnemonic) case value: return OP_##name;
+			COB_OPCODE_LIST(COB_OPCODE_CASE)
+			#undef COB_OPCODE_CASE
+			default: break;
+		}
+
+		return OP_UNKNOWN;
+	}
+
+	int GetNumOperands(Opcode op)
+	{
+		static const int numOperands[OP_COUNT] = {
+			#define COB_OPCODE_ARGS(name, value, numArgs, mnemonic) numArgs,
+			COB_OPCODE_LIST(COB_OPCODE_ARGS)
+			#undef COB_OPCODE_ARGS
+			0, // OP_UNKNOWN
+		};
+
+		return numOperands[op];
+	}
+
+	const char* GetOpcodeName(Opcode op)
+	{
+		static const char* names[OP_COUNT] = {
+			#define COB_OPCODE_NAME(name, value, numArgs, mnemonic) mnemonic,
+			COB_OPCODE_LIST(COB_OPCODE_NAME)
+			#undef COB_OPCODE_NAME
+			"unknown",
+		};
+
+		return names[op];
+	}
+
+
+	void DecodeCode(
+		const int* code,
+		int numInts,
+		const std::vector<std::string>& scriptNames,
+		std::vector<Instruction>& instructions
+	) {
+		instructions.clear();
+		instructions.resize(numInts);
+
+		// operands past the end of the stream read as 0
+		const auto GetOperand = [&](int offset) { return ((offset < numInts)? code[offset]: 0); };
+
+		for (int pc = 0; pc < numInts; pc++) {
+			Instruction& insn = instructions[pc];
+			Opcode op = GetOpcode(code[pc]);
+
+			const int numArgs = GetNumOperands(op);
+
+			insn.arg0 = (numArgs > 0)? GetOperand(pc + 1): 0;
+			insn.arg1 = (numArgs > 1)? GetOperand(pc + 2): 0;
+			insn.next = pc + 1 + numArgs;
+
+			if (op == OP_CALL) {
+				// the raw interpreter rewrote these in place on first execution
+				if (insn.arg0 < 0 || static_cast<size_t>(insn.arg0) >= scriptNames.size()) {
+					op = OP_UNKNOWN;
+					insn.arg0 = 0;
+					insn.arg1 = 0;
+					insn.next = pc + 1;
+				} else {
+					op = (scriptNames[insn.arg0].find("lua_") == 0)? OP_LUA_CALL: OP_REAL_CALL;
+				}
+			}
+
+			insn.op = op;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_OPCODES_H
+#define COB_OPCODES_H
+
+#include <string>
+#include <vector>
+
+// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
+// And some information from basm0.8 source (basm ops.txt)
+//
+// X(name, raw opcode, number of inline operands, mnemonic)
+#define COB_OPCODE_LIST(X) \
+	/* Model interaction */ \
+	X(MOVE,                 0x10001000, 2, "move"         ) \
+	X(TURN,                 0x10002000, 2, "turn"         ) \
+	X(SPIN,                 0x10003000, 2, "spin"         ) \
+	X(STOP_SPIN,            0x10004000, 2, "stop-spin"    ) \
+	X(SHOW,                 0x10005000, 1, "show"         ) \
+	X(HIDE,                 0x10006000, 1, "hide"         ) \
+	X(CACHE,                0x10007000, 1, "cache"        ) \
+	X(DONT_CACHE,           0x10008000, 1, "dont-cache"   ) \
+	X(MOVE_NOW,             0x1000B000, 2, "move-now"     ) \
+	X(TURN_NOW,             0x1000C000, 2, "turn-now"     ) \
+	X(SHADE,                0x1000D000, 1, "shade"        ) \
+	X(DONT_SHADE,           0x1000E000, 1, "dont-shade"   ) \
+	X(EMIT_SFX,             0x1000F000, 1, "sfx"          ) \
+	/* Blocking operations */ \
+	X(WAIT_TURN,            0x10011000, 2, "wait-for-turn") \
+	X(WAIT_MOVE,            0x10012000, 2, "wait-for-move") \
+	X(SLEEP,                0x10013000, 0, "sleep"        ) \
+	/* Stack manipulation */ \
+	X(PUSH_CONSTANT,        0x10021001, 1, "pushc"        ) \
+	X(PUSH_LOCAL_VAR,       0x10021002, 1, "pushl"        ) \
+	X(PUSH_STATIC,          0x10021004, 1, "pushs"        ) \
+	X(CREATE_LOCAL_VAR,     0x10022000, 0, "clv"          ) \
+	X(POP_LOCAL_VAR,        0x10023002, 1, "popl"         ) \
+	X(POP_STATIC,           0x10023004, 1, "pops"         ) \
+	X(POP_STACK,            0x10024000, 0, "pop-stack"    ) /* Not sure what this is supposed to do */ \
+	/* Arithmetic operations */ \
+	X(ADD,                  0x10031000, 0, "add"          ) \
+	X(SUB,                  0x10032000, 0, "sub"          ) \
+	X(MUL,                  0x10033000, 0, "mul"          ) \
+	X(DIV,                  0x10034000, 0, "div"          ) \
+	X(MOD,                  0x10034001, 0, "mod"          ) /* spring specific */ \
+	X(BITWISE_AND,          0x10035000, 0, "and"          ) \
+	X(BITWISE_OR,           0x10036000, 0, "or"           ) \
+	X(BITWISE_XOR,          0x10037000, 0, "xor"          ) \
+	X(BITWISE_NOT,          0x10038000, 0, "not"          ) \
+	/* Native function calls */ \
+	X(RAND,                 0x10041000, 0, "rand"         ) \
+	X(GET_UNIT_VALUE,       0x10042000, 0, "getuv"        ) \
+	X(GET,                  0x10043000, 0, "get"          ) \
+	/* Comparison */ \
+	X(SET_LESS,             0x10051000, 0, "setl"         ) \
+	X(SET_LESS_OR_EQUAL,    0x10052000, 0, "setle"        ) \
+	X(SET_GREATER,          0x10053000, 0, "setg"         ) \
+	X(SET_GREATER_OR_EQUAL, 0x10054000, 0, "setge"        ) \
+	X(SET_EQUAL,            0x10055000, 0, "sete"         ) \
+	X(SET_NOT_EQUAL,        0x10056000, 0, "setne"        ) \
+	X(LOGICAL_AND,          0x10057000, 0, "land"         ) \
+	X(LOGICAL_OR,           0x10058000, 0, "lor"          ) \
+	X(LOGICAL_XOR,          0x10059000, 0, "lxor"         ) \
+	X(LOGICAL_NOT,          0x1005A000, 0, "neg"          ) \
+	/* Flow control */ \
+	X(START,                0x10061000, 2, "start"        ) \
+	X(CALL,                 0x10062000, 2, "call"         ) /* resolved to REAL_CALL or LUA_CALL when decoded */ \
+	X(REAL_CALL,            0x10062001, 2, "call"         ) /* spring custom */ \
+	X(LUA_CALL,             0x10062002, 2, "lua_call"     ) /* spring custom */ \
+	X(JUMP,                 0x10064000, 1, "jmp"          ) \
+	X(RETURN,               0x10065000, 0, "return"       ) \
+	X(JUMP_NOT_EQUAL,       0x10066000, 1, "jne"          ) \
+	X(SIGNAL,               0x10067000, 0, "signal"       ) \
+	X(SET_SIGNAL_MASK,      0x10068000, 0, "mask"         ) \
+	/* Piece destruction */ \
+	X(EXPLODE,              0x10071000, 1, "explode"      ) \
+	X(PLAY_SOUND,           0x10072000, 1, "play-sound"   ) \
+	/* Special functions */ \
+	X(SET,                  0x10082000, 0, "set"          ) \
+	X(ATTACH,               0x10083000, 0, "attach"       ) \
+	X(DROP,                 0x10084000, 0, "drop"         )
+
+
+namespace cob {
+	enum Opcode {
+		#define COB_OPCODE_ENUM(name, value, numArgs, mnemonic) OP_##name,
+		COB_OPCODE_LIST(COB_OPCODE_ENUM)
+		#undef COB_OPCODE_ENUM
+		OP_UNKNOWN,
+		OP_COUNT
+	};
+
+	/**
+	 * A COB instruction with its operands fetched from the raw code stream.
+	 * Decoded instructions are stored at the raw offset of their opcode so
+	 * that PC values (and therefore savegames and error messages) keep the
+	 * meaning they have for the raw code.
+	 */
+	struct Instruction {
+		int op;   ///< cob::Opcode
+		int arg0; ///< first inline operand, 0 if none
+		int arg1; ///< second inline operand, 0 if none
+		int next; ///< raw offset of the following instruction
+	};
+
+	/// returns OP_UNKNOWN for opcodes not in COB_OPCODE_LIST
+	Opcode GetOpcode(int rawOpcode);
+	int GetNumOperands(Opcode op);
+	const char* GetOpcodeName(Opcode op);
+
+	/**
+	 * Decodes an instruction at every offset of code[0, numInts), jumps into
+	 * the middle of an instruction thereby behave exactly as they do when
+	 * interpreting the raw stream. CALLs are resolved to REAL_CALL or LUA_CALL
+	 * based on the callee's name, calls to unknown scripts become OP_UNKNOWN.
+	 */
+	void DecodeCode(
+		const int* code,
+		int numInts,
+		const std::vector<std::string>& scriptNames,
+		std::vector<Instruction>& instructions
+	);
+}
+
+#endif // COB_OPCODES_H
@@ -5,6 +5,7 @@
 #include "CobFile.h"
 #include "CobInstance.h"
 #include "CobEngine.h"
+#include "CobOpcodes.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/GlobalSynced.h"
 
@@ -14,6 +15,7 @@ CR_BIND(CCobThread, )
 
 CR_REG_METADATA(CCobThread, (
 	CR_MEMBER(owner),
+	CR_MEMBER(id),
 	CR_MEMBER(wakeTime),
 	CR_MEMBER(PC),
 	CR_MEMBER(paramCount),
@@ -37,13 +39,10 @@ CR_REG_METADATA_SUB(CCobThread, CallInfo,(
 		CR_MEMBER(stackTop)
 ))
 
-//creg only
+//creg and thread-pool only
 CCobThread::CCobThread()
-{ }
-
-
-CCobThread::CCobThread(CCobInstance* owner)
-	: owner(owner)
+	: owner(nullptr)
+	, id(-1)
 	, wakeTime(0)
 	, PC(0)
 	, paramCount(0)
@@ -52,24 +51,52 @@ CCobThread::CCobThread(CCobInstance* owner)
 	, cbParam(0)
 	, waitAxis(-1)
 	, waitPiece(-1)
-	, state(Init)
+	, state(Dead)
 	, signalMask(0)
 {
 	memset(&luaArgs[0], 0, MAX_LUA_COB_ARGS * sizeof(luaArgs[0]));
-	owner->threads.push_back(this);
 }
 
-CCobThread::~CCobThread()
+
+void CCobThread::Reset(CCobInstance* _owner, int _id)
+{
+	owner = _owner;
+
+	id = _id;
+	wakeTime = 0;
+	PC = 0;
+	paramCount = 0;
+	retCode = -1;
+	cbType = CCobInstance::CBNone;
+	cbParam = 0;
+	waitAxis = -1;
+	waitPiece = -1;
+	state = Init;
+	signalMask = 0;
+
+	memset(&luaArgs[0], 0, MAX_LUA_COB_ARGS * sizeof(luaArgs[0]));
+
+	// clear() keeps the capacity of a recycled thread's stacks
+	stack.clear();
+	callStack.clear();
+
+	owner->threadIDs.push_back(id);
+}
+
+void CCobThread::Release()
 {
 	if (owner != nullptr) {
 		if (cbType != CCobInstance::CBNone) {
 			//LOG_L(L_DEBUG, "%s callback with %d", script.scriptNames[callStack.back().functionId].c_str(), retCode);
 			owner->ThreadCallback(cbType, retCode, cbParam);
 		}
-		auto it = std::find(owner->threads.begin(), owner->threads.end(), this);
-		assert(it != owner->threads.end());
-		owner->threads.erase(it);
+		auto it = std::find(owner->threadIDs.begin(), owner->threadIDs.end(), id);
+		assert(it != owner->threadIDs.end());
+		owner->threadIDs.erase(it);
 	}
+
+	owner = nullptr;
+	state = Dead;
 }
 
 void CCobThread::SetCallback(CCobInstance::ThreadCallbackType cb, int cbp)
@@ -79,6 +106,14 @@ void CCobThread::SetCallback(CCobInstance::ThreadCallbackType cb, int cbp)
 }
 
 void CCobThread::Start(int functionId, const vector<int>& args, bool schedule)
+{
+	// copy arguments
+	stack = args;
+
+	Start(functionId, schedule);
+}
+
+void CCobThread::Start(int functionId, bool schedule)
 {
 	state = Run;
 	PC = owner->script->scriptOffsets[functionId];
@@ -89,10 +124,7 @@ void CCobThread::Start(int functionId, const vector<int>& args, bool schedule)
 	ci.stackTop   = 0;
 
 	callStack.push_back(ci);
-	paramCount = args.size();
-
-	// copy arguments
-	stack = args;
+	paramCount = stack.size();
 
 	// Add to scheduler
 	if (schedule)
@@ -130,86 +162,6 @@ int CCobThread::GetWakeTime() const
 	return wakeTime;
 }
 
-// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
-// And some information from basm0.8 source (basm ops.txt)
-
-// Model interaction
-const int MOVE       = 0x10001000;
-const int TURN       = 0x10002000;
-const int SPIN       = 0x10003000;
-const int STOP_SPIN  = 0x10004000;
-const int SHOW       = 0x10005000;
-const int HIDE       = 0x10006000;
-const int CACHE      = 0x10007000;
-const int DONT_CACHE = 0x10008000;
-const int MOVE_NOW   = 0x1000B000;
-const int TURN_NOW   = 0x1000C000;
-const int SHADE      = 0x1000D000;
-const int DONT_SHADE = 0x1000E000;
-const int EMIT_SFX   = 0x1000F000;
-
-// Blocking operations
-const int WAIT_TURN  = 0x10011000;
-const int WAIT_MOVE  = 0x10012000;
-const int SLEEP      = 0x10013000;
-
-// Stack manipulation
-const int PUSH_CONSTANT    = 0x10021001;
-const int PUSH_LOCAL_VAR   = 0x10021002;
-const int PUSH_STATIC      = 0x10021004;
-const int CREATE_LOCAL_VAR = 0x10022000;
-const int POP_LOCAL_VAR    = 0x10023002;
-const int POP_STATIC       = 0x10023004;
-const int POP_STACK        = 0x10024000; ///< Not sure what this is supposed to do
-
-// Arithmetic operations
-const int ADD         = 0x10031000;
-const int SUB         = 0x10032000;
-const int MUL         = 0x10033000;
-const int DIV         = 0x10034000;
-const int MOD		  = 0x10034001; ///< spring specific
-const int BITWISE_AND = 0x10035000;
-const int BITWISE_OR  = 0x10036000;
-const int BITWISE_XOR = 0x10037000;
-const int BITWISE_NOT = 0x10038000;
-
-// Native function calls
-const int RAND           = 0x10041000;
-const int GET_UNIT_VALUE = 0x10042000;
-const int GET            = 0x10043000;
-
-// Comparison
-const int SET_LESS             = 0x10051000;
-const int SET_LESS_OR_EQUAL    = 0x10052000;
-const int SET_GREATER          = 0x10053000;
-const int SET_GREATER_OR_EQUAL = 0x10054000;
-const int SET_EQUAL            = 0x10055000;
-const int SET_NOT_EQUAL        = 0x10056000;
-const int LOGICAL_AND          = 0x10057000;
-const int LOGICAL_OR           = 0x10058000;
-const int LOGICAL_XOR          = 0x10059000;
-const int LOGICAL_NOT          = 0x1005A000;
-
-// Flow control
-const int START           = 0x10061000;
-const int CALL            = 0x10062000; ///< converted when executed
-const int REAL_CALL       = 0x10062001; ///< spring custom
-const int LUA_CALL        = 0x10062002; ///< spring custom
-const int JUMP            = 0x10064000;
-const int RETURN          = 0x10065000;
-const int JUMP_NOT_EQUAL  = 0x10066000;
-const int SIGNAL          = 0x10067000;
-const int SET_SIGNAL_MASK = 0x10068000;
-
-// Piece destruction
-const int EXPLODE    = 0x10071000;
-const int PLAY_SOUND = 0x10072000;
-
-// Special functions
-const int SET    = 0x10082000;
-const int ATTACH = 0x10083000;
-const int DROP   = 0x10084000;
-
 // Indices for SET, GET, and GET_UNIT_VALUE for LUA return values
 #define LUA0 110 // (LUA0 returns the lua call status, 0 or 1)
 #define LUA1 111
@@ -223,9 +175,19 @@ const int DROP   = 0x10084000;
 #define LUA9 119
 
 
-// Handy macros
-#define GET_LONG_PC() (owner->script->code[PC++])
-// #define POP() (stack.size() > 0) ? stack.back(), stack.pop_back(); : 0
+// computed-goto dispatch needs the GCC "labels as values" extension
+#if defined(__GNUC__) && !defined(COB_SWITCH_DISPATCH)
+	#define COB_COMPUTED_GOTO
+#endif
+
+#ifdef COB_COMPUTED_GOTO
+	#define COB_OP(name) op_##name
+	#define COB_NEXT() goto op_next
+#else
+	#define COB_OP(name) case cob::OP_##name
+	#define COB_NEXT() break
+#endif
+
 
 int CCobThread::POP()
 {
@@ -251,50 +213,63 @@ bool CCobThread::Tick()
 
 	int r1, r2, r3, r4, r5, r6;
 
-	vector<int> args;
-	vector<int>::iterator ei;
-
-	//execTrace.clear();
+	// operands were fetched and CALLs resolved when the script was loaded
+	const cob::Instruction* code = &owner->script->instructions[0];
+	const cob::Instruction* insn = nullptr;
 
 	//LOG_L(L_DEBUG, "Executing in %s (from %s)", script.scriptNames[callStack.back().functionId].c_str(), GetName().c_str());
 
-	while (state == Run) {
-		//int opcode = *(int*)&script.code[PC];
+#ifdef COB_COMPUTED_GOTO
+	static const void* dispatchTable[cob::OP_COUNT] = {
+		#define COB_OPCODE_LABEL(name, value, numArgs, mnemonic) &&op_##name,
+		COB_OPCODE_LIST(COB_OPCODE_LABEL)
+		#undef COB_OPCODE_LABEL
+		&&op_UNKNOWN,
+	};
 
-		// Disabling exec trace gives about a 50% speedup on vm-intensive code
-		//execTrace.push_back(PC);
+op_next:
+	if (state != Run)
+		return (state != Dead); // can arrive here as dead, through CCobInstance::Signal()
 
-		int opcode = GET_LONG_PC();
+	insn = &code[PC];
+	// PC points past the operands while executing, just as with the raw code
+	PC = insn->next;
 
-		//LOG_L(L_DEBUG, "PC: %x opcode: %x (%s)", PC - 1, opcode, GetOpcodeName(opcode).c_str());
+	//LOG_L(L_DEBUG, "PC: %x opcode: %x (%s)", PC - 1, insn->op, cob::GetOpcodeName(cob::Opcode(insn->op)));
 
-		switch(opcode) {
-			case PUSH_CONSTANT:
-				r1 = GET_LONG_PC();
-				stack.push_back(r1);
-				break;
-			case SLEEP:
+	goto *dispatchTable[insn->op];
+	{
+#else
+	while (state == Run) {
+		insn = &code[PC];
+		// PC points past the operands while executing, just as with the raw code
+		PC = insn->next;
+
+		//LOG_L(L_DEBUG, "PC: %x opcode: %x (%s)", PC - 1, insn->op, cob::GetOpcodeName(cob::Opcode(insn->op)));
+
+		switch (insn->op) {
+#endif
+			COB_OP(PUSH_CONSTANT):
+				stack.push_back(insn->arg0);
+				COB_NEXT();
+			COB_OP(SLEEP):
 				r1 = POP();
 				wakeTime = cobEngine->GetCurrentTime() + r1;
 				state = Sleep;
 				cobEngine->AddThread(this);
 				//LOG_L(L_DEBUG, "%s sleeping for %d ms", script.scriptNames[callStack.back().functionId].c_str(), r1);
 				return true;
-			case SPIN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+			COB_OP(SPIN):
 				r3 = POP();         // speed
 				r4 = POP();         // accel
-				owner->Spin(r1, r2, r3, r4);
-				break;
-			case STOP_SPIN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				owner->Spin(insn->arg0, insn->arg1, r3, r4);
+				COB_NEXT();
+			COB_OP(STOP_SPIN):
 				r3 = POP();         // decel
-				//LOG_L(L_DEBUG, "Stop spin of %s around %d", script.pieceNames[r1].c_str(), r2);
-				owner->StopSpin(r1, r2, r3);
-				break;
-			case RETURN:
+				//LOG_L(L_DEBUG, "Stop spin of %s around %d", script.pieceNames[insn->arg0].c_str(), insn->arg1);
+				owner->StopSpin(insn->arg0, insn->arg1, r3);
+				COB_NEXT();
+			COB_OP(RETURN):
 				retCode = POP();
 				if (callStack.back().returnAddr == -1) {
 					//LOG_L(L_DEBUG, "%s returned %d", script.scriptNames[callStack.back().functionId].c_str(), retCode);
@@ -310,39 +285,19 @@ bool CCobThread::Tick()
 				}
 				callStack.pop_back();
 				//LOG_L(L_DEBUG, "Returning to %s", owner->script->scriptNames[callStack.back().functionId].c_str());
-				break;
-			case SHADE:
-				r1 = GET_LONG_PC();
-				break;
-			case DONT_SHADE:
-				r1 = GET_LONG_PC();
-				break;
-			case CACHE:
-				r1 = GET_LONG_PC();
-				break;
-			case DONT_CACHE:
-				r1 = GET_LONG_PC();
-				break;
-			case CALL: {
-				r1 = GET_LONG_PC();
-				PC--;
-				const string& name = owner->script->scriptNames[r1];
-				if (name.find("lua_") == 0) {
-					owner->script->code[PC - 1] = LUA_CALL;
-					LuaCall();
-					break;
-				}
-				owner->script->code[PC - 1] = REAL_CALL;
-
-				// fall through //
-			}
-			case REAL_CALL:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(SHADE):
+			COB_OP(DONT_SHADE):
+			COB_OP(CACHE):
+			COB_OP(DONT_CACHE):
+				COB_NEXT();
+			COB_OP(REAL_CALL): {
+				r1 = insn->arg0;
+				r2 = insn->arg1;
 
 				if (owner->script->scriptLengths[r1] == 0) {
 					//LOG_L(L_DEBUG, "Preventing call to zero-len script %s", owner->script->scriptNames[r1].c_str());
-					break;
+					COB_NEXT();
 				}
 
 				CallInfo ci;
@@ -354,196 +309,169 @@ bool CCobThread::Tick()
 
 				PC = owner->script->scriptOffsets[r1];
 				//LOG_L(L_DEBUG, "Calling %s", owner->script->scriptNames[r1].c_str());
-				break;
-			case LUA_CALL:
-				LuaCall();
-				break;
-			case POP_STATIC:
-				r1 = GET_LONG_PC();
+				COB_NEXT();
+			}
+			COB_OP(LUA_CALL):
+				LuaCall(insn->arg0, insn->arg1);
+				COB_NEXT();
+			COB_OP(POP_STATIC):
 				r2 = POP();
-				owner->staticVars[r1] = r2;
-				//LOG_L(L_DEBUG, "Pop static var %d val %d", r1, r2);
-				break;
-			case POP_STACK:
+				owner->staticVars[insn->arg0] = r2;
+				//LOG_L(L_DEBUG, "Pop static var %d val %d", insn->arg0, r2);
+				COB_NEXT();
+			COB_OP(POP_STACK):
 				POP();
-				break;
-			case START: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(START): {
+				r1 = insn->arg0;
+				r2 = insn->arg1;
 
 				if (owner->script->scriptLengths[r1] == 0) {
 					//LOG_L(L_DEBUG, "Preventing start of zero-len script %s", owner->script->scriptNames[r1].c_str());
-					break;
+					COB_NEXT();
 				}
 
-				args.clear();
-				args.reserve(r2);
+				CCobThread* thread = cobEngine->AllocThread(owner);
+
+				// pop arguments straight onto the new thread's (recycled) stack
 				for (r3 = 0; r3 < r2; ++r3) {
 					r4 = POP();
-					args.push_back(r4);
+					thread->stack.push_back(r4);
 				}
 
-				CCobThread* thread = new CCobThread(owner);
-				thread->Start(r1, args, true);
+				thread->Start(r1, true);
 
 				// Seems that threads should inherit signal mask from creator
 				thread->signalMask = signalMask;
 				//LOG_L(L_DEBUG, "Starting %s %d", owner->script->scriptNames[r1].c_str(), signalMask);
-			} break;
-			case CREATE_LOCAL_VAR:
+				COB_NEXT();
+			}
+			COB_OP(CREATE_LOCAL_VAR):
 				if (paramCount == 0) {
 					stack.push_back(0);
 				} else {
 					paramCount--;
 				}
-				break;
-			case GET_UNIT_VALUE:
+				COB_NEXT();
+			COB_OP(GET_UNIT_VALUE):
 				r1 = POP();
 				if ((r1 >= LUA0) && (r1 <= LUA9)) {
 					stack.push_back(luaArgs[r1 - LUA0]);
-					break;
+					COB_NEXT();
 				}
 				r1 = owner->GetUnitVal(r1, 0, 0, 0, 0);
 				stack.push_back(r1);
-				break;
-			case JUMP_NOT_EQUAL:
-				r1 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(JUMP_NOT_EQUAL):
 				r2 = POP();
 				if (r2 == 0) {
-					PC = r1;
+					PC = insn->arg0;
 				}
-				break;
-			case JUMP:
-				r1 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(JUMP):
 				// this seem to be an error in the docs..
-				//r2 = owner->script->scriptOffsets[callStack.back().functionId] + r1;
-				PC = r1;
-				break;
-			case POP_LOCAL_VAR:
-				r1 = GET_LONG_PC();
+				//r2 = owner->script->scriptOffsets[callStack.back().functionId] + insn->arg0;
+				PC = insn->arg0;
+				COB_NEXT();
+			COB_OP(POP_LOCAL_VAR):
 				r2 = POP();
-				stack[callStack.back().stackTop + r1] = r2;
-				break;
-			case PUSH_LOCAL_VAR:
-				r1 = GET_LONG_PC();
-				r2 = stack[callStack.back().stackTop + r1];
+				stack[callStack.back().stackTop + insn->arg0] = r2;
+				COB_NEXT();
+			COB_OP(PUSH_LOCAL_VAR):
+				r2 = stack[callStack.back().stackTop + insn->arg0];
 				stack.push_back(r2);
-				break;
-			case SET_LESS_OR_EQUAL:
+				COB_NEXT();
+			COB_OP(SET_LESS_OR_EQUAL):
 				r2 = POP();
 				r1 = POP();
-				if (r1 <= r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case BITWISE_AND:
+				stack.push_back(int(r1 <= r2));
+				COB_NEXT();
+			COB_OP(BITWISE_AND):
 				r1 = POP();
 				r2 = POP();
 				stack.push_back(r1 & r2);
-				break;
-			case BITWISE_OR: // seems to want stack contents or'd, result places on stack
+				COB_NEXT();
+			COB_OP(BITWISE_OR): // seems to want stack contents or'd, result places on stack
 				r1 = POP();
 				r2 = POP();
 				stack.push_back(r1 | r2);
-				break;
-			case BITWISE_XOR:
+				COB_NEXT();
+			COB_OP(BITWISE_XOR):
 				r1 = POP();
 				r2 = POP();
 				stack.push_back(r1 ^ r2);
-				break;
-			case BITWISE_NOT:
+				COB_NEXT();
+			COB_OP(BITWISE_NOT):
 				r1 = POP();
 				stack.push_back(~r1);
-				break;
-			case EXPLODE:
-				r1 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(EXPLODE):
 				r2 = POP();
-				owner->Explode(r1, r2);
-				break;
-			case PLAY_SOUND:
-				r1 = GET_LONG_PC();
+				owner->Explode(insn->arg0, r2);
+				COB_NEXT();
+			COB_OP(PLAY_SOUND):
 				r2 = POP();
-				owner->PlayUnitSound(r1, r2);
-				break;
-			case PUSH_STATIC:
-				r1 = GET_LONG_PC();
-				stack.push_back(owner->staticVars[r1]);
-				//LOG_L(L_DEBUG, "Push static %d val %d", r1, owner->staticVars[r1]);
-				break;
-			case SET_NOT_EQUAL:
+				owner->PlayUnitSound(insn->arg0, r2);
+				COB_NEXT();
+			COB_OP(PUSH_STATIC):
+				stack.push_back(owner->staticVars[insn->arg0]);
+				//LOG_L(L_DEBUG, "Push static %d val %d", insn->arg0, owner->staticVars[insn->arg0]);
+				COB_NEXT();
+			COB_OP(SET_NOT_EQUAL):
 				r1 = POP();
 				r2 = POP();
-				if (r1 != r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_EQUAL:
+				stack.push_back(int(r1 != r2));
+				COB_NEXT();
+			COB_OP(SET_EQUAL):
 				r1 = POP();
 				r2 = POP();
-				if (r1 == r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_LESS:
+				stack.push_back(int(r1 == r2));
+				COB_NEXT();
+			COB_OP(SET_LESS):
 				r2 = POP();
 				r1 = POP();
-				if (r1 < r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_GREATER:
+				stack.push_back(int(r1 < r2));
+				COB_NEXT();
+			COB_OP(SET_GREATER):
 				r2 = POP();
 				r1 = POP();
-				if (r1 > r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_GREATER_OR_EQUAL:
+				stack.push_back(int(r1 > r2));
+				COB_NEXT();
+			COB_OP(SET_GREATER_OR_EQUAL):
 				r2 = POP();
 				r1 = POP();
-				if (r1 >= r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case RAND:
+				stack.push_back(int(r1 >= r2));
+				COB_NEXT();
+			COB_OP(RAND):
 				r2 = POP();
 				r1 = POP();
 				r3 = gsRNG.NextInt() % (r2 - r1 + 1) + r1;
 				stack.push_back(r3);
-				break;
-			case EMIT_SFX:
+				COB_NEXT();
+			COB_OP(EMIT_SFX):
 				r1 = POP();
-				r2 = GET_LONG_PC();
-				owner->EmitSfx(r1, r2);
-				break;
-			case MUL:
+				owner->EmitSfx(r1, insn->arg0);
+				COB_NEXT();
+			COB_OP(MUL):
 				r1 = POP();
 				r2 = POP();
 				stack.push_back(r1 * r2);
-				break;
-			case SIGNAL:
+				COB_NEXT();
+			COB_OP(SIGNAL):
 				r1 = POP();
 				owner->Signal(r1);
-				break;
-			case SET_SIGNAL_MASK:
+				COB_NEXT();
+			COB_OP(SET_SIGNAL_MASK):
 				r1 = POP();
 				signalMask = r1;
-				break;
-			case TURN:
+				COB_NEXT();
+			COB_OP(TURN):
 				r2 = POP();
 				r1 = POP();
-				r3 = GET_LONG_PC();
-				r4 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Turning piece %s axis %d to %d speed %d", owner->script->pieceNames[r3].c_str(), r4, r2, r1);
-				owner->Turn(r3, r4, r1, r2);
-				break;
-			case GET:
+				//LOG_L(L_DEBUG, "Turning piece %s axis %d to %d speed %d", owner->script->pieceNames[insn->arg0].c_str(), insn->arg1, r2, r1);
+				owner->Turn(insn->arg0, insn->arg1, r1, r2);
+				COB_NEXT();
+			COB_OP(GET):
 				r5 = POP();
 				r4 = POP();
 				r3 = POP();
@@ -551,23 +479,23 @@ bool CCobThread::Tick()
 				r1 = POP();
 				if ((r1 >= LUA0) && (r1 <= LUA9)) {
 					stack.push_back(luaArgs[r1 - LUA0]);
-					break;
+					COB_NEXT();
 				}
 				r6 = owner->GetUnitVal(r1, r2, r3, r4, r5);
 				stack.push_back(r6);
-				break;
-			case ADD:
+				COB_NEXT();
+			COB_OP(ADD):
 				r2 = POP();
 				r1 = POP();
 				stack.push_back(r1 + r2);
-				break;
-			case SUB:
+				COB_NEXT();
+			COB_OP(SUB):
 				r2 = POP();
 				r1 = POP();
 				r3 = r1 - r2;
 				stack.push_back(r3);
-				break;
-			case DIV:
+				COB_NEXT();
+			COB_OP(DIV):
 				r2 = POP();
 				r1 = POP();
 				if (r2 != 0)
@@ -577,8 +505,8 @@ bool CCobThread::Tick()
 					ShowError("division by zero");
 				}
 				stack.push_back(r3);
-				break;
-			case MOD:
+				COB_NEXT();
+			COB_OP(MOD):
 				r2 = POP();
 				r1 = POP();
 				if (r2 != 0)
@@ -587,140 +515,116 @@ bool CCobThread::Tick()
 					stack.push_back(0);
 					ShowError("modulo division by zero");
 				}
-				break;
-			case MOVE:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				COB_NEXT();
+			COB_OP(MOVE):
 				r4 = POP();
 				r3 = POP();
-				owner->Move(r1, r2, r3, r4);
-				break;
-			case MOVE_NOW:{
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				owner->Move(insn->arg0, insn->arg1, r3, r4);
+				COB_NEXT();
+			COB_OP(MOVE_NOW):
 				r3 = POP();
-				owner->MoveNow(r1, r2, r3);
-				break;}
-			case TURN_NOW:{
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
+				owner->MoveNow(insn->arg0, insn->arg1, r3);
+				COB_NEXT();
+			COB_OP(TURN_NOW):
 				r3 = POP();
-				owner->TurnNow(r1, r2, r3);
-				break;}
-			case WAIT_TURN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Waiting for turn on piece %s around axis %d", owner->script->pieceNames[r1].c_str(), r2);
-				if (owner->NeedsWait(CCobInstance::ATurn, r1, r2)) {
+				owner->TurnNow(insn->arg0, insn->arg1, r3);
+				COB_NEXT();
+			COB_OP(WAIT_TURN):
+				//LOG_L(L_DEBUG, "Waiting for turn on piece %s around axis %d", owner->script->pieceNames[insn->arg0].c_str(), insn->arg1);
+				if (owner->NeedsWait(CCobInstance::ATurn, insn->arg0, insn->arg1)) {
 					state = WaitTurn;
-					waitPiece = r1;
-					waitAxis = r2;
+					waitPiece = insn->arg0;
+					waitAxis = insn->arg1;
 					return true;
 				}
-				else
-					break;
-			case WAIT_MOVE:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Waiting for move on piece %s on axis %d", owner->script->pieceNames[r1].c_str(), r2);
-				if (owner->NeedsWait(CCobInstance::AMove, r1, r2)) {
+				COB_NEXT();
+			COB_OP(WAIT_MOVE):
+				//LOG_L(L_DEBUG, "Waiting for move on piece %s on axis %d", owner->script->pieceNames[insn->arg0].c_str(), insn->arg1);
+				if (owner->NeedsWait(CCobInstance::AMove, insn->arg0, insn->arg1)) {
 					state = WaitMove;
-					waitPiece = r1;
-					waitAxis = r2;
+					waitPiece = insn->arg0;
+					waitAxis = insn->arg1;
 					return true;
 				}
-				break;
-			case SET:
+				COB_NEXT();
+			COB_OP(SET):
 				r2 = POP();
 				r1 = POP();
 				//LOG_L(L_DEBUG, "Setting unit value %d to %d", r1, r2);
 				if ((r1 >= LUA0) && (r1 <= LUA9)) {
 					luaArgs[r1 - LUA0] = r2;
-					break;
+					COB_NEXT();
 				}
 				owner->SetUnitVal(r1, r2);
-				break;
-			case ATTACH:
+				COB_NEXT();
+			COB_OP(ATTACH):
 				r3 = POP();
 				r2 = POP();
 				r1 = POP();
 				owner->AttachUnit(r2, r1);
-				break;
-			case DROP:
+				COB_NEXT();
+			COB_OP(DROP):
 				r1 = POP();
 				owner->DropUnit(r1);
-				break;
-			case LOGICAL_NOT: // Like bitwise, but only on values 1 and 0.
+				COB_NEXT();
+			COB_OP(LOGICAL_NOT): // Like bitwise, but only on values 1 and 0.
 				r1 = POP();
-				if (r1 == 0)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_AND:
+				stack.push_back(int(r1 == 0));
+				COB_NEXT();
+			COB_OP(LOGICAL_AND):
 				r1 = POP();
 				r2 = POP();
-				if (r1 && r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_OR:
+				stack.push_back(int(r1 && r2));
+				COB_NEXT();
+			COB_OP(LOGICAL_OR):
 				r1 = POP();
 				r2 = POP();
-				if (r1 || r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_XOR:
+				stack.push_back(int(r1 || r2));
+				COB_NEXT();
+			COB_OP(LOGICAL_XOR):
 				r1 = POP();
 				r2 = POP();
-				if ( (!!r1) ^ (!!r2))
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case HIDE:
-				r1 = GET_LONG_PC();
-				owner->SetVisibility(r1, false);
-				//LOG_L(L_DEBUG, "Hiding %d", r1);
-				break;
-			case SHOW:{
-				r1 = GET_LONG_PC();
-				int i;
-				for (i = 0; i < MAX_WEAPONS_PER_UNIT; ++i)
-					if (callStack.back().functionId == owner->script->scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i])
-						break;
-
+				stack.push_back(int((!!r1) ^ (!!r2)));
+				COB_NEXT();
+			COB_OP(HIDE):
+				owner->SetVisibility(insn->arg0, false);
+				//LOG_L(L_DEBUG, "Hiding %d", insn->arg0);
+				COB_NEXT();
+			COB_OP(SHOW):
 				// If true, we are in a Fire-script and should show a special flare effect
-				if (i < MAX_WEAPONS_PER_UNIT) {
-					owner->ShowFlare(r1);
-				}
-				else {
-					owner->SetVisibility(r1, true);
+				if (owner->script->IsFireScript(callStack.back().functionId)) {
+					owner->ShowFlare(insn->arg0);
+				} else {
+					owner->SetVisibility(insn->arg0, true);
 				}
-				//LOG_L(L_DEBUG, "Showing %d", r1);
-				break;}
+				//LOG_L(L_DEBUG, "Showing %d", insn->arg0);
+				COB_NEXT();
+			COB_OP(CALL): // never emitted by the decoder
+			COB_OP(UNKNOWN):
+#ifndef COB_COMPUTED_GOTO
 			default:
+#endif
 				LOG_L(L_ERROR, "Unknown opcode %x (in %s:%s at %x)",
-						opcode, owner->script->name.c_str(),
+						owner->script->code[PC - 1], owner->script->name.c_str(),
 						owner->script->scriptNames[callStack.back().functionId].c_str(),
 						PC - 1);
 				LOG_L(L_ERROR, "Exec trace:");
-				// ei = execTrace.begin();
-				// while (ei != execTrace.end()) {
-					// LOG_L(L_ERROR, "PC: %3x  opcode: %s", *ei, GetOpcodeName(owner->script->code[*ei]).c_str());
-					// ++ei;
-				// }
 				state = Dead;
 				return false;
 		}
+#ifdef COB_COMPUTED_GOTO
+	// not reached, every opcode either jumps back to op_next or returns
+	return (state != Dead);
+#else
 	}
 
 	return (state != Dead); // can arrive here as dead, through CCobInstance::Signal()
+#endif
 }
 
+#undef COB_NEXT
+#undef COB_OP
+
 void CCobThread::ShowError(const string& msg)
 {
 	static int spamPrevention = 100;
@@ -736,87 +640,11 @@ void CCobThread::ShowError(const string& msg)
 	}
 }
 
-string CCobThread::GetOpcodeName(int opcode)
-{
-	switch (opcode) {
-		case MOVE: return "move";
-		case TURN: return "turn";
-		case SPIN: return "spin";
-		case STOP_SPIN: return "stop-spin";
-		case SHOW: return "show";
-		case HIDE: return "hide";
-		case CACHE: return "cache";
-		case DONT_CACHE: return "dont-cache";
-		case TURN_NOW: return "turn-now";
-		case MOVE_NOW: return "move-now";
-		case SHADE: return "shade";
-		case DONT_SHADE: return "dont-shade";
-		case EMIT_SFX: return "sfx";
-
-		case WAIT_TURN: return "wait-for-turn";
-		case WAIT_MOVE: return "wait-for-move";
-		case SLEEP: return "sleep";
-
-		case PUSH_CONSTANT: return "pushc";
-		case PUSH_LOCAL_VAR: return "pushl";
-		case PUSH_STATIC: return "pushs";
-		case CREATE_LOCAL_VAR: return "clv";
-		case POP_LOCAL_VAR: return "popl";
-		case POP_STATIC: return "pops";
-		case POP_STACK: return "pop-stack";
-
-		case ADD: return "add";
-		case SUB: return "sub";
-		case MUL: return "mul";
-		case DIV: return "div";
-		case MOD: return "mod";
-		case BITWISE_AND: return "and";
-		case BITWISE_OR: return "or";
-		case BITWISE_XOR: return "xor";
-		case BITWISE_NOT: return "not";
-
-		case RAND: return "rand";
-		case GET_UNIT_VALUE: return "getuv";
-		case GET: return "get";
-
-		case SET_LESS: return "setl";
-		case SET_LESS_OR_EQUAL: return "setle";
-		case SET_GREATER: return "setg";
-		case SET_GREATER_OR_EQUAL: return "setge";
-		case SET_EQUAL: return "sete";
-		case SET_NOT_EQUAL: return "setne";
-		case LOGICAL_AND: return "land";
-		case LOGICAL_OR: return "lor";
-		case LOGICAL_XOR: return "lxor";
-		case LOGICAL_NOT: return "neg";
-
-		case START: return "start";
-		case CALL: return "call";
-		case REAL_CALL: return "call";
-		case LUA_CALL: return "lua_call";
-		case JUMP: return "jmp";
-		case RETURN: return "return";
-		case JUMP_NOT_EQUAL: return "jne";
-		case SIGNAL: return "signal";
-		case SET_SIGNAL_MASK: return "mask";
-
-		case EXPLODE: return "explode";
-		case PLAY_SOUND: return "play-sound";
-
-		case SET: return "set";
-		case ATTACH: return "attach";
-		case DROP: return "drop";
-	}
-
-	return "unknown";
-}
-
 /******************************************************************************/
 
-void CCobThread::LuaCall()
+void CCobThread::LuaCall(int r1, int r2)
 {
-	const int r1 = GET_LONG_PC(); // script id
-	const int r2 = GET_LONG_PC(); // arg count
+	// r1 is the script id, r2 the arg count
 
 	// setup the parameter array
 	const int size = (int) stack.size();
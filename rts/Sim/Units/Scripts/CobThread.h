@@ -20,11 +20,17 @@ class CCobThread
 	CR_DECLARE_STRUCT(CCobThread)
 	CR_DECLARE_SUB(CallInfo)
 public:
-	//creg only
+	//creg and CCobEngine thread-pool only
 	CCobThread();
-	CCobThread(CCobInstance* owner);
+
+	/**
+	 * Prepares a pooled thread for a new call on behalf of owner.
+	 * Stacks keep the capacity of the previous call, so that recycled
+	 * threads do not allocate.
+	 */
+	void Reset(CCobInstance* owner, int id);
 	/// Inform the vultures that we finally croaked
-	~CCobThread();
+	void Release();
 
 	/**
 	 * Returns false if this thread is dead and needs to be killed.
@@ -36,6 +42,11 @@ public:
 	 * it is expected that the starter is responsible for ticking it.
 	 */
 	void Start(int functionId, const vector<int>& args, bool schedule);
+	/**
+	 * Same as above, but takes the arguments already pushed onto this
+	 * thread's stack (avoids copying through a temporary vector).
+	 */
+	void Start(int functionId, bool schedule);
 	/**
 	 * Sets a callback that will be called when the thread dies.
 	 * There can be only one.
@@ -60,16 +71,17 @@ public:
 	void ShowError(const std::string& msg);
 	void AnimFinished(CUnitScript::AnimType type, int piece, int axis);
 
+	int GetID() const { return id; }
 	int GetRetCode() const { return retCode; }
 	bool IsWaiting() const { return (waitAxis != -1); }
 
 	CCobInstance* owner;
 protected:
-	std::string GetOpcodeName(int opcode);
-	void LuaCall();
+	void LuaCall(int scriptID, int numArgs);
 
 	inline int POP();
 
+	int id;
 	int wakeTime;
 	int PC;
 	vector<int> stack;
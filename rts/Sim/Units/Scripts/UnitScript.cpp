@@ -51,7 +51,7 @@ CR_BIND_INTERFACE(CUnitScript)
 CR_REG_METADATA(CUnitScript, (
 	CR_MEMBER(unit),
 	CR_MEMBER(busy),
-	CR_MEMBER(anims),
+	CR_MEMBER(numAnims),
 
 	//Populated by children
 	CR_IGNORED(pieces),
@@ -60,436 +60,6 @@ CR_REG_METADATA(CUnitScript, (
 	CR_IGNORED(hasStartBuilding)
 ))
 
-CR_BIND(CUnitScript::AnimInfo,)
-
-CR_REG_METADATA_SUB(CUnitScript, AnimInfo,(
-		CR_MEMBER(axis),
-		CR_MEMBER(piece),
-		CR_MEMBER(speed),
-		CR_MEMBER(dest),
-		CR_MEMBER(accel),
-		CR_MEMBER(done),
-		CR_MEMBER(hasWaiting)
-))
-
-
-CUnitScript::CUnitScript(CUnit* unit)
-	: unit(unit)
-	, busy(false)
-	, hasSetSFXOccupy(false)
-	, hasRockUnit(false)
-	, hasStartBuilding(false)
-{ }
-
-
-CUnitScript::~CUnitScript()
-{
-	// Remove us from possible animation ticking
-	if (HaveAnimations())
-		unitScriptEngine->RemoveInstance(this);
-}
-
-
-/******************************************************************************/
-
-
-/**
- * @brief Updates move animations
- * @param cur float value to update
- * @param dest float final value
- * @param speed float max increment per tick
- * @return returns true if destination was reached, false otherwise
- */
-bool CUnitScript::MoveToward(float& cur, float dest, float speed)
-{
-	const float delta = dest - cur;
-
-	if (math::fabsf(delta) <= speed) {
-		cur = dest;
-		return true;
-	}
-
-	if (delta > 0.0f) {
-		cur += speed;
-	} else {
-		cur -= speed;
-	}
-
-	return false;
-}
-
-
-/**
- * @brief Updates turn animations
- * @param cur float value to update
- * @param dest float final value
- * @param speed float max increment per tick
- * @return returns true if destination was reached, false otherwise
- */
-bool CUnitScript::TurnToward(float& cur, float dest, float speed)
-{
-	float delta = dest - cur;
-
-	// clamp: -pi .. 0 .. +pi (remainder(x,TWOPI) would do the same but is slower due to streflop)
-	if (delta > math::PI) {
-		delta -= math::TWOPI;
-	} else if (delta <= -math::PI) {
-		delta += math::TWOPI;
-	}
-
-	if (math::fabsf(delta) <= speed) {
-		cur = dest;
-		return true;
-	}
-
-	if (delta > 0.0f) {
-		cur += speed;
-	} else {
-		cur -= speed;
-	}
-
-	ClampRad(&cur);
-
-	return false;
-}
-
-
-/**
- * @brief Updates spin animations
- * @param cur float value to update
- * @param dest float the final desired speed (NOT the final angle!)
- * @param speed float is updated if it is not equal to dest
- * @param divisor int is the deltatime, it is not added before the call because speed may have to be updated
- * @return true if the desired speed is 0 and it is reached, false otherwise
- */
-bool CUnitScript::DoSpin(float& cur, float dest, float &speed, float accel, int divisor)
-{
-	const float delta = dest - speed;
-
-	// Check if we are not at the final speed and
-	// make sure we dont go past desired speed
-	if (math::fabsf(delta) <= accel) {
-		speed = dest;
-		if (speed == 0.0f)
-			return true;
-	}
-	else {
-		if (delta > 0.0f) {
-			// accelerations are defined in speed/frame (at GAME_SPEED fps)
-			speed += accel * (float(GAME_SPEED) / divisor);
-		} else {
-			speed -= accel * (float(GAME_SPEED) / divisor);
-		}
-	}
-
-	cur += (speed / divisor);
-	ClampRad(&cur);
-
-	return false;
-}
-
-
-
-void CUnitScript::TickAnims(int deltaTime, AnimType type, std::vector<AnimInfo>& doneAnims) {
-	switch (type) {
-		case AMove: {
-			int i = 0;
-			while (i < anims[type].size()) {
-				AnimInfo& ai = anims[type][i];
-				const int piece = ai.piece;
-
-				// NOTE: we should not need to copy-and-set here, because
-				// MoveToward/TurnToward/DoSpin modify pos/rot by reference
-				float3 pos = pieces[piece]->GetPosition();
-
-				if (MoveToward(pos[ai.axis], ai.dest, ai.speed / (1000 / deltaTime))) {
-					ai.done = true;
-					if (ai.hasWaiting)
-						doneAnims.push_back(ai);
-
-					ai = anims[type].back();
-					anims[type].pop_back();
-				} else {
-					++i;
-				}
-
-				pieces[piece]->SetPosition(pos);
-			}
-		} break;
-
-		case ATurn: {
-			int i = 0;
-			while (i < anims[type].size()) {
-				AnimInfo& ai = anims[type][i];
-				const int piece = ai.piece;
-				float3 rot = pieces[piece]->GetRotation();
-
-				if (TurnToward(rot[ai.axis], ai.dest, ai.speed / (1000 / deltaTime))) {
-					ai.done = true;
-					if (ai.hasWaiting)
-						doneAnims.push_back(ai);
-
-					ai = anims[type].back();
-					anims[type].pop_back();
-				} else {
-					++i;
-				}
-
-				pieces[piece]->SetRotation(rot);
-			}
-		} break;
-
-		case ASpin: {
-			int i = 0;
-			while (i < anims[type].size()) {
-				AnimInfo& ai = anims[type][i];
-				const int piece = ai.piece;
-				float3 rot = pieces[piece]->GetRotation();
-
-				if (DoSpin(rot[ai.axis], ai.dest, ai.speed, ai.accel, 1000 / deltaTime)) {
-					ai.done = true;
-					if (ai.hasWaiting)
-						doneAnims.push_back(ai);
-
-					ai = anims[type].back();
-					anims[type].pop_back();
-				} else {
-					++i;
-				}
-
-				pieces[piece]->SetRotation(rot);
-			}
-		} break;
-
-		default: {
-		} break;
-	}
-}
-
-/**
- * @brief Called by the engine when we are registered as animating.
-          If we return false there are no active animations left.
- * @param deltaTime int delta time to update
- * @return true if there are still active animations
- */
-bool CUnitScript::Tick(int deltaTime)
-{
-	// vector of indexes of finished animations,
-	// so we can get rid of them in constant time
-	static std::vector<AnimInfo> doneAnims[AMove + 1];
-
-	for (int animType = ATurn; animType <= AMove; animType++) {
-		TickAnims(deltaTime, AnimType(animType), doneAnims[animType]);
-	}
-
-	// Tell listeners to unblock, and remove finished animations from the unit/script.
-	for (int animType = ATurn; animType <= AMove; animType++) {
-		for (AnimInfo& ai: doneAnims[animType]) {
-			AnimFinished((AnimType) animType, ai.piece, ai.axis);
-		}
-		doneAnims[animType].clear();
-	}
-
-	return (HaveAnimations());
-}
-
-
-
-CUnitScript::AnimContainerTypeIt CUnitScript::FindAnim(AnimType type, int piece, int axis)
-{
-	for (auto it = anims[type].begin(); it != anims[type].end(); ++it) {
-		if (((*it).piece == piece) && ((*it).axis == axis))
-			return it;
-	}
-
-	return anims[type].end();
-}
-
-void CUnitScript::RemoveAnim(AnimType type, const AnimContainerTypeIt& animInfoIt)
-{
-	if (animInfoIt == anims[type].end())
-		return;
-
-	AnimInfo& ai = *animInfoIt;
-
-	//! We need to unblock threads waiting on this animation, otherwise they will be lost in the void
-	//! NOTE: AnimFinished might result in new anims being added
-	if (ai.hasWaiting)
-		AnimFinished(type, ai.piece, ai.axis);
-
-	ai = anims[type].back();
-	anims[type].pop_back();
-
-	// If this was the last animation, remove from currently animating list
-	// FIXME: this could be done in a cleaner way
-	if (!HaveAnimations()) {
-		unitScriptEngine->RemoveInstance(this);
-	}
-}
-
-
-//Overwrites old information. This means that threads blocking on turn completion
-//will now wait for this new turn instead. Not sure if this is the expected behaviour
-//Other option would be to kill them. Or perhaps unblock them.
-void CUnitScript::AddAnim(AnimType type, int piece, int axis, float speed, float dest, float accel)
-{
-	if (!PieceExists(piece)) {
-		ShowUnitScriptError("Invalid piecenumber");
-		return;
-	}
-
-	float destf = 0.0f;
-
-	if (type == AMove) {
-		destf = pieces[piece]->original->offset[axis] + dest;
-	} else {
-		destf = dest;
-		if (type == ATurn) {
-			ClampRad(&destf);
-		}
-	}
-
-	AnimContainerTypeIt animInfoIt;
-	AnimInfo* ai = NULL;
-	AnimType overrideType = ANone;
-
-	// first find an animation of a type we override
-	// Turns override spins.. Not sure about the other way around? If so
-	// the system should probably be redesigned to only have two types of
-	// anims (turns and moves), with spin as a bool
-	switch (type) {
-		case ATurn: {
-			overrideType = ASpin;
-			animInfoIt = FindAnim(overrideType, piece, axis);
-		} break;
-		case ASpin: {
-			overrideType = ATurn;
-			animInfoIt = FindAnim(overrideType, piece, axis);
-		} break;
-		case AMove: {
-			// ensure we never remove an animation of this type
-			overrideType = AMove;
-			animInfoIt = anims[overrideType].end();
-		} break;
-		default: {
-		} break;
-	}
-	assert(overrideType >= 0);
-
-	if (animInfoIt != anims[overrideType].end())
-		RemoveAnim(overrideType, animInfoIt);
-
-	// now find an animation of our own type
-	animInfoIt = FindAnim(type, piece, axis);
-
-	if (animInfoIt == anims[type].end()) {
-		// If we were not animating before, inform the engine of this so it can schedule us
-		// FIXME: this could be done in a cleaner way
-		if (!HaveAnimations()) {
-			unitScriptEngine->AddInstance(this);
-		}
-
-		anims[type].emplace_back();
-		ai = &anims[type].back();
-		ai->piece = piece;
-		ai->axis = axis;
-	} else {
-		ai = &(*animInfoIt);
-	}
-
-	ai->dest  = destf;
-	ai->speed = speed;
-	ai->accel = accel;
-	ai->done = false;
-}
-
-
-void CUnitScript::Spin(int piece, int axis, float speed, float accel)
-{
-	auto animInfoIt = FindAnim(ASpin, piece, axis);
-
-	//If we are already spinning, we may have to decelerate to the new speed
-	if (animInfoIt != anims[ASpin].end()) {
-		AnimInfo* ai = &(*animInfoIt);
-		ai->dest = speed;
-
-		if (accel > 0) {
-			ai->accel = accel;
-		} else {
-			//Go there instantly. Or have a defaul accel?
-			ai->speed = speed;
-			ai->accel = 0;
-		}
-	} else {
-		//No accel means we start at desired speed instantly
-		if (accel <= 0)
-			AddAnim(ASpin, piece, axis, speed, speed, 0);
-		else
-			AddAnim(ASpin, piece, axis, 0, speed, accel);
-	}
-}
-
-
-void CUnitScript::StopSpin(int piece, int axis, float decel)
-{
-	auto animInfoIt = FindAnim(ASpin, piece, axis);
-
-	if (decel <= 0) {
-		RemoveAnim(ASpin, animInfoIt);
-	} else {
-		if (animInfoIt == anims[ASpin].end())
-			return;
-
-		AnimInfo* ai = &(*animInfoIt);
-		ai->dest = 0;
-		ai->accel = decel;
-	}
-}
-
-
-void CUnitScript::Turn(int piece, int axis, float speed, float destination)
-{
-	AddAnim(ATurn, piece, axis, std::max(speed, -speed), destination, 0);
-}
-
-
-void CUnitScript::Move(int piece, int axis, float speed, float destination)
-{
-	AddAnim(AMove, piece, axis, std::max(speed, -speed), destination, 0);
-}
-
-
-void CUnitScript::MoveNow(int piece, int axis, float destination)
-{
-	if (!PieceExists(piece)) {
-		ShowUnitScriptError("Invalid piecenumber");
-		return;
-	}
-
-	LocalModelPiece* p = pieces[piece];
-
-	float3 pos = p->GetPosition();
-	pos[axis] = pieces[piece]->original->offset[axis] + destination;
-
-	p->SetPosition(pos);
-}
-
-
-void CUnitScript::TurnNow(int piece, int axis, float destination)
-{
-	if (!PieceExists(piece)) {
-		ShowUnitScriptError("Invalid piecenumber");
-		return;
-	}
-
-	LocalModelPiece* p = pieces[piece];
-
-	float3 rot = p->GetRotation();
-	rot[axis] = destination;
-
-	p->SetRotation(rot);
-}
-
 
 void CUnitScript::SetVisibility(int piece, bool visible)
 {
@@ -702,36 +272,6 @@ void CUnitScript::DropUnit(int u)
 }
 
 
-//Returns true if there was an animation to listen to
-bool CUnitScript::NeedsWait(AnimType type, int piece, int axis)
-{
-	auto animInfoIt = FindAnim(type, piece, axis);
-
-	if (animInfoIt != anims[type].end()) {
-		AnimInfo* ai = &(*animInfoIt);
-
-		if (!ai->done) {
-			ai->hasWaiting = true;
-			return true;
-		}
-
-		// if the animation is already finished, listening for
-		// it just adds some overhead since either the current
-		// or the next Tick will remove it and call UnblockAll
-		// (which calls AnimFinished for each listener)
-		//
-		// we could notify the listener here, but a cleaner way
-		// is to treat the animation as if it did not exist and
-		// simply disregard the WaitFor* (no side-effects)
-		//
-		// if (ai->hasWaiting)
-		// 		AnimFinished(ai->type, ai->piece, ai->axis);
-	}
-
-	return false;
-}
-
-
 //Flags as defined by the cob standard
 void CUnitScript::Explode(int piece, int flags)
 {
@@ -1618,10 +1158,3 @@ int CUnitScript::ModelToScript(int lmodelPieceNum) const {
 
 	return (lmp->GetScriptPieceIndex());
 }
-
-void CUnitScript::ShowUnitScriptError(const std::string& error)
-{
-	ShowScriptError(unit ? error + std::string(" ") + IntToString(unit->id) + std::string(" of type ") + unit->unitDef->name
-						 : error + std::string(" -> Unit doesn't have a script!"));
-}
-
@@ -18,7 +18,9 @@ class CPlasmaRepulser;
 class CUnitScript
 {
 	CR_DECLARE(CUnitScript)
-	CR_DECLARE_SUB(AnimInfo)
+
+	friend class CUnitScriptEngine;
+
 public:
 	enum AnimType {ANone = -1, ATurn = 0, ASpin = 1, AMove = 2};
 
@@ -42,32 +44,19 @@ protected:
 	CUnit* unit;
 	bool busy;
 
-	struct AnimInfo {
-		CR_DECLARE_STRUCT(AnimInfo)
-		int axis;
-		int piece;
-		float speed;
-		float dest;     // means final position when turning or moving, final speed when spinning
-		float accel;    // used for spinning, can be negative
-		bool done;
-		bool hasWaiting;
-	};
-
-	typedef std::vector<AnimInfo> AnimContainerType;
-	typedef AnimContainerType::iterator AnimContainerTypeIt;
-
-	AnimContainerType anims[AMove + 1];
+	// number of animations this script has in the global unitScriptEngine arrays
+	int numAnims;
 
 	bool hasSetSFXOccupy;
 	bool hasRockUnit;
 	bool hasStartBuilding;
 
-	bool MoveToward(float& cur, float dest, float speed);
-	bool TurnToward(float& cur, float dest, float speed);
-	bool DoSpin(float& cur, float dest, float& speed, float accel, int divisor);
+	static bool MoveToward(float& cur, float dest, float speed);
+	static bool TurnToward(float& cur, float dest, float speed);
+	static bool DoSpin(float& cur, float dest, float& speed, float accel, int divisor);
 
-	AnimContainerTypeIt FindAnim(AnimType type, int piece, int axis);
-	void RemoveAnim(AnimType type, const AnimContainerTypeIt& animInfoIt);
+	int FindAnim(AnimType type, int piece, int axis) const;
+	void RemoveAnim(AnimType type, int animIndex);
 	void AddAnim(AnimType type, int piece, int axis, float speed, float dest, float accel);
 
 	virtual void ShowScriptError(const std::string& msg) = 0;
@@ -119,9 +108,6 @@ public:
 	      CUnit* GetUnit()       { return unit; }
 	const CUnit* GetUnit() const { return unit; }
 
-	bool Tick(int deltaTime);
-	void TickAnims(int deltaTime, AnimType type, std::vector<AnimInfo>& doneAnims);
-
 	// animation, used by CCobThread
 	void Spin(int piece, int axis, float speed, float accel);
 	void StopSpin(int piece, int axis, float decel);
@@ -143,12 +129,10 @@ public:
 	int GetUnitVal(int val, int p1, int p2, int p3, int p4);
 	void SetUnitVal(int val, int param);
 
-	bool IsInAnimation(AnimType type, int piece, int axis) {
-		return (FindAnim(type, piece, axis) != anims[type].end());
-	}
-	bool HaveAnimations() const {
-		return (!anims[ATurn].empty() || !anims[ASpin].empty() || !anims[AMove].empty());
+	bool IsInAnimation(AnimType type, int piece, int axis) const {
+		return (FindAnim(type, piece, axis) != -1);
 	}
+	bool HaveAnimations() const { return (numAnims > 0); }
 
 	// checks for callin existence
 	bool HasSetSFXOccupy () const { return hasSetSFXOccupy; }
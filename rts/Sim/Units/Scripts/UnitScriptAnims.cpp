@@ -0,0 +1,331 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/* construction and animations of CUnitScript, which only depend on the pieces */
+#include "UnitScript.h"
+
+#include "UnitScriptEngine.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Units/Unit.h"
+#include "Sim/Units/UnitDef.h"
+#include "System/myMath.h"
+#include "System/Util.h"
+
+
+CUnitScript::CUnitScript(CUnit* unit)
+	: unit(unit)
+	, busy(false)
+	, numAnims(0)
+	, hasSetSFXOccupy(false)
+	, hasRockUnit(false)
+	, hasStartBuilding(false)
+{ }
+
+
+CUnitScript::~CUnitScript()
+{
+	// Remove us from possible animation ticking; this is needed even
+	// without animations left, Tick may still have AnimFinished calls
+	// queued for us (and we can be deleted by an earlier one of them)
+	if (unitScriptEngine != nullptr)
+		unitScriptEngine->RemoveAnims(this);
+}
+
+
+/******************************************************************************/
+
+
+/**
+ * @brief Updates move animations
+ * @param cur float value to update
+ * @param dest float final value
+ * @param speed float max increment per tick
+ * @return returns true if destination was reached, false otherwise
+ */
+bool CUnitScript::MoveToward(float& cur, float dest, float speed)
+{
+	const float delta = dest - cur;
+
+	if (math::fabsf(delta) <= speed) {
+		cur = dest;
+		return true;
+	}
+
+	if (delta > 0.0f) {
+		cur += speed;
+	} else {
+		cur -= speed;
+	}
+
+	return false;
+}
+
+
+/**
+ * @brief Updates turn animations
+ * @param cur float value to update
+ * @param dest float final value
+ * @param speed float max increment per tick
+ * @return returns true if destination was reached, false otherwise
+ */
+bool CUnitScript::TurnToward(float& cur, float dest, float speed)
+{
+	float delta = dest - cur;
+
+	// clamp: -pi .. 0 .. +pi (remainder(x,TWOPI) would do the same but is slower due to streflop)
+	if (delta > math::PI) {
+		delta -= math::TWOPI;
+	} else if (delta <= -math::PI) {
+		delta += math::TWOPI;
+	}
+
+	if (math::fabsf(delta) <= speed) {
+		cur = dest;
+		return true;
+	}
+
+	if (delta > 0.0f) {
+		cur += speed;
+	} else {
+		cur -= speed;
+	}
+
+	ClampRad(&cur);
+
+	return false;
+}
+
+
+/**
+ * @brief Updates spin animations
+ * @param cur float value to update
+ * @param dest float the final desired speed (NOT the final angle!)
+ * @param speed float is updated if it is not equal to dest
+ * @param divisor int is the deltatime, it is not added before the call because speed may have to be updated
+ * @return true if the desired speed is 0 and it is reached, false otherwise
+ */
+bool CUnitScript::DoSpin(float& cur, float dest, float &speed, float accel, int divisor)
+{
+	const float delta = dest - speed;
+
+	// Check if we are not at the final speed and
+	// make sure we dont go past desired speed
+	if (math::fabsf(delta) <= accel) {
+		speed = dest;
+		if (speed == 0.0f)
+			return true;
+	}
+	else {
+		if (delta > 0.0f) {
+			// accelerations are defined in speed/frame (at GAME_SPEED fps)
+			speed += accel * (float(GAME_SPEED) / divisor);
+		} else {
+			speed -= accel * (float(GAME_SPEED) / divisor);
+		}
+	}
+
+	cur += (speed / divisor);
+	ClampRad(&cur);
+
+	return false;
+}
+
+
+
+int CUnitScript::FindAnim(AnimType type, int piece, int axis) const
+{
+	if (!HaveAnimations())
+		return -1;
+
+	return (unitScriptEngine->FindAnim(type, this, piece, axis));
+}
+
+void CUnitScript::RemoveAnim(AnimType type, int animIndex)
+{
+	if (animIndex == -1)
+		return;
+
+	const CUnitScriptEngine::AnimContainer& ac = unitScriptEngine->GetAnims(type);
+
+	const int piece = ac.pieces[animIndex];
+	const int axis = ac.axes[animIndex];
+	const bool hasWaiting = ac.waiting[animIndex];
+
+	unitScriptEngine->RemoveAnim(type, animIndex);
+
+	//! We need to unblock threads waiting on this animation, otherwise they will be lost in the void
+	//! NOTE: AnimFinished might result in new anims being added, so it is called after removal
+	if (hasWaiting)
+		AnimFinished(type, piece, axis);
+}
+
+
+//Overwrites old information. This means that threads blocking on turn completion
+//will now wait for this new turn instead. Not sure if this is the expected behaviour
+//Other option would be to kill them. Or perhaps unblock them.
+void CUnitScript::AddAnim(AnimType type, int piece, int axis, float speed, float dest, float accel)
+{
+	if (!PieceExists(piece)) {
+		ShowUnitScriptError("Invalid piecenumber");
+		return;
+	}
+
+	float destf = 0.0f;
+
+	if (type == AMove) {
+		destf = pieces[piece]->original->offset[axis] + dest;
+	} else {
+		destf = dest;
+		if (type == ATurn) {
+			ClampRad(&destf);
+		}
+	}
+
+	int animIndex = -1;
+	AnimType overrideType = ANone;
+
+	// first find an animation of a type we override
+	// Turns override spins.. Not sure about the other way around? If so
+	// the system should probably be redesigned to only have two types of
+	// anims (turns and moves), with spin as a bool
+	switch (type) {
+		case ATurn: {
+			overrideType = ASpin;
+			animIndex = FindAnim(overrideType, piece, axis);
+		} break;
+		case ASpin: {
+			overrideType = ATurn;
+			animIndex = FindAnim(overrideType, piece, axis);
+		} break;
+		case AMove: {
+			// ensure we never remove an animation of this type
+			overrideType = AMove;
+			animIndex = -1;
+		} break;
+		default: {
+		} break;
+	}
+	assert(overrideType >= 0);
+
+	if (animIndex != -1)
+		RemoveAnim(overrideType, animIndex);
+
+	// now find an animation of our own type
+	if ((animIndex = FindAnim(type, piece, axis)) == -1)
+		animIndex = unitScriptEngine->AddAnim(type, this, piece, axis);
+
+	CUnitScriptEngine::AnimContainer& ac = unitScriptEngine->GetAnims(type);
+
+	ac.dests[animIndex]  = destf;
+	ac.speeds[animIndex] = speed;
+	ac.accels[animIndex] = accel;
+}
+
+
+void CUnitScript::Spin(int piece, int axis, float speed, float accel)
+{
+	const int animIndex = FindAnim(ASpin, piece, axis);
+
+	//If we are already spinning, we may have to decelerate to the new speed
+	if (animIndex != -1) {
+		CUnitScriptEngine::AnimContainer& ac = unitScriptEngine->GetAnims(ASpin);
+		ac.dests[animIndex] = speed;
+
+		if (accel > 0) {
+			ac.accels[animIndex] = accel;
+		} else {
+			//Go there instantly. Or have a defaul accel?
+			ac.speeds[animIndex] = speed;
+			ac.accels[animIndex] = 0;
+		}
+	} else {
+		//No accel means we start at desired speed instantly
+		if (accel <= 0)
+			AddAnim(ASpin, piece, axis, speed, speed, 0);
+		else
+			AddAnim(ASpin, piece, axis, 0, speed, accel);
+	}
+}
+
+
+void CUnitScript::StopSpin(int piece, int axis, float decel)
+{
+	const int animIndex = FindAnim(ASpin, piece, axis);
+
+	if (decel <= 0) {
+		RemoveAnim(ASpin, animIndex);
+	} else {
+		if (animIndex == -1)
+			return;
+
+		CUnitScriptEngine::AnimContainer& ac = unitScriptEngine->GetAnims(ASpin);
+		ac.dests[animIndex] = 0;
+		ac.accels[animIndex] = decel;
+	}
+}
+
+
+void CUnitScript::Turn(int piece, int axis, float speed, float destination)
+{
+	AddAnim(ATurn, piece, axis, std::max(speed, -speed), destination, 0);
+}
+
+
+void CUnitScript::Move(int piece, int axis, float speed, float destination)
+{
+	AddAnim(AMove, piece, axis, std::max(speed, -speed), destination, 0);
+}
+
+
+void CUnitScript::MoveNow(int piece, int axis, float destination)
+{
+	if (!PieceExists(piece)) {
+		ShowUnitScriptError("Invalid piecenumber");
+		return;
+	}
+
+	LocalModelPiece* p = pieces[piece];
+
+	float3 pos = p->GetPosition();
+	pos[axis] = pieces[piece]->original->offset[axis] + destination;
+
+	p->SetPosition(pos);
+}
+
+
+void CUnitScript::TurnNow(int piece, int axis, float destination)
+{
+	if (!PieceExists(piece)) {
+		ShowUnitScriptError("Invalid piecenumber");
+		return;
+	}
+
+	LocalModelPiece* p = pieces[piece];
+
+	float3 rot = p->GetRotation();
+	rot[axis] = destination;
+
+	p->SetRotation(rot);
+}
+
+
+//Returns true if there was an animation to listen to
+bool CUnitScript::NeedsWait(AnimType type, int piece, int axis)
+{
+	const int animIndex = FindAnim(type, piece, axis);
+
+	// finished animations are removed by the same Tick that
+	// finishes them, so any animation found here still runs
+	if (animIndex != -1) {
+		unitScriptEngine->GetAnims(type).waiting[animIndex] = true;
+		return true;
+	}
+
+	return false;
+}
+
+
+void CUnitScript::ShowUnitScriptError(const std::string& error)
+{
+	ShowScriptError(unit ? error + std::string(" ") + IntToString(unit->id) + std::string(" of type ") + unit->unitDef->name
+						 : error + std::string(" -> Unit doesn't have a script!"));
+}
@@ -8,17 +8,40 @@
 #include "UnitScript.h"
 #include "System/Util.h"
 #include "System/FileSystem/FileHandler.h"
+#include "System/Threading/ThreadPool.h"
 
 CUnitScriptEngine* unitScriptEngine = nullptr;
 
+// number of animations stepped per ThreadPool task
+static constexpr int ANIM_BLOCK_SIZE = 256;
+
 
 CR_BIND(CUnitScriptEngine, )
 
 CR_REG_METADATA(CUnitScriptEngine, (
-	CR_MEMBER(animating),
+	CR_MEMBER(anims),
+
+	// rebuilt from anims
+	CR_IGNORED(animIndices),
+	// always empty when saving
+	CR_IGNORED(finishedAnims),
+
+	CR_POSTLOAD(PostLoad)
+))
 
-	//always null when saving
-	CR_IGNORED(currentScript)
+CR_BIND(CUnitScriptEngine::AnimContainer, )
+
+CR_REG_METADATA_SUB(CUnitScriptEngine, AnimContainer, (
+	CR_MEMBER(scripts),
+	CR_MEMBER(pieces),
+	CR_MEMBER(axes),
+	CR_MEMBER(speeds),
+	CR_MEMBER(dests),
+	CR_MEMBER(accels),
+	CR_MEMBER(waiting),
+
+	CR_IGNORED(values),
+	CR_IGNORED(finished)
 ))
 
 
@@ -38,7 +61,7 @@ void CUnitScriptEngine::KillStatic() {
 /******************************************************************************/
 
 
-CUnitScriptEngine::CUnitScriptEngine() : currentScript(nullptr)
+CUnitScriptEngine::CUnitScriptEngine()
 {
 }
 
@@ -48,56 +71,210 @@ CUnitScriptEngine::~CUnitScriptEngine()
 }
 
 
-void CUnitScriptEngine::CheckForDuplicates(const char* name, const CUnitScript* instance)
+void CUnitScriptEngine::PostLoad()
 {
-	int found = 0;
+	for (int animType = CUnitScript::ATurn; animType <= CUnitScript::AMove; animType++) {
+		const AnimContainer& ac = anims[animType];
 
-	for (const CUnitScript* us: animating) {
-		if (us == instance)
-			found++;
+		for (size_t i = 0; i < ac.size(); i++) {
+			animIndices[GetAnimKey(AnimType(animType), ac.scripts[i], ac.pieces[i], ac.axes[i])] = i;
+		}
 	}
+}
 
-	if (found > 1)
-		LOG_L(L_WARNING, "%s found duplicates %d", name, found);
+
+int CUnitScriptEngine::FindAnim(AnimType type, const CUnitScript* script, int piece, int axis) const
+{
+	const auto it = animIndices.find(GetAnimKey(type, script, piece, axis));
+
+	if (it == animIndices.end())
+		return -1;
+
+	return it->second;
 }
 
 
-void CUnitScriptEngine::AddInstance(CUnitScript *instance)
+int CUnitScriptEngine::AddAnim(AnimType type, CUnitScript* script, int piece, int axis)
 {
-	if (instance != currentScript)
-		VectorInsertUnique(animating, instance);
+	AnimContainer& ac = anims[type];
+
+	const int index = ac.size();
+
+	ac.scripts.push_back(script);
+	ac.pieces.push_back(piece);
+	ac.axes.push_back(axis);
+	ac.speeds.push_back(0.0f);
+	ac.dests.push_back(0.0f);
+	ac.accels.push_back(0.0f);
+	ac.waiting.push_back(false);
+
+	animIndices[GetAnimKey(type, script, piece, axis)] = index;
+	script->numAnims++;
+	return index;
 }
 
 
-void CUnitScriptEngine::RemoveInstance(CUnitScript *instance)
+void CUnitScriptEngine::RemoveAnim(AnimType type, int index)
 {
-	// Error checking
-#ifdef _DEBUG
-	CheckForDuplicates(__FUNCTION__, instance);
-#endif
-
-	//This is slow. would be better if instance was a hashlist perhaps
-	if (instance != currentScript)
-		VectorErase(animating, instance);
+	AnimContainer& ac = anims[type];
+
+	const int last = ac.size() - 1;
+
+	assert(index >= 0 && index <= last);
+	assert(ac.scripts[index]->numAnims > 0);
+
+	ac.scripts[index]->numAnims--;
+	animIndices.erase(GetAnimKey(type, ac.scripts[index], ac.pieces[index], ac.axes[index]));
+
+	if (index != last) {
+		ac.scripts[index] = ac.scripts[last];
+		ac.pieces[index]  = ac.pieces[last];
+		ac.axes[index]    = ac.axes[last];
+		ac.speeds[index]  = ac.speeds[last];
+		ac.dests[index]   = ac.dests[last];
+		ac.accels[index]  = ac.accels[last];
+		ac.waiting[index] = ac.waiting[last];
+
+		animIndices[GetAnimKey(type, ac.scripts[index], ac.pieces[index], ac.axes[index])] = index;
+	}
+
+	ac.scripts.pop_back();
+	ac.pieces.pop_back();
+	ac.axes.pop_back();
+	ac.speeds.pop_back();
+	ac.dests.pop_back();
+	ac.accels.pop_back();
+	ac.waiting.pop_back();
 }
 
 
-void CUnitScriptEngine::Tick(int deltaTime)
+void CUnitScriptEngine::RemoveAnims(const CUnitScript* script)
 {
-	// Tick all instances that have registered themselves as animating
-	int i = 0;
-	while (i < animating.size()) {
-		currentScript = animating[i];
+	for (int animType = CUnitScript::ATurn; animType <= CUnitScript::AMove && script->HaveAnimations(); animType++) {
+		const AnimContainer& ac = anims[animType];
+
+		// backwards, so the element swapped into <i> was already checked
+		for (int i = int(ac.size()) - 1; i >= 0; i--) {
+			if (ac.scripts[i] == script)
+				RemoveAnim(AnimType(animType), i);
+		}
+	}
+
+	// the script may die from within an AnimFinished callin during Tick
+	for (FinishedAnim& fa: finishedAnims) {
+		if (fa.script == script)
+			fa.script = nullptr;
+	}
+}
+
 
-		if (currentScript->Tick(deltaTime)) {
-			++i;
+/**
+ * @brief Computes the new piece position or rotation of each animation
+ *
+ * Only reads from the pieces, so this is safe to run on multiple threads;
+ * each animation touches a different component of a piece's pos or rot.
+ */
+void CUnitScriptEngine::StepAnims(AnimType type, int deltaTime)
+{
+	AnimContainer& ac = anims[type];
+
+	ac.values.resize(ac.size());
+	ac.finished.resize(ac.size());
+
+	const int numAnims = ac.size();
+	const int numBlocks = (numAnims + ANIM_BLOCK_SIZE - 1) / ANIM_BLOCK_SIZE;
+
+	const int divisor = 1000 / deltaTime;
+
+	for_mt(0, numBlocks, [&](const int block) {
+		const int start = block * ANIM_BLOCK_SIZE;
+		const int end = std::min(start + ANIM_BLOCK_SIZE, numAnims);
+
+		for (int i = start; i < end; i++) {
+			const LocalModelPiece* lmp = ac.scripts[i]->pieces[ac.pieces[i]];
+
+			switch (type) {
+				case CUnitScript::AMove: {
+					float cur = lmp->GetPosition()[ac.axes[i]];
+					ac.finished[i] = CUnitScript::MoveToward(cur, ac.dests[i], ac.speeds[i] / divisor);
+					ac.values[i] = cur;
+				} break;
+				case CUnitScript::ATurn: {
+					float cur = lmp->GetRotation()[ac.axes[i]];
+					ac.finished[i] = CUnitScript::TurnToward(cur, ac.dests[i], ac.speeds[i] / divisor);
+					ac.values[i] = cur;
+				} break;
+				case CUnitScript::ASpin: {
+					float cur = lmp->GetRotation()[ac.axes[i]];
+					ac.finished[i] = CUnitScript::DoSpin(cur, ac.dests[i], ac.speeds[i], ac.accels[i], divisor);
+					ac.values[i] = cur;
+				} break;
+				default: {
+				} break;
+			}
+		}
+	});
+}
+
+
+/**
+ * @brief Writes the values computed by StepAnims back to the pieces and
+ *        removes finished animations, queueing notifications for those
+ *        that are being waited on
+ */
+void CUnitScriptEngine::ApplyAnims(AnimType type)
+{
+	AnimContainer& ac = anims[type];
+
+	for (size_t i = 0; i < ac.size(); i++) {
+		LocalModelPiece* lmp = ac.scripts[i]->pieces[ac.pieces[i]];
+
+		if (type == CUnitScript::AMove) {
+			float3 pos = lmp->GetPosition();
+			pos[ac.axes[i]] = ac.values[i];
+			lmp->SetPosition(pos);
 		} else {
-			animating[i] = animating.back();
-			animating.pop_back();
+			float3 rot = lmp->GetRotation();
+			rot[ac.axes[i]] = ac.values[i];
+			lmp->SetRotation(rot);
 		}
+
+		if (!ac.finished[i])
+			continue;
+
+		if (ac.waiting[i])
+			finishedAnims.push_back({ac.scripts[i], type, ac.pieces[i], ac.axes[i]});
+	}
+
+	// backwards, so the element swapped into <i> was already checked
+	for (int i = int(ac.size()) - 1; i >= 0; i--) {
+		if (!ac.finished[i])
+			continue;
+
+		RemoveAnim(type, i);
+	}
+}
+
+
+void CUnitScriptEngine::Tick(int deltaTime)
+{
+	for (int animType = CUnitScript::ATurn; animType <= CUnitScript::AMove; animType++) {
+		StepAnims(AnimType(animType), deltaTime);
+		ApplyAnims(AnimType(animType));
+	}
+
+	// tell listeners to unblock; callins may add or remove animations
+	// and kill scripts, but Tick itself is never reentered from them
+	for (size_t i = 0; i < finishedAnims.size(); i++) {
+		const FinishedAnim& fa = finishedAnims[i];
+
+		if (fa.script == nullptr)
+			continue;
+
+		fa.script->AnimFinished(fa.type, fa.piece, fa.axis);
 	}
 
-	currentScript = nullptr;
+	finishedAnims.clear();
 }
 
 
@@ -5,32 +5,102 @@
 #ifndef UNIT_SCRIPT_ENGINE_H
 #define UNIT_SCRIPT_ENGINE_H
 
+#include "UnitScript.h"
 #include "System/creg/creg_cond.h"
+#include "System/UnorderedMap.hpp"
+
+#include <cstdint>
 #include <vector>
 
 class CUnit;
-class CUnitScript;
 
 
 class CUnitScriptEngine
 {
 	CR_DECLARE_STRUCT(CUnitScriptEngine)
+	CR_DECLARE_SUB(AnimContainer)
+
+public:
+	typedef CUnitScript::AnimType AnimType;
+
+	/**
+	 * All running animations of one type (for every unit), stored as
+	 * parallel arrays so Tick can step them in one pass. Elements are
+	 * removed by swapping with the last one, so indices are only valid
+	 * until the next Add/Remove.
+	 */
+	struct AnimContainer {
+		CR_DECLARE_STRUCT(AnimContainer)
+
+		size_t size() const { return scripts.size(); }
 
-protected:
-	std::vector<CUnitScript*> animating; // hash would be optimal, but not crucial
-	void CheckForDuplicates(const char* name, const CUnitScript* instance);
+		std::vector<CUnitScript*> scripts;
+		std::vector<int> pieces;
+		std::vector<int> axes;
+		std::vector<float> speeds;
+		std::vector<float> dests;  // means final position when turning or moving, final speed when spinning
+		std::vector<float> accels; // used for spinning, can be negative
+		std::vector<bool> waiting; // true if a thread or coroutine waits for this animation
+
+		// scratch, written by the (multithreaded) step pass
+		std::vector<float> values;
+		std::vector<char> finished;
+	};
 
 public:
 	CUnitScriptEngine();
 	~CUnitScriptEngine();
-	void AddInstance(CUnitScript* instance);
-	void RemoveInstance(CUnitScript* instance);
+
 	void Tick(int deltaTime);
 
+	/// @return index of the animation in GetAnims(type), or -1
+	int FindAnim(AnimType type, const CUnitScript* script, int piece, int axis) const;
+	/// appends a new animation with zero speed, dest and accel, returns its index
+	int AddAnim(AnimType type, CUnitScript* script, int piece, int axis);
+	void RemoveAnim(AnimType type, int index);
+	/// drops all animations of <script> without notifying it
+	void RemoveAnims(const CUnitScript* script);
+
+	AnimContainer& GetAnims(AnimType type) { return anims[type]; }
+
 	static void InitStatic();
 	static void KillStatic();
+
+private:
+	struct AnimKey {
+		bool operator == (const AnimKey& k) const { return (script == k.script && id == k.id); }
+
+		const CUnitScript* script;
+		int id; // piece, axis and type
+	};
+	struct AnimKeyHash {
+		size_t operator () (const AnimKey& k) const {
+			return (reinterpret_cast<std::uintptr_t>(k.script) ^ (size_t(k.id) * 2654435761u));
+		}
+	};
+	struct FinishedAnim {
+		CUnitScript* script; // nulled if the script dies before being notified
+		AnimType type;
+		int piece;
+		int axis;
+	};
+
+	static AnimKey GetAnimKey(AnimType type, const CUnitScript* script, int piece, int axis) {
+		return {script, (piece << 4) | (type << 2) | axis};
+	}
+
+	void StepAnims(AnimType type, int deltaTime);
+	void ApplyAnims(AnimType type);
+	void PostLoad();
+
 private:
-	CUnitScript* currentScript;
+	AnimContainer anims[CUnitScript::AMove + 1];
+
+	// keyed by pointer, only used for lookups and never iterated
+	spring::unsynced_map<AnimKey, int, AnimKeyHash> animIndices;
+
+	// notifications collected by Tick, sent after all animations were stepped
+	std::vector<FinishedAnim> finishedAnims;
 };
 
 extern CUnitScriptEngine* unitScriptEngine;
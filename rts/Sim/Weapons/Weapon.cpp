@@ -95,7 +95,11 @@ CR_REG_METADATA(CWeapon, (
 	CR_MEMBER(currentTarget),
 	CR_MEMBER(currentTargetPos),
 
-	CR_MEMBER(incomingProjectileIDs)
+	CR_MEMBER(incomingProjectileIDs),
+
+	CR_IGNORED(lineOfFireTests),
+	CR_IGNORED(numLineOfFireTests),
+	CR_IGNORED(cacheLineOfFireTests)
 ))
 
 
@@ -162,7 +166,9 @@ CWeapon::CWeapon(CUnit* owner, const WeaponDef* def):
 	errorVectorAdd(ZeroVector),
 	muzzleFlareSize(1),
 	fireSoundId(0),
-	fireSoundVolume(0)
+	fireSoundVolume(0),
+	numLineOfFireTests(0),
+	cacheLineOfFireTests(false)
 {
 }
 
@@ -643,7 +649,7 @@ bool CWeapon::AutoTarget()
 	targets.clear();
 	targets.reserve(16);
 
-	CGameHelper::GenerateWeaponTargets(this, avoidUnit, targets);
+	helper->GenerateWeaponTargets(this, avoidUnit, targets);
 
 	CUnit* goodTargetUnit = nullptr;
 	CUnit* badTargetUnit = nullptr;
@@ -696,6 +702,11 @@ void CWeapon::SlowUpdate()
 	UpdateWeaponPieces();
 	UpdateWeaponVectors();
 
+	// targets tend to be tested several times below (HoldIfTargetInvalid,
+	// Attack, AutoTarget) with nothing having moved in between
+	numLineOfFireTests = 0;
+	cacheLineOfFireTests = true;
+
 	// HoldFire: if Weapon Target isn't valid
 	HoldIfTargetInvalid();
 
@@ -719,6 +730,8 @@ void CWeapon::SlowUpdate()
 	}
 	// AutoTarget: Find new/better Target
 	AutoTarget();
+
+	cacheLineOfFireTests = false;
 }
 
 
@@ -860,7 +873,39 @@ bool CWeapon::TryTarget(const float3 tgtPos, const SWeaponTarget& trg, bool preF
 		return false;
 
 	//FIXME add a forcedUserTarget (a forced fire mode enabled with ctrl key or something) and skip the tests below then
-	return HaveFreeLineOfFire(tgtPos, trg, preFire);
+	return TestLineOfFire(tgtPos, trg, preFire);
+}
+
+
+bool CWeapon::TestLineOfFire(const float3 tgtPos, const SWeaponTarget& trg, bool preFire) const
+{
+	// results are only reused within our own SlowUpdate; anywhere else
+	// (e.g. unsynced GuiHandler queries, or Lua between sim steps) units
+	// may have moved since the last test and must not touch this state
+	if (!cacheLineOfFireTests)
+		return HaveFreeLineOfFire(tgtPos, trg, preFire);
+
+	for (int n = 0, N = std::min(numLineOfFireTests, int(NUM_LINE_OF_FIRE_TESTS)); n < N; n++) {
+		const LineOfFireTest& test = lineOfFireTests[n];
+
+		if (test.preFire != preFire || test.target != trg)
+			continue;
+		if (test.tgtPos != tgtPos || test.aimFromPos != aimFromPos || test.muzzlePos != weaponMuzzlePos)
+			continue;
+
+		return test.result;
+	}
+
+	LineOfFireTest& test = lineOfFireTests[(numLineOfFireTests++) % NUM_LINE_OF_FIRE_TESTS];
+
+	test.preFire = preFire;
+	test.result = HaveFreeLineOfFire(tgtPos, trg, preFire);
+	test.tgtPos = tgtPos;
+	test.aimFromPos = aimFromPos;
+	test.muzzlePos = weaponMuzzlePos;
+	test.target = trg;
+
+	return test.result;
 }
 
 
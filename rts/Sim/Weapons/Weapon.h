@@ -109,6 +109,7 @@ private:
 	void HoldIfTargetInvalid();
 
 	bool TryTarget(const float3 tgtPos, const SWeaponTarget& trg, bool preFire = false) const;
+	bool TestLineOfFire(const float3 tgtPos, const SWeaponTarget& trg, bool preFire) const;
 
 public:
 	CUnit* owner;
@@ -190,6 +191,26 @@ protected:
 	// projectiles that are on the way to our interception zone
 	// (eg. nuke toward a repulsor, or missile toward a shield)
 	std::vector<int> incomingProjectileIDs;
+
+private:
+	struct LineOfFireTest {
+		bool preFire;
+		bool result;
+
+		float3 tgtPos;
+		float3 aimFromPos;
+		float3 muzzlePos;
+
+		SWeaponTarget target;
+	};
+
+	static const int NUM_LINE_OF_FIRE_TESTS = 4;
+
+	// most recent HaveFreeLineOfFire results of the running SlowUpdate
+	mutable LineOfFireTest lineOfFireTests[NUM_LINE_OF_FIRE_TESTS];
+	mutable int numLineOfFireTests;
+
+	bool cacheLineOfFireTests;
 };
 
 #endif /* WEAPON_H */
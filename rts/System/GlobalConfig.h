@@ -84,6 +84,14 @@ public:
 	 */
 	int linkIncomingMaxWaitingPackets;
 
+	/**
+	 * @brief linkCompression
+	 *
+	 * Whether bursts of outgoing messages (large orders) are compressed on
+	 * connections whose other end can unpack them
+	 */
+	bool linkCompression;
+
 	/**
 	 * @brief useNetMessageSmoothingBuffer
 	 *
@@ -1,6 +1,8 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <cstdint>
 #include <sstream>
+#include <streambuf>
 #include <zlib.h>
 
 #include "ExternalAI/EngineOutHandler.h"
@@ -33,6 +35,7 @@
 #include "System/Platform/errorhandler.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystemAbstraction.h"
 #include "System/FileSystem/GZFileHandler.h"
 #include "System/creg/Serializer.h"
 #include "System/Exceptions.h"
@@ -91,6 +94,61 @@ void CGameStateCollector::Serialize(creg::ISerializer* s)
 	s->SerializeObjectInstance(eoh, eoh->GetClass());
 }
 
+/**
+ * Compresses everything written to it straight into a gz file, so a save
+ * never has to be held in memory as a whole. Only supports telling the
+ * current position, which is all COutputStreamSerializer needs for a
+ * streamed package.
+ */
+class CGZOutputBuffer : public std::streambuf
+{
+public:
+	CGZOutputBuffer(gzFile f): file(f), numFlushed(0) { setp(buffer, buffer + sizeof(buffer)); }
+	~CGZOutputBuffer() { sync(); }
+
+protected:
+	int_type overflow(int_type c) override {
+		if (!FlushBuffer())
+			return traits_type::eof();
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+		return c;
+	}
+
+	int sync() override {
+		return (FlushBuffer()? 0: -1);
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::out) == 0)
+			return pos_type(off_type(-1));
+
+		return pos_type(off_type(numFlushed + (pptr() - pbase())));
+	}
+
+private:
+	bool FlushBuffer() {
+		const int size = pptr() - pbase();
+
+		if (size > 0 && gzwrite(file, pbase(), size) != size)
+			return false;
+
+		numFlushed += size;
+		setp(buffer, buffer + sizeof(buffer));
+		return true;
+	}
+
+private:
+	gzFile file;
+	std::int64_t numFlushed;
+
+	char buffer[64 * 1024];
+};
+
+
 static void WriteString(std::ostream& s, const std::string& str)
 {
 	assert(str.length() < (1 << 16));
@@ -124,9 +182,28 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 {
 #ifdef USING_CREG
 	LOG("Saving game");
+
+	const std::string filePath = dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE);
+	gzFile file = gzopen(filePath.c_str(), "wb9");
+
+	if (file == nullptr) {
+		LOG_L(L_ERROR, "Save failed: couldn't open file");
+		return;
+	}
+
+	bool saved = false;
+
 	try {
+		// the game state is written as it is serialized, the AI state is
+		// small and has to come first since the streamed package ends the file
+		std::stringstream aiState;
+		eoh->Save(&aiState);
+
+		const std::string aiData = aiState.str();
+		const std::uint32_t aiSize = aiData.size();
 
-		std::stringstream oss;
+		CGZOutputBuffer gzBuffer(file);
+		std::ostream oss(&gzBuffer);
 
 		// write our own header. SavePackage() will add its own
 		WriteString(oss, SpringVersion::GetSync());
@@ -134,27 +211,24 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 		WriteString(oss, modName);
 		WriteString(oss, mapName);
 
+		// save ai state
+		oss.write(reinterpret_cast<const char*>(&aiSize), sizeof(aiSize));
+		oss.write(aiData.data(), aiSize);
+		PrintSize("AIs", aiSize);
+
 		CGameStateCollector gsc = CGameStateCollector();
 
 		// save creg state
+		const int gameStart = oss.tellp();
 		creg::COutputStreamSerializer os;
-		os.SavePackage(&oss, &gsc, gsc.GetClass());
-		PrintSize("Game", oss.tellp());
+		os.SavePackage(&oss, &gsc, gsc.GetClass(), true);
+		PrintSize("Game", ((int)oss.tellp()) - gameStart);
 
-		// save ai state
-		int aistart = oss.tellp();
-		eoh->Save(&oss);
-		PrintSize("AIs", ((int)oss.tellp()) - aistart);
-
-		gzFile file = gzopen(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE).c_str(), "wb9");
-		if (file == nullptr) {
-			LOG_L(L_ERROR, "Save failed: couldn't open file");
-			return;
-		}
-		const std::string data = oss.str();
-		gzwrite(file, data.c_str(), data.size());
-		gzflush(file, Z_FINISH);
-		gzclose(file);
+		oss.flush();
+		saved = oss.good();
+
+		if (!saved)
+			LOG_L(L_ERROR, "Save failed: couldn't write file");
 
 		//FIXME add lua state
 	} catch (const content_error& ex) {
@@ -168,6 +242,12 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 	} catch (...) {
 		LOG_L(L_ERROR, "Save failed(unknown error)");
 	}
+
+	gzclose(file);
+
+	// do not leave a truncated save behind
+	if (!saved)
+		FileSystemAbstraction::DeleteFile(filePath);
 #else //USING_CREG
 	LOG_L(L_ERROR, "Save failed: creg is disabled");
 #endif //USING_CREG
@@ -224,8 +304,17 @@ void CCregLoadSaveHandler::LoadGame()
 	void* pGSC = NULL;
 	creg::Class* gsccls = NULL;
 
+	// the ai state precedes the game state, but can only be loaded after it
+	std::uint32_t aiSize = 0;
+	iss->read(reinterpret_cast<char*>(&aiSize), sizeof(aiSize));
+
+	std::string aiData(aiSize, 0);
+	iss->read(&aiData[0], aiSize);
+
+	std::stringstream aiState(aiData);
+
 	// load creg state
-	creg::CInputStreamSerializer inputStream;
+	creg::CInputStreamSerializer inputStream(true);
 	inputStream.LoadPackage(iss, pGSC, gsccls);
 	assert(pGSC && gsccls == CGameStateCollector::StaticClass());
 
@@ -234,7 +323,7 @@ void CCregLoadSaveHandler::LoadGame()
 	gsc = NULL;
 
 	// load ai state
-	eoh->Load(iss);
+	eoh->Load(&aiState);
 	//for (int a=0; a < teamHandler->ActiveTeams(); a++) { // For old savegames
 	//	if (teamHandler->Team(a)->isDead && eoh->IsSkirmishAI(a)) {
 	//		eoh->DestroySkirmishAI(skirmishAIId(a), 2 /* = team died */);
@@ -158,15 +158,12 @@ void CDemoRecorder::SetPlayerStats(int playerNum, const PlayerStatistics& stats)
 }
 
 /** @brief Set (overwrite) the TeamStatistics history for team teamNum */
-void CDemoRecorder::SetTeamStats(int teamNum, const std::vector<TeamStatistics>& stats)
+void CDemoRecorder::SetTeamStats(int teamNum, const TeamStatsHistory& stats)
 {
 	assert((unsigned)teamNum < teamStats.size()); //FIXME
 
-	teamStats[teamNum].clear();
-	teamStats[teamNum].reserve(stats.size());
-
-	for (auto it = stats.cbegin(); it != stats.cend(); ++it)
-		teamStats[teamNum].push_back(*it);
+	// kept encoded, only decoded piecewise by WriteTeamStats
+	teamStats[teamNum] = stats;
 }
 
 
@@ -251,16 +248,22 @@ void CDemoRecorder::WriteTeamStats()
 	int pos = demoStream.tellp();
 
 	// Write array of dwords indicating number of TeamStatistics per team.
-	for (std::vector<TeamStatistics>& history: teamStats) {
+	for (const TeamStatsHistory& history: teamStats) {
 		unsigned int c = swabDWord(history.size());
 		demoStream.write((char*)&c, sizeof(unsigned int));
 	}
 
-	// Write big array of TeamStatistics.
-	for (std::vector<TeamStatistics>& history: teamStats) {
-		for (TeamStatistics& stats: history) {
-			stats.swab();
-			demoStream.write(reinterpret_cast<char*>(&stats), sizeof(TeamStatistics));
+	// Write big array of TeamStatistics, decoding one keyframe interval at a time.
+	std::vector<TeamStatistics> records;
+
+	for (const TeamStatsHistory& history: teamStats) {
+		for (unsigned int n = 0; n < history.size(); n += TeamStatsHistory::KEYFRAME_INTERVAL) {
+			history.GetRange(n, n + TeamStatsHistory::KEYFRAME_INTERVAL - 1, records);
+
+			for (TeamStatistics& stats: records) {
+				stats.swab();
+				demoStream.write(reinterpret_cast<char*>(&stats), sizeof(TeamStatistics));
+			}
 		}
 	}
 
@@ -9,7 +9,7 @@
 
 #include "Demo.h"
 #include "Game/Players/PlayerStatistics.h"
-#include "Sim/Misc/TeamStatistics.h"
+#include "Sim/Misc/TeamStatsHistory.h"
 
 
 /**
@@ -36,7 +36,7 @@ public:
 	void AddNewPlayer(const std::string& name, int playerNum);
 	void InitializeStats(int numPlayers, int numTeams);
 	void SetPlayerStats(int playerNum, const PlayerStatistics& stats);
-	void SetTeamStats(int teamNum, const std::vector<TeamStatistics>& stats);
+	void SetTeamStats(int teamNum, const TeamStatsHistory& stats);
 	void SetWinningAllyTeams(const std::vector<unsigned char>& winningAllyTeams);
 
 private:
@@ -51,7 +51,7 @@ private:
 	gzFile file;
 	std::stringstream demoStream;
 	std::vector<PlayerStatistics> playerStats;
-	std::vector< std::vector<TeamStatistics> > teamStats;
+	std::vector<TeamStatsHistory> teamStats;
 	std::vector<unsigned char> winningAllyTeams;
 };
 
@@ -14,6 +14,7 @@ unsigned CLocalConnection::instances = 0;
 
 std::deque< std::shared_ptr<const RawPacket> > CLocalConnection::pqueues[2];
 spring::mutex CLocalConnection::mutexes[2];
+std::function<void()> CLocalConnection::callbacks[2];
 
 CLocalConnection::CLocalConnection()
 {
@@ -33,6 +34,7 @@ CLocalConnection::CLocalConnection()
 
 CLocalConnection::~CLocalConnection()
 {
+	SetDataCallback(nullptr);
 	instances--;
 }
 
@@ -59,6 +61,15 @@ void CLocalConnection::SendData(std::shared_ptr<const RawPacket> packet)
 	// when sending from A to B we must lock B's queue
 	std::lock_guard<spring::mutex> scoped_lock(mutexes[OtherInstance()]);
 	pqueues[OtherInstance()].push_back(packet);
+
+	if (callbacks[OtherInstance()])
+		callbacks[OtherInstance()]();
+}
+
+void CLocalConnection::SetDataCallback(std::function<void()> callback)
+{
+	std::lock_guard<spring::mutex> scoped_lock(mutexes[instance]);
+	callbacks[instance] = callback;
 }
 
 std::shared_ptr<const RawPacket> CLocalConnection::GetData()
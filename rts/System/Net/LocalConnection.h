@@ -4,6 +4,7 @@
 #define _LOCAL_CONNECTION_H
 
 #include <deque>
+#include <functional>
 #include "System/Threading/SpringThreading.h"
 
 #include "Connection.h"
@@ -50,11 +51,18 @@ public:
 	std::string Statistics() const;
 	std::string GetFullAddress() const;
 
+	/**
+	 * @brief Set a function to be called whenever the other side sends
+	 * data to this connection; called from the sending thread
+	 */
+	void SetDataCallback(std::function<void()> callback);
+
 	// END overriding CConnection
 
 private:
 	static std::deque< std::shared_ptr<const RawPacket> > pqueues[2];
 	static spring::mutex mutexes[2];
+	static std::function<void()> callbacks[2];
 
 	unsigned int OtherInstance() const { return ((instance + 1) % 2); }
 
@@ -2,8 +2,11 @@
 
 #include "UDPConnection.h"
 
+#include <algorithm>
 #include <memory>
 #include <cinttypes>
+#include <cstring>
+#include <zlib.h>
 
 
 #include "Socket.h"
@@ -29,6 +32,12 @@ static const unsigned udpMaxPacketSize = 4096;
 static const int maxChunkSize = 254;
 static const int chunksPerSec = 30;
 
+/// runs of outgoing messages shorter than this are not worth compressing
+static const unsigned minBundleLength = 256;
+/// keeps the compressed size within NETMSG_COMPRESSED's ushort msgsize
+static const unsigned maxBundleLength = 16 * 1024;
+static const unsigned bundleHeaderSize = 1 + 2 * sizeof(std::uint16_t);
+
 
 
 #if NETWORK_TEST
@@ -79,7 +88,7 @@ inline void EMULATE_PACKET_CORRUPTION(std::uint8_t& crc) {}
 		} else { ++di; } \
 	} \
 	if (cond) \
-		delayed[spring_gettime() + spring_msecs(PACKET_MIN_LATENCY + (PACKET_MAX_LATENCY - PACKET_MIN_LATENCY) * RANDOM_NUMBER())] = data; \
+		delayed[spring_gettime() + spring_msecs(PACKET_MIN_LATENCY + (PACKET_MAX_LATENCY - PACKET_MIN_LATENCY) * RANDOM_NUMBER())].assign(data, data + size); \
 	if (false)
 #else
 #define EMULATE_LATENCY(cond) if(cond)
@@ -103,9 +112,11 @@ public:
 		pos += sizeof(t);
 	}
 
-	void Unpack(std::vector<std::uint8_t>& t, unsigned unpackLength) {
-		std::copy(data + pos, data + pos + unpackLength, std::back_inserter(t));
+	/// returns the next <unpackLength> bytes in place
+	const unsigned char* Skip(unsigned unpackLength) {
+		const unsigned char* ptr = data + pos;
 		pos += unpackLength;
+		return ptr;
 	}
 
 	unsigned Remaining() const {
@@ -120,24 +131,27 @@ private:
 class Packer
 {
 public:
-	Packer(std::vector<std::uint8_t>& data): data(data)
+	Packer(std::uint8_t* data): data(data), pos(0)
 	{
-		assert(data.empty());
 	}
 
 	template<typename T>
-	void Pack(T& t) {
-		const size_t pos = data.size();
-		data.resize(pos + sizeof(T));
-		*reinterpret_cast<T*>(&data[pos]) = t;
+	void Pack(const T& t) {
+		*reinterpret_cast<T*>(data + pos) = t;
+		pos += sizeof(T);
 	}
 
-	void Pack(std::vector<std::uint8_t>& _data) {
-		std::copy(_data.begin(), _data.end(), std::back_inserter(data));
+	void Pack(const std::uint8_t* _data, unsigned length) {
+		if (length > 0)
+			std::memcpy(data + pos, _data, length);
+		pos += length;
 	}
 
+	unsigned GetPos() const { return pos; }
+
 private:
-	std::vector<std::uint8_t>& data;
+	std::uint8_t* data;
+	unsigned pos;
 };
 
 
@@ -147,40 +161,59 @@ void Chunk::UpdateChecksum(CRC& crc) const {
 	crc << chunkNumber;
 	crc << (unsigned int)chunkSize;
 
-	if (!data.empty()) {
-		crc.Update(&data[0], data.size());
+	if (chunkSize > 0) {
+		crc.Update(data, chunkSize);
+	}
+}
+
+
+
+void ChunkWindow::Push(const std::uint8_t* data, unsigned length)
+{
+	assert((length > 0) && (length <= Chunk::maxSize));
+
+	if (size() == slots.size())
+		Grow();
+
+	Slot& slot = GetSlot(endNumber++);
+	slot.size = length;
+	std::memcpy(slot.data, data, length);
+}
+
+void ChunkWindow::Grow()
+{
+	std::vector<Slot> newSlots(std::max(slots.size() * 2, size_t(64)));
+
+	for (std::int32_t n = firstNumber; n != endNumber; ++n) {
+		newSlots[n & (newSlots.size() - 1)] = GetSlot(n);
 	}
+
+	slots.swap(newSlots);
 }
 
 
 
-Packet::Packet(const unsigned char* data, unsigned length)
+void Packet::Parse(const unsigned char* data, unsigned length)
 {
 	Unpacker buf(data, length);
 	buf.Unpack(lastContinuous);
 	buf.Unpack(nakType);
 	buf.Unpack(checksum);
 
-	if (nakType > 0) {
-		naks.reserve(nakType);
-		for (int i = 0; i != nakType; ++i) {
-			if (buf.Remaining() >= sizeof(naks[i])) {
-				if (naks.size() <= i) {
-					naks.push_back(0);
-				}
-				buf.Unpack(naks[i]);
-			} else {
-				break;
-			}
-		}
+	naks.clear();
+	chunks.clear();
+
+	for (int i = 0; i < nakType && buf.Remaining() >= sizeof(std::uint8_t); ++i) {
+		naks.push_back(0);
+		buf.Unpack(naks.back());
 	}
 
 	while (buf.Remaining() > Chunk::headerSize) {
-		ChunkPtr temp(new Chunk);
-		buf.Unpack(temp->chunkNumber);
-		buf.Unpack(temp->chunkSize);
-		if (buf.Remaining() >= temp->chunkSize) {
-			buf.Unpack(temp->data, temp->chunkSize);
+		Chunk temp;
+		buf.Unpack(temp.chunkNumber);
+		buf.Unpack(temp.chunkSize);
+		if (buf.Remaining() >= temp.chunkSize) {
+			temp.data = buf.Skip(temp.chunkSize);
 			chunks.push_back(temp);
 		} else {
 			// defective, ignore
@@ -189,18 +222,22 @@ Packet::Packet(const unsigned char* data, unsigned length)
 	}
 }
 
-Packet::Packet(int _lastContinuous, int _nak)
-	: lastContinuous(_lastContinuous)
-	, nakType(_nak)
+void Packet::Reset(int _lastContinuous, int _nak)
 {
+	lastContinuous = _lastContinuous;
+	nakType = _nak;
+	checksum = 0;
+
+	naks.clear();
+	chunks.clear();
 }
 
 unsigned Packet::GetSize() const {
 
 	unsigned size = headerSize + naks.size();
 
-	for (auto chk = chunks.begin(); chk != chunks.end(); ++chk)
-		size += (*chk)->GetSize();
+	for (const Chunk& chunk: chunks)
+		size += chunk.GetSize();
 
 	return size;
 }
@@ -214,28 +251,28 @@ std::uint8_t Packet::GetChecksum() const {
 	if (!naks.empty())
 		crc.Update(&naks[0], naks.size());
 
-	for (auto chk = chunks.begin(); chk != chunks.end(); ++chk)
-		(*chk)->UpdateChecksum(crc);
+	for (const Chunk& chunk: chunks)
+		chunk.UpdateChecksum(crc);
 
 	return (std::uint8_t)crc.GetDigest();
 }
 
-void Packet::Serialize(std::vector<std::uint8_t>& data)
+unsigned Packet::Serialize(std::uint8_t* data) const
 {
-	data.reserve(GetSize());
 	Packer buf(data);
 	buf.Pack(lastContinuous);
 	buf.Pack(nakType);
 	buf.Pack(checksum);
-	buf.Pack(naks);
+	buf.Pack(naks.data(), naks.size());
 
-	for (auto ci = chunks.begin(); ci != chunks.end(); ++ci) {
-		buf.Pack((*ci)->chunkNumber);
-		buf.Pack((*ci)->chunkSize);
-		buf.Pack((*ci)->data);
+	for (const Chunk& chunk: chunks) {
+		buf.Pack(chunk.chunkNumber);
+		buf.Pack(chunk.chunkSize);
+		buf.Pack(chunk.data, chunk.chunkSize);
 	}
-}
 
+	return buf.GetPos();
+}
 
 
 
@@ -273,6 +310,7 @@ void UDPConnection::Init()
 	// make sure protocoldef is initialized
 	CBaseNetProtocol::Get();
 
+	createTime = spring_gettime();
 	lastNakTime = spring_gettime();
 	lastUnackResentTime = spring_gettime();
 	lastPacketSendTime = spring_gettime();
@@ -297,21 +335,27 @@ void UDPConnection::Init()
 	numEmptyGetDataCalls = 0;
 	numTotalGetDataCalls = 0;
 	#endif
-	currentPacketChunkNum = 0;
+	firstNewChunk = 0;
 
 	lastNak = -1;
 	sentOverhead = 0;
 	recvOverhead = 0;
-	fragmentBuffer = 0;
 	resentChunks = 0;
 	sentPackets = recvPackets = 0;
+	sentBundles = recvBundles = 0;
+	sentBundleBytes = recvBundleBytes = 0;
+	sentBundledBytes = recvBundledBytes = 0;
 	droppedChunks = 0;
 	mtu = globalConfig->mtu;
+	sendBuffer.resize(std::max(mtu, udpMaxPacketSize));
 	reconnectTime = globalConfig->reconnectTimeout;
 
 	muted = true;
 	closed = false;
 	resend = false;
+	compressOutgoing = false;
+
+	logMessages = false;
 
 	#ifndef UNIT_TEST
 	logMessages = configHandler->GetBool("UDPConnectionLogDebugMessages");
@@ -339,11 +383,9 @@ void UDPConnection::InitConnection(ip::udp::endpoint address, std::shared_ptr<ip
 
 UDPConnection::~UDPConnection()
 {
-	delete fragmentBuffer;
 	for (auto &it: waitingPackets)
 		delete it.second;
 
-	fragmentBuffer = NULL;
 	Flush(true);
 }
 
@@ -443,12 +485,14 @@ void UDPConnection::Update()
 		size_t bytesAvail = 0;
 
 		while ((bytesAvail = mySocket->available()) > 0) {
-			std::vector<std::uint8_t> buffer(bytesAvail, 0);
+			// only ever grows, datagrams are parsed in place
+			recvBuffer.resize(std::max(recvBuffer.size(), bytesAvail));
+
 			ip::udp::endpoint sender_endpoint;
 			ip::udp::socket::message_flags flags = 0;
 			asio::error_code err;
 
-			const size_t bytesReceived = mySocket->receive_from(asio::buffer(buffer), sender_endpoint, flags, err);
+			const size_t bytesReceived = mySocket->receive_from(asio::buffer(recvBuffer), sender_endpoint, flags, err);
 
 			if (CheckErrorCode(err))
 				break;
@@ -456,10 +500,10 @@ void UDPConnection::Update()
 			if (bytesReceived < Packet::headerSize)
 				continue;
 
-			Packet data(&buffer[0], bytesReceived);
+			recvPacket.Parse(&recvBuffer[0], bytesReceived);
 
 			if (IsUsingAddress(sender_endpoint))
-				ProcessRawPacket(data);
+				ProcessRawPacket(recvPacket);
 
 			// not likely, but make sure we do not get stuck here
 			if ((spring_gettime() - curTime) > spring_msecs(10)) {
@@ -492,26 +536,32 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 		return;
 	}
 
+	// only chunks that were sent and not yet acked count here, not the
+	// queued ones from firstNewChunk on which the peer never saw
+	const bool haveUnacked = (firstNewChunk > sendWindow.GetFirstNumber());
+
 	if (incoming.lastContinuous < 0 && lastInOrder >= 0 &&
-		(unackedChunks.empty() || unackedChunks[0]->chunkNumber > 0)) {
+		(!haveUnacked || sendWindow.GetFirstNumber() > 0)) {
 		LOG_L(L_WARNING, "Discarding superfluous reconnection attempt");
 		return;
 	}
 
 	AckChunks(incoming.lastContinuous);
 
-	if (!unackedChunks.empty()) {
+	// chunks in the window below firstNewChunk are the ones that were sent
+	const int numUnacked = firstNewChunk - sendWindow.GetFirstNumber();
+
+	if (numUnacked > 0) {
 		const int nextCont = incoming.lastContinuous + 1;
-		const int unAckDiff = unackedChunks[0]->chunkNumber - nextCont;
+		const int unAckDiff = sendWindow.GetFirstNumber() - nextCont;
 
 		if (-256 <= unAckDiff && unAckDiff <= 256) {
 			if (incoming.nakType < 0) {
 				for (int i = 0; i != -incoming.nakType; ++i) {
 					const int unAckPos = i + unAckDiff;
 
-					if (unAckPos >= 0 && unAckPos < unackedChunks.size()) {
-						assert(unackedChunks[unAckPos]->chunkNumber == nextCont + i);
-						RequestResend(unackedChunks[unAckPos]);
+					if (unAckPos >= 0 && unAckPos < numUnacked) {
+						RequestResend(sendWindow.GetFirstNumber() + unAckPos);
 					}
 				}
 			} else if (incoming.nakType > 0) {
@@ -523,15 +573,14 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 
 					while (unAckPos < unAckDiff + incoming.naks[i]) {
 						// if there are gaps in the array, assume that further resends are not needed
-						if (unAckPos < unackedChunks.size())
-							resendRequested.erase(unackedChunks[unAckPos]->chunkNumber);
+						if (unAckPos < numUnacked)
+							CancelResend(sendWindow.GetFirstNumber() + unAckPos);
 
 						++unAckPos;
 					}
 
-					if (unAckPos < unackedChunks.size()) {
-						assert(unackedChunks[unAckPos]->chunkNumber == nextCont + incoming.naks[i]);
-						RequestResend(unackedChunks[unAckPos]);
+					if (unAckPos < numUnacked) {
+						RequestResend(sendWindow.GetFirstNumber() + unAckPos);
 					}
 
 					++unAckPos;
@@ -540,36 +589,30 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 		}
 	}
 
-	for (auto ci = incoming.chunks.begin(); ci != incoming.chunks.end(); ++ci) {
-		const std::shared_ptr<netcode::Chunk>& c = *ci;
-
-		if ((lastInOrder >= c->chunkNumber) || (waitingPackets.find(c->chunkNumber) != waitingPackets.end())) {
+	for (const Chunk& c: incoming.chunks) {
+		if ((lastInOrder >= c.chunkNumber) || (waitingPackets.find(c.chunkNumber) != waitingPackets.end())) {
 			++droppedChunks;
 			continue;
 		}
 
-		waitingPackets.emplace(c->chunkNumber, new RawPacket(&c->data[0], c->data.size()));
+		waitingPackets.emplace(c.chunkNumber, new RawPacket(c.data, c.chunkSize));
 	}
 
 	packetMap::iterator wpi;
 
 	// process all in order packets that we have waiting
 	while ((wpi = waitingPackets.find(lastInOrder + 1)) != waitingPackets.end()) {
-		std::vector<std::uint8_t> buf;
-
-		if (fragmentBuffer != NULL) {
-			buf.resize(fragmentBuffer->length);
-			// combine with fragment buffer (packet reassembly)
-			std::copy(fragmentBuffer->data, fragmentBuffer->data + fragmentBuffer->length, buf.begin());
-			delete fragmentBuffer;
-			fragmentBuffer = NULL;
-		}
+		// combine with fragment buffer (packet reassembly)
+		std::vector<std::uint8_t>& buf = fragmentBuffer;
 
 		lastInOrder++;
-		std::copy(wpi->second->data, wpi->second->data + wpi->second->length, std::back_inserter(buf));
+		buf.insert(buf.end(), wpi->second->data, wpi->second->data + wpi->second->length);
+		delete wpi->second;
 		waitingPackets.erase(wpi);
 
-		for (unsigned pos = 0; pos < buf.size(); ) {
+		unsigned pos = 0;
+
+		while (pos < buf.size()) {
 			const unsigned char* bufp = &buf[pos];
 			const unsigned msglength = buf.size() - pos;
 
@@ -577,38 +620,11 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 
 			// this returns false for zero/invalid pktlength
 			if (ProtocolDef::GetInstance()->IsValidLength(pktlength, msglength)) {
-				msgQueue.push_back(std::shared_ptr<const RawPacket>(new RawPacket(bufp, pktlength)));
-
-				#ifdef ENABLE_DEBUG_STATS
-				// server sends both of these, clients send only keyframe messages
-				// TODO: would be easy to feed this data into a Q3A-style lagometer
-				//
-				if ((msgQueue.back())->data[0] == NETMSG_NEWFRAME || (msgQueue.back())->data[0] == NETMSG_KEYFRAME) {
-					const spring_time dt = spring_gettime() - lastFramePacketRecvTime;
-
-					sumDeltaFramePacketRecvTime += dt.toMilliSecsf();
-					minDeltaFramePacketRecvTime = std::min(dt.toMilliSecsf(), minDeltaFramePacketRecvTime);
-					maxDeltaFramePacketRecvTime = std::max(dt.toMilliSecsf(), maxDeltaFramePacketRecvTime);
-
-					numReceivedFramePackets += 1;
-					numEnqueuedFramePackets += 1;
-					lastFramePacketRecvTime = spring_gettime();
-
-					if (logMessages) {
-						LOG_L(L_INFO,
-							"\t[%s] (received=%u enqueued=%u) packets (dt=%fms mindt=%fms maxdt=%fms sumdt=%fms)",
-							__FUNCTION__, numReceivedFramePackets, numEnqueuedFramePackets, dt.toMilliSecsf(),
-							minDeltaFramePacketRecvTime, maxDeltaFramePacketRecvTime, sumDeltaFramePacketRecvTime
-						);
-					}
-				}
-				#endif
-
+				EnqueueMessage(bufp, pktlength);
 				pos += pktlength;
 			} else {
 				if (pktlength >= 0) {
-					// partial packet in buffer
-					fragmentBuffer = new RawPacket(bufp, msglength);
+					// partial packet in buffer, kept for the next chunk
 					break;
 				}
 
@@ -619,9 +635,186 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 				++pos;
 			}
 		}
+
+		buf.erase(buf.begin(), buf.begin() + pos);
 	}
 }
 
+void UDPConnection::EnqueueMessage(const std::uint8_t* data, unsigned length)
+{
+	if (data[0] != NETMSG_COMPRESSED) {
+		msgQueue.push_back(std::shared_ptr<const RawPacket>(new RawPacket(data, length)));
+
+		#ifdef ENABLE_DEBUG_STATS
+		// server sends both of these, clients send only keyframe messages
+		// TODO: would be easy to feed this data into a Q3A-style lagometer
+		//
+		if ((msgQueue.back())->data[0] == NETMSG_NEWFRAME || (msgQueue.back())->data[0] == NETMSG_KEYFRAME) {
+			const spring_time dt = spring_gettime() - lastFramePacketRecvTime;
+
+			sumDeltaFramePacketRecvTime += dt.toMilliSecsf();
+			minDeltaFramePacketRecvTime = std::min(dt.toMilliSecsf(), minDeltaFramePacketRecvTime);
+			maxDeltaFramePacketRecvTime = std::max(dt.toMilliSecsf(), maxDeltaFramePacketRecvTime);
+
+			numReceivedFramePackets += 1;
+			numEnqueuedFramePackets += 1;
+			lastFramePacketRecvTime = spring_gettime();
+
+			if (logMessages) {
+				LOG_L(L_INFO,
+					"\t[%s] (received=%u enqueued=%u) packets (dt=%fms mindt=%fms maxdt=%fms sumdt=%fms)",
+					__FUNCTION__, numReceivedFramePackets, numEnqueuedFramePackets, dt.toMilliSecsf(),
+					minDeltaFramePacketRecvTime, maxDeltaFramePacketRecvTime, sumDeltaFramePacketRecvTime
+				);
+			}
+		}
+		#endif
+
+		return;
+	}
+
+	std::uint16_t rawLength = 0;
+
+	if (length >= bundleHeaderSize)
+		memcpy(&rawLength, data + 1 + sizeof(std::uint16_t), sizeof(rawLength));
+
+	// the other end sends bundles, so it can unpack ours too
+	compressOutgoing |= globalConfig->linkCompression;
+
+	recvBundles += 1;
+	recvBundleBytes += length;
+
+	// an empty bundle only announces the above, see SetCompression
+	if (rawLength == 0)
+		return;
+
+	uLongf unpackedLength = rawLength;
+	bundleBuffer.resize(rawLength);
+
+	if (uncompress(&bundleBuffer[0], &unpackedLength, data + bundleHeaderSize, length - bundleHeaderSize) != Z_OK || unpackedLength != rawLength) {
+		LOG_L(L_ERROR, "Discarding incoming invalid bundle: LEN %u, RAWLEN %u", length, rawLength);
+		return;
+	}
+
+	recvBundledBytes += rawLength;
+
+	for (unsigned pos = 0; pos < rawLength; ) {
+		const std::uint8_t* msg = &bundleBuffer[pos];
+		const int msgLength = ProtocolDef::GetInstance()->PacketLength(msg, rawLength - pos);
+
+		// bundles are never nested, and never split a message
+		if (!ProtocolDef::GetInstance()->IsValidLength(msgLength, rawLength - pos) || msg[0] == NETMSG_COMPRESSED) {
+			LOG_L(L_ERROR, "Discarding rest of incoming bundle: ID %d, LEN %d", (int)msg[0], msgLength);
+			return;
+		}
+
+		EnqueueMessage(msg, msgLength);
+		pos += msgLength;
+	}
+}
+
+void UDPConnection::SetCompression(bool enable)
+{
+	if (enable && !compressOutgoing) {
+		// an empty bundle, tells the other end it may send us bundles as well
+		const std::uint16_t msgLength = bundleHeaderSize;
+		const std::uint16_t rawLength = 0;
+
+		RawPacket* packet = new RawPacket(bundleHeaderSize);
+		packet->data[0] = NETMSG_COMPRESSED;
+		memcpy(packet->data + 1, &msgLength, sizeof(msgLength));
+		memcpy(packet->data + 1 + sizeof(msgLength), &rawLength, sizeof(rawLength));
+
+		outgoingData.push_back(std::shared_ptr<const RawPacket>(packet));
+
+		sentBundles += 1;
+		sentBundleBytes += bundleHeaderSize;
+	}
+
+	compressOutgoing = enable;
+}
+
+void UDPConnection::CompressOutgoingData()
+{
+	unsigned outgoingLength = 0;
+
+	for (const std::shared_ptr<const RawPacket>& packet: outgoingData) {
+		outgoingLength += packet->length;
+	}
+
+	if (outgoingLength < minBundleLength)
+		return;
+
+	packetList bundledData;
+
+	// replaces [runStart, runEnd) by a bundle if that is smaller
+	const auto CloseRun = [&](packetList::const_iterator runStart, packetList::const_iterator runEnd, unsigned runLength) {
+		if (runLength >= minBundleLength) {
+			bundleBuffer.resize(runLength);
+
+			unsigned pos = 0;
+
+			for (auto it = runStart; it != runEnd; ++it) {
+				memcpy(&bundleBuffer[pos], (*it)->data, (*it)->length);
+				pos += (*it)->length;
+			}
+
+			uLongf packedLength = compressBound(runLength);
+			compressBuffer.resize(packedLength);
+
+			if (compress2(&compressBuffer[0], &packedLength, &bundleBuffer[0], runLength, Z_BEST_SPEED) == Z_OK && (bundleHeaderSize + packedLength) < runLength) {
+				const std::uint16_t msgLength = bundleHeaderSize + packedLength;
+				const std::uint16_t rawLength = runLength;
+
+				RawPacket* packet = new RawPacket(msgLength);
+				packet->data[0] = NETMSG_COMPRESSED;
+				memcpy(packet->data + 1, &msgLength, sizeof(msgLength));
+				memcpy(packet->data + 1 + sizeof(msgLength), &rawLength, sizeof(rawLength));
+				memcpy(packet->data + bundleHeaderSize, &compressBuffer[0], packedLength);
+
+				bundledData.push_back(std::shared_ptr<const RawPacket>(packet));
+
+				sentBundles += 1;
+				sentBundleBytes += msgLength;
+				sentBundledBytes += runLength;
+				return;
+			}
+		}
+
+		bundledData.insert(bundledData.end(), runStart, runEnd);
+	};
+
+	packetList::const_iterator runStart = outgoingData.begin();
+	unsigned runLength = 0;
+
+	for (packetList::const_iterator it = outgoingData.begin(); it != outgoingData.end(); ++it) {
+		const RawPacket* packet = it->get();
+
+		// invalid messages are left for Flush to discard, bundles are never nested
+		const bool bundleable =
+			(packet->length <= maxBundleLength) &&
+			(packet->data[0] != NETMSG_COMPRESSED) &&
+			ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length);
+
+		if (!bundleable || (runLength + packet->length) > maxBundleLength) {
+			CloseRun(runStart, it, runLength);
+			runStart = it;
+			runLength = 0;
+		}
+
+		if (!bundleable) {
+			bundledData.push_back(*it);
+			runStart = it + 1;
+			continue;
+		}
+
+		runLength += packet->length;
+	}
+
+	CloseRun(runStart, outgoingData.end(), runLength);
+	outgoingData.swap(bundledData);
+}
+
 void UDPConnection::Flush(const bool forced)
 {
 	if (muted)
@@ -642,6 +835,9 @@ void UDPConnection::Flush(const bool forced)
 	}
 
 	if (forced || (!waitMore && outgoingLength > requiredLength)) {
+		if (compressOutgoing)
+			CompressOutgoingData();
+
 		std::uint8_t buffer[udpMaxPacketSize];
 		unsigned pos = 0;
 
@@ -651,12 +847,15 @@ void UDPConnection::Flush(const bool forced)
 		bool partialPacket = false;
 		bool sendMore = true;
 
+		// bytes of the front packet that went into earlier chunks
+		unsigned packetOffset = 0;
+
 		do {
 			sendMore  = (outgoing.GetAverage(true) <= globalConfig->linkOutgoingBandwidth);
 			sendMore |= ((globalConfig->linkOutgoingBandwidth <= 0) || partialPacket || forced);
 
 			if (!outgoingData.empty() && sendMore) {
-				std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
+				const std::shared_ptr<const RawPacket>& packet = outgoingData.front();
 
 				if (!partialPacket && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
 					LOG_L(L_ERROR,
@@ -665,25 +864,26 @@ void UDPConnection::Flush(const bool forced)
 						packet->length);
 					outgoingData.pop_front();
 				} else {
-					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length);
+					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length - packetOffset);
 
 					assert(packet->length > 0);
-					memcpy(buffer + pos, packet->data, numBytes);
+					memcpy(buffer + pos, packet->data + packetOffset, numBytes);
 					pos += numBytes;
 					outgoing.DataSent(numBytes, true);
-					partialPacket = (numBytes != packet->length);
+					partialPacket = (numBytes != (packet->length - packetOffset));
 
 					if (partialPacket) {
 						// partially transfered
-						packet.reset(new RawPacket(packet->data + numBytes, packet->length - numBytes));
+						packetOffset += numBytes;
 					} else {
 						// full packet copied
 						outgoingData.pop_front();
+						packetOffset = 0;
 					}
 				}
 			}
 			if ((pos > 0) && (outgoingData.empty() || (pos == maxChunkSize) || !sendMore)) {
-				CreateChunk(buffer, pos, currentPacketChunkNum++);
+				CreateChunk(buffer, pos, sendWindow.GetEndNumber());
 				pos = 0;
 			}
 		} while (!outgoingData.empty() && sendMore);
@@ -729,11 +929,15 @@ bool UDPConnection::CanReconnect() const {
 
 std::string UDPConnection::Statistics() const
 {
+	const float secs = (spring_gettime() - createTime).toSecsf();
+
 	std::string msg = "Statistics for UDP connection:\n";
-	msg += spring::format("Received: %u bytes in %u packets (%f bytes/package)\n",
-			dataRecv, recvPackets, SafeDivide(dataRecv, recvPackets));
-	msg += spring::format("Sent: %u bytes in %u packets (%f bytes/package)\n",
-			dataSent, sentPackets, SafeDivide(dataSent, sentPackets));
+	msg += spring::format("Received: %u bytes in %u packets (%f bytes/package, %.1f bytes/s, %.1f packets/s)\n",
+			dataRecv, recvPackets, SafeDivide(dataRecv, recvPackets), SafeDivide(dataRecv, secs), SafeDivide(recvPackets, secs));
+	msg += spring::format("Sent: %u bytes in %u packets (%f bytes/package, %.1f bytes/s, %.1f packets/s)\n",
+			dataSent, sentPackets, SafeDivide(dataSent, sentPackets), SafeDivide(dataSent, secs), SafeDivide(sentPackets, secs));
+	msg += spring::format("Compression %s: %u bundles received (%u bytes unpacked to %u), %u sent (%u bytes packed to %u)\n",
+			(compressOutgoing? "on": "off"), recvBundles, recvBundleBytes, recvBundledBytes, sentBundles, sentBundledBytes, sentBundleBytes);
 	msg += spring::format("Relative protocol overhead: %f up, %f down\n",
 			SafeDivide(sentOverhead, dataSent), SafeDivide(recvOverhead, dataRecv) );
 	msg += spring::format("%u incoming chunks dropped, %u outgoing chunks resent\n",
@@ -761,11 +965,8 @@ void UDPConnection::SetMTU(unsigned mtu2)
 void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
 {
 	assert((length > 0) && (length < 255));
-	ChunkPtr buf(new Chunk);
-	buf->chunkNumber = packetNum;
-	buf->chunkSize = length;
-	std::copy(data, data+length, std::back_inserter(buf->data));
-	newChunks.push_back(buf);
+	assert(packetNum == sendWindow.GetEndNumber());
+	sendWindow.Push(data, length);
 	lastChunkCreatedTime = spring_gettime();
 }
 
@@ -809,58 +1010,57 @@ void UDPConnection::SendIfNecessary(bool flushed)
 		}
 	}
 
-	if (!unackedChunks.empty() &&
+	const std::int32_t endChunk = sendWindow.GetEndNumber();
+
+	if ((firstNewChunk != sendWindow.GetFirstNumber()) &&
 		(curTime - lastChunkCreatedTime) > spring_msecs(400 >> netLossFactor) &&
 		(curTime - lastUnackResentTime) > spring_msecs(400 >> netLossFactor)) {
 		// resend last packet if we didn't get an ack within reasonable time
 		// and don't plan sending out a new chunk either
-		if (newChunks.empty())
-			RequestResend(*unackedChunks.rbegin());
+		if (firstNewChunk == endChunk)
+			RequestResend(firstNewChunk - 1);
 		lastUnackResentTime = curTime;
 	}
 
-	if (flushed || !newChunks.empty() || (netLossFactor == MIN_LOSS_FACTOR && !resendRequested.empty()) || (nak > 0) || (curTime - lastPacketSendTime) > spring_msecs(200 >> netLossFactor))
+	if (flushed || (firstNewChunk != endChunk) || (netLossFactor == MIN_LOSS_FACTOR && !resendRequested.empty()) || (nak > 0) || (curTime - lastPacketSendTime) > spring_msecs(200 >> netLossFactor))
 	{
 		bool todo = true;
 
 		int maxResend = resendRequested.size();
-		int unackPrevSize = unackedChunks.size();
+		const std::int32_t prevFirstNewChunk = firstNewChunk;
+
+		// positions in resendRequested; resRevIdx counts down from the back
+		int resIdx = 0;
+		int resMidIdx = 0, resMidIdxStart = 0, resMidIdxEnd = 0;
+		int resRevIdx = resendRequested.size() - 1;
 
-		std::map<std::int32_t, ChunkPtr>::iterator resIter = resendRequested.begin();
-		std::map<std::int32_t, ChunkPtr>::iterator resMidIter, resMidIterStart, resMidIterEnd;
-		std::map<std::int32_t, ChunkPtr>::reverse_iterator resRevIter;
+		const int numResend = resendRequested.size();
 
 		if (netLossFactor != MIN_LOSS_FACTOR) {
 			maxResend = std::min(maxResend, 20 * netLossFactor); // keep it reasonable, or it could cause a tremendous flood of packets
 
-			resMidIter = resendRequested.begin();
-			resMidIterStart = resendRequested.begin();
-			resMidIterEnd = resendRequested.end();
-			resRevIter = resendRequested.rbegin();
-
 			const int resMidStart = (maxResend + 3) / 4;
 			const int resMidEnd = (maxResend + 2) / 4;
 
-			for (int i = 0; i < resMidStart; ++i)
-				++resMidIterStart;
-			if (resMidIterStart != resendRequested.end() && lastMidChunk < resMidIterStart->first)
-				lastMidChunk = resMidIterStart->first - 1;
+			resMidIdxStart = resMidStart;
+			if (resMidIdxStart != numResend && lastMidChunk < resendRequested[resMidIdxStart])
+				lastMidChunk = resendRequested[resMidIdxStart] - 1;
 
-			for (int i = 0; i < resMidEnd; ++i)
-				--resMidIterEnd;
+			resMidIdxEnd = numResend - resMidEnd;
 
-			while (resMidIter != resendRequested.end() && resMidIter->first <= lastMidChunk)
-				++resMidIter;
+			while (resMidIdx != numResend && resendRequested[resMidIdx] <= lastMidChunk)
+				++resMidIdx;
 
-			if (resMidIter == resendRequested.end() || resMidIterEnd == resendRequested.end() ||
-				resMidIter->first >= resMidIterEnd->first)
-				resMidIter = resMidIterStart;
+			if (resMidIdx == numResend || resMidIdxEnd == numResend ||
+				resendRequested[resMidIdx] >= resendRequested[resMidIdxEnd])
+				resMidIdx = resMidIdxStart;
 		}
 
 		int rev = 0;
 
 		while (todo && ((outgoing.GetAverage() <= globalConfig->linkOutgoingBandwidth) || (globalConfig->linkOutgoingBandwidth <= 0))) {
-			Packet buf(lastInOrder, nak);
+			Packet& buf = sendPacket;
+			buf.Reset(lastInOrder, nak);
 
 			if (nak > 0) {
 				buf.naks.resize(nak);
@@ -875,9 +1075,9 @@ void UDPConnection::SendIfNecessary(bool flushed)
 			while (true) {
 				bool canResend = maxResend > 0 &&
 					((buf.GetSize() +
-					(((netLossFactor == MIN_LOSS_FACTOR) || (rev == 0)) ? resIter->second->GetSize() : ((rev == 1) ? resRevIter->second->GetSize() : resMidIter->second->GetSize())) // resend chunk size
+					sendWindow.Get(resendRequested[((netLossFactor == MIN_LOSS_FACTOR) || (rev == 0)) ? resIdx : ((rev == 1) ? resRevIdx : resMidIdx)]).GetSize() // resend chunk size
 					) <= mtu);
-				bool canSendNew = !newChunks.empty() && ((buf.GetSize() + newChunks[0]->GetSize()) <= mtu);
+				bool canSendNew = (firstNewChunk != endChunk) && ((buf.GetSize() + sendWindow.Get(firstNewChunk).GetSize()) <= mtu);
 
 				if (!canResend && !canSendNew)
 					break;
@@ -887,28 +1087,26 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 				if (resend && canResend) {
 					if (netLossFactor == MIN_LOSS_FACTOR) {
-						buf.chunks.push_back(resIter->second);
-						resIter = resendRequested.erase(resIter);
+						// sent ones are removed from the front once we are done
+						buf.chunks.push_back(sendWindow.Get(resendRequested[resIdx++]));
 					} else {
 						// on a lossy connection, just keep resending until it is acked
 						switch(rev) {
 							case 0:
-								buf.chunks.push_back(resIter->second);
-								++resIter;
+								buf.chunks.push_back(sendWindow.Get(resendRequested[resIdx++]));
 								break;
 								// alternate between sending from front, middle and back of list of requested chunks,
 							case 1:
-								buf.chunks.push_back(resRevIter->second);
-								++resRevIter;
+								buf.chunks.push_back(sendWindow.Get(resendRequested[resRevIdx--]));
 								break;
 								// since this improves performance on high latency connections
 							case 2:
 							case 3:
-								buf.chunks.push_back(resMidIter->second);
-								lastMidChunk = resMidIter->first;
-								++resMidIter;
-								if (resMidIter == resMidIterEnd)
-									resMidIter = resMidIterStart;
+								buf.chunks.push_back(sendWindow.Get(resendRequested[resMidIdx]));
+								lastMidChunk = resendRequested[resMidIdx];
+								++resMidIdx;
+								if (resMidIdx == resMidIdxEnd)
+									resMidIdx = resMidIdxStart;
 								break;
 						}
 						rev = (rev + 1) % 4;
@@ -917,13 +1115,11 @@ void UDPConnection::SendIfNecessary(bool flushed)
 					--maxResend;
 					sent = true;
 				} else if (!resend && canSendNew) {
-					buf.chunks.push_back(newChunks[0]);
-					unackedChunks.push_back(newChunks[0]);
-					newChunks.pop_front();
+					buf.chunks.push_back(sendWindow.Get(firstNewChunk++));
 					sent = true;
 				}
 			}
-			if (!sent || (maxResend == 0 && newChunks.empty()))
+			if (!sent || (maxResend == 0 && firstNewChunk == endChunk))
 				todo = false;
 			buf.checksum = buf.GetChecksum();
 			EMULATE_PACKET_CORRUPTION(buf.checksum);
@@ -931,50 +1127,64 @@ void UDPConnection::SendIfNecessary(bool flushed)
 			SendPacket(buf);
 		}
 
-		if (netLossFactor != MIN_LOSS_FACTOR) {
+		if (netLossFactor == MIN_LOSS_FACTOR) {
+			resendRequested.erase(resendRequested.begin(), resendRequested.begin() + resIdx);
+		} else {
 			// on a lossy connection the packet will be sent multiple times
-			for (int i = unackPrevSize; i < unackedChunks.size(); ++i)
-				RequestResend(unackedChunks[i]);
+			for (std::int32_t n = prevFirstNewChunk; n < firstNewChunk; ++n)
+				RequestResend(n);
 		}
 	}
 }
 
 void UDPConnection::SendPacket(Packet& pkt)
 {
-	std::vector<std::uint8_t> data;
-	pkt.Serialize(data);
+	sendBuffer.resize(std::max<size_t>(sendBuffer.size(), pkt.GetSize()));
+
+	// serialized straight into the reused datagram buffer
+	const std::uint8_t* data = &sendBuffer[0];
+	const unsigned size = pkt.Serialize(&sendBuffer[0]);
 
-	outgoing.DataSent(data.size());
+	outgoing.DataSent(size);
 	lastPacketSendTime = spring_gettime();
 	ip::udp::socket::message_flags flags = 0;
 	asio::error_code err;
 
 	EMULATE_LATENCY( !EMULATE_PACKET_LOSS( LOSS_COUNTER ) ) {
-		mySocket->send_to(buffer(data), addr, flags, err);
+		mySocket->send_to(buffer(data, size), addr, flags, err);
 	}
 
 	if (CheckErrorCode(err))
 		return;
 
-	dataSent += data.size();
+	dataSent += size;
 	++sentPackets;
 }
 
 void UDPConnection::AckChunks(int lastAck)
 {
-	while (!unackedChunks.empty() && (lastAck >= (*unackedChunks.begin())->chunkNumber))
-		unackedChunks.pop_front();
+	while ((firstNewChunk != sendWindow.GetFirstNumber()) && (lastAck >= sendWindow.GetFirstNumber()))
+		sendWindow.PopFront();
 
 	// resend requested and later acked, happens every now and then
-	while (!resendRequested.empty() && lastAck >= resendRequested.begin()->first)
-		resendRequested.erase(resendRequested.begin());
+	resendRequested.erase(resendRequested.begin(), std::upper_bound(resendRequested.begin(), resendRequested.end(), lastAck));
 }
 
-void UDPConnection::RequestResend(ChunkPtr ptr)
+void UDPConnection::RequestResend(std::int32_t chunkNumber)
 {
 	// filter out duplicates
-	if (resendRequested.find(ptr->chunkNumber) == resendRequested.end())
-		resendRequested[ptr->chunkNumber] = ptr;
+	const auto it = std::lower_bound(resendRequested.begin(), resendRequested.end(), chunkNumber);
+
+	if (it == resendRequested.end() || *it != chunkNumber)
+		resendRequested.insert(it, chunkNumber);
+}
+
+void UDPConnection::CancelResend(std::int32_t chunkNumber)
+{
+	const auto it = std::lower_bound(resendRequested.begin(), resendRequested.end(), chunkNumber);
+
+	if (it != resendRequested.end() && *it == chunkNumber)
+		resendRequested.erase(it);
 }
 
 UDPConnection::BandwidthUsage::BandwidthUsage()
@@ -4,10 +4,11 @@
 #define _UDP_CONNECTION_H
 
 #include <asio/ip/udp.hpp>
+#include <cassert>
 #include <map>
 #include <memory>
 #include <deque>
-#include <list>
+#include <vector>
 
 #include "Connection.h"
 #include "System/Misc/SpringTime.h"
@@ -27,38 +28,98 @@ namespace netcode {
 #define PACKET_MAX_LATENCY 1250               // in [milliseconds] maximum latency
 #define ENABLE_DEBUG_STATS
 
+/**
+ * A chunk as it is laid out in a datagram. The data is not owned, it points
+ * into either a slot of the sender's ChunkWindow or a received datagram.
+ */
 class Chunk
 {
 public:
-	unsigned GetSize() const { return (data.size() + headerSize); }
+	unsigned GetSize() const { return (chunkSize + headerSize); }
 	void UpdateChecksum(CRC& crc) const;
 	static const unsigned maxSize = 254;
 	static const unsigned headerSize = 5;
 	std::int32_t chunkNumber;
 	std::uint8_t chunkSize;
-	std::vector<std::uint8_t> data;
+	const std::uint8_t* data;
+};
+
+/**
+ * Chunks that were created but not yet acked by the other side, indexed
+ * by their (continuous) chunk number. Slots including their data are kept
+ * in a ring and reused, so storage only grows when more chunks are in
+ * flight than ever before on this connection.
+ */
+class ChunkWindow
+{
+public:
+	ChunkWindow(): firstNumber(0), endNumber(0) {}
+
+	bool empty() const { return (firstNumber == endNumber); }
+	unsigned size() const { return (endNumber - firstNumber); }
+
+	/// number of the oldest chunk in the window
+	std::int32_t GetFirstNumber() const { return firstNumber; }
+	/// number the next pushed chunk will get
+	std::int32_t GetEndNumber() const { return endNumber; }
+
+	bool Contains(std::int32_t chunkNumber) const { return (chunkNumber >= firstNumber && chunkNumber < endNumber); }
+
+	Chunk Get(std::int32_t chunkNumber) const {
+		assert(Contains(chunkNumber));
+		const Slot& slot = GetSlot(chunkNumber);
+		return {chunkNumber, slot.size, slot.data};
+	}
+
+	void Push(const std::uint8_t* data, unsigned length);
+	void PopFront() { assert(!empty()); ++firstNumber; }
+
+private:
+	struct Slot {
+		std::uint8_t size;
+		std::uint8_t data[Chunk::maxSize];
+	};
+
+	// slots.size() is always zero or a power of two
+	const Slot& GetSlot(std::int32_t chunkNumber) const { return slots[chunkNumber & (slots.size() - 1)]; }
+	      Slot& GetSlot(std::int32_t chunkNumber)       { return slots[chunkNumber & (slots.size() - 1)]; }
+
+	void Grow();
+
+private:
+	std::vector<Slot> slots;
+
+	std::int32_t firstNumber;
+	std::int32_t endNumber;
 };
-typedef std::shared_ptr<Chunk> ChunkPtr;
 
 class Packet
 {
 public:
 	static const unsigned headerSize = 6;
-	Packet(const unsigned char* data, unsigned length);
-	Packet(int lastContinuous, int nak);
+	Packet(): lastContinuous(-1), nakType(0), checksum(0) {}
+	/// the chunks keep pointing into <data>
+	Packet(const unsigned char* data, unsigned length) { Parse(data, length); }
+	Packet(int lastContinuous, int nak) { Reset(lastContinuous, nak); }
+
+	/// reuse this packet (and its storage) for a received datagram
+	void Parse(const unsigned char* data, unsigned length);
+	/// reuse this packet (and its storage) for a new outgoing datagram
+	void Reset(int lastContinuous, int nak);
 
 	unsigned GetSize() const;
 
 	std::uint8_t GetChecksum() const;
 
-	void Serialize(std::vector<std::uint8_t>& data);
+	/// writes the datagram to <data>, which must hold GetSize() bytes
+	unsigned Serialize(std::uint8_t* data) const;
 
 	std::int32_t lastContinuous;
 	/// if < 0, we lost -x packets since lastContinuous, if >0, x = size of naks
 	std::int8_t nakType;
 	std::uint8_t checksum;
 	std::vector<std::uint8_t> naks;
-	std::list<ChunkPtr> chunks;
+	std::vector<Chunk> chunks;
 };
 
 /*
@@ -123,6 +184,16 @@ public:
 	void Close(bool flush);
 	void SetLossFactor(int factor);
 
+	/**
+	 * @brief whether runs of outgoing messages may be packed into
+	 *   NETMSG_COMPRESSED bundles, only enable if the other end can unpack them
+	 *
+	 * Enabling also tells the other end that we can unpack its bundles, which
+	 * in turn lets it compress what it sends (if LinkCompression is set there).
+	 */
+	void SetCompression(bool enable);
+	bool GetCompression() const { return compressOutgoing; }
+
 	const asio::ip::udp::endpoint &GetEndpoint() const { return addr; }
 
 private:
@@ -141,9 +212,16 @@ private:
 	void SendIfNecessary(bool flushed);
 	void AckChunks(int lastAck);
 
-	void RequestResend(ChunkPtr ptr);
+	/// replaces runs of outgoing messages by NETMSG_COMPRESSED bundles, where that saves bytes
+	void CompressOutgoingData();
+	/// queues a received message, bundles are unpacked into their messages
+	void EnqueueMessage(const std::uint8_t* data, unsigned length);
+
+	void RequestResend(std::int32_t chunkNumber);
+	void CancelResend(std::int32_t chunkNumber);
 	void SendPacket(Packet& pkt);
 
+	spring_time createTime;
 	spring_time lastChunkCreatedTime;
 	spring_time lastPacketSendTime;
 	spring_time lastPacketRecvTime;
@@ -156,7 +234,7 @@ private:
 	#endif
 
 	typedef std::map<int,RawPacket*> packetMap;
-	typedef std::list< std::shared_ptr<const RawPacket> > packetList;
+	typedef std::deque< std::shared_ptr<const RawPacket> > packetList;
 	/// address of the other end
 	asio::ip::udp::endpoint addr;
 
@@ -168,6 +246,7 @@ private:
 	bool resend;
 	bool sharedSocket;
 	bool logMessages;
+	bool compressOutgoing;
 
 	int netLossFactor;
 	int reconnectTime;
@@ -177,13 +256,22 @@ private:
 	/// packets we have received but not yet read
 	packetMap waitingPackets;
 
-	/// Newly created and not yet sent
-	std::deque<ChunkPtr> newChunks;
-	/// packets the other side did not ack'ed until now
-	std::deque<ChunkPtr> unackedChunks;
+	/**
+	 * Chunks the other side did not ack until now. Those numbered below
+	 * firstNewChunk were sent at least once, the rest are newly created
+	 * and not yet sent.
+	 */
+	ChunkWindow sendWindow;
+	std::int32_t firstNewChunk;
+
+	/// (sorted) numbers of the chunks the other side missed
+	std::vector<std::int32_t> resendRequested;
 
-	/// Packets the other side missed
-	std::map<std::int32_t, ChunkPtr> resendRequested;
+	/// reused for every datagram we send, and received if !sharedSocket
+	Packet sendPacket;
+	Packet recvPacket;
+	std::vector<std::uint8_t> sendBuffer;
+	std::vector<std::uint8_t> recvBuffer;
 
 	/// complete packets we received but did not yet consume
 	std::deque< std::shared_ptr<const RawPacket> > msgQueue;
@@ -202,7 +290,11 @@ private:
 	/// Our socket
 	std::shared_ptr<asio::ip::udp::socket> mySocket;
 
-	RawPacket* fragmentBuffer;
+	/// received bytes of a packet that is not complete yet
+	std::vector<std::uint8_t> fragmentBuffer;
+	/// uncompressed contents of the bundle being packed or unpacked
+	std::vector<std::uint8_t> bundleBuffer;
+	std::vector<std::uint8_t> compressBuffer;
 
 	// Traffic statistics and stuff
 	#ifdef ENABLE_DEBUG_STATS
@@ -215,7 +307,6 @@ private:
 	unsigned int numEmptyGetDataCalls;
 	unsigned int numTotalGetDataCalls;
 	#endif
-	unsigned int currentPacketChunkNum;
 
 	/// packets that are resent
 	unsigned int resentChunks;
@@ -224,6 +315,11 @@ private:
 	unsigned int sentOverhead, recvOverhead;
 	unsigned int sentPackets, recvPackets;
 
+	/// number of bundles, their size and the size of the messages they hold
+	unsigned int sentBundles, recvBundles;
+	unsigned int sentBundleBytes, recvBundleBytes;
+	unsigned int sentBundledBytes, recvBundledBytes;
+
 	class BandwidthUsage {
 	public:
 		BandwidthUsage();
@@ -8,10 +8,18 @@
 #include "System/Misc/NonCopyable.h"
 #include <memory>
 #include <asio.hpp>
+#include <algorithm>
 #include <cinttypes>
 #include <list>
 #include <queue>
 
+#if defined(__linux__)
+	#include <sys/socket.h>
+#endif
+#if !defined(_WIN32)
+	#include <poll.h>
+#endif
+
 
 #include "ProtocolDef.h"
 #include "UDPConnection.h"
@@ -25,8 +33,20 @@ namespace netcode
 {
 using namespace asio;
 
+// largest possible UDP payload, datagrams are never truncated
+static constexpr size_t RECV_SLOT_SIZE = 65536;
+#if defined(__linux__)
+// number of datagrams pulled from the socket per recvmmsg call
+static constexpr size_t RECV_BATCH_SIZE = 16;
+#else
+static constexpr size_t RECV_BATCH_SIZE = 1;
+#endif
+
+
 UDPListener::UDPListener(int port, const std::string& ip)
 	: acceptNewConnections(false)
+	, recvBuffer(RECV_SLOT_SIZE * RECV_BATCH_SIZE)
+	, wakePending(false)
 {
 	SocketPtr socket;
 
@@ -45,6 +65,28 @@ UDPListener::UDPListener(int port, const std::string& ip)
 	} else {
 		throw network_error(err);
 	}
+
+	// wake-ups are empty datagrams sent to ourselves over loopback
+	asio::error_code wakeErr;
+	wakeEndpoint = mySocket->local_endpoint(wakeErr);
+
+	if (!wakeErr && wakeEndpoint.address().is_unspecified()) {
+		if (wakeEndpoint.address().is_v6()) {
+			wakeEndpoint.address(ip::address_v6::loopback());
+		} else {
+			wakeEndpoint.address(ip::address_v4::loopback());
+		}
+	}
+
+	if (!wakeErr) {
+		wakeSocket.reset(new ip::udp::socket(netservice));
+		wakeSocket->open(wakeEndpoint.protocol(), wakeErr);
+	}
+
+	if (wakeErr) {
+		LOG_L(L_WARNING, "[UDPListener] could not open wake-up socket (%s), relying on timeouts", wakeErr.message().c_str());
+		wakeSocket.reset();
+	}
 }
 
 std::string UDPListener::TryBindSocket(int port, SocketPtr* socket, const std::string& ip) {
@@ -108,66 +150,154 @@ std::string UDPListener::TryBindSocket(int port, SocketPtr* socket, const std::s
 void UDPListener::Update() {
 	netservice.poll();
 
-	size_t bytes_avail = 0;
+	ReceiveDatagrams();
+
+	for (ConnMap::iterator i = conn.begin(); i != conn.end(); ) {
+		if (i->second.expired()) {
+			LOG_L(L_DEBUG, "Connection closed: [%s]:%i", i->first.address().to_string().c_str(), i->first.port());
+			i = conn.erase(i);
+			continue;
+		}
+		i->second.lock()->Update();
+		++i;
+	}
+}
+
+void UDPListener::ReceiveDatagrams() {
+#if defined(__linux__)
+	mmsghdr msgs[RECV_BATCH_SIZE];
+	iovec iovecs[RECV_BATCH_SIZE];
+	ip::udp::endpoint senders[RECV_BATCH_SIZE];
+
+	while (true) {
+		for (size_t i = 0; i < RECV_BATCH_SIZE; i++) {
+			iovecs[i].iov_base = &recvBuffer[i * RECV_SLOT_SIZE];
+			iovecs[i].iov_len = RECV_SLOT_SIZE;
+
+			msgs[i] = {};
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = senders[i].data();
+			msgs[i].msg_hdr.msg_namelen = senders[i].capacity();
+		}
+
+		const int numMsgs = ::recvmmsg(mySocket->native_handle(), msgs, RECV_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+		if (numMsgs <= 0)
+			break;
 
-	while ((bytes_avail = mySocket->available()) > 0) {
-		std::vector<std::uint8_t> buffer(bytes_avail);
+		for (int i = 0; i < numMsgs; i++) {
+			senders[i].resize(msgs[i].msg_hdr.msg_namelen);
+			ProcessDatagram(&recvBuffer[i * RECV_SLOT_SIZE], msgs[i].msg_len, senders[i]);
+		}
+
+		if (numMsgs < int(RECV_BATCH_SIZE))
+			break;
+	}
+#else
+	// not while available() > 0, that is also 0 for a pending (empty)
+	// wake-up datagram which would then never be read; mySocket is
+	// non-blocking, so this stops once it is drained
+	while (true) {
 		ip::udp::endpoint sender_endpoint;
 		asio::ip::udp::socket::message_flags flags = 0;
 		asio::error_code err;
-		size_t bytesReceived = mySocket->receive_from(asio::buffer(buffer), sender_endpoint, flags, err);
-
-		ConnMap::iterator ci = conn.find(sender_endpoint);
-		bool knownConnection = (ci != conn.end());
-
-		if (knownConnection && ci->second.expired())
-			continue;
+		size_t bytesReceived = mySocket->receive_from(asio::buffer(recvBuffer), sender_endpoint, flags, err);
 
+		if (err == asio::error::would_block || err == asio::error::try_again)
+			break;
 		if (CheckErrorCode(err))
 			break;
-
-		if (bytesReceived < Packet::headerSize)
+		// connection_reset, from an earlier send to a closed port
+		if (err)
 			continue;
 
-		Packet data(&buffer[0], bytesReceived);
+		ProcessDatagram(&recvBuffer[0], bytesReceived, sender_endpoint);
+	}
+#endif
+}
 
-		if (knownConnection) {
-			ci->second.lock()->ProcessRawPacket(data);
-		}
-		else { // still have the packet (means no connection with the sender's address found)
-			if (acceptNewConnections && data.lastContinuous == -1 && data.nakType == 0)	{
-				if (!data.chunks.empty() && (*data.chunks.begin())->chunkNumber == 0) {
-					// new client wants to connect
-					std::shared_ptr<UDPConnection> incoming(new UDPConnection(mySocket, sender_endpoint));
-					waiting.push(incoming);
-					conn[sender_endpoint] = incoming;
-					incoming->ProcessRawPacket(data);
-				}
-			}
-			else {
-				LOG_L(L_WARNING, "Dropping packet from unknown IP: [%s]:%i",
-						sender_endpoint.address().to_string().c_str(),
-						sender_endpoint.port());
-			#ifdef DEBUG
-				std::string conns;
-				for (ConnMap::iterator it = conn.begin(); it != conn.end(); ++it) {
-					conns += spring::format(" [%s]:%i;", it->first.address().to_string().c_str(),it->first.port());
-				}
-				LOG_L(L_DEBUG, "Open connections: %s", conns.c_str());
-			#endif
-			}
-		}
+void UDPListener::ProcessDatagram(std::uint8_t* data, size_t size, const ip::udp::endpoint& sender_endpoint) {
+	ConnMap::iterator ci = conn.find(sender_endpoint);
+	bool knownConnection = (ci != conn.end());
+
+	if (knownConnection && ci->second.expired())
+		return;
+
+	// also drops the empty wake-up datagrams
+	if (size < Packet::headerSize)
+		return;
+
+	Packet& packet = recvPacket;
+	packet.Parse(data, size);
+
+	if (knownConnection) {
+		ci->second.lock()->ProcessRawPacket(packet);
+		return;
 	}
 
-	for (ConnMap::iterator i = conn.begin(); i != conn.end(); ) {
-		if (i->second.expired()) {
-			LOG_L(L_DEBUG, "Connection closed: [%s]:%i", i->first.address().to_string().c_str(), i->first.port());
-			i = conn.erase(i);
-			continue;
+	// still have the packet (means no connection with the sender's address found)
+	if (acceptNewConnections && packet.lastContinuous == -1 && packet.nakType == 0)	{
+		if (!packet.chunks.empty() && packet.chunks.front().chunkNumber == 0) {
+			// new client wants to connect
+			std::shared_ptr<UDPConnection> incoming(new UDPConnection(mySocket, sender_endpoint));
+			waiting.push(incoming);
+			conn[sender_endpoint] = incoming;
+			incoming->ProcessRawPacket(packet);
 		}
-		i->second.lock()->Update();
-		++i;
 	}
+	else {
+		LOG_L(L_WARNING, "Dropping packet from unknown IP: [%s]:%i",
+				sender_endpoint.address().to_string().c_str(),
+				sender_endpoint.port());
+	#ifdef DEBUG
+		std::string conns;
+		for (ConnMap::iterator it = conn.begin(); it != conn.end(); ++it) {
+			conns += spring::format(" [%s]:%i;", it->first.address().to_string().c_str(),it->first.port());
+		}
+		LOG_L(L_DEBUG, "Open connections: %s", conns.c_str());
+	#endif
+	}
+}
+
+bool UDPListener::WaitForData(spring_time timeout) {
+	// rounded up, so that waits below a millisecond do not become busy polls
+	const int timeoutMs = (std::max(timeout.toMicroSecsi(), std::int64_t(0)) + 999) / 1000;
+
+	// polls the socket directly, its io_service (netservice) is shared with
+	// every other socket and may be run by other threads at the same time;
+	// an interrupted or failed wait counts as woken up, the caller then just
+	// updates early
+#if defined(_WIN32)
+	WSAPOLLFD pfd = {};
+	pfd.fd = mySocket->native_handle();
+	pfd.events = POLLRDNORM;
+
+	const bool haveData = (::WSAPoll(&pfd, 1, timeoutMs) != 0);
+#else
+	pollfd pfd = {};
+	pfd.fd = mySocket->native_handle();
+	pfd.events = POLLIN;
+
+	const bool haveData = (::poll(&pfd, 1, timeoutMs) != 0);
+#endif
+
+	// a Wake racing with this still leaves its datagram in the socket
+	wakePending = false;
+	return haveData;
+}
+
+void UDPListener::Wake() {
+	if (wakeSocket == nullptr)
+		return;
+
+	// one outstanding wake-up is enough
+	if (wakePending.exchange(true))
+		return;
+
+	std::lock_guard<spring::mutex> lock(wakeMutex);
+	asio::error_code err;
+	wakeSocket->send_to(asio::buffer(&wakeEndpoint, 0), wakeEndpoint, 0, err);
 }
 
 std::shared_ptr<UDPConnection> UDPListener::SpawnConnection(const std::string& ip, const unsigned port)
@@ -3,17 +3,22 @@
 #ifndef _UDP_LISTENER_H
 #define _UDP_LISTENER_H
 
+#include "UDPConnection.h"
 #include "System/Misc/NonCopyable.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/SpringThreading.h"
+#include <atomic>
+#include <cinttypes>
 #include <memory>
 #include <asio/ip/udp.hpp>
 #include <list>
 #include <map>
 #include <queue>
 #include <string>
+#include <vector>
 
 namespace netcode
 {
-class UDPConnection;
 typedef std::shared_ptr<asio::ip::udp::socket> SocketPtr;
 
 /**
@@ -58,6 +63,19 @@ public:
 	 */
 	void Update();
 
+	/**
+	 * @brief Block until data arrives on the socket, Wake is called or
+	 * <timeout> has passed, whichever comes first
+	 * @return true if woken up before the timeout
+	 */
+	bool WaitForData(spring_time timeout);
+
+	/**
+	 * @brief Make a (concurrent) WaitForData call return
+	 * Thread-safe, intended for data that does not arrive via the socket.
+	 */
+	void Wake();
+
 	/**
 	 * @brief Initiate a connection
 	 * Make a new connection to ip:port. It will be pushed back in conn.
@@ -79,6 +97,11 @@ public:
 
 	void UpdateConnections(); // Updates connections when the endpoint has been reconnected
 
+private:
+	/// pulls all pending datagrams from the socket into ProcessDatagram
+	void ReceiveDatagrams();
+	void ProcessDatagram(std::uint8_t* data, size_t size, const asio::ip::udp::endpoint& sender);
+
 private:
 	/**
 	 * @brief Do we accept packets from unknown sources?
@@ -95,6 +118,17 @@ private:
 	ConnMap conn;
 
 	std::queue< std::shared_ptr<UDPConnection> > waiting;
+
+	/// receive buffers, one per datagram of a batch
+	std::vector<std::uint8_t> recvBuffer;
+	/// reused for every received datagram, points into recvBuffer
+	Packet recvPacket;
+
+	/// sends the (empty) wake-up datagrams to mySocket
+	std::unique_ptr<asio::ip::udp::socket> wakeSocket;
+	asio::ip::udp::endpoint wakeEndpoint;
+	spring::mutex wakeMutex;
+	std::atomic<bool> wakePending;
 };
 
 }
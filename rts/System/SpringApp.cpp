@@ -21,6 +21,7 @@
 #include "ExternalAI/IAILibraryManager.h"
 #include "Game/Benchmark.h"
 #include "Game/ClientSetup.h"
+#include "Game/DemoAnalysis.h"
 #include "Game/GameSetup.h"
 #include "Game/GameVersion.h"
 #include "Game/GameController.h"
@@ -132,6 +133,7 @@ DEFINE_string   (server,                                   "",    "Set listening
 DEFINE_bool     (textureatlas,                             false, "Dump each finalized textureatlas in textureatlasN.tga");
 DEFINE_int32    (benchmark,                                -1,    "Enable benchmark mode (writes a benchmark.data file). The given number specifies the timespan to test.");
 DEFINE_int32    (benchmarkstart,                           -1,    "Benchmark start time in minutes.");
+DEFINE_string_EX(analyze_demo,       "analyze-demo",       "",    "Replay the given demo as fast as possible without drawing, then write team statistics and rules params as JSON to this file and quit.");
 
 DEFINE_bool_EX  (list_ai_interfaces, "list-ai-interfaces", false, "Dump a list of available AI Interfaces to stdout");
 DEFINE_bool_EX  (list_skirmish_ais,  "list-skirmish-ais",  false, "Dump a list of available Skirmish AIs to stdout");
@@ -580,6 +582,11 @@ void SpringApp::ParseCmdLine(int argc, char* argv[])
 		CBenchmark::endFrame = CBenchmark::startFrame + FLAGS_benchmark * 60 * GAME_SPEED;
 	}
 
+	if (!FLAGS_analyze_demo.empty()) {
+		CDemoAnalysis::enabled = true;
+		CDemoAnalysis::outputFile = FLAGS_analyze_demo;
+	}
+
 	if (argc >= 2) {
 		inputFile = argv[1];
 	}
@@ -696,6 +703,9 @@ void SpringApp::Startup()
 	// bash input
 	const std::string extension = FileSystem::GetExtension(inputFile);
 
+	if (CDemoAnalysis::enabled && extension != "sdfz")
+		throw content_error("--analyze-demo requires a demo file (.sdfz) to be given");
+
 	// note: avoid any .get() leaks between here and GameServer!
 	clientSetup.reset(new ClientSetup());
 
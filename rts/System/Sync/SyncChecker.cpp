@@ -9,5 +9,38 @@
 unsigned CSyncChecker::g_checksum;
 int CSyncChecker::inSyncedCode;
 
+SyncSectionChecksums CSyncChecker::frameSections;
+SyncSectionChecksums CSyncChecker::sectionHistory[SECTION_HISTORY_SIZE];
+
+
+const SyncSectionChecksums& CSyncChecker::EndFrame(int frameNum)
+{
+	SyncSectionChecksums& record = sectionHistory[frameNum % SECTION_HISTORY_SIZE];
+
+	frameSections.frameNum = frameNum;
+	record = frameSections;
+	return record;
+}
+
+const SyncSectionChecksums* CSyncChecker::GetSectionChecksums(int frameNum)
+{
+	if (frameNum < 0)
+		return nullptr;
+
+	const SyncSectionChecksums& record = sectionHistory[frameNum % SECTION_HISTORY_SIZE];
+
+	if (record.frameNum != frameNum)
+		return nullptr;
+
+	return &record;
+}
+
+void CSyncChecker::ClearSectionChecksums()
+{
+	for (SyncSectionChecksums& record: sectionHistory) {
+		record.frameNum = -1;
+	}
+}
+
 
 #endif // SYNCDEBUG
@@ -13,6 +13,8 @@
 	#include "HsiehHash.h"
 #endif
 
+#include "SyncSections.h"
+
 #include <assert.h>
 
 /**
@@ -37,6 +39,17 @@ class CSyncChecker {
 		static unsigned GetChecksum() { return g_checksum; }
 		static void NewFrame() { g_checksum = 0xfade1eaf; }
 
+		/**
+		 * Per-section checksums of the last SECTION_HISTORY_SIZE frames.
+		 * Each section stores the running checksum at its end, so once the
+		 * state diverged all later sections differ as well.
+		 */
+		static void EndSection(SyncSection section) { frameSections.checksums[section] = g_checksum; }
+		static const SyncSectionChecksums& EndFrame(int frameNum);
+		/// @return nullptr if frameNum is no longer (or not yet) recorded
+		static const SyncSectionChecksums* GetSectionChecksums(int frameNum);
+		static void ClearSectionChecksums();
+
 		static void Sync(const void* p, unsigned size) {
 			// most common cases first, make it easy for compiler to optimize for it
 			// simple xor is not enough to detect multiple zeroes, e.g.
@@ -93,6 +106,11 @@ class CSyncChecker {
 		 */
 		static unsigned g_checksum;
 
+		static const unsigned SECTION_HISTORY_SIZE = 512;
+
+		static SyncSectionChecksums frameSections;
+		static SyncSectionChecksums sectionHistory[SECTION_HISTORY_SIZE];
+
 		/**
 		 * @brief in synced code
 		 *
@@ -101,6 +119,12 @@ class CSyncChecker {
 		static int inSyncedCode;
 };
 
+#define SYNC_SECTION_END(section) CSyncChecker::EndSection(section)
+
+#else
+
+#define SYNC_SECTION_END(section)
+
 #endif // SYNCDEBUG
 
 #endif // SYNCDEBUGGER_H
@@ -0,0 +1,133 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "SyncSections.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+static const char* SYNC_SECTION_NAMES[SYNC_SECTION_COUNT] = {
+	"input",
+	"lua",
+	"mapdamage",
+	"path",
+	"units",
+	"projectiles",
+	"features",
+	"scripts",
+	"los",
+	"teams",
+};
+
+static const char SYNC_SECTION_LOG_MAGIC[8] = {'s', 'p', 'r', 's', 'y', 'n', 'c', '\0'};
+static const std::uint32_t SYNC_SECTION_LOG_VERSION = 1;
+
+
+const char* SyncSections::GetName(unsigned section)
+{
+	if (section >= SYNC_SECTION_COUNT)
+		return "none";
+
+	return SYNC_SECTION_NAMES[section];
+}
+
+unsigned SyncSections::FindFirstDivergence(const SyncSectionChecksums& a, const SyncSectionChecksums& b)
+{
+	unsigned section = 0;
+
+	while (section < SYNC_SECTION_COUNT && a.checksums[section] == b.checksums[section])
+		section++;
+
+	return section;
+}
+
+unsigned SyncSections::FindFirstDivergence(const std::vector<SyncSectionChecksums>& a, const std::vector<SyncSectionChecksums>& b, size_t* frame)
+{
+	const size_t numFrames = std::min(a.size(), b.size());
+
+	for (size_t n = 0; n < numFrames; n++) {
+		const unsigned section = FindFirstDivergence(a[n], b[n]);
+
+		if (section == SYNC_SECTION_COUNT && a[n].frameNum == b[n].frameNum)
+			continue;
+
+		*frame = n;
+		// records that do not belong to the same frame differ in all sections
+		return ((a[n].frameNum == b[n].frameNum)? section: 0);
+	}
+
+	*frame = numFrames;
+	return SYNC_SECTION_COUNT;
+}
+
+
+bool CSyncSectionLog::Open(const std::string& fileName)
+{
+	Close();
+
+	if ((file = fopen(fileName.c_str(), "wb")) == nullptr)
+		return false;
+
+	const std::uint32_t numSections = SYNC_SECTION_COUNT;
+
+	fwrite(SYNC_SECTION_LOG_MAGIC, sizeof(SYNC_SECTION_LOG_MAGIC), 1, file);
+	fwrite(&SYNC_SECTION_LOG_VERSION, sizeof(SYNC_SECTION_LOG_VERSION), 1, file);
+	fwrite(&numSections, sizeof(numSections), 1, file);
+	return true;
+}
+
+void CSyncSectionLog::Close()
+{
+	if (file == nullptr)
+		return;
+
+	fclose(file);
+	file = nullptr;
+}
+
+void CSyncSectionLog::Write(const SyncSectionChecksums& record)
+{
+	if (file == nullptr)
+		return;
+
+	const std::int32_t frameNum = record.frameNum;
+
+	fwrite(&frameNum, sizeof(frameNum), 1, file);
+	fwrite(record.checksums, sizeof(record.checksums), 1, file);
+}
+
+bool CSyncSectionLog::Read(const std::string& fileName, std::vector<SyncSectionChecksums>& records)
+{
+	FILE* file = fopen(fileName.c_str(), "rb");
+
+	if (file == nullptr)
+		return false;
+
+	char magic[sizeof(SYNC_SECTION_LOG_MAGIC)];
+	std::uint32_t version = 0;
+	std::uint32_t numSections = 0;
+
+	bool valid = true;
+	valid &= (fread(magic, sizeof(magic), 1, file) == 1);
+	valid &= (fread(&version, sizeof(version), 1, file) == 1);
+	valid &= (fread(&numSections, sizeof(numSections), 1, file) == 1);
+	valid &= (memcmp(magic, SYNC_SECTION_LOG_MAGIC, sizeof(magic)) == 0);
+	valid &= (version == SYNC_SECTION_LOG_VERSION && numSections == SYNC_SECTION_COUNT);
+
+	records.clear();
+
+	for (SyncSectionChecksums record; valid; records.push_back(record)) {
+		std::int32_t frameNum;
+
+		if (fread(&frameNum, sizeof(frameNum), 1, file) != 1)
+			break;
+		if (fread(record.checksums, sizeof(record.checksums), 1, file) != 1)
+			break;
+
+		record.frameNum = frameNum;
+	}
+
+	fclose(file);
+	return valid;
+}
@@ -0,0 +1,73 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SYNC_SECTIONS_H
+#define SYNC_SECTIONS_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Parts of a SimFrame, in the order in which they run. CSyncChecker records
+ * its running checksum at the end of each, so the first section for which
+ * two clients recorded different checksums is where their states diverged.
+ */
+enum SyncSection {
+	SYNC_SECTION_INPUT       = 0, ///< network messages executed since the previous frame
+	SYNC_SECTION_LUA         = 1, ///< GameFrame call-ins
+	SYNC_SECTION_MAPDAMAGE   = 2, ///< CGameHelper and CMapDamage
+	SYNC_SECTION_PATH        = 3,
+	SYNC_SECTION_UNITS       = 4,
+	SYNC_SECTION_PROJECTILES = 5,
+	SYNC_SECTION_FEATURES    = 6,
+	SYNC_SECTION_SCRIPTS     = 7, ///< COB and Lua unit scripts
+	SYNC_SECTION_LOS         = 8, ///< wind, LOS, ghosts and interceptors
+	SYNC_SECTION_TEAMS       = 9, ///< team and player updates
+	SYNC_SECTION_COUNT       = 10,
+};
+
+struct SyncSectionChecksums {
+	int frameNum;
+	unsigned checksums[SYNC_SECTION_COUNT];
+};
+
+
+namespace SyncSections {
+	const char* GetName(unsigned section);
+
+	/// @return the first section in which a and b differ, SYNC_SECTION_COUNT if none
+	unsigned FindFirstDivergence(const SyncSectionChecksums& a, const SyncSectionChecksums& b);
+
+	/**
+	 * @brief compares two runs (e.g. of the same demo) frame by frame
+	 * @param frame set to the index of the first record that differs
+	 * @return the first diverging section in that record, or SYNC_SECTION_COUNT
+	 *   if all records both runs have agree
+	 */
+	unsigned FindFirstDivergence(const std::vector<SyncSectionChecksums>& a, const std::vector<SyncSectionChecksums>& b, size_t* frame);
+}
+
+
+/**
+ * Binary file of SyncSectionChecksums records, one per frame. Written by
+ * clients if SyncSectionLog is set, compared by `demotool --syncdiff`.
+ */
+class CSyncSectionLog {
+public:
+	CSyncSectionLog(): file(nullptr) {}
+	CSyncSectionLog(const CSyncSectionLog&) = delete;
+	~CSyncSectionLog() { Close(); }
+
+	bool Open(const std::string& fileName);
+	void Close();
+	bool IsOpen() const { return (file != nullptr); }
+
+	void Write(const SyncSectionChecksums& record);
+
+	static bool Read(const std::string& fileName, std::vector<SyncSectionChecksums>& records);
+
+private:
+	FILE* file;
+};
+
+#endif // SYNC_SECTIONS_H
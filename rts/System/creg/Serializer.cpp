@@ -13,6 +13,7 @@
 #include "System/Log/ILog.h"
 #include "System/Platform/byteorder.h"
 #include "System/Exceptions.h"
+#include "System/Threading/ThreadPool.h"
 
 #include <algorithm>
 #include <fstream>
@@ -33,6 +34,8 @@ LOG_REGISTER_SECTION_GLOBAL(LOG_SECTION_CREG_SERIALIZER)
 
 //
 #define CREG_PACKAGE_FILE_ID "CRPK"
+// the leading header of a streamed package, the real one is at the end of the stream
+#define CREG_STREAMED_PACKAGE_FILE_ID "CRPS"
 
 // File format structures
 struct PackageHeader
@@ -277,14 +280,20 @@ struct COutputStreamSerializer::ClassRef
 	creg::Class* class_;
 };
 
-void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class* rootObjClass)
+void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class* rootObjClass, bool streamed)
 {
 	PackageHeader ph;
 
+	if (streamed)
+		memcpy(ph.magic, CREG_STREAMED_PACKAGE_FILE_ID, 4);
+
 	stream = s;
 	unsigned startOffset = stream->tellp();
 	stream->write((char*)&ph, sizeof(PackageHeader));
-	stream->seekp(startOffset + sizeof(PackageHeader));
+
+	if (!streamed)
+		stream->seekp(startOffset + sizeof(PackageHeader));
+
 	ph.objDataOffset = (int)stream->tellp();
 
 	// Insert dummy object with id 0
@@ -404,7 +413,10 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	}
 
 	int endOffset = stream->tellp();
-	stream->seekp(startOffset);
+
+	if (!streamed)
+		stream->seekp(startOffset);
+
 	memcpy(ph.magic, CREG_PACKAGE_FILE_ID, 4);
 	ph.SwapBytes();
 	stream->write((const char*)&ph, sizeof(PackageHeader));
@@ -413,7 +425,9 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 			"Checksum: %X\nNumber of objects saved: %i\nNumber of classes involved: %i",
 			ph.metadataChecksum, int(objects.size()), int(classRefs.size()));
 
-	stream->seekp(endOffset);
+	if (!streamed)
+		stream->seekp(endOffset);
+
 	ptrToId.clear();
 	pendingObjects.clear();
 	objects.clear();
@@ -423,8 +437,17 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 // CInputStreamSerializer
 //-------------------------------------------------------------------------
 
-CInputStreamSerializer::CInputStreamSerializer()
+CInputStreamSerializer::CInputStreamSerializer(bool parallel)
 	: stream(NULL)
+	, owner(this)
+	, parallelLoad(parallel)
+{
+}
+
+CInputStreamSerializer::CInputStreamSerializer(CInputStreamSerializer* o, std::istream* s)
+	: stream(s)
+	, owner(o)
+	, parallelLoad(false)
 {
 }
 
@@ -492,8 +515,11 @@ void CInputStreamSerializer::SerializeObjectPtr(void** ptr, creg::Class* cls)
 	unsigned int id;
 	ReadVarSizeUInt(stream, &id);
 	if (id) {
-		StoredObject& o = objects [id];
-		if (o.obj) *ptr = o.obj;
+		const StoredObject& o = owner->objects[id];
+
+		// during a parallel load, embedded objects may be registered by
+		// another worker at any time; only non-embedded ones are stable
+		if ((owner == this || !o.isEmbedded) && o.obj != nullptr) *ptr = o.obj;
 		else {
 			// The object is not yet available, so it needs fixing afterwards
 			*ptr = (void*) 1;
@@ -515,7 +541,7 @@ void CInputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* cl
 	if (id == 0)
 		return; // this is old save game and it has not this object - skip it
 
-	StoredObject& o = objects[id];
+	StoredObject& o = owner->objects[id];
 	assert(!o.obj);
 	assert(o.isEmbedded);
 
@@ -544,6 +570,124 @@ void CallPostLoad(creg::Class* c, creg::Class* oc, void* obj)
 	}
 }
 
+void CInputStreamSerializer::ReadObjectsSerial()
+{
+	for (uint a = 0; a < objects.size(); a++)
+	{
+		if (!objects[a].isEmbedded) {
+			creg::Class* cls = classRefs[objects[a].classRef];
+			SerializeObject(cls, objects[a].obj);
+			LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Deserialized %s size:%i", cls->name.c_str(), cls->size);
+		}
+	}
+}
+
+
+namespace {
+	// reads a chunk of object data from memory, without copying it
+	class ChunkBuffer : public std::streambuf {
+	public:
+		ChunkBuffer(char* begin, char* end) { setg(begin, begin, end); }
+
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+			if (off != 0 || dir != std::ios_base::cur)
+				return pos_type(off_type(-1));
+
+			return pos_type(off_type(gptr() - eback()));
+		}
+	};
+
+	struct ObjectChunk {
+		unsigned int firstObject;
+		unsigned int endObject;
+		size_t dataOffset;
+		size_t dataSize;
+	};
+}
+
+void CInputStreamSerializer::ReadObjectsParallel()
+{
+	// the records of non-embedded objects follow each other in object
+	// order, the table gives their sizes; cut them into chunks of about
+	// equal size, a few per thread so a huge record does not stall all
+	std::vector<ObjectChunk> chunks;
+	size_t dataSize = 0;
+
+	for (const StoredObject& o: objects) {
+		dataSize += (o.isEmbedded? 0: o.dataSize);
+	}
+
+	const size_t chunkSize = std::max(dataSize / (ThreadPool::GetNumThreads() * 4), size_t(1));
+
+	size_t dataOffset = 0;
+
+	for (unsigned int a = 0; a < objects.size(); ) {
+		ObjectChunk chunk = {a, a, dataOffset, 0};
+
+		for (; chunk.endObject < objects.size() && chunk.dataSize < chunkSize; chunk.endObject++) {
+			const StoredObject& o = objects[chunk.endObject];
+			chunk.dataSize += (o.isEmbedded? 0: o.dataSize);
+		}
+
+		chunks.push_back(chunk);
+		a = chunk.endObject;
+		dataOffset += chunk.dataSize;
+	}
+
+	std::vector<char> data(dataSize);
+	stream->read(data.data(), dataSize);
+
+	if (size_t(stream->gcount()) != dataSize)
+		throw std::runtime_error("Package file object data is truncated");
+
+	std::vector< std::vector<UnfixedPtr> > chunkUnfixedPointers(chunks.size());
+	std::vector< std::vector<PostLoadCallback> > chunkCallbacks(chunks.size());
+	std::vector<std::string> chunkErrors(chunks.size());
+
+	for_mt(0, chunks.size(), [&](const int i) {
+		const ObjectChunk& chunk = chunks[i];
+
+		ChunkBuffer buffer(data.data() + chunk.dataOffset, data.data() + chunk.dataOffset + chunk.dataSize);
+		std::istream chunkStream(&buffer);
+		CInputStreamSerializer worker(this, &chunkStream);
+
+		try {
+			for (unsigned int a = chunk.firstObject; a < chunk.endObject; a++) {
+				if (!objects[a].isEmbedded)
+					worker.SerializeObject(classRefs[objects[a].classRef], objects[a].obj);
+			}
+		} catch (const std::exception& ex) {
+			chunkErrors[i] = ex.what();
+		} catch (const char* ex) {
+			chunkErrors[i] = ex;
+		} catch (const std::string& ex) {
+			chunkErrors[i] = ex;
+		} catch (...) {
+			chunkErrors[i] = "Unknown error while reading object data";
+		}
+
+		if (chunkErrors[i].empty() && size_t(chunkStream.tellg()) != chunk.dataSize)
+			chunkErrors[i] = "Package file object sizes do not match their data";
+
+		chunkUnfixedPointers[i].swap(worker.unfixedPointers);
+		chunkCallbacks[i].swap(worker.callbacks);
+	});
+
+	for (const std::string& error: chunkErrors) {
+		if (!error.empty())
+			throw std::runtime_error(error);
+	}
+
+	// keep the callbacks in the order a serial load would have registered them
+	for (size_t i = 0; i < chunks.size(); i++) {
+		unfixedPointers.insert(unfixedPointers.end(), chunkUnfixedPointers[i].begin(), chunkUnfixedPointers[i].end());
+		callbacks.insert(callbacks.end(), chunkCallbacks[i].begin(), chunkCallbacks[i].end());
+	}
+
+	LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Deserialized %u bytes in %u chunks", unsigned(dataSize), unsigned(chunks.size()));
+}
+
 void CInputStreamSerializer::LoadPackage(std::istream* s, void*& root, creg::Class*& rootCls)
 {
 	PackageHeader ph;
@@ -551,6 +695,13 @@ void CInputStreamSerializer::LoadPackage(std::istream* s, void*& root, creg::Cla
 	stream = s;
 	s->read((char*)&ph, sizeof(PackageHeader));
 
+	const bool streamed = (memcmp(ph.magic, CREG_STREAMED_PACKAGE_FILE_ID, 4) == 0);
+
+	if (streamed) {
+		s->seekg(-int(sizeof(PackageHeader)), std::ios_base::end);
+		s->read((char*)&ph, sizeof(PackageHeader));
+	}
+
 	if (memcmp(ph.magic, CREG_PACKAGE_FILE_ID, 4))
 		throw std::runtime_error("Incorrect object package file ID");
 
@@ -586,6 +737,8 @@ void CInputStreamSerializer::LoadPackage(std::istream* s, void*& root, creg::Cla
 		stream->read((char*)&isEmbedded, sizeof(char));
 		ReadVarSizeUInt(stream, &mgcnt);
 
+		objects[a].dataSize = 0;
+
 		for (unsigned int b = 0; b < mgcnt; b++) {
 			unsigned int cid, mcnt;
 			char groupFlags;
@@ -595,6 +748,7 @@ void CInputStreamSerializer::LoadPackage(std::istream* s, void*& root, creg::Cla
 			for (unsigned int c = 0; c < mcnt; c++) {
 				unsigned int size;
 				ReadVarSizeUInt(stream, &size);
+				objects[a].dataSize += size;
 			}
 		}
 
@@ -609,23 +763,21 @@ void CInputStreamSerializer::LoadPackage(std::istream* s, void*& root, creg::Cla
 		objects[a].classRef = classRefIndex;
 	}
 
-	int endOffset = s->tellg();
+	// a streamed package ends with its header
+	const int endOffset = int(s->tellg()) + (streamed? sizeof(PackageHeader): 0);
 
 	// Read the object data using serialization
 	s->seekg(ph.objDataOffset);
-	for (uint a = 0; a < objects.size(); a++)
-	{
-		if (!objects[a].isEmbedded) {
-			creg::Class* cls = classRefs[objects[a].classRef];
-			SerializeObject(cls, objects[a].obj);
-			LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Deserialized %s size:%i", cls->name.c_str(), cls->size);
-		}
+
+	if (parallelLoad && ThreadPool::HasThreads()) {
+		ReadObjectsParallel();
+	} else {
+		ReadObjectsSerial();
 	}
 
 	// Fix pointers to embedded objects
-	for (uint a = 0; a < unfixedPointers.size(); a++) {
-		void* p = objects[unfixedPointers[a].objID].obj;
-		*unfixedPointers[a].ptrAddr = p;
+	for (const UnfixedPtr& ufp: unfixedPointers) {
+		*ufp.ptrAddr = objects[ufp.objID].obj;
 	}
 
 	// Run all registered post load callbacks
@@ -13,6 +13,8 @@
 #include <deque>
 #include <istream>
 
+#include "System/UnorderedMap.hpp"
+
 namespace creg {
 
 	/**
@@ -81,7 +83,7 @@ namespace creg {
 		struct ClassRef;
 
 		std::ostream* stream;
-		std::map<void*,std::vector<ObjectRef*> > ptrToId;
+		spring::unsynced_map<void*, std::vector<ObjectRef*> > ptrToId;
 		std::deque<ObjectRef> objects;
 		std::vector<ObjectRef*> pendingObjects; // these objects still have to be saved
 		std::map<Class*, int> classSizes;
@@ -103,9 +105,12 @@ namespace creg {
 		 * @param s stream to serialize the data to
 		 * @param rootObj the rootObj: the starting point for finding all the objects to save
 		 * @param cls the class of the root object
+		 * @param streamed if true, <s> is only ever appended to (e.g. a compressing stream):
+		 *   the header then follows the object table instead of being patched in front of
+		 *   the data, so the package has to be the last thing written to <s>
 		 * This method throws an std::runtime_error when something goes wrong
 		 */
-		void SavePackage(std::ostream* s, void* rootObj, Class* cls);
+		void SavePackage(std::ostream* s, void* rootObj, Class* cls, bool streamed = false);
 
 		/** @see ISerializer::IsWriting */
 		bool IsWriting();
@@ -136,6 +141,10 @@ namespace creg {
 		std::istream* stream;
 		std::vector<Class*> classRefs;
 
+		/// whose objects are being loaded; this, unless a worker of a parallel load
+		CInputStreamSerializer* owner;
+		bool parallelLoad;
+
 		struct UnfixedPtr {
 			void** ptrAddr;
 			int objID;
@@ -146,6 +155,8 @@ namespace creg {
 		{
 			void* obj;
 			int classRef;
+			/// bytes of object data, including everything embedded in it
+			unsigned int dataSize;
 			bool isEmbedded;
 		};
 		std::vector<StoredObject> objects;
@@ -158,8 +169,19 @@ namespace creg {
 		std::vector<PostLoadCallback> callbacks;
 
 		void SerializeObject(Class* c, void* ptr);
+
+		void ReadObjectsSerial();
+		void ReadObjectsParallel();
+
+		CInputStreamSerializer(CInputStreamSerializer* owner, std::istream* s);
 	public:
-		CInputStreamSerializer();
+		/**
+		 * @param parallel decode the non-embedded objects on the thread pool;
+		 *   pointers to embedded objects are then always fixed up afterwards,
+		 *   and Serialize procs must not touch shared state (PostLoad and post
+		 *   load callbacks still run serially, in object order)
+		 */
+		CInputStreamSerializer(bool parallel = false);
 		~CInputStreamSerializer();
 
 		/** @see ISerializer::IsWriting */
@@ -180,8 +202,8 @@ namespace creg {
 		/** @see ISerializer::AddPostLoadCallback */
 		void AddPostLoadCallback(void (*cb)(void* userdata), void* userdata);
 
-		/** Load a package that is saved by CInputStreamSerializer
-		 * @param s the input stream to read from
+		/** Load a package that is saved by COutputStreamSerializer
+		 * @param s the input stream to read from, seekable (a streamed package is read up to its end)
 		 * @param root the root object address will be assigned to this
 		 * @param rootCls the root object class will be assigned to this
 		 * This method throws an std::runtime_error when something goes wrong */
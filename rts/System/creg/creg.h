@@ -426,6 +426,9 @@ public: \
  * There can only be one serialize method per class/struct.
  * On serialization, the registered members will be serialized first,
  * and then this function will be called if specified
+ * When loading, it may run on a thread-pool thread concurrently with the
+ * serializers of other objects, so it must not touch anything but its own
+ * object; work with side-effects on other objects belongs in CR_POSTLOAD.
  *
  * @param SerializeFunc the serialize method, should be a member function of the
  *   class
@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <string>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -54,7 +55,7 @@ extern "C"
 {
 #endif
 
-void ParseCmdLine(int argc, char* argv[], std::string& scriptName)
+void ParseCmdLine(int argc, char* argv[], std::vector<std::string>& scriptNames)
 {
 	#undef  LOG_SECTION_CURRENT
 	#define LOG_SECTION_CURRENT LOG_SECTION_DEFAULT
@@ -71,11 +72,11 @@ void ParseCmdLine(int argc, char* argv[], std::string& scriptName)
 		exit(0);
 	}
 
-	if (argc >= 2) {
-		scriptName = argv[1];
+	for (int i = 1; i < argc; i++) {
+		scriptNames.push_back(argv[i]);
 	}
 
-	if (scriptName.empty() && !FLAGS_list_config_vars) {
+	if (scriptNames.empty() && !FLAGS_list_config_vars) {
 		gflags::ShowUsageWithFlags(argv[0]);
 		exit(1);
 	}
@@ -107,6 +108,152 @@ void ParseCmdLine(int argc, char* argv[], std::string& scriptName)
 }
 
 
+// written by ClientSetup::LoadFromStartScript into the config handler all
+// servers share, but only meant for the server of that script; SourcePort is
+// written as well, but is neither registered nor read by spring-dedicated
+static const char* scriptConfigKeys[] = {"AutohostIP", "AutohostPort"};
+
+class CScriptConfigOverrides
+{
+public:
+	CScriptConfigOverrides() {
+		for (unsigned int n = 0; n < NUM_KEYS; n++) {
+			values[n] = configHandler->GetString(scriptConfigKeys[n]);
+		}
+	}
+	~CScriptConfigOverrides() {
+		for (unsigned int n = 0; n < NUM_KEYS; n++) {
+			configHandler->SetString(scriptConfigKeys[n], values[n], true);
+		}
+	}
+
+private:
+	static const unsigned int NUM_KEYS = sizeof(scriptConfigKeys) / sizeof(scriptConfigKeys[0]);
+
+	std::string values[NUM_KEYS];
+};
+
+
+/**
+ * Reads the map's start positions for <gameSetup>. The map's archives are in
+ * the VFS all servers share only meanwhile: maps keep some of their files at
+ * the same paths (e.g. mapinfo.lua) and with overwrite disabled, the archives
+ * of another server's map would shadow those of this one. Nothing else ever
+ * adds archives to the VFS of spring-dedicated.
+ */
+static bool LoadMapStartPositions(CGameSetup* gameSetup)
+{
+	const std::vector<std::string> mapArchives = archiveScanner->GetAllArchivesUsedBy(gameSetup->mapName);
+
+	bool loaded = true;
+
+	try {
+		CFileHandler f("maps/" + gameSetup->mapName);
+
+		if (!f.FileExists())
+			vfsHandler->AddArchiveWithDeps(gameSetup->mapName, false);
+
+		gameSetup->LoadStartPositions(); // full mode
+	} catch (const content_error& e) {
+		LOG_L(L_ERROR, "failed to load the start positions of map %s: %s", gameSetup->mapName.c_str(), e.what());
+		loaded = false;
+	}
+
+	for (const std::string& archiveName: mapArchives) {
+		vfsHandler->RemoveArchive(archiveName);
+	}
+
+	return loaded;
+}
+
+
+/**
+ * Loads the start script <scriptName> and starts a server for it, which runs
+ * in its own thread. All servers of this process share the file system, the
+ * archive scanner and the configuration.
+ */
+static CGameServer* CreateServer(const std::string& scriptName, CGlobalUnsyncedRNG& rng)
+{
+	LOG("loading script from file: %s", scriptName.c_str());
+
+	std::string scriptText;
+
+	// server will take ownership of these
+	std::shared_ptr<ClientSetup> dsClientSetup(new ClientSetup());
+	std::shared_ptr<GameData> dsGameData(new GameData());
+	std::shared_ptr<CGameSetup> dsGameSetup(new CGameSetup());
+
+	CFileHandler fh(scriptName);
+
+	if (!fh.FileExists()) {
+		LOG_L(L_ERROR, "script does not exist in given location: %s", scriptName.c_str());
+		return nullptr;
+	}
+
+	if (!fh.LoadStringData(scriptText)) {
+		LOG_L(L_ERROR, "script cannot be read: %s", scriptName.c_str());
+		return nullptr;
+	}
+
+	// NOTE: this also applies the script's config overrides (e.g. AutohostPort),
+	// which the server reads while being constructed below
+	const CScriptConfigOverrides configOverrides;
+
+	dsClientSetup->LoadFromStartScript(scriptText);
+
+	if (!dsGameSetup->Init(scriptText)) {
+		// read the script provided by cmdline
+		LOG_L(L_ERROR, "failed to load script %s", scriptName.c_str());
+		return nullptr;
+	}
+
+	dsGameData->SetRandomSeed(rng.NextInt());
+
+	//  Use script provided hashes if they exist
+	if (dsGameSetup->mapHash != 0) {
+		dsGameData->SetMapChecksum(dsGameSetup->mapHash);
+		dsGameSetup->LoadStartPositions(false); // reduced mode
+	} else {
+		dsGameData->SetMapChecksum(archiveScanner->GetArchiveCompleteChecksum(dsGameSetup->mapName));
+
+		if (!LoadMapStartPositions(dsGameSetup.get()))
+			return nullptr;
+	}
+
+	if (dsGameSetup->modHash != 0) {
+		dsGameData->SetModChecksum(dsGameSetup->modHash);
+	} else {
+		const std::string& modArchive = archiveScanner->ArchiveFromName(dsGameSetup->modName);
+		const unsigned int modCheckSum = archiveScanner->GetArchiveCompleteChecksum(modArchive);
+		dsGameData->SetModChecksum(modCheckSum);
+	}
+
+	LOG("starting server...");
+
+	dsGameData->SetSetupText(dsGameSetup->setupText);
+	return (new CGameServer(dsClientSetup, dsGameData, dsGameSetup));
+}
+
+static void LogServerInfo(const CGameServer* server)
+{
+	const std::unique_ptr<CDemoRecorder>& demoRec = server->GetDemoRecorder();
+	const std::uint8_t* gameID = (demoRec->GetFileHeader()).gameID;
+
+	LOG("recording demo: %s", (demoRec->GetName()).c_str());
+	LOG("using mod: %s", (server->GetGameSetup()->modName).c_str());
+	LOG("using map: %s", (server->GetGameSetup()->mapName).c_str());
+	LOG("GameID: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", gameID[0], gameID[1], gameID[2], gameID[3], gameID[4], gameID[5], gameID[6], gameID[7], gameID[8], gameID[9], gameID[10], gameID[11], gameID[12], gameID[13], gameID[14], gameID[15]);
+}
+
+static void LogServerStats(const CGameServer* server)
+{
+	LOG("[port %d] server thread time: %.1fs, traffic held in memory: %uKB",
+		server->GetClientSetup()->hostPort,
+		server->GetWorkTime().toSecsf(),
+		unsigned(server->GetMemoryUsage() / 1024)
+	);
+}
+
 
 int main(int argc, char* argv[])
 {
@@ -119,14 +266,13 @@ int main(int argc, char* argv[])
 
 		CLogOutput::LogSystemInfo();
 
-		std::string scriptName;
-		std::string scriptText;
+		std::vector<std::string> scriptNames;
 		std::string binaryName = argv[0];
 
-		gflags::SetUsageMessage("Usage: " + binaryName + " [options] path_to_script.txt");
+		gflags::SetUsageMessage("Usage: " + binaryName + " [options] path_to_script.txt [path_to_script2.txt ...]");
 		gflags::SetVersionString(SpringVersion::GetFull());
 		gflags::ParseCommandLineFlags(&argc, &argv, true);
-		ParseCmdLine(argc, argv, scriptName);
+		ParseCmdLine(argc, argv, scriptNames);
 
 		GlobalConfig::Instantiate();
 		FileSystemInitializer::InitializeLogOutput();
@@ -136,90 +282,66 @@ int main(int argc, char* argv[])
 		CrashHandler::Install();
 
 		LOG("report any errors to Mantis or the forums.");
-		LOG("loading script from file: %s", scriptName.c_str());
 
-		CGameServer* server = NULL;
+		struct HostedGame {
+			CGameServer* server;
+			bool printData;
+		};
 
-		// server will take ownership of these
-		std::shared_ptr<ClientSetup> dsClientSetup(new ClientSetup());
-		std::shared_ptr<GameData> dsGameData(new GameData());
-		std::shared_ptr<CGameSetup> dsGameSetup(new CGameSetup());
+		std::vector<HostedGame> games;
 
-		CFileHandler fh(scriptName);
-
-		if (!fh.FileExists())
-			throw content_error("script does not exist in given location: " + scriptName);
-
-		if (!fh.LoadStringData(scriptText))
-			throw content_error("script cannot be read: " + scriptName);
-
-		dsClientSetup->LoadFromStartScript(scriptText);
-
-		if (!dsGameSetup->Init(scriptText)) {
-			// read the script provided by cmdline
-			LOG_L(L_ERROR, "failed to load script %s", scriptName.c_str());
-			return 1;
-		}
-
-		// Create the server, it will run in a separate thread
+		// Create the servers, each will run in a separate thread
 		CGlobalUnsyncedRNG rng;
 
 		const unsigned sleepTime = FLAGS_sleeptime;
 		const unsigned randSeed = time(NULL) % ((spring_gettime().toNanoSecsi() + 1) * 9007);
 
 		rng.Seed(randSeed);
-		dsGameData->SetRandomSeed(rng.NextInt());
-
-		//  Use script provided hashes if they exist
-		if (dsGameSetup->mapHash != 0) {
-			dsGameData->SetMapChecksum(dsGameSetup->mapHash);
-			dsGameSetup->LoadStartPositions(false); // reduced mode
-		} else {
-			dsGameData->SetMapChecksum(archiveScanner->GetArchiveCompleteChecksum(dsGameSetup->mapName));
-
-			CFileHandler f("maps/" + dsGameSetup->mapName);
-			if (!f.FileExists()) {
-				vfsHandler->AddArchiveWithDeps(dsGameSetup->mapName, false);
+
+		for (const std::string& scriptName: scriptNames) {
+			CGameServer* server = nullptr;
+
+			// a broken script must not take down the games already running
+			try {
+				server = CreateServer(scriptName, rng);
+			} catch (const content_error& e) {
+				LOG_L(L_ERROR, "failed to load script %s: %s", scriptName.c_str(), e.what());
 			}
-			dsGameSetup->LoadStartPositions(); // full mode
-		}
 
-		if (dsGameSetup->modHash != 0) {
-			dsGameData->SetModChecksum(dsGameSetup->modHash);
-		} else {
-			const std::string& modArchive = archiveScanner->ArchiveFromName(dsGameSetup->modName);
-			const unsigned int modCheckSum = archiveScanner->GetArchiveCompleteChecksum(modArchive);
-			dsGameData->SetModChecksum(modCheckSum);
-		}
+			if (server == nullptr)
+				continue;
 
-		LOG("starting server...");
+			games.push_back({server, false});
+		}
 
-		dsGameData->SetSetupText(dsGameSetup->setupText);
-		server = new CGameServer(dsClientSetup, dsGameData, dsGameSetup);
+		if (games.empty())
+			return 1;
 
-		while (!server->HasGameID()) {
-			// wait until gameID has been generated or
-			// a timeout occurs (if no clients connect)
-			if (server->HasFinished()) {
-				break;
-			}
+		while (!games.empty()) {
+			// wait until a gameID has been generated (and print it) or
+			// a timeout occurs (if no clients connect), then until the
+			// game is over
+			for (HostedGame& game: games) {
+				if (game.printData || !game.server->HasGameID())
+					continue;
 
-			spring_sleep(spring_secs(sleepTime));
-		}
+				game.printData = true;
 
-		while (!server->HasFinished()) {
-			static bool printData = (server->GetDemoRecorder() != NULL);
+				if (game.server->GetDemoRecorder() != nullptr)
+					LogServerInfo(game.server);
+			}
 
-			if (printData) {
-				printData = false;
+			for (auto it = games.begin(); it != games.end(); ) {
+				if (!it->server->HasFinished()) {
+					++it;
+					continue;
+				}
 
-				const std::unique_ptr<CDemoRecorder>& demoRec = server->GetDemoRecorder();
-				const std::uint8_t* gameID = (demoRec->GetFileHeader()).gameID;
+				if (scriptNames.size() > 1)
+					LogServerStats(it->server);
 
-				LOG("recording demo: %s", (demoRec->GetName()).c_str());
-				LOG("using mod: %s", (dsGameSetup->modName).c_str());
-				LOG("using map: %s", (dsGameSetup->mapName).c_str());
-				LOG("GameID: %02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x", gameID[0], gameID[1], gameID[2], gameID[3], gameID[4], gameID[5], gameID[6], gameID[7], gameID[8], gameID[9], gameID[10], gameID[11], gameID[12], gameID[13], gameID[14], gameID[15]);
+				delete it->server;
+				it = games.erase(it);
 			}
 
 			spring_secs(sleepTime).sleep(true);
@@ -227,8 +349,6 @@ int main(int argc, char* argv[])
 
 		LOG("exiting");
 
-		delete server;
-
 		FileSystemInitializer::Cleanup();
 		GlobalConfig::Deallocate();
 		DataDirLocater::FreeInstance();
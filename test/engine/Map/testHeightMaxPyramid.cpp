@@ -0,0 +1,422 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Map/Ground.h"
+#include "Map/HeightMaxPyramid.h"
+#include "Map/ReadMap.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "System/float3.h"
+#include "System/TimeProfiler.h"
+#include "System/Misc/SpringTime.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#define BOOST_TEST_MODULE HeightMaxPyramid
+#include <boost/test/unit_test.hpp>
+BOOST_GLOBAL_FIXTURE(InitSpringTime);
+
+// Ground.cpp links against these, the tests hand it their own maps
+CReadMap* readMap = nullptr;
+MapDimensions mapDims;
+
+static const int MAPX = 512;
+static const int MAPY = 512;
+
+static inline float randf()
+{
+	return std::rand() / float(RAND_MAX);
+}
+
+// rolling hills with some noise on top
+static std::vector<float> MakeHeightMap()
+{
+	std::vector<float> heightMap((MAPX + 1) * (MAPY + 1));
+
+	std::srand(4321);
+
+	for (int z = 0; z <= MAPY; z++) {
+		for (int x = 0; x <= MAPX; x++) {
+			const float h = std::sin(x * 0.031f) * std::cos(z * 0.027f) * 150.0f + std::sin((x + z) * 0.011f) * 100.0f;
+			heightMap[z * (MAPX + 1) + x] = h + randf() * 10.0f;
+		}
+	}
+
+	return heightMap;
+}
+
+static float GetSquareMaxHeight(const std::vector<float>& heightMap, int x, int z)
+{
+	const float* hm = &heightMap[z * (MAPX + 1) + x];
+	return std::max(std::max(hm[0], hm[1]), std::max(hm[MAPX + 1], hm[MAPX + 2]));
+}
+
+static float GetBlockMaxHeight(const std::vector<float>& heightMap, int level, int bx, int bz)
+{
+	const int shift = CHeightMaxPyramid::BASE_SHIFT + level;
+	float maxHeight = -FLT_MAX;
+
+	for (int z = (bz << shift); z < std::min(MAPY, (bz + 1) << shift); z++) {
+		for (int x = (bx << shift); x < std::min(MAPX, (bx + 1) << shift); x++) {
+			maxHeight = std::max(maxHeight, GetSquareMaxHeight(heightMap, x, z));
+		}
+	}
+
+	return maxHeight;
+}
+
+// lowest point of the (infinite) line <from>, <to> over square (<x>, <z>)
+static float GetLineMinHeight(const float3& from, const float3& to, int x, int z)
+{
+	const float3 dir = to - from;
+
+	float tmin = -FLT_MAX;
+	float tmax =  FLT_MAX;
+
+	if (dir.x != 0.0f) {
+		const float t1 = (x * SQUARE_SIZE - from.x) / dir.x;
+		const float t2 = ((x + 1) * SQUARE_SIZE - from.x) / dir.x;
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	}
+	if (dir.z != 0.0f) {
+		const float t1 = (z * SQUARE_SIZE - from.z) / dir.z;
+		const float t2 = ((z + 1) * SQUARE_SIZE - from.z) / dir.z;
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+	}
+
+	if (tmin > tmax)
+		return FLT_MAX;
+
+	return std::min(from.y + dir.y * tmin, from.y + dir.y * tmax);
+}
+
+// a long ray starting above the terrain, going down at a shallow angle
+static void MakeRay(float3& from, float3& to)
+{
+	from.x = randf() * MAPX * SQUARE_SIZE;
+	from.z = randf() * MAPY * SQUARE_SIZE;
+	from.y = 260.0f + randf() * 200.0f;
+
+	const float angle = randf() * 6.2831853f;
+	const float length = 500.0f + randf() * 3000.0f;
+
+	to.x = Clamp(from.x + std::cos(angle) * length, 0.0f, MAPX * SQUARE_SIZE - 0.01f);
+	to.z = Clamp(from.z + std::sin(angle) * length, 0.0f, MAPY * SQUARE_SIZE - 0.01f);
+	to.y = from.y - randf() * 600.0f;
+}
+
+
+// the parts of the map LineGroundCol reads, the pyramid skipping blocks
+// in one variant and never updated (so skipping nothing) in the other
+struct Ground {
+	Ground(): heightMap(MakeHeightMap()), faceNormals(MAPX * MAPY * 2) {
+		mapDims.mapx = MAPX;
+		mapDims.mapy = MAPY;
+		mapDims.Initialize();
+
+		float3::maxxpos = MAPX * SQUARE_SIZE - 1;
+		float3::maxzpos = MAPY * SQUARE_SIZE - 1;
+
+		// same as CReadMap::UpdateFaceNormals
+		for (int z = 0; z < MAPY; z++) {
+			for (int x = 0; x < MAPX; x++) {
+				const float hTL = heightMap[(z    ) * (MAPX + 1) + x    ];
+				const float hTR = heightMap[(z    ) * (MAPX + 1) + x + 1];
+				const float hBL = heightMap[(z + 1) * (MAPX + 1) + x    ];
+				const float hBR = heightMap[(z + 1) * (MAPX + 1) + x + 1];
+
+				faceNormals[(z * MAPX + x) * 2    ] = float3(-(hTR - hTL), SQUARE_SIZE, -(hBL - hTL)).Normalize();
+				faceNormals[(z * MAPX + x) * 2 + 1] = float3( (hBL - hBR), SQUARE_SIZE,  (hTR - hBR)).Normalize();
+			}
+		}
+
+		maxHeight = *std::max_element(heightMap.begin(), heightMap.end());
+
+		pyramid.Init(MAPX, MAPY);
+		pyramid.Update(&heightMap[0], SRectangle(0, 0, MAPX, MAPY));
+		noPyramid.Init(MAPX, MAPY);
+	}
+
+	float LineGroundCol(const float3& from, const float3& to, bool skipBlocks, bool synced) const {
+		return CGround::LineGroundCol(from, to, &heightMap[0], &faceNormals[0], skipBlocks? &pyramid: &noPyramid, maxHeight, synced);
+	}
+
+	// the height of the triangle below <pos>, see InterpolateHeight in Ground.cpp
+	float GetHeight(const float3& pos) const {
+		const float x = Clamp(pos.x / SQUARE_SIZE, 0.0f, float(MAPX));
+		const float z = Clamp(pos.z / SQUARE_SIZE, 0.0f, float(MAPY));
+		const int isx = std::min(int(x), MAPX - 1);
+		const int isz = std::min(int(z), MAPY - 1);
+		const float dx = x - isx;
+		const float dz = z - isz;
+		const float* hm = &heightMap[isz * (MAPX + 1) + isx];
+
+		if (dx + dz < 1.0f)
+			return (hm[0] + dx * (hm[1] - hm[0]) + dz * (hm[MAPX + 1] - hm[0]));
+
+		return (hm[MAPX + 2] + (1.0f - dx) * (hm[MAPX + 1] - hm[MAPX + 2]) + (1.0f - dz) * (hm[1] - hm[MAPX + 2]));
+	}
+
+	std::vector<float> heightMap;
+	std::vector<float3> faceNormals;
+	float maxHeight;
+
+	CHeightMaxPyramid pyramid;
+	CHeightMaxPyramid noPyramid;
+};
+
+// the nearest border between two squares, rays along the map edges are cut away
+static float GetBorder(float pos, int mapSize)
+{
+	return (Clamp(int(pos / SQUARE_SIZE + 0.5f), 1, mapSize - 1) * SQUARE_SIZE);
+}
+
+// a ray along the z-axis if <alongZ>, else along the x-axis; it stays in
+// one column (or row) of squares, sometimes exactly on its border
+static void MakeAxisRay(float3& from, float3& to, bool alongZ)
+{
+	MakeRay(from, to);
+
+	float3 axisFrom = from;
+	float3 axisTo = to;
+
+	if (randf() < 0.5f)
+		axisFrom.x = GetBorder(axisFrom.x, alongZ? MAPX: MAPY);
+
+	axisTo.x = axisFrom.x;
+
+	// wander within the square
+	if (randf() < 0.25f && axisFrom.x < (MAPX - 1) * SQUARE_SIZE)
+		axisTo.x = (int(axisFrom.x / SQUARE_SIZE) + randf() * 0.99f) * SQUARE_SIZE;
+
+	if (!alongZ) {
+		std::swap(axisFrom.x, axisFrom.z);
+		std::swap(axisTo.x, axisTo.z);
+	}
+
+	from = axisFrom;
+	to = axisTo;
+}
+
+// a ray ending (and sometimes also starting) on the border of a square
+static void MakeBorderRay(float3& from, float3& to)
+{
+	MakeRay(from, to);
+
+	if (randf() < 0.75f) to.x = GetBorder(to.x, MAPX);
+	if (randf() < 0.75f) to.z = GetBorder(to.z, MAPY);
+	if (randf() < 0.25f) from.x = GetBorder(from.x, MAPX);
+	if (randf() < 0.25f) from.z = GetBorder(from.z, MAPY);
+}
+
+// LineGroundCol has to find the same first hit whether it skips blocks or
+// not, the hit has to be on the ground, and a ray that ends below ground
+// has to hit it somewhere
+static void CheckRays(const Ground& ground, const std::vector<float3>& rays)
+{
+	int numHits = 0;
+
+	for (bool synced: {true, false}) {
+		for (size_t n = 0; n < rays.size(); n += 2) {
+			const float3& from = rays[n];
+			const float3& to = rays[n + 1];
+
+			const float stepDist = ground.LineGroundCol(from, to, false, synced);
+			const float skipDist = ground.LineGroundCol(from, to, true, synced);
+
+			BOOST_REQUIRE_EQUAL(stepDist, skipDist);
+
+			if (to.y < ground.GetHeight(to) - 1.0f)
+				BOOST_REQUIRE_GE(stepDist, 0.0f);
+
+			if (stepDist < 0.0f)
+				continue;
+
+			const float3 hitPos = from + (to - from).SafeNormalize() * stepDist;
+
+			BOOST_REQUIRE_SMALL(hitPos.y - ground.GetHeight(hitPos), 0.5f);
+			numHits++;
+		}
+	}
+
+	BOOST_CHECK_GT(numHits, 0);
+	BOOST_CHECK_LT(numHits, rays.size());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(Conservative)
+{
+	const std::vector<float> heightMap = MakeHeightMap();
+
+	CHeightMaxPyramid pyramid;
+	pyramid.Init(MAPX, MAPY);
+
+	// nothing is skipped before the first update
+	{
+		float3 from(100.0f, 10000.0f, 100.0f);
+		float3 to(1000.0f, 10000.0f, 1000.0f);
+		SRectangle block;
+		BOOST_CHECK(!pyramid.FindSkipBlock(from, to, 50, 50, block));
+	}
+
+	pyramid.Update(&heightMap[0], SRectangle(0, 0, MAPX, MAPY));
+
+	for (int l = 0; l < CHeightMaxPyramid::NUM_LEVELS; l++) {
+		for (int bz = 0; bz < pyramid.GetSizeZ(l); bz++) {
+			for (int bx = 0; bx < pyramid.GetSizeX(l); bx++) {
+				BOOST_REQUIRE_EQUAL(pyramid.GetMaxHeight(l, bx, bz), GetBlockMaxHeight(heightMap, l, bx, bz));
+			}
+		}
+	}
+
+	int numSkipped = 0;
+
+	for (int n = 0; n < 20000; n++) {
+		float3 from;
+		float3 to;
+		MakeRay(from, to);
+
+		const int x = Clamp(int(mix(from.x, to.x, randf()) / SQUARE_SIZE), 0, MAPX - 1);
+		const int z = Clamp(int(mix(from.z, to.z, randf()) / SQUARE_SIZE), 0, MAPY - 1);
+
+		SRectangle block;
+
+		if (!pyramid.FindSkipBlock(from, to, x, z, block))
+			continue;
+
+		numSkipped++;
+
+		BOOST_REQUIRE(x >= block.x1 && x <= block.x2 && z >= block.z1 && z <= block.z2);
+
+		for (int bz = block.z1; bz <= block.z2; bz++) {
+			for (int bx = block.x1; bx <= block.x2; bx++) {
+				BOOST_REQUIRE_GT(GetLineMinHeight(from, to, bx, bz), GetSquareMaxHeight(heightMap, bx, bz));
+			}
+		}
+	}
+
+	BOOST_CHECK_GT(numSkipped, 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(Deformation)
+{
+	std::vector<float> heightMap = MakeHeightMap();
+
+	CHeightMaxPyramid pyramid;
+	pyramid.Init(MAPX, MAPY);
+	pyramid.Update(&heightMap[0], SRectangle(0, 0, MAPX, MAPY));
+
+	// raise a hill, the pyramid has to follow before it is updated
+	const SRectangle rect(100, 200, 140, 230);
+
+	for (int z = rect.z1; z <= rect.z2; z++) {
+		for (int x = rect.x1; x <= rect.x2; x++) {
+			float& h = heightMap[z * (MAPX + 1) + x];
+
+			h += 300.0f - (std::abs(x - 120) + std::abs(z - 215)) * 5.0f;
+			pyramid.RaiseHeight(x, z, h);
+		}
+	}
+
+	for (int l = 0; l < CHeightMaxPyramid::NUM_LEVELS; l++) {
+		for (int bz = 0; bz < pyramid.GetSizeZ(l); bz++) {
+			for (int bx = 0; bx < pyramid.GetSizeX(l); bx++) {
+				BOOST_REQUIRE_GE(pyramid.GetMaxHeight(l, bx, bz), GetBlockMaxHeight(heightMap, l, bx, bz));
+			}
+		}
+	}
+
+	// then dig it out again, an update makes the bounds exact
+	for (int z = rect.z1; z <= rect.z2; z++) {
+		for (int x = rect.x1; x <= rect.x2; x++) {
+			heightMap[z * (MAPX + 1) + x] -= 400.0f;
+		}
+	}
+
+	pyramid.Update(&heightMap[0], rect);
+
+	for (int l = 0; l < CHeightMaxPyramid::NUM_LEVELS; l++) {
+		for (int bz = 0; bz < pyramid.GetSizeZ(l); bz++) {
+			for (int bx = 0; bx < pyramid.GetSizeX(l); bx++) {
+				BOOST_REQUIRE_EQUAL(pyramid.GetMaxHeight(l, bx, bz), GetBlockMaxHeight(heightMap, l, bx, bz));
+			}
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(LongRays)
+{
+	static const int NUM_RAYS = 200000;
+
+	const Ground ground;
+
+	std::vector<float3> rays(NUM_RAYS * 2);
+	std::vector<float> stepDists(NUM_RAYS);
+	std::vector<float> skipDists(NUM_RAYS);
+
+	for (int n = 0; n < NUM_RAYS; n++) {
+		MakeRay(rays[n * 2], rays[n * 2 + 1]);
+	}
+
+	{
+		ScopedOnceTimer timer("HeightMaxPyramid: every square");
+
+		for (int n = 0; n < NUM_RAYS; n++) {
+			stepDists[n] = ground.LineGroundCol(rays[n * 2], rays[n * 2 + 1], false, true);
+		}
+	}
+	{
+		ScopedOnceTimer timer("HeightMaxPyramid: skipping blocks");
+
+		for (int n = 0; n < NUM_RAYS; n++) {
+			skipDists[n] = ground.LineGroundCol(rays[n * 2], rays[n * 2 + 1], true, true);
+		}
+	}
+
+	for (int n = 0; n < NUM_RAYS; n++) {
+		BOOST_REQUIRE_EQUAL(stepDists[n], skipDists[n]);
+	}
+
+	CheckRays(ground, rays);
+}
+
+
+BOOST_AUTO_TEST_CASE(AxisParallelRays)
+{
+	static const int NUM_RAYS = 50000;
+
+	const Ground ground;
+
+	for (bool alongZ: {true, false}) {
+		std::vector<float3> rays(NUM_RAYS * 2);
+
+		for (int n = 0; n < NUM_RAYS; n++) {
+			MakeAxisRay(rays[n * 2], rays[n * 2 + 1], alongZ);
+		}
+
+		CheckRays(ground, rays);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(BorderRays)
+{
+	static const int NUM_RAYS = 50000;
+
+	const Ground ground;
+
+	std::vector<float3> rays(NUM_RAYS * 2);
+
+	for (int n = 0; n < NUM_RAYS; n++) {
+		MakeBorderRay(rays[n * 2], rays[n * 2 + 1]);
+	}
+
+	CheckRays(ground, rays);
+}
@@ -0,0 +1,187 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Net/PacketCache.h"
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "System/Net/RawPacket.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define BOOST_TEST_MODULE PacketCache
+#include <boost/test/unit_test.hpp>
+
+
+typedef std::shared_ptr<const netcode::RawPacket> PacketPtr;
+
+static PacketPtr MakeKeyFrame(int frameNum)
+{
+	netcode::RawPacket* packet = new netcode::RawPacket(1 + sizeof(frameNum));
+	packet->data[0] = NETMSG_KEYFRAME;
+	std::memcpy(packet->data + 1, &frameNum, sizeof(frameNum));
+	return PacketPtr(packet);
+}
+
+static PacketPtr MakeCommand(unsigned size)
+{
+	netcode::RawPacket* packet = new netcode::RawPacket(size);
+	packet->data[0] = NETMSG_COMMAND;
+
+	// somewhat compressible, like real traffic
+	for (unsigned n = 1; n < size; n++) {
+		packet->data[n] = std::rand() % 16;
+	}
+
+	return PacketPtr(packet);
+}
+
+// a game of <numFrames> frames with some pre-game traffic
+static std::vector<PacketPtr> MakeGame(int numFrames)
+{
+	std::vector<PacketPtr> game;
+
+	std::srand(1234);
+
+	for (int n = 0; n < 50; n++) {
+		game.push_back(MakeCommand(20 + std::rand() % 200));
+	}
+
+	for (int frameNum = 0; frameNum < numFrames; frameNum++) {
+		if ((frameNum % 16) == 0) {
+			game.push_back(MakeKeyFrame(frameNum));
+		} else {
+			game.push_back(PacketPtr(new netcode::RawPacket(reinterpret_cast<const unsigned char*>("\x02"), 1)));
+		}
+
+		for (int n = std::rand() % 4; n > 0; n--) {
+			game.push_back(MakeCommand(10 + std::rand() % 300));
+		}
+	}
+
+	return game;
+}
+
+static std::vector<PacketPtr> Replay(const CPacketCache& cache, int fromFrameNum = -1)
+{
+	std::vector<PacketPtr> packets;
+	cache.ForEachPacket([&](const PacketPtr& p) { packets.push_back(p); }, fromFrameNum);
+	return packets;
+}
+
+static bool Equal(const PacketPtr& a, const PacketPtr& b)
+{
+	return (a->length == b->length && std::memcmp(a->data, b->data, a->length) == 0);
+}
+
+static size_t GetRawSize(const std::vector<PacketPtr>& packets)
+{
+	size_t size = 0;
+
+	for (const PacketPtr& p: packets) {
+		size += p->length;
+	}
+
+	return size;
+}
+
+
+BOOST_AUTO_TEST_CASE(ReplayAll)
+{
+	const std::vector<PacketPtr> game = MakeGame(30 * 60 * 5);
+
+	CPacketCache cache;
+
+	for (const PacketPtr& p: game) {
+		cache.Add(p);
+	}
+
+	BOOST_CHECK_EQUAL(cache.GetNumPackets(), game.size());
+	BOOST_CHECK_GT(cache.GetNumSegments(), 2);
+	BOOST_CHECK_LT(cache.GetMemoryUsage(), GetRawSize(game));
+
+	const std::vector<PacketPtr> replayed = Replay(cache);
+
+	BOOST_REQUIRE_EQUAL(replayed.size(), game.size());
+
+	for (size_t n = 0; n < game.size(); n++) {
+		BOOST_REQUIRE(Equal(replayed[n], game[n]));
+	}
+
+	cache.Clear();
+	BOOST_CHECK(Replay(cache).empty());
+}
+
+
+BOOST_AUTO_TEST_CASE(SpillToDisk)
+{
+	const std::vector<PacketPtr> game = MakeGame(30 * 60 * 5);
+	const size_t maxMemory = 64 * 1024;
+
+	CPacketCache cache;
+	cache.SetMemoryLimit(maxMemory, true);
+
+	for (const PacketPtr& p: game) {
+		cache.Add(p);
+	}
+
+	BOOST_CHECK_GT(cache.GetNumSpilledSegments(), 0);
+	BOOST_CHECK_LE(cache.GetMemoryUsage(), maxMemory);
+
+	const std::vector<PacketPtr> replayed = Replay(cache);
+
+	BOOST_REQUIRE_EQUAL(replayed.size(), game.size());
+
+	for (size_t n = 0; n < game.size(); n++) {
+		BOOST_REQUIRE(Equal(replayed[n], game[n]));
+	}
+
+	// without spilling the limit can not be kept
+	CPacketCache memCache;
+	memCache.SetMemoryLimit(maxMemory, false);
+
+	for (const PacketPtr& p: game) {
+		memCache.Add(p);
+	}
+
+	BOOST_CHECK_EQUAL(memCache.GetNumSpilledSegments(), 0);
+	BOOST_CHECK_EQUAL(Replay(memCache).size(), game.size());
+}
+
+
+BOOST_AUTO_TEST_CASE(ReplayFromFrame)
+{
+	const std::vector<PacketPtr> game = MakeGame(30 * 60 * 5);
+	const int fromFrameNum = 30 * 60 * 4;
+
+	CPacketCache cache;
+
+	for (const PacketPtr& p: game) {
+		cache.Add(p);
+	}
+
+	const std::vector<PacketPtr> replayed = Replay(cache, fromFrameNum);
+
+	BOOST_CHECK_LT(replayed.size(), game.size() / 2);
+
+	// the pre-game traffic, then the tail starting with a keyframe
+	size_t n = 0;
+
+	for (; game[n]->data[0] != NETMSG_KEYFRAME; n++) {
+		BOOST_REQUIRE(Equal(replayed[n], game[n]));
+	}
+
+	BOOST_REQUIRE_EQUAL(replayed[n]->data[0], NETMSG_KEYFRAME);
+
+	int keyFrameNum = -1;
+	std::memcpy(&keyFrameNum, replayed[n]->data + 1, sizeof(keyFrameNum));
+
+	BOOST_CHECK_GT(keyFrameNum, 0);
+	BOOST_CHECK_LE(keyFrameNum, fromFrameNum);
+
+	// the skipped part lies between the two
+	const size_t numSkipped = game.size() - replayed.size();
+
+	for (; n < replayed.size(); n++) {
+		BOOST_REQUIRE(Equal(replayed[n], game[n + numSkipped]));
+	}
+}
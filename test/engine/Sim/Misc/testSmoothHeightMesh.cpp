@@ -0,0 +1,249 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Map/ReadMap.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/SmoothHeightMesh.h"
+#include "System/float3.h"
+#include "System/Misc/SpringTime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define BOOST_TEST_MODULE SmoothHeightMesh
+#include <boost/test/unit_test.hpp>
+BOOST_GLOBAL_FIXTURE(InitSpringTime);
+
+// Deforms a synthetic heightmap, lets the mesh follow through TerrainChanged
+// and Update (as CBasicMapDamage does) and compares the result bit for bit
+// with a mesh made from scratch; air movement reads the mesh in synced code.
+
+CReadMap* readMap = nullptr;
+MapDimensions mapDims;
+
+// not square, so mixed up axes show
+static const int MAPX = 256;
+static const int MAPY = 192;
+
+static inline float randf()
+{
+	return std::rand() / float(RAND_MAX);
+}
+
+
+// the parts of CReadMap that Ground.cpp and SmoothHeightMesh.cpp read;
+// ReadMap.cpp itself would pull in the whole map loading and rendering
+CReadMap::CReadMap()
+	: metalMap(nullptr)
+	, heightMapSyncedPtr(nullptr)
+	, heightMapUnsyncedPtr(nullptr)
+	, mapChecksum(0)
+	, boundingRadius(0.0f)
+{
+}
+
+CReadMap::~CReadMap()
+{
+}
+
+void CReadMap::Initialize()
+{
+	sharedCornerHeightMaps[0] = &(*heightMapUnsyncedPtr)[0];
+	sharedCornerHeightMaps[1] = &(*heightMapSyncedPtr)[0];
+
+	const auto bounds = std::minmax_element(heightMapSyncedPtr->begin(), heightMapSyncedPtr->end());
+
+	initHeightBounds.x = *bounds.first;
+	initHeightBounds.y = *bounds.second;
+	currHeightBounds = initHeightBounds;
+}
+
+
+class CTestReadMap: public CReadMap
+{
+public:
+	// rolling hills, partly under water, with some noise on top
+	CTestReadMap(): heightMap((MAPX + 1) * (MAPY + 1)) {
+		mapDims.mapx = MAPX;
+		mapDims.mapy = MAPY;
+		mapDims.Initialize();
+
+		float3::maxxpos = MAPX * SQUARE_SIZE - 1;
+		float3::maxzpos = MAPY * SQUARE_SIZE - 1;
+
+		std::srand(1234);
+
+		for (int z = 0; z <= MAPY; z++) {
+			for (int x = 0; x <= MAPX; x++) {
+				const float h = std::sin(x * 0.043f) * std::cos(z * 0.037f) * 120.0f + std::sin((x - z) * 0.013f) * 80.0f;
+				heightMap[z * (MAPX + 1) + x] = h + randf() * 8.0f;
+			}
+		}
+
+		heightMapSyncedPtr = &heightMap;
+		heightMapUnsyncedPtr = &heightMap;
+		heightMaxPyramidSynced.Init(MAPX, MAPY);
+
+		Initialize();
+	}
+
+	void UpdateHeightMapUnsynced(const SRectangle&) {}
+
+	void InitGroundDrawer() {}
+	void KillGroundDrawer() {}
+	unsigned int GetShadingTexture() const { return 0; }
+	void DrawMinimap() const {}
+
+	int GetNumFeatures() { return 0; }
+	int GetNumFeatureTypes() { return 0; }
+	void GetFeatureInfo(MapFeatureInfo* f) {}
+	const char* GetFeatureTypeName(int typeID) { return ""; }
+
+	unsigned char* GetInfoMap(const std::string& name, MapBitmapInfo* bm) { return nullptr; }
+	void FreeInfoMap(const std::string& name, unsigned char* data) {}
+
+	void GridVisibility(CCamera* cam, IQuadDrawer* cb, float maxDist, int quadSize, int extraSize) {}
+
+private:
+	std::vector<float> heightMap;
+};
+
+
+struct Fixture {
+	Fixture() {
+		readMap = &map;
+		mesh = MakeMesh();
+	}
+	~Fixture() {
+		delete mesh;
+		readMap = nullptr;
+	}
+
+	// same parameters as CGame
+	static SmoothHeightMesh* MakeMesh() {
+		return (new SmoothHeightMesh(float3::maxxpos, float3::maxzpos, SQUARE_SIZE * 2, SQUARE_SIZE * 40));
+	}
+
+	// vertices within <x1, z1> - <x2, z2> (inclusive), the way CBasicMapDamage reports them
+	void Deform(int x1, int z1, int x2, int z2, float height) {
+		for (int z = z1; z <= z2; z++) {
+			for (int x = x1; x <= x2; x++) {
+				map.AddHeight(z * (MAPX + 1) + x, height * (0.5f + randf()));
+			}
+		}
+
+		mesh->TerrainChanged(x1, z1, x2, z2);
+	}
+
+	void DeformRandom(int maxSize, float height) {
+		const int x1 = std::rand() % (MAPX + 1);
+		const int z1 = std::rand() % (MAPY + 1);
+		const int x2 = std::min(x1 + std::rand() % maxSize, MAPX);
+		const int z2 = std::min(z1 + std::rand() % maxSize, MAPY);
+
+		Deform(x1, z1, x2, z2, height);
+	}
+
+	// number of cells that differ from those of a mesh made from scratch
+	int Compare() const {
+		SmoothHeightMesh* fresh = MakeMesh();
+
+		const int maxx = mesh->GetMaxX();
+		const int maxy = mesh->GetMaxY();
+
+		BOOST_REQUIRE_EQUAL(maxx, fresh->GetMaxX());
+		BOOST_REQUIRE_EQUAL(maxy, fresh->GetMaxY());
+
+		int numDiffs = 0;
+
+		for (int i = 0; i < (maxx * maxy); i++) {
+			const bool sameMesh = (std::memcmp(&mesh->GetMeshData()[i], &fresh->GetMeshData()[i], sizeof(float)) == 0);
+			const bool sameOrig = (std::memcmp(&mesh->GetOriginalMeshData()[i], &fresh->GetOriginalMeshData()[i], sizeof(float)) == 0);
+
+			if (sameMesh && sameOrig)
+				continue;
+
+			if ((numDiffs++) == 0) {
+				BOOST_TEST_MESSAGE("first difference at cell " << (i % maxx) << ", " << (i / maxx) << ": "
+					<< mesh->GetMeshData()[i] << " instead of " << fresh->GetMeshData()[i]);
+			}
+		}
+
+		delete fresh;
+		return numDiffs;
+	}
+
+	CTestReadMap map;
+	SmoothHeightMesh* mesh;
+};
+
+
+BOOST_FIXTURE_TEST_CASE(InteriorChanges, Fixture)
+{
+	// craters and bumps, one per frame
+	for (int n = 0; n < 40; n++) {
+		const int x = 8 + std::rand() % (MAPX - 24);
+		const int z = 8 + std::rand() % (MAPY - 24);
+
+		Deform(x, z, x + std::rand() % 8, z + std::rand() % 8, (randf() - 0.6f) * 40.0f);
+		mesh->Update();
+
+		BOOST_CHECK_EQUAL(Compare(), 0);
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(BorderChanges, Fixture)
+{
+	// corners, edges, single vertices on them and full-length strips
+	const SRectangle rects[] = {
+		SRectangle(   0,    0,    5,    5),
+		SRectangle(MAPX - 3,    0, MAPX,    7),
+		SRectangle(   0, MAPY - 6,    4, MAPY),
+		SRectangle(MAPX - 1, MAPY - 1, MAPX, MAPY),
+		SRectangle(   0,    0,    0,    0),
+		SRectangle(MAPX, MAPY, MAPX, MAPY),
+		SRectangle(  60,    0,   70,    2),
+		SRectangle(   0,   90,    3,  100),
+		SRectangle( 120, MAPY,  121, MAPY),
+		SRectangle(MAPX,   40, MAPX,   48),
+		SRectangle(   0,   50, MAPX,   52),
+		SRectangle( 130,    0,  131, MAPY),
+		SRectangle(   0,    0, MAPX, MAPY),
+	};
+
+	for (const SRectangle& r: rects) {
+		Deform(r.x1, r.z1, r.x2, r.z2, 30.0f);
+		mesh->Update();
+
+		BOOST_CHECK_EQUAL(Compare(), 0);
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(BatchedChanges, Fixture)
+{
+	// many overlapping changes within one frame, merged by Update
+	for (int n = 0; n < 10; n++) {
+		for (int k = 0; k < 25; k++) {
+			DeformRandom(20, (randf() - 0.5f) * 30.0f);
+		}
+
+		mesh->Update();
+
+		BOOST_CHECK_EQUAL(Compare(), 0);
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(NewMaximum, Fixture)
+{
+	// raising the ground above the highest point moves the height bound
+	// all smoothed cells are clamped to, including the unchanged ones
+	Deform(100, 100, 104, 104, 400.0f);
+	mesh->Update();
+	BOOST_CHECK_EQUAL(Compare(), 0);
+
+	Deform(10, 150, 12, 152, 800.0f);
+	mesh->Update();
+	BOOST_CHECK_EQUAL(Compare(), 0);
+}
@@ -0,0 +1,121 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/TeamStatsHistory.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define BOOST_TEST_MODULE TeamStatsHistory
+#include <boost/test/unit_test.hpp>
+
+static inline float randf()
+{
+	return std::rand() / float(RAND_MAX);
+}
+
+// four hours of a team that keeps growing its economy
+static void MakeHistory(TeamStatsHistory& history, std::vector<TeamStatistics>& records)
+{
+	static const int NUM_RECORDS = (4 * 60 * 60) / TeamStatistics::statsPeriod;
+
+	std::srand(1234);
+
+	for (int n = 0; n < NUM_RECORDS; n++) {
+		TeamStatistics& stats = history.GetCurrent();
+
+		stats.frame = n * TeamStatistics::statsPeriod * 30;
+		stats.metalProduced  += 20.0f * TeamStatistics::statsPeriod * (1.0f + n * 0.01f) * randf();
+		stats.energyProduced += 200.0f * TeamStatistics::statsPeriod * (1.0f + n * 0.01f) * randf();
+		stats.metalUsed      += 15.0f * TeamStatistics::statsPeriod * randf();
+		stats.energyUsed     += 150.0f * TeamStatistics::statsPeriod * randf();
+		stats.damageDealt    += 1000.0f * randf() * (randf() < 0.3f);
+		stats.unitsProduced  += std::rand() % 4;
+		stats.unitsDied      += std::rand() % 3;
+		stats.unitsKilled    += std::rand() % 3;
+
+		records.push_back(stats);
+		history.PushCurrent();
+	}
+
+	// the current record, still being filled
+	history.GetCurrent().metalUsed += 1.0f;
+	records.push_back(history.GetCurrent());
+}
+
+static bool Equal(const TeamStatistics& a, const TeamStatistics& b)
+{
+	return (std::memcmp(&a, &b, sizeof(TeamStatistics)) == 0);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(Empty)
+{
+	TeamStatsHistory history;
+	std::vector<TeamStatistics> range;
+
+	BOOST_CHECK_EQUAL(history.size(), 1);
+
+	history.GetRange(0, 10, range);
+	BOOST_CHECK_EQUAL(range.size(), 1);
+}
+
+
+BOOST_AUTO_TEST_CASE(Lossless)
+{
+	TeamStatsHistory history;
+	std::vector<TeamStatistics> records;
+	std::vector<TeamStatistics> range;
+
+	MakeHistory(history, records);
+
+	BOOST_REQUIRE_EQUAL(history.size(), records.size());
+
+	history.GetRange(0, history.size() - 1, range);
+	BOOST_REQUIRE_EQUAL(range.size(), records.size());
+
+	for (size_t n = 0; n < records.size(); n++) {
+		BOOST_REQUIRE(Equal(range[n], records[n]));
+	}
+
+	BOOST_TEST_MESSAGE("encoded " << (records.size() - 1) << " records in " << history.GetDataSize() << " bytes, raw " << ((records.size() - 1) * sizeof(TeamStatistics)));
+	BOOST_CHECK_LT(history.GetDataSize(), ((records.size() - 1) * sizeof(TeamStatistics)) / 2);
+}
+
+
+BOOST_AUTO_TEST_CASE(Ranges)
+{
+	TeamStatsHistory history;
+	std::vector<TeamStatistics> records;
+	std::vector<TeamStatistics> range;
+
+	MakeHistory(history, records);
+
+	const unsigned int size = history.size();
+	const unsigned int interval = TeamStatsHistory::KEYFRAME_INTERVAL;
+
+	const unsigned int starts[] = {0, 1, interval - 1, interval, interval + 1, size - 2, size - 1};
+
+	for (const unsigned int start: starts) {
+		for (unsigned int count = 1; count <= (interval * 2 + 3); count += 7) {
+			history.GetRange(start, start + count - 1, range);
+
+			// clamped to the end of the history
+			const unsigned int expected = std::min(count, size - start);
+
+			BOOST_REQUIRE_EQUAL(range.size(), expected);
+
+			for (unsigned int n = 0; n < expected; n++) {
+				BOOST_REQUIRE(Equal(range[n], records[start + n]));
+			}
+		}
+	}
+
+	history.GetRange(size, size + 10, range);
+	BOOST_CHECK(range.empty());
+
+	history.GetRange(10, 5, range);
+	BOOST_CHECK(range.empty());
+}
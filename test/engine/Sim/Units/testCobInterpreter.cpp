@@ -0,0 +1,719 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/CobEngine.h"
+#include "Sim/Units/Scripts/CobFile.h"
+#include "Sim/Units/Scripts/CobInstance.h"
+#include "Sim/Units/Scripts/CobOpcodes.h"
+#include "Sim/Weapons/WeaponDefHandler.h"
+#include "Lua/LuaRules.h"
+#include "System/FileSystem/FileHandler.h"
+#include "System/GlobalRNG.h"
+#include "System/Sound/ISound.h"
+#include "System/Sound/ISoundChannels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE CobInterpreter
+#include <boost/test/unit_test.hpp>
+
+// Runs COB scripts through the real CCobFile, CCobInstance, CCobThread and
+// CCobEngine; only the CUnitScript callouts (animation, SET/GET, ...) are
+// replaced by stubs which hash their arguments. The RandomScripts checksums
+// were recorded with the switch interpreter that executed the raw code before
+// it was pre-decoded, this test is built once with computed-goto dispatch and
+// once with -DCOB_SWITCH_DISPATCH.
+
+
+// the parts of the engine the COB sources link against, which are
+// either never reached by these tests or only record their calls
+CLuaRules* luaRules = nullptr;
+CWeaponDefHandler* weaponDefHandler = nullptr;
+CGlobalSyncedRNG gsRNG;
+
+ISound* ISound::singleton = nullptr;
+IAudioChannel* Channels::UnitReply = nullptr;
+
+lua_Hash lua_calchash(const char* s, size_t l) { return 0; }
+void CLuaRules::Cob2Lua(const LuaHashString& funcName, const CUnit* unit, int& argsCount, int args[MAX_LUA_COB_ARGS]) {}
+const WeaponDef* CWeaponDefHandler::GetWeaponDefByID(int weaponDefId) const { return nullptr; }
+
+CFileHandler::CFileHandler(const std::string& fileName, const std::string& modes): filePos(0), fileSize(-1) {}
+CFileHandler::~CFileHandler() {}
+bool CFileHandler::TryReadFromPWD(const std::string& fileName) { return false; }
+bool CFileHandler::TryReadFromRawFS(const std::string& fileName) { return false; }
+bool CFileHandler::TryReadFromVFS(const std::string& fileName, int section) { return false; }
+bool CFileHandler::FileExists() const { return (fileSize >= 0); }
+int CFileHandler::FileSize() const { return fileSize; }
+int CFileHandler::Read(void* buf, int length)
+{
+	length = std::min(length, fileSize - filePos);
+	memcpy(buf, &fileBuffer[filePos], length);
+	filePos += length;
+	return length;
+}
+
+class CMemFileHandler: public CFileHandler
+{
+public:
+	CMemFileHandler(const std::vector<std::uint8_t>& data) {
+		fileBuffer = data;
+		fileSize = data.size();
+	}
+};
+
+
+
+// every callout of the scripts is hashed in the order it was made
+static unsigned int traceHash = 2166136261u;
+static unsigned int numTraceEvents = 0;
+
+static void Trace(int v)
+{
+	traceHash = (traceHash ^ unsigned(v)) * 16777619u;
+	numTraceEvents++;
+}
+
+static void Trace(float v)
+{
+	int i;
+	memcpy(&i, &v, sizeof(i));
+	Trace(i);
+}
+
+template<typename T, typename... Args> static void Trace(T v, Args... args)
+{
+	Trace(v);
+	Trace(args...);
+}
+
+
+// animations finish one engine tick after they were started
+struct PendingAnim {
+	const CUnitScript* script;
+	CUnitScript::AnimType type;
+	int piece;
+	int axis;
+};
+
+static std::vector<PendingAnim> pendingAnims;
+
+static void StopAnim(const CUnitScript* script, CUnitScript::AnimType type, int piece, int axis)
+{
+	for (size_t i = 0; i < pendingAnims.size(); i++) {
+		const PendingAnim& pa = pendingAnims[i];
+
+		if (pa.script != script || pa.type != type || pa.piece != piece || pa.axis != axis)
+			continue;
+
+		pendingAnims.erase(pendingAnims.begin() + i);
+		return;
+	}
+}
+
+static void StartAnim(const CUnitScript* script, CUnitScript::AnimType type, int piece, int axis)
+{
+	StopAnim(script, type, piece, axis);
+	pendingAnims.push_back({script, type, piece, axis});
+}
+
+static void FinishAnims(CCobInstance* instance)
+{
+	std::vector<PendingAnim> finished;
+	finished.swap(pendingAnims);
+
+	for (const PendingAnim& pa: finished) {
+		instance->AnimFinished(pa.type, pa.piece, pa.axis);
+	}
+}
+
+
+CUnitScript::CUnitScript(CUnit* unit)
+	: unit(unit)
+	, busy(false)
+	, numAnims(0)
+	, hasSetSFXOccupy(false)
+	, hasRockUnit(false)
+	, hasStartBuilding(false)
+{ }
+
+CUnitScript::~CUnitScript() {}
+
+void CUnitScript::Spin(int piece, int axis, float speed, float accel) { Trace(1, piece, axis, speed, accel); }
+void CUnitScript::StopSpin(int piece, int axis, float decel) { Trace(2, piece, axis, decel); }
+void CUnitScript::Turn(int piece, int axis, float speed, float destination) { Trace(3, piece, axis, speed, destination); StartAnim(this, ATurn, piece, axis); }
+void CUnitScript::Move(int piece, int axis, float speed, float destination) { Trace(4, piece, axis, speed, destination); StartAnim(this, AMove, piece, axis); }
+void CUnitScript::MoveNow(int piece, int axis, float destination) { Trace(5, piece, axis, destination); StopAnim(this, AMove, piece, axis); }
+void CUnitScript::TurnNow(int piece, int axis, float destination) { Trace(6, piece, axis, destination); StopAnim(this, ATurn, piece, axis); }
+
+bool CUnitScript::NeedsWait(AnimType type, int piece, int axis)
+{
+	Trace(7, int(type), piece, axis);
+
+	for (const PendingAnim& pa: pendingAnims) {
+		if (pa.script == this && pa.type == type && pa.piece == piece && pa.axis == axis)
+			return true;
+	}
+
+	return false;
+}
+
+void CUnitScript::SetVisibility(int piece, bool visible) { Trace(8, piece, int(visible)); }
+void CUnitScript::EmitSfx(int type, int piece) { Trace(9, type, piece); }
+void CUnitScript::AttachUnit(int piece, int unit) { Trace(10, piece, unit); }
+void CUnitScript::DropUnit(int unit) { Trace(11, unit); }
+void CUnitScript::Explode(int piece, int flags) { Trace(12, piece, flags); }
+void CUnitScript::ShowFlare(int piece) { Trace(13, piece); }
+void CUnitScript::SetUnitVal(int val, int param) { Trace(14, val, param); }
+
+int CUnitScript::GetUnitVal(int val, int p1, int p2, int p3, int p4)
+{
+	Trace(15, val, p1, p2, p3, p4);
+	return int(unsigned(val) * 31u + unsigned(p1) * 7u + unsigned(p2) * 5u + unsigned(p3) * 3u + unsigned(p4));
+}
+
+
+
+// raw opcodes, as found in .cob files
+enum RawOpcode {
+	#define COB_RAW_OPCODE(name, value, numArgs, mnemonic) name = value,
+	COB_OPCODE_LIST(COB_RAW_OPCODE)
+	#undef COB_RAW_OPCODE
+};
+
+// LUA0, see CobThread.cpp
+static const int LUA_ARG_0 = 110;
+
+
+struct CobScript {
+	std::vector<std::string> names;
+	std::vector<int> offsets;
+	std::vector<int> code;
+	int numStatics;
+
+	int Here() const { return code.size(); }
+
+	void Emit(int v) { code.push_back(v); }
+	void Emit(int v, int a) { Emit(v); Emit(a); }
+	void Emit(int v, int a, int b) { Emit(v); Emit(a); Emit(b); }
+
+	void Begin(const std::string& name) {
+		names.push_back(name);
+		offsets.push_back(Here());
+	}
+
+	// a .cob file as written by scriptor, without pieces and sounds
+	std::vector<std::uint8_t> Write() const {
+		const int numScripts = names.size();
+		const int headerSize = 13;
+
+		std::vector<int> header(headerSize + numScripts * 2, 0);
+		std::vector<char> strings;
+
+		for (int i = 0; i < numScripts; i++) {
+			header[headerSize + i] = offsets[i];
+			header[headerSize + numScripts + i] = header.size() * 4 + strings.size();
+			strings.insert(strings.end(), names[i].begin(), names[i].end());
+			strings.push_back(0);
+		}
+
+		strings.resize((strings.size() + 3) & ~3, 0);
+
+		header[0] = 4; // VersionSignature
+		header[1] = numScripts;
+		header[2] = 0; // NumberOfPieces
+		header[3] = code.size(); // TotalScriptLen
+		header[4] = numStatics;
+		header[6] = headerSize * 4; // OffsetToScriptCodeIndexArray
+		header[7] = (headerSize + numScripts) * 4; // OffsetToScriptNameOffsetArray
+		header[8] = (headerSize + numScripts * 2) * 4; // OffsetToPieceNameOffsetArray
+		header[9] = header.size() * 4 + strings.size(); // OffsetToScriptCode
+		header[10] = header[headerSize + numScripts];
+
+		std::vector<std::uint8_t> data;
+
+		// little endian
+		const auto WriteInt = [&](int v) {
+			for (int b = 0; b < 4; b++) {
+				data.push_back((unsigned(v) >> (b * 8)) & 0xFF);
+			}
+		};
+
+		for (const int v: header) {
+			WriteInt(v);
+		}
+
+		data.insert(data.end(), strings.begin(), strings.end());
+
+		for (const int v: code) {
+			WriteInt(v);
+		}
+
+		return data;
+	}
+};
+
+
+// a unit that runs <script>, ticked the same way as in the sim
+struct CobUnit {
+	CobUnit(const CobScript& s): file(nullptr), instance(nullptr) {
+		CMemFileHandler fh(s.Write());
+
+		cobEngine = new CCobEngine();
+		file = new CCobFile(fh, "test.cob");
+
+		// CCobInstance::Init needs a unit with a model
+		instance = new CCobInstance();
+		instance->script = file;
+		instance->staticVars.resize(file->numStaticVars, 0);
+
+		pendingAnims.clear();
+	}
+
+	~CobUnit() {
+		delete instance;
+		delete cobEngine;
+		delete file;
+
+		cobEngine = nullptr;
+	}
+
+	int Call(int fn, std::vector<int>& args) {
+		const int ret = instance->RawCall(fn, args);
+
+		Trace(100, ret, int(args.size()));
+
+		for (const int arg: args) {
+			Trace(arg);
+		}
+
+		return ret;
+	}
+
+	void Tick() {
+		cobEngine->Tick(33);
+		FinishAnims(instance);
+
+		for (const int v: instance->staticVars) {
+			Trace(v);
+		}
+	}
+
+	CCobFile* file;
+	CCobInstance* instance;
+};
+
+
+
+BOOST_AUTO_TEST_CASE(Arithmetic)
+{
+	CobScript s;
+	s.numStatics = 2;
+
+	// Create(a, b) { call-script Sum(a); b = static0 * 3 - 1 / 0; call-script lua_Func(7, 8, 9); static1 = get LUA2; return b; }
+	s.Begin("Create");
+	s.Emit(CREATE_LOCAL_VAR);
+	s.Emit(CREATE_LOCAL_VAR);
+	s.Emit(PUSH_LOCAL_VAR, 0);
+	s.Emit(CALL, 1, 1);
+	s.Emit(PUSH_CONSTANT, 3);
+	s.Emit(PUSH_STATIC, 0);
+	s.Emit(MUL);
+	s.Emit(PUSH_CONSTANT, 1);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(DIV); // division by zero, yields 1000
+	s.Emit(SUB);
+	s.Emit(POP_LOCAL_VAR, 1);
+	s.Emit(PUSH_CONSTANT, 7);
+	s.Emit(PUSH_CONSTANT, 8);
+	s.Emit(PUSH_CONSTANT, 9);
+	s.Emit(CALL, 2, 3); // LUA_CALL without Lua, copies the arguments
+	s.Emit(PUSH_CONSTANT, LUA_ARG_0 + 2);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(GET);
+	s.Emit(POP_STATIC, 1);
+	s.Emit(PUSH_LOCAL_VAR, 1);
+	s.Emit(RETURN);
+
+	// Sum(n) { i = 0; while (i < n) { i = i + 1; static0 = static0 + i; } return 0; }
+	s.Begin("Sum");
+	s.Emit(CREATE_LOCAL_VAR);
+	s.Emit(CREATE_LOCAL_VAR);
+	const int loop = s.Here();
+	s.Emit(PUSH_LOCAL_VAR, 1);
+	s.Emit(PUSH_LOCAL_VAR, 0);
+	s.Emit(SET_LESS);
+	s.Emit(JUMP_NOT_EQUAL, 0);
+	const int exit = s.Here() - 1;
+	s.Emit(PUSH_LOCAL_VAR, 1);
+	s.Emit(PUSH_CONSTANT, 1);
+	s.Emit(ADD);
+	s.Emit(POP_LOCAL_VAR, 1);
+	s.Emit(PUSH_STATIC, 0);
+	s.Emit(PUSH_LOCAL_VAR, 1);
+	s.Emit(ADD);
+	s.Emit(POP_STATIC, 0);
+	s.Emit(JUMP, loop);
+	s.code[exit] = s.Here();
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(RETURN);
+
+	s.Begin("lua_Func");
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(RETURN);
+
+	CobUnit u(s);
+
+	std::vector<int> args = {10, 0};
+
+	BOOST_CHECK_EQUAL(u.Call(0, args), 0);
+	BOOST_CHECK_EQUAL(u.instance->staticVars[0], 55);
+	BOOST_CHECK_EQUAL(u.instance->staticVars[1], 9);
+	BOOST_CHECK_EQUAL(args[0], 10);
+	BOOST_CHECK_EQUAL(args[1], 55 * 3 - 1000);
+	BOOST_CHECK(u.instance->threadIDs.empty());
+}
+
+
+BOOST_AUTO_TEST_CASE(WaitAndSleep)
+{
+	CobScript s;
+	s.numStatics = 1;
+
+	// Create() { start-script Anim(); set-signal-mask 1; while (TRUE) { sleep 30; static0 = static0 + 1; } }
+	s.Begin("Create");
+	s.Emit(START, 1, 0);
+	s.Emit(PUSH_CONSTANT, 1);
+	s.Emit(SET_SIGNAL_MASK);
+	const int loop = s.Here();
+	s.Emit(PUSH_CONSTANT, 30);
+	s.Emit(SLEEP);
+	s.Emit(PUSH_STATIC, 0);
+	s.Emit(PUSH_CONSTANT, 1);
+	s.Emit(ADD);
+	s.Emit(POP_STATIC, 0);
+	s.Emit(JUMP, loop);
+
+	// Anim() { turn 3 around y-axis to 5 speed 2; wait-for-turn 3 around y-axis; signal 1; return 0; }
+	s.Begin("Anim");
+	s.Emit(PUSH_CONSTANT, 2);
+	s.Emit(PUSH_CONSTANT, 5);
+	s.Emit(TURN, 3, 1);
+	s.Emit(WAIT_TURN, 3, 1);
+	s.Emit(PUSH_CONSTANT, 1);
+	s.Emit(SIGNAL);
+	s.Emit(PUSH_CONSTANT, 0);
+	s.Emit(RETURN);
+
+	CobUnit u(s);
+
+	std::vector<int> args;
+
+	// Create sleeps, Anim is scheduled for the next tick
+	BOOST_CHECK_EQUAL(u.Call(0, args), 1);
+	BOOST_CHECK_EQUAL(u.instance->threadIDs.size(), 2);
+
+	// Create wakes up every tick; Anim starts its turn in the
+	// second, waits for it until the third and kills Create in
+	// the fourth
+	for (int n = 1; n <= 3; n++) {
+		u.Tick();
+		BOOST_CHECK_EQUAL(u.instance->staticVars[0], n);
+		BOOST_CHECK_EQUAL(u.instance->threadIDs.size(), 2);
+	}
+
+	u.Tick();
+	BOOST_CHECK_EQUAL(u.instance->staticVars[0], 3);
+	BOOST_CHECK(u.instance->threadIDs.empty());
+}
+
+
+// random, but well-formed scripts; functions only call those with higher
+// indices and loops are bounded, so every thread terminates eventually
+class ScriptGenerator {
+public:
+	static const int numScripts = 6;
+	static const int numStatics = 4;
+	static const int numLocals = 4;
+
+	CobScript Generate() {
+		s = CobScript();
+		s.numStatics = numStatics;
+
+		const int emptyScript = RandInt(numScripts * 2);
+
+		for (int i = 0; i < numScripts; i++) {
+			curScript = i;
+
+			switch (i) {
+				case 0: { s.Begin("Create"); } break;
+				case 1: { s.Begin("FireWeapon1"); } break; // SHOW shows a flare
+				case 2: { s.Begin("lua_Func2"); } break;
+				default: { s.Begin("Func" + std::to_string(i)); } break;
+			}
+
+			// skip the call, but not the arguments
+			if (i == emptyScript && i > 0)
+				continue;
+
+			for (int n = 0; n < numLocals; n++) {
+				s.Emit(CREATE_LOCAL_VAR);
+			}
+
+			Block(0, 2 + RandInt(12));
+
+			Expr(1);
+			s.Emit(RETURN);
+		}
+
+		return s;
+	}
+
+	// the sequence of std::minstd_rand, which is fixed unlike rand()'s (<random>
+	// itself can not be used, the engine is built with _RANDOM_TCC defined)
+	int RandInt(int n) { return ((rngState = (std::uint64_t(rngState) * 48271u) % 2147483647u) % n); }
+	void Seed(unsigned int seed) { rngState = ((seed % 2147483647u) == 0)? 1: (seed % 2147483647u); }
+
+private:
+	void Const(int v) { s.Emit(PUSH_CONSTANT, v); }
+
+	void Expr(int depth) {
+		static const int binaryOps[] = {
+			ADD, SUB, MUL, BITWISE_AND, BITWISE_OR, BITWISE_XOR,
+			SET_LESS, SET_LESS_OR_EQUAL, SET_GREATER, SET_GREATER_OR_EQUAL, SET_EQUAL, SET_NOT_EQUAL,
+			LOGICAL_AND, LOGICAL_OR, LOGICAL_XOR,
+		};
+
+		switch (RandInt((depth < 3)? 10: 4)) {
+			case 0: { Const(RandInt(48) - 8); } break;
+			case 1: { s.Emit(PUSH_LOCAL_VAR, RandInt(numLocals)); } break;
+			case 2: { s.Emit(PUSH_STATIC, RandInt(numStatics)); } break;
+			case 3: { Const(RandInt(1 << 20) - (1 << 19)); } break;
+			case 4:
+			case 5: {
+				Expr(depth + 1);
+				Expr(depth + 1);
+				s.Emit(binaryOps[RandInt(sizeof(binaryOps) / sizeof(binaryOps[0]))]);
+			} break;
+			case 6: {
+				// constant divisors, INT_MIN / -1 traps; 0 is an error but handled
+				Expr(depth + 1);
+				Const((RandInt(2) == 0)? RandInt(6): -2 - RandInt(4));
+				s.Emit(Pick(DIV, MOD));
+			} break;
+			case 7: {
+				Expr(depth + 1);
+				s.Emit(Pick(BITWISE_NOT, LOGICAL_NOT));
+			} break;
+			case 8: {
+				const int lo = RandInt(20) - 10;
+				Const(lo);
+				Const(lo + RandInt(10));
+				s.Emit(RAND);
+			} break;
+			case 9: {
+				if (RandInt(2) == 0) {
+					Const(UnitValue());
+					s.Emit(GET_UNIT_VALUE);
+				} else {
+					Const(UnitValue());
+					for (int n = 0; n < 4; n++) {
+						Expr(depth + 1);
+					}
+					s.Emit(GET);
+				}
+			} break;
+		}
+	}
+
+	// unit value or Lua argument index
+	int UnitValue() { return ((RandInt(3) == 0)? LUA_ARG_0 + RandInt(10): RandInt(100)); }
+	int Piece() { return RandInt(4); }
+	int Axis() { return RandInt(3); }
+	int Pick(int a, int b) { return ((RandInt(2) == 0)? a: b); }
+
+	// the order in which function arguments are evaluated is unspecified,
+	// draw the operands one by one to generate the same scripts everywhere
+	void PieceOp(int op) {
+		const int piece = Piece();
+		s.Emit(op, piece);
+	}
+	void AxisOp(int op) {
+		const int piece = Piece();
+		const int axis = Axis();
+		s.Emit(op, piece, axis);
+	}
+
+	// a callee and at most numLocals arguments
+	void Call(int op, int depth) {
+		if (curScript == numScripts - 1) {
+			Expr(depth);
+			s.Emit(POP_STACK);
+			return;
+		}
+
+		const int callee = curScript + 1 + RandInt(numScripts - curScript - 1);
+		const int numArgs = RandInt(numLocals + 1);
+
+		for (int n = 0; n < numArgs; n++) {
+			Expr(depth + 1);
+		}
+
+		s.Emit(op, callee, numArgs);
+	}
+
+	void Block(int depth, int numStatements) {
+		for (int n = 0; n < numStatements; n++) {
+			Statement(depth);
+		}
+	}
+
+	// statements leave the stack as they found it, except for calls to empty scripts
+	void Statement(int depth) {
+		switch (RandInt((depth < 2)? 24: 20)) {
+			case 0: { Expr(1); s.Emit(POP_STATIC, RandInt(numStatics)); } break;
+			// the last local is the loop counter
+			case 1: { Expr(1); s.Emit(POP_LOCAL_VAR, RandInt(numLocals - 1)); } break;
+			case 2: { Expr(1); s.Emit(POP_STACK); } break;
+			case 3: { Expr(1); Expr(1); AxisOp(Pick(TURN, MOVE)); } break;
+			case 4: { Expr(1); Expr(1); AxisOp(SPIN); } break;
+			case 5: { Expr(1); AxisOp(Pick(TURN_NOW, MOVE_NOW)); } break;
+			case 6: { Expr(1); AxisOp(STOP_SPIN); } break;
+			case 7: { AxisOp(Pick(WAIT_TURN, WAIT_MOVE)); } break;
+			case 8: { Const(RandInt(120) - 20); s.Emit(SLEEP); } break;
+			case 9: { PieceOp(Pick(SHOW, HIDE)); } break;
+			case 10: { Expr(1); PieceOp(Pick(EMIT_SFX, EXPLODE)); } break;
+			case 11: { Const(UnitValue()); Expr(1); s.Emit(SET); } break;
+			case 12: { Expr(1); Expr(1); Expr(1); s.Emit(ATTACH); } break;
+			case 13: { Expr(1); s.Emit(DROP); } break;
+			case 14: { Const(RandInt(8)); s.Emit((RandInt(3) == 0)? SIGNAL: SET_SIGNAL_MASK); } break;
+			case 15: { PieceOp(Pick(CACHE, DONT_CACHE)); PieceOp(Pick(SHADE, DONT_SHADE)); } break;
+			case 16:
+			case 17: { Call(CALL, 1); } break;
+			case 18: { Call((RandInt(4) == 0)? START: CALL, 1); } break;
+			case 19: {
+				// a jump into the middle of an instruction: SHADE skips the
+				// POP_STACK when the condition is false, both paths are neutral
+				Expr(1);
+				s.Emit(JUMP_NOT_EQUAL, s.Here() + 3);
+				s.Emit(PUSH_CONSTANT, SHADE);
+				s.Emit(POP_STACK);
+			} break;
+			case 20:
+			case 21: {
+				// if (expr) { ... } else { ... }
+				Expr(1);
+				s.Emit(JUMP_NOT_EQUAL, 0);
+				const int jumpElse = s.Here() - 1;
+				Block(depth + 1, 1 + RandInt(4));
+
+				if (RandInt(2) == 0) {
+					s.code[jumpElse] = s.Here();
+					break;
+				}
+
+				s.Emit(JUMP, 0);
+				const int jumpEnd = s.Here() - 1;
+				s.code[jumpElse] = s.Here();
+				Block(depth + 1, 1 + RandInt(4));
+				s.code[jumpEnd] = s.Here();
+			} break;
+			case 22: {
+				if (depth > 0) {
+					s.Emit(PUSH_LOCAL_VAR, 0);
+					s.Emit(RETURN);
+					break;
+				}
+
+				// i = 0; while (i < n) { ...; i = i + 1; }
+				Const(0);
+				s.Emit(POP_LOCAL_VAR, numLocals - 1);
+				const int loop = s.Here();
+				s.Emit(PUSH_LOCAL_VAR, numLocals - 1);
+				Const(1 + RandInt(3));
+				s.Emit(SET_LESS);
+				s.Emit(JUMP_NOT_EQUAL, 0);
+				const int jumpEnd = s.Here() - 1;
+				Block(depth + 2, 1 + RandInt(5));
+				s.Emit(PUSH_LOCAL_VAR, numLocals - 1);
+				Const(1);
+				s.Emit(ADD);
+				s.Emit(POP_LOCAL_VAR, numLocals - 1);
+				s.Emit(JUMP, loop);
+				s.code[jumpEnd] = s.Here();
+			} break;
+			case 23: {
+				// not an opcode, kills the thread
+				if (RandInt(8) == 0) {
+					s.Emit(0x10099000);
+				}
+			} break;
+		}
+	}
+
+	std::uint32_t rngState = 1;
+
+	CobScript s;
+	int curScript;
+};
+
+
+BOOST_AUTO_TEST_CASE(RandomScripts)
+{
+	// checksums of the raw code switch interpreter over each group of runs
+	static const unsigned int expectedHashes[] = {
+		 990472038u, 1802561239u, 2214217406u, 1299681450u,
+		 285811670u, 2754721490u, 4172457047u,  959172171u,
+		3343875613u, 3638371023u, 2683370243u, 4110321555u,
+		1153102969u, 3528994071u, 3198509370u, 4275965518u,
+	};
+
+	static const int numGroups = sizeof(expectedHashes) / sizeof(expectedHashes[0]);
+	static const int runsPerGroup = 100;
+
+	ScriptGenerator generator;
+	generator.Seed(1234);
+
+	for (int group = 0; group < numGroups; group++) {
+		traceHash = 2166136261u;
+		numTraceEvents = 0;
+
+		for (int run = 0; run < runsPerGroup; run++) {
+			const CobScript s = generator.Generate();
+
+			gsRNG.SetSeed(group * runsPerGroup + run, true);
+
+			CobUnit u(s);
+
+			for (int tick = 0; tick < 100; tick++) {
+				// call-ins from the sim
+				if ((tick % 10) == 0) {
+					int fn = 0;
+
+					// the code of an empty script belongs to the next one, or is past the end
+					if (tick > 0) {
+						do {
+							fn = generator.RandInt(ScriptGenerator::numScripts);
+						} while (u.file->scriptLengths[fn] == 0);
+					}
+
+					std::vector<int> args(generator.RandInt(3), tick);
+					u.Call(fn, args);
+				}
+
+				u.Tick();
+			}
+
+			Trace(int(u.instance->threadIDs.size()));
+		}
+
+		BOOST_TEST_MESSAGE("group " << group << ": " << numTraceEvents << " events, hash " << traceHash);
+		BOOST_CHECK_EQUAL(traceHash, expectedHashes[group]);
+	}
+}
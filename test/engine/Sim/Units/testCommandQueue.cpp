@@ -0,0 +1,302 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/CommandAI/CommandQueue.h"
+
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <vector>
+
+#define BOOST_TEST_MODULE CommandQueue
+#include <boost/test/unit_test.hpp>
+
+
+static bool countAllocs = false;
+static unsigned int numAllocs = 0;
+
+void* operator new(std::size_t size)
+{
+	numAllocs += countAllocs;
+
+	if (void* p = std::malloc(size))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+
+// CCommandQueue can only be created by its owning CommandAI, this
+// stands in for it (the real CCommandAI is not linked into the test)
+class CCommandAI {
+public:
+	CCommandQueue commandQue;
+};
+
+
+static Command MakeCommand(int id, unsigned int numParams)
+{
+	Command c(id, 0);
+
+	for (unsigned int n = 0; n < numParams; n++) {
+		c.PushParam(id * 100.0f + n);
+	}
+
+	return c;
+}
+
+static void CheckEqual(const CCommandQueue& q, const std::deque<Command>& ref)
+{
+	BOOST_REQUIRE_EQUAL(q.size(), ref.size());
+
+	size_t n = 0;
+
+	for (auto it = q.begin(); it != q.end(); ++it, ++n) {
+		BOOST_CHECK_EQUAL(it->GetID(), ref[n].GetID());
+		BOOST_CHECK(it->params == ref[n].params);
+		BOOST_CHECK_EQUAL(q[n].GetID(), ref[n].GetID());
+	}
+
+	n = ref.size();
+
+	for (auto it = q.rbegin(); it != q.rend(); ++it) {
+		BOOST_CHECK_EQUAL(it->GetID(), ref[--n].GetID());
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(ParamsInlineAndSpilled)
+{
+	CommandParams p;
+
+	for (unsigned int n = 0; n < CommandParams::NUM_INLINE_PARAMS; n++) {
+		p.push_back(n);
+	}
+
+	BOOST_CHECK_EQUAL(p.capacity(), CommandParams::NUM_INLINE_PARAMS);
+
+	// out-of-bounds reads behave like safe_vector
+	BOOST_CHECK_EQUAL(p[CommandParams::NUM_INLINE_PARAMS], 0.0f);
+
+	p.push_back(6.0f);
+	BOOST_CHECK_GT(p.capacity(), CommandParams::NUM_INLINE_PARAMS);
+
+	for (unsigned int n = 0; n < p.size(); n++) {
+		BOOST_CHECK_EQUAL(p[n], float(n));
+	}
+
+	// moving steals the spilled buffer, copying does not
+	CommandParams q = p;
+	CommandParams r = std::move(p);
+
+	BOOST_CHECK(q == r);
+	BOOST_CHECK(p.empty());
+	BOOST_CHECK_EQUAL(p.capacity(), CommandParams::NUM_INLINE_PARAMS);
+
+	r.resize(2);
+	r.resize(4, 9.0f);
+	BOOST_CHECK_EQUAL(r.size(), 4);
+	BOOST_CHECK_EQUAL(r[1], 1.0f);
+	BOOST_CHECK_EQUAL(r[3], 9.0f);
+}
+
+
+BOOST_AUTO_TEST_CASE(ParamsPoolRecycles)
+{
+	const unsigned int numPooled = CommandParams::GetNumPooledBuffers();
+
+	{
+		CommandParams p;
+		p.resize(20);
+	}
+
+	BOOST_CHECK_EQUAL(CommandParams::GetNumPooledBuffers(), numPooled + 1);
+
+	numAllocs = 0;
+	countAllocs = true;
+
+	{
+		CommandParams p;
+		p.resize(20);
+	}
+
+	countAllocs = false;
+	BOOST_CHECK_EQUAL(numAllocs, 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(QueueMatchesDeque)
+{
+	CCommandAI cai;
+	CCommandQueue& q = cai.commandQue;
+	std::deque<Command> ref;
+
+	std::srand(1234);
+
+	for (int n = 0; n < 20000; n++) {
+		const Command c = MakeCommand(n, std::rand() % 10);
+
+		switch (std::rand() % 7) {
+			case 0: { q.push_back(c); ref.push_back(c); } break;
+			case 1: { q.push_front(c); ref.push_front(c); } break;
+			case 2: {
+				const size_t i = std::rand() % (ref.size() + 1);
+				BOOST_CHECK_EQUAL(q.insert(q.begin() + i, c)->GetID(), c.GetID());
+				ref.insert(ref.begin() + i, c);
+			} break;
+			case 3: {
+				if (ref.empty())
+					break;
+
+				const size_t i = std::rand() % ref.size();
+				const size_t j = std::min(ref.size(), i + std::rand() % 3);
+				q.erase(q.begin() + i, q.begin() + j);
+				ref.erase(ref.begin() + i, ref.begin() + j);
+			} break;
+			case 4: {
+				if (ref.empty())
+					break;
+
+				q.pop_front(); ref.pop_front();
+			} break;
+			case 5: {
+				if (ref.empty())
+					break;
+
+				q.pop_back(); ref.pop_back();
+			} break;
+			case 6: {
+				if (std::rand() % 50 != 0)
+					break;
+
+				q.clear(); ref.clear();
+			} break;
+		}
+
+		if ((n % 97) == 0)
+			CheckEqual(q, ref);
+	}
+
+	CheckEqual(q, ref);
+}
+
+
+BOOST_AUTO_TEST_CASE(QueueReferencesStayValid)
+{
+	CCommandAI cai;
+	CCommandQueue& q = cai.commandQue;
+
+	q.push_back(MakeCommand(1, 3));
+
+	const Command& first = q.front();
+	const unsigned int firstTag = first.tag;
+
+	// self-referencing pushes plus enough commands to grow the ring a few times
+	for (int n = 0; n < 100; n++) {
+		const int frontID = q.front().GetID();
+
+		q.push_back(q.front());
+		q.push_front(MakeCommand(n + 2, 7));
+		q.insert(q.begin() + q.size() / 2, q.back());
+
+		BOOST_CHECK_EQUAL(q.back().GetID(), frontID);
+		BOOST_CHECK_EQUAL(q[(q.size() - 1) / 2].GetID(), frontID);
+	}
+
+	BOOST_CHECK_EQUAL(first.GetID(), 1);
+	BOOST_CHECK_EQUAL(first.tag, firstTag);
+	BOOST_CHECK_EQUAL(first.params.size(), 3);
+}
+
+
+// a queued (shift) build order of <numBuildCmds> buildings given to 500
+// units twice, the way it arrives from the network: one unpacked command
+// vector that is copied into every unit's queue, which is then worked off
+template<typename Queue, typename Cmd>
+static unsigned int CountBuildOrderAllocs(std::vector<Queue>& queues, int numBuildCmds)
+{
+	numAllocs = 0;
+	countAllocs = true;
+
+	std::vector<Cmd> order;
+	order.reserve(numBuildCmds);
+
+	for (int n = 0; n < numBuildCmds; n++) {
+		order.emplace_back();
+		order.back().id = -(n + 1);
+		order.back().params.reserve(4);
+
+		for (int k = 0; k < 4; k++) {
+			order.back().params.push_back(n * 16.0f + k);
+		}
+	}
+
+	for (Queue& q: queues) {
+		for (const Cmd& c: order) {
+			q.push_back(c);
+		}
+	}
+
+	for (Queue& q: queues) {
+		while (!q.empty()) {
+			q.pop_front();
+		}
+	}
+
+	countAllocs = false;
+	return numAllocs;
+}
+
+struct LegacyCommand {
+	int id;
+	std::vector<float> params;
+};
+
+
+BOOST_AUTO_TEST_CASE(BuildOrderAllocations)
+{
+	const int numUnits = 500;
+	const int numBuildCmds = 20;
+
+	std::vector<CCommandAI> cais(numUnits);
+	std::vector<std::deque<LegacyCommand>> legacyQueues(numUnits);
+
+	const unsigned int legacyCold = CountBuildOrderAllocs<std::deque<LegacyCommand>, LegacyCommand>(legacyQueues, numBuildCmds);
+	const unsigned int legacyWarm = CountBuildOrderAllocs<std::deque<LegacyCommand>, LegacyCommand>(legacyQueues, numBuildCmds);
+
+	struct QueueRef {
+		void push_back(const Command& c) { cai->commandQue.push_back(c); }
+		void pop_front() { cai->commandQue.pop_front(); }
+		bool empty() const { return cai->commandQue.empty(); }
+		CCommandAI* cai;
+	};
+	struct BuildCommand: public Command {
+		BuildCommand(): Command(0, 0) {}
+	};
+
+	std::vector<QueueRef> queues;
+
+	for (CCommandAI& cai: cais) {
+		queues.push_back({&cai});
+	}
+
+	const unsigned int cold = CountBuildOrderAllocs<QueueRef, BuildCommand>(queues, numBuildCmds);
+	const unsigned int warm = CountBuildOrderAllocs<QueueRef, BuildCommand>(queues, numBuildCmds);
+
+	BOOST_TEST_MESSAGE("allocations for a " << numBuildCmds << "-building order to " << numUnits << " units:");
+	BOOST_TEST_MESSAGE("  deque<vector>: first " << legacyCold << ", repeated " << legacyWarm);
+	BOOST_TEST_MESSAGE("  CCommandQueue: first " << cold << ", repeated " << warm);
+
+	// params are inline, so only queue storage is allocated; and that only once
+	BOOST_CHECK_LT(cold, legacyCold);
+	BOOST_CHECK_EQUAL(warm, 1);
+}
@@ -0,0 +1,196 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/CobEngine.h"
+#include "Sim/Units/Scripts/UnitScript.h"
+#include "Sim/Units/Scripts/UnitScriptEngine.h"
+
+#include <vector>
+
+#define BOOST_TEST_MODULE UnitScriptEngine
+#include <boost/test/unit_test.hpp>
+
+
+// the parts of the engine UnitScriptEngine.cpp and UnitScriptAnims.cpp
+// link against, but which these tests never reach
+CCobEngine* cobEngine = nullptr;
+CCobFileHandler* cobFileHandler = nullptr;
+
+CCobEngine::CCobEngine() {}
+CCobEngine::~CCobEngine() {}
+CCobFileHandler::~CCobFileHandler() {}
+
+CollisionVolume::CollisionVolume() {}
+
+void LocalModelPiece::SetPosOrRot(const float3& src, float3& dst) { dst = src; }
+
+
+
+struct AnimFinishedCall {
+	const CUnitScript* script;
+	int piece;
+	int axis;
+};
+
+static std::vector<AnimFinishedCall> animFinishedCalls;
+
+
+class CTestUnitScript: public CUnitScript
+{
+public:
+	CTestUnitScript(): CUnitScript(nullptr), victim(nullptr) {
+		pieces.push_back(&piece);
+	}
+
+	// deleted by the first AnimFinished callin this script receives
+	CTestUnitScript* victim;
+
+	void ShowScriptError(const std::string& msg) override {}
+
+	void RawCall(int functionId) override {}
+	void Create() override {}
+	void Killed() override {}
+	void WindChanged(float heading, float speed) override {}
+	void ExtractionRateChanged(float speed) override {}
+	void WorldRockUnit(const float3& rockDir) override {}
+	void RockUnit(const float3& rockDir) override {}
+	void WorldHitByWeapon(const float3& hitDir, int weaponDefId, float& inoutDamage) override {}
+	void HitByWeapon(const float3& hitDir, int weaponDefId, float& inoutDamage) override {}
+	void SetSFXOccupy(int curTerrainType) override {}
+	void QueryLandingPads(std::vector<int>& out_pieces) override {}
+	void BeginTransport(const CUnit* unit) override {}
+	int  QueryTransport(const CUnit* unit) override { return -1; }
+	void TransportPickup(const CUnit* unit) override {}
+	void TransportDrop(const CUnit* unit, const float3& pos) override {}
+	void StartBuilding(float heading, float pitch) override {}
+	int  QueryNanoPiece() override { return -1; }
+	int  QueryBuildInfo() override { return -1; }
+
+	void Destroy() override {}
+	void StartMoving(bool reversing) override {}
+	void StopMoving() override {}
+	void ChangeHeading(short deltaHeading) override {}
+	void StartUnload() override {}
+	void EndTransport() override {}
+	void StartBuilding() override {}
+	void StopBuilding() override {}
+	void Falling() override {}
+	void Landed() override {}
+	void Activate() override {}
+	void Deactivate() override {}
+	void MoveRate(int curRate) override {}
+	void FireWeapon(int weaponNum) override {}
+	void EndBurst(int weaponNum) override {}
+
+	int   QueryWeapon(int weaponNum) override { return -1; }
+	void  AimWeapon(int weaponNum, float heading, float pitch) override {}
+	void  AimShieldWeapon(CPlasmaRepulser* weapon) override {}
+	int   AimFromWeapon(int weaponNum) override { return -1; }
+	void  Shot(int weaponNum) override {}
+	bool  BlockShot(int weaponNum, const CUnit* targetUnit, bool userTarget) override { return false; }
+	float TargetWeight(int weaponNum, const CUnit* targetUnit) override { return 1.0f; }
+
+	void AnimFinished(AnimType type, int piece, int axis) override {
+		animFinishedCalls.push_back({this, piece, axis});
+
+		// like a LuaUnitScript whose callin destroys the unit
+		if (victim != nullptr) {
+			delete victim;
+			victim = nullptr;
+		}
+	}
+
+	// a turn that finishes within one tick and is waited on
+	void TurnAndWait() {
+		Turn(0, 1, 100.0f, 1.0f);
+		BOOST_REQUIRE(NeedsWait(ATurn, 0, 1));
+	}
+
+private:
+	LocalModelPiece piece;
+};
+
+
+struct UnitScriptEngineFixture {
+	UnitScriptEngineFixture() { unitScriptEngine = new CUnitScriptEngine(); animFinishedCalls.clear(); }
+	~UnitScriptEngineFixture() { delete unitScriptEngine; unitScriptEngine = nullptr; }
+};
+
+
+
+BOOST_FIXTURE_TEST_CASE(AnimFinished, UnitScriptEngineFixture)
+{
+	CTestUnitScript* a = new CTestUnitScript();
+	CTestUnitScript* b = new CTestUnitScript();
+
+	a->TurnAndWait();
+	b->TurnAndWait();
+	BOOST_CHECK(a->HaveAnimations());
+	BOOST_CHECK(b->HaveAnimations());
+
+	unitScriptEngine->Tick(33);
+
+	BOOST_CHECK(!a->HaveAnimations());
+	BOOST_CHECK(!b->HaveAnimations());
+	BOOST_REQUIRE_EQUAL(animFinishedCalls.size(), 2);
+	BOOST_CHECK_EQUAL(animFinishedCalls[0].script, a);
+	BOOST_CHECK_EQUAL(animFinishedCalls[1].script, b);
+	BOOST_CHECK_EQUAL(animFinishedCalls[0].piece, 0);
+	BOOST_CHECK_EQUAL(animFinishedCalls[0].axis, 1);
+
+	delete a;
+	delete b;
+}
+
+
+BOOST_FIXTURE_TEST_CASE(DeleteFromAnimFinished, UnitScriptEngineFixture)
+{
+	// <b> has no animations left once its turn finished, but still a
+	// queued AnimFinished call when <a> deletes it from its own callin
+	CTestUnitScript* a = new CTestUnitScript();
+	CTestUnitScript* b = new CTestUnitScript();
+
+	a->victim = b;
+	a->TurnAndWait();
+	b->TurnAndWait();
+
+	unitScriptEngine->Tick(33);
+
+	BOOST_REQUIRE_EQUAL(animFinishedCalls.size(), 1);
+	BOOST_CHECK_EQUAL(animFinishedCalls[0].script, a);
+
+	// nothing of <b> is left to be ticked or notified
+	animFinishedCalls.clear();
+	unitScriptEngine->Tick(33);
+	BOOST_CHECK(animFinishedCalls.empty());
+
+	for (int animType = CUnitScript::ATurn; animType <= CUnitScript::AMove; animType++) {
+		BOOST_CHECK_EQUAL(unitScriptEngine->GetAnims(CUnitScript::AnimType(animType)).size(), 0);
+	}
+
+	delete a;
+}
+
+
+BOOST_FIXTURE_TEST_CASE(DeleteWithPendingAnims, UnitScriptEngineFixture)
+{
+	// <b> still has an unfinished animation when it is deleted
+	CTestUnitScript* a = new CTestUnitScript();
+	CTestUnitScript* b = new CTestUnitScript();
+
+	a->victim = b;
+	a->TurnAndWait();
+	b->Turn(0, 2, 0.001f, 2.0f);
+	b->Spin(0, 0, 1.0f, 0.0f);
+
+	unitScriptEngine->Tick(33);
+
+	BOOST_REQUIRE_EQUAL(animFinishedCalls.size(), 1);
+	BOOST_CHECK_EQUAL(animFinishedCalls[0].script, a);
+
+	for (int animType = CUnitScript::ATurn; animType <= CUnitScript::AMove; animType++) {
+		BOOST_CHECK_EQUAL(unitScriptEngine->GetAnims(CUnitScript::AnimType(animType)).size(), 0);
+	}
+
+	unitScriptEngine->Tick(33);
+	delete a;
+}
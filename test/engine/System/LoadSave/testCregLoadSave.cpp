@@ -2,14 +2,20 @@
 
 #include "System/creg/creg_cond.h"
 #include "System/creg/Serializer.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <sstream>
+#include <streambuf>
 #include <string>
 #include <vector>
 #include <stdio.h>
 
 #define BOOST_TEST_MODULE CregLoadSave
 #include <boost/test/unit_test.hpp>
+BOOST_GLOBAL_FIXTURE(InitSpringTime);
 
 
 
@@ -78,7 +84,34 @@ CR_REG_METADATA(TestObj, (
 ));
 
 
-static void savetest(std::ostream* os)
+// an output stream that can only be appended to, like a compressing one
+class AppendOnlyBuffer : public std::streambuf {
+public:
+	std::string data;
+
+protected:
+	int_type overflow(int_type c) override {
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+			data.push_back(traits_type::to_char_type(c));
+
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize n) override {
+		data.append(s, n);
+		return n;
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if (off != 0 || dir != std::ios_base::cur)
+			return pos_type(off_type(-1));
+
+		return pos_type(off_type(data.size()));
+	}
+};
+
+
+static void savetest(std::ostream* os, bool streamed = false)
 {
 	// root obj
 	TestObj* o = new TestObj;
@@ -104,7 +137,7 @@ static void savetest(std::ostream* os)
 
 	// save
 	creg::COutputStreamSerializer ss;
-	ss.SavePackage(os, o, o->GetClass());
+	ss.SavePackage(os, o, o->GetClass(), streamed);
 
 	delete(o);
 }
@@ -170,3 +203,182 @@ BOOST_AUTO_TEST_CASE( BOOST_TEST_MODULE )
 
 	delete root;
 }
+
+
+BOOST_AUTO_TEST_CASE( Streamed )
+{
+	// save state behind some other data, without ever seeking back
+	AppendOnlyBuffer buffer;
+	std::ostream os(&buffer);
+
+	os.write("prefix", 7);
+	savetest(&os, true);
+
+	BOOST_REQUIRE(os.good());
+
+	// load state
+	std::stringstream ss(buffer.data, std::ios::in | std::ios::out | std::ios::binary);
+	ss.seekg(7);
+
+	TestObj* root = (TestObj*)loadtest(&ss);
+
+	BOOST_CHECK_MESSAGE(dynamic_cast<TestObj*>(root), "test root obj");
+	BOOST_CHECK_MESSAGE(test_creg_members(root),      "test class members");
+	BOOST_CHECK_MESSAGE(test_creg_pointers(root),     "test class pointers");
+	BOOST_CHECK_EQUAL(ss.tellg(), std::streamoff(buffer.data.size()));
+
+	delete root;
+}
+
+
+
+// roughly what a save of a big game consists of: many separately
+// allocated objects pointing at each other and into each other
+struct BenchUnit {
+	CR_DECLARE(BenchUnit);
+
+	BenchUnit(): id(0), health(0.0f), target(nullptr), targetWeapon(nullptr) {}
+
+	int id;
+	float health;
+	float pos[3];
+	std::string name;
+	std::vector<float> path;
+	std::vector<int> orders;
+
+	EmbeddedObj weapon;
+	BenchUnit* target;
+	EmbeddedObj* targetWeapon;
+};
+
+CR_BIND(BenchUnit, );
+CR_REG_METADATA(BenchUnit, (
+	CR_MEMBER(id),
+	CR_MEMBER(health),
+	CR_MEMBER(pos),
+	CR_MEMBER(name),
+	CR_MEMBER(path),
+	CR_MEMBER(orders),
+	CR_MEMBER(weapon),
+	CR_MEMBER(target),
+	CR_MEMBER(targetWeapon)
+));
+
+struct BenchWorld {
+	CR_DECLARE(BenchWorld);
+
+	~BenchWorld() {
+		for (BenchUnit* u: units) {
+			delete u;
+		}
+	}
+
+	std::vector<BenchUnit*> units;
+};
+
+CR_BIND(BenchWorld, );
+CR_REG_METADATA(BenchWorld, (
+	CR_MEMBER(units)
+));
+
+
+static BenchWorld* MakeWorld(int numUnits)
+{
+	BenchWorld* world = new BenchWorld();
+
+	for (int n = 0; n < numUnits; n++) {
+		BenchUnit* u = new BenchUnit();
+		u->id = n;
+		u->health = n * 0.5f;
+		u->pos[0] = n; u->pos[1] = -n; u->pos[2] = n * 2.0f;
+		u->name = "unit" + std::to_string(n);
+		u->path.assign(64 + (n % 64), n * 0.25f);
+		u->orders.assign(n % 16, n);
+		world->units.push_back(u);
+	}
+
+	// everybody targets somebody far away, and that one's weapon
+	for (int n = 0; n < numUnits; n++) {
+		BenchUnit* target = world->units[(n * 7919 + numUnits / 2) % numUnits];
+		world->units[n]->target = target;
+		world->units[n]->targetWeapon = &target->weapon;
+	}
+
+	return world;
+}
+
+static bool WorldsEqual(const BenchWorld* a, const BenchWorld* b)
+{
+	if (a->units.size() != b->units.size())
+		return false;
+
+	for (size_t n = 0; n < a->units.size(); n++) {
+		const BenchUnit* ua = a->units[n];
+		const BenchUnit* ub = b->units[n];
+
+		if (ua->id != ub->id || ua->health != ub->health || ua->name != ub->name)
+			return false;
+		if (!std::equal(ua->pos, ua->pos + 3, ub->pos) || ua->path != ub->path || ua->orders != ub->orders)
+			return false;
+
+		// same structure: the target is the unit with the same index
+		if (ub->target != b->units[ua->target->id] || ub->targetWeapon != &ub->target->weapon)
+			return false;
+	}
+
+	return true;
+}
+
+static BenchWorld* LoadWorld(const std::string& data, bool parallel, double* msecs)
+{
+	std::stringstream ss(data, std::ios::in | std::ios::out | std::ios::binary);
+
+	void* root;
+	creg::Class* rootCls;
+
+	const auto t0 = std::chrono::steady_clock::now();
+
+	creg::CInputStreamSerializer ser(parallel);
+	ser.LoadPackage(&ss, root, rootCls);
+
+	*msecs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+	BOOST_CHECK(rootCls == BenchWorld::StaticClass());
+	return static_cast<BenchWorld*>(root);
+}
+
+
+BOOST_AUTO_TEST_CASE( ParallelLoadBenchmark )
+{
+	const int numUnits = 5000;
+	const int numThreads = std::min(ThreadPool::GetMaxThreads(), 8);
+
+	ThreadPool::SetThreadCount(numThreads);
+
+	BenchWorld* world = MakeWorld(numUnits);
+
+	std::stringstream os(std::ios::in | std::ios::out | std::ios::binary);
+	creg::COutputStreamSerializer ser;
+	ser.SavePackage(&os, world, world->GetClass());
+
+	const std::string data = os.str();
+
+	double serialMsecs = 0.0;
+	double parallelMsecs = 0.0;
+
+	BenchWorld* serialWorld = LoadWorld(data, false, &serialMsecs);
+	BenchWorld* parallelWorld = LoadWorld(data, true, &parallelMsecs);
+
+	BOOST_TEST_MESSAGE("loading " << numUnits << " units (" << (data.size() >> 10) << " KB):");
+	BOOST_TEST_MESSAGE("  serial:   " << serialMsecs << " ms");
+	BOOST_TEST_MESSAGE("  parallel: " << parallelMsecs << " ms (" << ThreadPool::GetNumThreads() << " threads)");
+
+	BOOST_CHECK(WorldsEqual(world, serialWorld));
+	BOOST_CHECK(WorldsEqual(world, parallelWorld));
+
+	delete parallelWorld;
+	delete serialWorld;
+	delete world;
+
+	ThreadPool::SetThreadCount(0);
+}
@@ -1,11 +1,49 @@
 
 #include "System/Net/UDPListener.h"
+#include "System/Net/UDPConnection.h"
+#include "Net/Protocol/BaseNetProtocol.h"
 #include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/GlobalConfig.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <thread>
+#include <vector>
 
 
 #define BOOST_TEST_MODULE UDPListener
 #include <boost/test/unit_test.hpp>
 
+BOOST_GLOBAL_FIXTURE(InitSpringTime);
+
+
+static bool countAllocs = false;
+static unsigned int numAllocs = 0;
+
+void* operator new(std::size_t size)
+{
+	numAllocs += countAllocs;
+
+	if (void* p = std::malloc(size))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+
 class SocketTest {
 public:
 	SocketTest(){
@@ -83,3 +121,411 @@ BOOST_AUTO_TEST_CASE(TryBindSocket)
 	t.TestPort(-1, false);
 }
 
+
+
+BOOST_AUTO_TEST_CASE(WaitForData)
+{
+	netcode::UDPListener listener(11112, "127.0.0.1");
+
+	// nothing arrives, runs into the timeout
+	spring_time t0 = spring_gettime();
+	BOOST_CHECK(!listener.WaitForData(spring_msecs(50)));
+	BOOST_CHECK((spring_gettime() - t0) >= spring_msecs(40));
+
+	// woken up from another thread long before the timeout
+	std::thread waker([&]() { spring_sleep(spring_msecs(20)); listener.Wake(); });
+
+	t0 = spring_gettime();
+	BOOST_CHECK(listener.WaitForData(spring_secs(10)));
+	BOOST_CHECK((spring_gettime() - t0) < spring_secs(5));
+	waker.join();
+
+	// the wake-up datagram is dropped and not taken for a connection attempt,
+	// and it was read: the next wait runs into its timeout again
+	listener.Update();
+	BOOST_CHECK(!listener.HasIncomingConnections());
+
+	t0 = spring_gettime();
+	BOOST_CHECK(!listener.WaitForData(spring_msecs(50)));
+	BOOST_CHECK((spring_gettime() - t0) >= spring_msecs(40));
+
+	// several wake-ups before one Update are all drained by it
+	for (int n = 0; n < 3; n++) {
+		listener.Wake();
+		BOOST_CHECK(listener.WaitForData(spring_secs(10)));
+	}
+
+	listener.Update();
+
+	t0 = spring_gettime();
+	BOOST_CHECK(!listener.WaitForData(spring_msecs(50)));
+	BOOST_CHECK((spring_gettime() - t0) >= spring_msecs(40));
+}
+
+
+BOOST_AUTO_TEST_CASE(ReceiveBatch)
+{
+	GlobalConfig::Instantiate();
+
+	{
+		netcode::UDPListener server(11113, "127.0.0.1");
+
+		// more connection attempts than fit into one receive batch, all queued up before the server reads any
+		std::vector< std::shared_ptr<netcode::UDPConnection> > clients;
+
+		for (int n = 0; n < 40; n++) {
+			clients.emplace_back(new netcode::UDPConnection(0, "127.0.0.1", 11113));
+			clients.back()->Unmute();
+			clients.back()->SendData(CBaseNetProtocol::Get().SendKeyFrame(n));
+			clients.back()->Flush(true);
+		}
+
+		BOOST_CHECK(server.WaitForData(spring_secs(5)));
+		server.Update();
+
+		for (int n = 0; n < 40; n++) {
+			BOOST_REQUIRE(server.HasIncomingConnections());
+
+			std::shared_ptr<netcode::UDPConnection> incoming = server.AcceptConnection();
+			std::shared_ptr<const netcode::RawPacket> packet = incoming->GetData();
+
+			BOOST_REQUIRE(packet != nullptr);
+			BOOST_CHECK_EQUAL(packet->data[0], NETMSG_KEYFRAME);
+		}
+
+		BOOST_CHECK(!server.HasIncomingConnections());
+	}
+
+	GlobalConfig::Deallocate();
+}
+
+
+BOOST_AUTO_TEST_CASE(PacketWireFormat)
+{
+	const std::uint8_t chunkData[] = {'a', 'b', 'c', 0xff};
+
+	netcode::Packet packet(5, 2);
+	packet.naks = {1, 3};
+	packet.chunks.push_back({6, 3, &chunkData[0]});
+	packet.chunks.push_back({7, 1, &chunkData[3]});
+	packet.checksum = packet.GetChecksum();
+
+	// as sent by the previous (shared_ptr<Chunk> based) implementation
+	const std::uint8_t expected[] = {
+		0x05, 0x00, 0x00, 0x00, 0x02, 0xef, 0x01, 0x03,
+		0x06, 0x00, 0x00, 0x00, 0x03, 0x61, 0x62, 0x63,
+		0x07, 0x00, 0x00, 0x00, 0x01, 0xff,
+	};
+
+	std::uint8_t buffer[64];
+	BOOST_REQUIRE_EQUAL(packet.GetSize(), sizeof(expected));
+	BOOST_REQUIRE_EQUAL(packet.Serialize(buffer), sizeof(expected));
+	BOOST_CHECK(std::memcmp(buffer, expected, sizeof(expected)) == 0);
+
+	// parse it back into a reused packet
+	netcode::Packet parsed(-1, -3);
+	parsed.Parse(buffer, sizeof(expected));
+
+	BOOST_CHECK_EQUAL(parsed.lastContinuous, 5);
+	BOOST_CHECK_EQUAL(parsed.nakType, 2);
+	BOOST_CHECK_EQUAL(parsed.checksum, parsed.GetChecksum());
+	BOOST_REQUIRE_EQUAL(parsed.naks.size(), 2);
+	BOOST_CHECK_EQUAL(parsed.naks[1], 3);
+	BOOST_REQUIRE_EQUAL(parsed.chunks.size(), 2);
+	BOOST_CHECK_EQUAL(parsed.chunks[0].chunkNumber, 6);
+	BOOST_CHECK_EQUAL(parsed.chunks[0].chunkSize, 3);
+	BOOST_CHECK(std::memcmp(parsed.chunks[0].data, "abc", 3) == 0);
+	BOOST_CHECK_EQUAL(parsed.chunks[1].chunkNumber, 7);
+	BOOST_CHECK_EQUAL(parsed.chunks[1].data[0], 0xff);
+
+	// header-only packet
+	netcode::Packet empty(-1, -3);
+	empty.checksum = empty.GetChecksum();
+
+	const std::uint8_t expectedEmpty[] = {0xff, 0xff, 0xff, 0xff, 0xfd, 0x97};
+
+	BOOST_REQUIRE_EQUAL(empty.Serialize(buffer), sizeof(expectedEmpty));
+	BOOST_CHECK(std::memcmp(buffer, expectedEmpty, sizeof(expectedEmpty)) == 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(LoopbackSoak)
+{
+	GlobalConfig::Instantiate();
+	globalConfig->linkOutgoingBandwidth = 0;
+
+	{
+		netcode::UDPConnection sender(11114, "127.0.0.1", 11115);
+		netcode::UDPConnection receiver(11115, "127.0.0.1", 11114);
+
+		sender.Unmute();
+		receiver.Unmute();
+
+		// packets claiming nothing was received yet are taken for reconnection
+		// attempts once data has arrived, so let both sides see some traffic
+		receiver.SendData(CBaseNetProtocol::Get().SendKeyFrame(0));
+		receiver.Flush(true);
+
+		for (int n = 0; n < 100 && !sender.HasIncomingData(); n++) {
+			spring_sleep(spring_msecs(1));
+			sender.Update();
+		}
+
+		BOOST_REQUIRE(sender.GetData() != nullptr);
+
+		const int numRounds = 400;
+		const int numWarmupRounds = 20;
+		const int numMessagesPerRound = 64;
+
+		// pre-built, so only the connection's own allocations are counted;
+		// sizes range from a single chunk up to several (fragmented) ones
+		std::vector< std::shared_ptr<const netcode::RawPacket> > messages;
+
+		for (int n = 0; n < numMessagesPerRound; n++) {
+			std::vector<std::uint8_t> msg(4 + (n * 37) % 900);
+			std::memcpy(&msg[0], &n, sizeof(n));
+			messages.push_back(CBaseNetProtocol::Get().SendLuaMsg(0, 0, 0, msg));
+		}
+
+		unsigned int sendAllocs = 0;
+		unsigned int recvAllocs = 0;
+		unsigned int numBytes = 0;
+		unsigned int numReceived = 0;
+
+		const spring_time t0 = spring_gettime();
+
+		for (int round = 0; round < numRounds; round++) {
+			for (const auto& msg: messages) {
+				sender.SendData(msg);
+			}
+
+			numAllocs = 0;
+			countAllocs = (round >= numWarmupRounds);
+			sender.Flush(true);
+			countAllocs = false;
+			sendAllocs += numAllocs;
+
+			// receive everything of this round, then send the acks back
+			for (int n = 0; n < numMessagesPerRound; ) {
+				numAllocs = 0;
+				countAllocs = (round >= numWarmupRounds);
+				receiver.Update();
+				countAllocs = false;
+				recvAllocs += numAllocs;
+
+				std::shared_ptr<const netcode::RawPacket> packet;
+
+				while ((packet = receiver.GetData()) != nullptr) {
+					int index = -1;
+					std::memcpy(&index, packet->data + 7, sizeof(index));
+
+					BOOST_REQUIRE_EQUAL(packet->data[0], NETMSG_LUAMSG);
+					BOOST_REQUIRE_EQUAL(index, n);
+					BOOST_REQUIRE_EQUAL(packet->length, messages[n]->length);
+
+					numBytes += packet->length;
+					numReceived += 1;
+					n += 1;
+				}
+
+				// resends of lost datagrams are triggered by the acks
+				receiver.Flush(true);
+				sender.Update();
+			}
+
+			receiver.Flush(true);
+
+			numAllocs = 0;
+			countAllocs = (round >= numWarmupRounds);
+			sender.Update();
+			countAllocs = false;
+			sendAllocs += numAllocs;
+		}
+
+		const float seconds = (spring_gettime() - t0).toSecsf();
+		const int numCountedMessages = (numRounds - numWarmupRounds) * numMessagesPerRound;
+
+		BOOST_TEST_MESSAGE("loopback soak: " << numReceived << " messages (" << numBytes << " bytes) in " << seconds << "s");
+		BOOST_TEST_MESSAGE("  " << (numBytes / 1024.0f) / seconds << " KB/s, " << numReceived / seconds << " messages/s");
+		BOOST_TEST_MESSAGE("  allocations per message: sending " << float(sendAllocs) / numCountedMessages << ", receiving " << float(recvAllocs) / numCountedMessages);
+
+		BOOST_CHECK_EQUAL(numReceived, numRounds * numMessagesPerRound);
+
+		// chunks live in the reused send window, datagrams in a reused buffer
+		BOOST_CHECK_EQUAL(sendAllocs, 0);
+	}
+
+	GlobalConfig::Deallocate();
+}
+
+
+// receives until <expected> messages arrived, checking them one by one;
+// <update> lets both ends process their sockets
+static size_t ReceiveAll(netcode::UDPConnection& conn, const std::function<void()>& update, const std::vector< std::shared_ptr<const netcode::RawPacket> >& expected)
+{
+	size_t numReceived = 0;
+
+	for (int n = 0; numReceived < expected.size() && n < 1000; n++) {
+		update();
+
+		std::shared_ptr<const netcode::RawPacket> packet;
+
+		while ((packet = conn.GetData()) != nullptr) {
+			BOOST_REQUIRE_LT(numReceived, expected.size());
+			BOOST_REQUIRE_EQUAL(packet->length, expected[numReceived]->length);
+			BOOST_REQUIRE(std::memcmp(packet->data, expected[numReceived]->data, packet->length) == 0);
+			numReceived++;
+		}
+
+		if (numReceived < expected.size())
+			spring_sleep(spring_msecs(1));
+	}
+
+	return numReceived;
+}
+
+BOOST_AUTO_TEST_CASE(CompressedBundles)
+{
+	GlobalConfig::Instantiate();
+	globalConfig->linkOutgoingBandwidth = 0;
+
+	{
+		netcode::UDPListener server(11117, "127.0.0.1");
+		netcode::UDPConnection client(0, "127.0.0.1", 11117);
+
+		client.Unmute();
+		client.SendData(CBaseNetProtocol::Get().SendKeyFrame(0));
+		client.Flush(true);
+
+		std::shared_ptr<netcode::UDPConnection> link;
+
+		for (int n = 0; link == nullptr && n < 100; n++) {
+			server.WaitForData(spring_msecs(10));
+			server.Update();
+
+			if (server.HasIncomingConnections())
+				link = server.AcceptConnection();
+		}
+
+		BOOST_REQUIRE(link != nullptr);
+		BOOST_CHECK(link->GetData() != nullptr);
+		BOOST_CHECK(!client.GetCompression());
+
+		link->Unmute();
+		link->SetCompression(true);
+
+		// a mass order: many similar messages in one burst, plus some frames
+		std::vector< std::shared_ptr<const netcode::RawPacket> > burst;
+		unsigned burstLength = 0;
+
+		for (int n = 0; n < 500; n++) {
+			std::vector<std::uint8_t> order(60, 0);
+			order[n % order.size()] = n;
+
+			burst.push_back(CBaseNetProtocol::Get().SendLuaMsg(0, 0, 0, order));
+			burst.push_back(CBaseNetProtocol::Get().SendNewFrame());
+		}
+
+		for (const auto& packet: burst) {
+			burstLength += packet->length;
+			link->SendData(packet);
+		}
+
+		link->Flush(true);
+
+		const auto update = [&]() { client.Update(); server.Update(); };
+
+		BOOST_CHECK_EQUAL(ReceiveAll(client, update, burst), burst.size());
+		BOOST_CHECK_LT(client.GetDataReceived(), burstLength / 4);
+
+		// learned from the server's bundles
+		BOOST_CHECK(client.GetCompression());
+
+		for (const auto& packet: burst) {
+			client.SendData(packet);
+		}
+
+		client.Flush(true);
+
+		BOOST_CHECK_EQUAL(ReceiveAll(*link, update, burst), burst.size());
+		BOOST_CHECK_LT(link->GetDataReceived(), burstLength / 4);
+
+		BOOST_TEST_MESSAGE(client.Statistics());
+		link.reset();
+	}
+
+	GlobalConfig::Deallocate();
+}
+
+
+BOOST_AUTO_TEST_CASE(SharedSpectatorBuffer)
+{
+	GlobalConfig::Instantiate();
+	globalConfig->linkOutgoingBandwidth = 0;
+
+	{
+		netcode::UDPListener server(11116, "127.0.0.1");
+
+		// stand-ins for remote spectators
+		const int numSpectators = 64;
+
+		std::vector< std::shared_ptr<netcode::UDPConnection> > spectators;
+		std::vector< std::shared_ptr<netcode::UDPConnection> > links;
+
+		for (int n = 0; n < numSpectators; n++) {
+			spectators.emplace_back(new netcode::UDPConnection(0, "127.0.0.1", 11116));
+			spectators.back()->Unmute();
+			spectators.back()->SendData(CBaseNetProtocol::Get().SendKeyFrame(n));
+			spectators.back()->Flush(true);
+		}
+
+		for (int n = 0; links.size() < numSpectators && n < 100; n++) {
+			server.WaitForData(spring_msecs(10));
+			server.Update();
+
+			while (server.HasIncomingConnections()) {
+				links.push_back(server.AcceptConnection());
+				links.back()->GetData();
+				links.back()->Unmute();
+			}
+		}
+
+		BOOST_REQUIRE_EQUAL(links.size(), numSpectators);
+
+		// one update's worth of broadcasts, appended to one buffer like
+		// CGameServer::SendToAll does and shared by all links, followed
+		// by a message sent to each spectator on its own
+		std::vector< std::shared_ptr<const netcode::RawPacket> > messages;
+		std::vector<std::uint8_t> batch;
+
+		for (int n = 0; n < 100; n++) {
+			messages.push_back(CBaseNetProtocol::Get().SendKeyFrame(n));
+			messages.push_back(CBaseNetProtocol::Get().SendLuaMsg(0, 0, 0, std::vector<std::uint8_t>(n * 7, n)));
+		}
+
+		for (const auto& msg: messages) {
+			batch.insert(batch.end(), msg->data, msg->data + msg->length);
+		}
+
+		messages.push_back(CBaseNetProtocol::Get().SendSystemMessage(0, "after the batch"));
+
+		const std::shared_ptr<const netcode::RawPacket> shared(new netcode::RawPacket(&batch[0], batch.size()));
+
+		for (const auto& link: links) {
+			link->SendData(shared);
+			link->SendData(messages.back());
+			link->Flush(true);
+		}
+
+		// every spectator sees the original messages, one by one
+		for (const auto& spectator: spectators) {
+			const auto update = [&]() { spectator->Update(); server.Update(); };
+
+			BOOST_CHECK_EQUAL(ReceiveAll(*spectator, update, messages), messages.size());
+		}
+
+		links.clear();
+	}
+
+	GlobalConfig::Deallocate();
+}
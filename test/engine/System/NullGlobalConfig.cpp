@@ -19,6 +19,7 @@ GlobalConfig::GlobalConfig() {
 	linkIncomingPeakBandwidth = 32;
 	linkIncomingMaxPacketRate = 64;
 	linkIncomingMaxWaitingPackets = 512;
+	linkCompression = true;
 	if ((linkIncomingSustainedBandwidth > 0) && (linkIncomingPeakBandwidth < linkIncomingSustainedBandwidth)) {
 		linkIncomingPeakBandwidth = linkIncomingSustainedBandwidth;
 	}
@@ -0,0 +1,120 @@
+#ifndef SYNCCHECK
+	#error "This test requires SYNCCHECK to be defined on the compiler command line."
+#endif
+#include "System/Sync/SyncChecker.h"
+#include "System/Sync/SyncSections.h"
+
+#include <cstdio>
+#include <vector>
+
+#define BOOST_TEST_MODULE SyncSections
+#include <boost/test/unit_test.hpp>
+
+
+// stands in for a SimFrame: every section syncs some values derived from
+// the frame, <divergeFrame> and <divergeSection> mark where one client
+// computed something else
+static std::vector<SyncSectionChecksums> RunFrames(int numFrames, int divergeFrame = -1, unsigned divergeSection = SYNC_SECTION_COUNT)
+{
+	std::vector<SyncSectionChecksums> run;
+
+	CSyncChecker::NewFrame();
+	CSyncChecker::ClearSectionChecksums();
+
+	for (int frameNum = 0; frameNum < numFrames; frameNum++) {
+		for (unsigned section = 0; section < SYNC_SECTION_COUNT; section++) {
+			int value = frameNum * 31 + section;
+
+			if (frameNum == divergeFrame && section == divergeSection)
+				value += 1;
+
+			CSyncChecker::Sync(&value, sizeof(value));
+			CSyncChecker::EndSection(SyncSection(section));
+		}
+
+		run.push_back(CSyncChecker::EndFrame(frameNum));
+	}
+
+	return run;
+}
+
+
+BOOST_AUTO_TEST_CASE(FirstDivergence)
+{
+	const std::vector<SyncSectionChecksums> a = RunFrames(200);
+	const std::vector<SyncSectionChecksums> b = RunFrames(200);
+	const std::vector<SyncSectionChecksums> c = RunFrames(200, 137, SYNC_SECTION_UNITS);
+
+	size_t frame = 0;
+
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(a, b, &frame), SYNC_SECTION_COUNT);
+	BOOST_CHECK_EQUAL(frame, 200);
+
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(a, c, &frame), SYNC_SECTION_UNITS);
+	BOOST_CHECK_EQUAL(a[frame].frameNum, 137);
+
+	// checksums are chained, everything after the divergence differs
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(a[138], c[138]), SYNC_SECTION_INPUT);
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(a[136], c[136]), SYNC_SECTION_COUNT);
+
+	// a shorter run is compared as far as it goes
+	const std::vector<SyncSectionChecksums> d = RunFrames(100);
+
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(a, d, &frame), SYNC_SECTION_COUNT);
+	BOOST_CHECK_EQUAL(frame, 100);
+
+	BOOST_CHECK_EQUAL(SyncSections::GetName(SYNC_SECTION_UNITS), "units");
+	BOOST_CHECK_EQUAL(SyncSections::GetName(SYNC_SECTION_COUNT), "none");
+}
+
+
+BOOST_AUTO_TEST_CASE(History)
+{
+	const std::vector<SyncSectionChecksums> run = RunFrames(1000);
+
+	BOOST_CHECK(CSyncChecker::GetSectionChecksums(-1) == nullptr);
+	BOOST_CHECK(CSyncChecker::GetSectionChecksums(1000) == nullptr);
+	BOOST_CHECK(CSyncChecker::GetSectionChecksums(10) == nullptr);
+
+	const SyncSectionChecksums* record = CSyncChecker::GetSectionChecksums(990);
+
+	BOOST_REQUIRE(record != nullptr);
+	BOOST_CHECK_EQUAL(record->frameNum, 990);
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(*record, run[990]), SYNC_SECTION_COUNT);
+
+	// the last section is what the regular sync response carries
+	BOOST_CHECK_EQUAL(run.back().checksums[SYNC_SECTION_TEAMS], CSyncChecker::GetChecksum());
+}
+
+
+BOOST_AUTO_TEST_CASE(LogRoundTrip)
+{
+	const char* fileName = "TestSyncSections.log";
+	const std::vector<SyncSectionChecksums> run = RunFrames(300, 250, SYNC_SECTION_PATH);
+
+	{
+		CSyncSectionLog log;
+		BOOST_REQUIRE(log.Open(fileName));
+
+		for (const SyncSectionChecksums& record: run) {
+			log.Write(record);
+		}
+	}
+
+	std::vector<SyncSectionChecksums> read;
+	BOOST_REQUIRE(CSyncSectionLog::Read(fileName, read));
+	BOOST_REQUIRE_EQUAL(read.size(), run.size());
+
+	size_t frame = 0;
+	BOOST_CHECK_EQUAL(SyncSections::FindFirstDivergence(run, read, &frame), SYNC_SECTION_COUNT);
+
+	// not a sync section log
+	FILE* file = fopen(fileName, "wb");
+	fputs("garbage", file);
+	fclose(file);
+
+	BOOST_CHECK(!CSyncSectionLog::Read(fileName, read));
+	BOOST_CHECK(read.empty());
+
+	std::remove(fileName);
+}
@@ -11,12 +11,17 @@
 #include "Net/Protocol/BaseNetProtocol.h"
 #include "System/LoadSave/DemoReader.h"
 #include "System/Net/RawPacket.h"
+#include "System/Sync/SyncSections.h"
 #include "Sim/Units/CommandAI/Command.h"
 
 /*
 Usage:
 Start with the full! path to the demofile as the only argument
 
+With --syncdiff, give the paths of two SyncSectionLog files instead (as
+written by two clients or two runs of the same demo); prints the first
+frame and section in which they differ.
+
 Please note that not all NETMSG's are implemented, expand if needed.
 
 When compiling for windows with MinGW, make sure to use the
@@ -32,10 +37,12 @@ no console output (you still could use this.exe > z.tzt though).
 	DEFINE_bool  (teamstats,    false, "Print teamstats");
 	DEFINE_int32 (team,         -1,    "Select team");
 	DEFINE_string(teamsstatcsv, "",    "Write teamstats in a csv file");
+	DEFINE_bool  (syncdiff,     false, "Compare two SyncSectionLog files instead of reading a demo");
 
 
 void TrafficDump(CDemoReader& reader, bool trafficStats);
 void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string& file);
+int SyncDiff(const std::string& fileA, const std::string& fileB);
 
 int main (int argc, char* argv[])
 {
@@ -43,6 +50,13 @@ int main (int argc, char* argv[])
 
 	gflags::SetUsageMessage(std::string("Usage: ") + argv[0] + " [options] path_to_demo.sdfz");
 	gflags::ParseCommandLineFlags(&argc, &argv, true);
+	if (FLAGS_syncdiff) {
+		if (argc < 3) {
+			std::cout << "syncdiff requires two sync section logs" << std::endl;
+			exit(1);
+		}
+		return SyncDiff(argv[1], argv[2]);
+	}
 	if (!FLAGS_demofile.empty()) {
 		filename = FLAGS_demofile;
 	} else if (argc >= 2) {
@@ -478,3 +492,49 @@ void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string&
 		exit(1);
 	}
 };
+
+
+int SyncDiff(const std::string& fileA, const std::string& fileB)
+{
+	std::vector<SyncSectionChecksums> runA;
+	std::vector<SyncSectionChecksums> runB;
+
+	if (!CSyncSectionLog::Read(fileA, runA)) {
+		std::cout << "could not read sync section log " << fileA << std::endl;
+		return 1;
+	}
+	if (!CSyncSectionLog::Read(fileB, runB)) {
+		std::cout << "could not read sync section log " << fileB << std::endl;
+		return 1;
+	}
+
+	size_t index = 0;
+	const unsigned section = SyncSections::FindFirstDivergence(runA, runB, &index);
+
+	if (section == SYNC_SECTION_COUNT) {
+		std::cout << "no divergence in " << index << " common frames";
+		if (runA.size() != runB.size())
+			std::cout << " (runs have " << runA.size() << " and " << runB.size() << " frames)";
+		std::cout << std::endl;
+		return 0;
+	}
+
+	const SyncSectionChecksums& a = runA[index];
+	const SyncSectionChecksums& b = runB[index];
+
+	if (a.frameNum != b.frameNum) {
+		std::cout << "record " << index << " is frame " << a.frameNum << " in " << fileA << " but frame " << b.frameNum << " in " << fileB << std::endl;
+		return 2;
+	}
+
+	std::cout << "first divergence in frame " << a.frameNum << ", section " << SyncSections::GetName(section) << std::endl;
+
+	for (unsigned n = 0; n < SYNC_SECTION_COUNT; ++n) {
+		std::cout << std::setw(12) << SyncSections::GetName(n) << std::hex
+			<< "  " << std::setw(8) << std::setfill('0') << a.checksums[n]
+			<< "  " << std::setw(8) << b.checksums[n]
+			<< std::setfill(' ') << std::dec << ((a.checksums[n] != b.checksums[n])? "  *": "") << std::endl;
+	}
+
+	return 2;
+}